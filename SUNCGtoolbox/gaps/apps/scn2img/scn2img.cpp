@@ -69,6 +69,14 @@ static RNScalar kinect_noise_fraction = 0.05;
 static RNScalar kinect_stereo_baseline = 0.075;
 
 
+// Image writing program variables
+
+static int encoder_threads = -1;
+static int png_compression_level = -1;
+static int png_compression_strategy = -1;
+static int png_filters = -1;
+
+
 // Informational program variables
 
 static int print_verbose = 0;
@@ -109,6 +117,7 @@ enum {
 static R3Scene *scene = NULL;
 static RNArray<R3Camera *> cameras;
 static int next_image_index = 0;
+static R2ImageWriter *image_writer = NULL;
 
 
 
@@ -272,14 +281,8 @@ EstimateGroundY(const R3Camera& camera, R3Scene *scene)
   if (!scene) return 0;
 
   // Check if scene has a node named "Room#*" containing camera
-  for (int i = 0; i < scene->NNodes(); i++) {
-    R3SceneNode *node = scene->Node(i);
-    if (node->Name() && !strncmp(node->Name(), "Room#", 5)) {
-      if (R3Contains(node->BBox(), camera.Origin())) {
-        return node->BBox().YMin();
-      }
-    }
-  }
+  R3SceneNode *room = scene->SUNCGRoom(camera.Origin());
+  if (room) return room->BBox().YMin();
 
 #if 0
   // Check first intersection with ray cast straight down
@@ -348,6 +351,60 @@ ComputeBoundaryImage(const R2Grid& depth_image, const R2Grid& node_image,
 
 
 
+static int
+WriteImage(const R2Grid& image, const char *filename)
+{
+  // Queue image for encoder threads, or write it now
+  if (image_writer) return image_writer->Write(image, filename);
+  else return image.WriteFile(filename);
+}
+
+
+
+static int
+WriteImage(const R2Image& image, const char *filename)
+{
+  // Queue image for encoder threads, or write it now
+  if (image_writer) return image_writer->Write(image, filename);
+  else return image.Write(filename);
+}
+
+
+
+static int
+FlushImages(void)
+{
+  // Wait for encoder threads to write all queued images
+  if (!image_writer) return 1;
+  if (!image_writer->Flush()) {
+    fprintf(stderr, "Unable to write some images\n");
+    return 0;
+  }
+
+  // Return success
+  return 1;
+}
+
+
+
+static int
+CreateImageWriter(void)
+{
+  // Check number of encoder threads (0 writes images synchronously)
+  if (encoder_threads == 0) return 1;
+
+  // Create image writer
+  image_writer = new R2ImageWriter((encoder_threads > 0) ? encoder_threads : 0);
+  image_writer->SetPNGCompressionLevel(png_compression_level);
+  image_writer->SetPNGCompressionStrategy(png_compression_strategy);
+  image_writer->SetPNGFilters(png_filters);
+
+  // Return success
+  return 1;
+}
+
+
+
 ////////////////////////////////////////////////////////////////////////
 // Image capture functions
 ////////////////////////////////////////////////////////////////////////
@@ -505,7 +562,7 @@ CaptureDepth(R2Grid& image)
 ////////////////////////////////////////////////////////////////////////
 
 static void 
-DrawNodeWithOpenGL(const R3Camera& camera, R3Scene *scene, R3SceneNode *node, int color_scheme, RNBoolean omit_objects = FALSE)
+DrawNodeWithOpenGL(const R3Camera& camera, R3Scene *scene, R3SceneNode *node, int color_scheme, RNScalar ground_y, RNBoolean omit_objects = FALSE)
 {
   // Check if should omit object
   if (omit_objects && node->Name() && !strncmp(node->Name(), "Object#", 7)) return;
@@ -515,7 +572,7 @@ DrawNodeWithOpenGL(const R3Camera& camera, R3Scene *scene, R3SceneNode *node, in
     // Recurse to children
     for (int i = 0; i < node->NChildren(); i++) {
       R3SceneNode *child = node->Child(i);
-      DrawNodeWithOpenGL(camera, scene, child, color_scheme, omit_objects);
+      DrawNodeWithOpenGL(camera, scene, child, color_scheme, ground_y, omit_objects);
     }
   }
   else {
@@ -602,7 +659,6 @@ DrawNodeWithOpenGL(const R3Camera& camera, R3Scene *scene, R3SceneNode *node, in
     }
     else if ((color_scheme == DEPTH_COLOR_SCHEME) || (color_scheme == NDOTV_COLOR_SCHEME) || (color_scheme == HEIGHT_COLOR_SCHEME)) {
       // Draw scalar values interpolated between triangle vertices
-      RNScalar ground_y = (color_scheme == HEIGHT_COLOR_SCHEME) ? EstimateGroundY(camera, scene) : 0;
       glBegin(GL_TRIANGLES);
       for (int i = 0; i < node->NElements(); i++) {
         R3SceneElement *element = node->Element(i);
@@ -655,7 +711,7 @@ DrawSceneWithOpenGL(const R3Camera& camera, R3Scene *scene, int color_scheme, RN
     glEnable(GL_LIGHTING);
     scene->LoadLights(headlight);
     R3null_material.Draw();
-    DrawNodeWithOpenGL(camera, scene, scene->Root(), color_scheme, omit_objects);
+    DrawNodeWithOpenGL(camera, scene, scene->Root(), color_scheme, 0, omit_objects);
     R3null_material.Draw();
   }
   else if (color_scheme == ALBEDO_COLOR_SCHEME) {
@@ -683,7 +739,7 @@ DrawSceneWithOpenGL(const R3Camera& camera, R3Scene *scene, int color_scheme, RN
     glDisable(GL_LIGHT0);
     glEnable(GL_LIGHTING);
     R3null_material.Draw();
-    DrawNodeWithOpenGL(camera, scene, scene->Root(), color_scheme, omit_objects);
+    DrawNodeWithOpenGL(camera, scene, scene->Root(), color_scheme, 0, omit_objects);
     R3null_material.Draw();
     glEnable(GL_LIGHT0);
 
@@ -697,11 +753,14 @@ DrawSceneWithOpenGL(const R3Camera& camera, R3Scene *scene, int color_scheme, RN
     }
   }
   else {
+    // Estimate ground height once for all nodes drawn from camera
+    RNScalar ground_y = (color_scheme == HEIGHT_COLOR_SCHEME) ? EstimateGroundY(camera, scene) : 0;
+
     // Draw scene
     glDisable(GL_LIGHTING);
     glColor3d(1.0, 1.0, 1.0);
     R3null_material.Draw();
-    DrawNodeWithOpenGL(camera, scene, scene->Root(), color_scheme, omit_objects);
+    DrawNodeWithOpenGL(camera, scene, scene->Root(), color_scheme, ground_y, omit_objects);
     R3null_material.Draw();
   }
 
@@ -731,6 +790,7 @@ void Redraw(void)
       printf("  # Images = %d\n", next_image_index);
       fflush(stdout);
     }
+    if (!FlushImages()) exit(-1);
     exit(0);
   }
 
@@ -779,7 +839,7 @@ void Redraw(void)
         image.Multiply(1000);
         char output_image_filename[1024];
         sprintf(output_image_filename, "%s/%s_depth.png", output_image_directory, name);
-        image.WriteFile(output_image_filename);
+        WriteImage(image, output_image_filename);
       }
     }
   }
@@ -792,7 +852,7 @@ void Redraw(void)
       if (CaptureScalar(image)) {
         char output_image_filename[1024];
         sprintf(output_image_filename, "%s/%s_depth2.png", output_image_directory, name);
-        image.WriteFile(output_image_filename);
+        WriteImage(image, output_image_filename);
       }
     }
   }
@@ -805,7 +865,7 @@ void Redraw(void)
       if (CaptureScalar(image)) {
         char output_image_filename[1024];
         sprintf(output_image_filename, "%s/%s_height.png", output_image_directory, name);
-        image.WriteFile(output_image_filename);
+        WriteImage(image, output_image_filename);
       }
     }
   }
@@ -817,7 +877,7 @@ void Redraw(void)
       if (CaptureInteger(image)) {
         char output_image_filename[1024];
         sprintf(output_image_filename, "%s/%s_angle.pfm", output_image_directory, name);
-        image.WriteFile(output_image_filename);
+        WriteImage(image, output_image_filename);
       }
     }
   }
@@ -830,7 +890,7 @@ void Redraw(void)
         image.Multiply(65535.0/255.0);
         char output_image_filename[1024];
         sprintf(output_image_filename, "%s/%s_ndotv.png", output_image_directory, name);
-        image.WriteFile(output_image_filename);
+        WriteImage(image, output_image_filename);
       }
     }
   }
@@ -842,7 +902,7 @@ void Redraw(void)
       if (CaptureColor(albedo_image)) {
         char output_image_filename[1024];
         sprintf(output_image_filename, "%s/%s_albedo.jpg", output_image_directory, name);
-        albedo_image.Write(output_image_filename);
+        WriteImage(albedo_image, output_image_filename);
       }
     }
   }
@@ -854,7 +914,7 @@ void Redraw(void)
       if (CaptureColor(brdf_image)) {
         char output_image_filename[1024];
         sprintf(output_image_filename, "%s/%s_brdf.jpg", output_image_directory, name);
-        brdf_image.Write(output_image_filename);
+        WriteImage(brdf_image, output_image_filename);
       }
     }
   }
@@ -866,7 +926,7 @@ void Redraw(void)
       if (CaptureInteger(image)) {
         char output_image_filename[1024];
         sprintf(output_image_filename, "%s/%s_material.png", output_image_directory, name);
-        image.WriteFile(output_image_filename);
+        WriteImage(image, output_image_filename);
       }
     }
   }
@@ -878,7 +938,7 @@ void Redraw(void)
       if (CaptureInteger(image)) {
         char output_image_filename[1024];
         sprintf(output_image_filename, "%s/%s_node.png", output_image_directory, name);
-        image.WriteFile(output_image_filename);
+        WriteImage(image, output_image_filename);
       }
     }
   }
@@ -890,7 +950,7 @@ void Redraw(void)
       if (CaptureInteger(image)) {
         char output_image_filename[1024];
         sprintf(output_image_filename, "%s/%s_category.png", output_image_directory, name);
-        image.WriteFile(output_image_filename);
+        WriteImage(image, output_image_filename);
       }
     }
   }
@@ -902,7 +962,7 @@ void Redraw(void)
       if (CaptureInteger(image)) {
         char output_image_filename[1024];
         sprintf(output_image_filename, "%s/%s_room_surface.png", output_image_directory, name);
-        image.WriteFile(output_image_filename);
+        WriteImage(image, output_image_filename);
       }
     }
   }
@@ -913,15 +973,15 @@ void Redraw(void)
     sprintf(output_image_filename, "%s/%s_xnormal.png", output_image_directory, name);
     DrawSceneWithOpenGL(*camera, scene, XNORMAL_COLOR_SCHEME);
     if (!CaptureInteger(image)) return;
-    image.WriteFile(output_image_filename);
+    WriteImage(image, output_image_filename);
     sprintf(output_image_filename, "%s/%s_ynormal.png", output_image_directory, name);
     DrawSceneWithOpenGL(*camera, scene, YNORMAL_COLOR_SCHEME);
     if (!CaptureInteger(image)) return;
-    image.WriteFile(output_image_filename);
+    WriteImage(image, output_image_filename);
     sprintf(output_image_filename, "%s/%s_znormal.png", output_image_directory, name);
     DrawSceneWithOpenGL(*camera, scene, ZNORMAL_COLOR_SCHEME);
     if (!CaptureInteger(image)) return;
-    image.WriteFile(output_image_filename);
+    WriteImage(image, output_image_filename);
   }
   
   // Capture and write boundary image 
@@ -942,7 +1002,7 @@ void Redraw(void)
     if (ComputeBoundaryImage(depth_image, node_image, xnormal_image, ynormal_image, znormal_image, image)) {
       char output_image_filename[1024];
       sprintf(output_image_filename, "%s/%s_boundary.png", output_image_directory, name);
-      image.WriteFile(output_image_filename);
+      WriteImage(image, output_image_filename);
     }
   }
 
@@ -964,7 +1024,7 @@ void Redraw(void)
     if (ComputeBoundaryImage(depth_image, node_image, xnormal_image, ynormal_image, znormal_image, image)) {
       char output_image_filename[1024];
       sprintf(output_image_filename, "%s/%s_room_boundary.png", output_image_directory, name);
-      image.WriteFile(output_image_filename);
+      WriteImage(image, output_image_filename);
     }
   }
 
@@ -1055,7 +1115,7 @@ void Redraw(void)
     kinect_image.Multiply(1000);
     char output_image_filename[1024];
     sprintf(output_image_filename, "%s/%s_kinect.png", output_image_directory, name);
-    kinect_image.WriteFile(output_image_filename);
+    WriteImage(kinect_image, output_image_filename);
   }
 
   // Draw, capture, and write color image 
@@ -1065,7 +1125,7 @@ void Redraw(void)
       if (CaptureColor(color_image)) {
         char output_image_filename[1024];
         sprintf(output_image_filename, "%s/%s_color.jpg", output_image_directory, name);
-        color_image.Write(output_image_filename);
+        WriteImage(color_image, output_image_filename);
       }
     }
   }
@@ -1274,43 +1334,43 @@ RenderImagesWithRaycasting(const R3Camera& camera, R3Scene *scene, const char *o
   // Write images
   if (capture_depth_images) {
     sprintf(output_image_filename, "%s/%06d_depth.png", output_image_directory, image_index);
-    depth_image.WriteFile(output_image_filename);
+    WriteImage(depth_image, output_image_filename);
   }
   if (capture_height_images) {
     sprintf(output_image_filename, "%s/%06d_height.png", output_image_directory, image_index);
-    height_image.WriteFile(output_image_filename);
+    WriteImage(height_image, output_image_filename);
   }
   if (capture_angle_images) {
     sprintf(output_image_filename, "%s/%06d_angle.png", output_image_directory, image_index);
-    angle_image.WriteFile(output_image_filename);
+    WriteImage(angle_image, output_image_filename);
   }
   if (capture_normal_images) {
     sprintf(output_image_filename, "%s/%06d_xnormal.png", output_image_directory, image_index);
-    xnormal_image.WriteFile(output_image_filename);
+    WriteImage(xnormal_image, output_image_filename);
     sprintf(output_image_filename, "%s/%06d_ynormal.png", output_image_directory, image_index);
-    ynormal_image.WriteFile(output_image_filename);
+    WriteImage(ynormal_image, output_image_filename);
     sprintf(output_image_filename, "%s/%06d_znormal.png", output_image_directory, image_index);
-    znormal_image.WriteFile(output_image_filename);
+    WriteImage(znormal_image, output_image_filename);
   }
   if (capture_ndotv_images) {
     sprintf(output_image_filename, "%s/%06d_ndotv.png", output_image_directory, image_index);
-    ndotv_image.WriteFile(output_image_filename);
+    WriteImage(ndotv_image, output_image_filename);
   }
   if (capture_brdf_images) {
     sprintf(output_image_filename, "%s/%06d_brdf.jpg", output_image_directory, image_index);
-    brdf_image.Write(output_image_filename);
+    WriteImage(brdf_image, output_image_filename);
   }
   if (capture_material_images) {
     sprintf(output_image_filename, "%s/%06d_material.png", output_image_directory, image_index);
-    material_image.WriteFile(output_image_filename);
+    WriteImage(material_image, output_image_filename);
   }
   if (capture_node_images) {
     sprintf(output_image_filename, "%s/%06d_node.png", output_image_directory, image_index);
-    node_image.WriteFile(output_image_filename);
+    WriteImage(node_image, output_image_filename);
   }
   if (capture_category_images) {
     sprintf(output_image_filename, "%s/%06d_category.png", output_image_directory, image_index);
-    node_image.WriteFile(output_image_filename);
+    WriteImage(node_image, output_image_filename);
   }
 
   // Return success
@@ -1341,6 +1401,9 @@ RenderImagesWithRaycasting(const char *output_image_directory)
     if (!RenderImagesWithRaycasting(*camera, scene, output_image_directory, i)) return 0;
   }
 
+  // Wait for queued images to be written
+  if (!FlushImages()) return 0;
+
   // Print message
   if (print_verbose) {
     printf("  Time = %.2f seconds\n", start_time.Elapsed());
@@ -1418,6 +1481,26 @@ ParseArgs(int argc, char **argv)
       else if (!strcmp(*argv, "-height")) { argc--; argv++; height = atoi(*argv); }
       else if (!strcmp(*argv, "-xfov")) { argc--; argv++; xfov = atof(*argv); }
       else if (!strcmp(*argv, "-headlight")) { headlight = 1; }
+      else if (!strcmp(*argv, "-encoder_threads")) { argc--; argv++; encoder_threads = atoi(*argv); }
+      else if (!strcmp(*argv, "-png_compression_level")) { argc--; argv++; png_compression_level = atoi(*argv); }
+      else if (!strcmp(*argv, "-png_compression_strategy")) {
+        argc--; argv++;
+        if (!strcmp(*argv, "default")) png_compression_strategy = R2_PNG_DEFAULT_STRATEGY;
+        else if (!strcmp(*argv, "filtered")) png_compression_strategy = R2_PNG_FILTERED_STRATEGY;
+        else if (!strcmp(*argv, "huffman")) png_compression_strategy = R2_PNG_HUFFMAN_ONLY_STRATEGY;
+        else if (!strcmp(*argv, "rle")) png_compression_strategy = R2_PNG_RLE_STRATEGY;
+        else { fprintf(stderr, "Invalid png compression strategy: %s\n", *argv); exit(1); }
+      }
+      else if (!strcmp(*argv, "-png_filter")) {
+        argc--; argv++;
+        if (!strcmp(*argv, "none")) png_filters = R2_PNG_FILTER_NONE;
+        else if (!strcmp(*argv, "sub")) png_filters = R2_PNG_FILTER_SUB;
+        else if (!strcmp(*argv, "up")) png_filters = R2_PNG_FILTER_UP;
+        else if (!strcmp(*argv, "avg")) png_filters = R2_PNG_FILTER_AVG;
+        else if (!strcmp(*argv, "paeth")) png_filters = R2_PNG_FILTER_PAETH;
+        else if (!strcmp(*argv, "all")) png_filters = R2_PNG_FILTER_ALL;
+        else { fprintf(stderr, "Invalid png filter: %s\n", *argv); exit(1); }
+      }
       else if (!strcmp(*argv, "-background")) {
         argc--; argv++; background[0] = atof(*argv);
         argc--; argv++; background[1] = atof(*argv);
@@ -1461,6 +1544,12 @@ ParseArgs(int argc, char **argv)
     return 0;
   }
 
+  // Check png options (they are applied only by encoder threads)
+  if ((encoder_threads == 0) && ((png_compression_level >= 0) || (png_compression_strategy >= 0) || (png_filters >= 0))) {
+    fprintf(stderr, "Png compression options cannot be used with -encoder_threads 0\n");
+    return 0;
+  }
+
   // Return OK status 
   return 1;
 }
@@ -1491,9 +1580,15 @@ int main(int argc, char **argv)
   if (input_lights_name) { if (!ReadLights(input_lights_name)) exit(-1); }
   else { scene->CreateDirectionalLights(); headlight = 1; }
 
+  // Create image writer
+  if (!CreateImageWriter()) exit(-1);
+
   // Render images
   if (!RenderImages(output_image_directory)) exit(-1);
 
+  // Delete image writer
+  if (image_writer) delete image_writer;
+
   // Return success 
   return 0;
 }
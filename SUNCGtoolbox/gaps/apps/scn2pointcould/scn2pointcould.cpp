@@ -5,6 +5,9 @@
 // Include files 
 
 #include "R3Graphics/R3Graphics.h"
+#include "R3Surfels/R3Surfels.h"
+#include <mutex>
+#include <condition_variable>
 
 
 // Program arguments
@@ -37,14 +40,30 @@ ReadScene(const char *filename)
   return scene;
 }
 
+////////////////////////////////////////////////////////////////////////
+// Triangle traversal
+////////////////////////////////////////////////////////////////////////
+
+typedef void (*TriangleCallback)(const R3Point& p0, const R3Point& p1, const R3Point& p2,
+  const R2Point& t0, const R2Point& t1, const R2Point& t2, int label, const RNRgb& rgb, R2Image *image, void *data);
+
+static R2Image *
+MaterialImage(R3Material *material)
+{
+  // Return texture image of material (or an empty image if it has none)
+  static R2Image empty_image;
+  if (!material->IsTextured()) return &empty_image;
+  return (R2Image *) material->Texture()->Image();
+}
+
 static void
-RasterizeTriangles(R3Grid *grid, R3Scene *scene, R3SceneNode *node, const R3Affine& parent_transformation)
+VisitTriangles(R3Scene *scene, R3SceneNode *node, const R3Affine& parent_transformation, TriangleCallback callback, void *data)
 {
   // Update transformation
   R3Affine transformation = R3identity_affine;
   transformation.Transform(parent_transformation);
   transformation.Transform(node->Transformation());
-  // Rasterize triangles
+  // Visit triangles
   if(node->NReferences()>0)
   {
 
@@ -61,11 +80,7 @@ RasterizeTriangles(R3Grid *grid, R3Scene *scene, R3SceneNode *node, const R3Affi
         R3SceneElement *element = node_new->Element(i);
         const RNRgb& rn = element->Material()->Brdf()->Ambient();
         RNBoolean f = element->Material()->IsTextured();
-        R2Image *img = new R2Image();
-        if(f)
-        {
-          *img = *element->Material()->Texture()->Image();
-        }
+        R2Image *img = MaterialImage(element->Material());
         double r =(double)rn.R();
 	    double g =(double)rn.G();
 	    double b =(double)rn.B();
@@ -97,14 +112,14 @@ RasterizeTriangles(R3Grid *grid, R3Scene *scene, R3SceneNode *node, const R3Affi
                 t1 = v1->TextureCoords();
                 t2 = v2->TextureCoords();
               }
-              grid->RasterizeWorldTriangleMat(p0, p1, p2, t0, t1, t2, 1.0, label_mark1,rgb,img);
+              (*callback)(p0, p1, p2, t0, t1, t2, label_mark1, rgb, img, data);
             }
           }
         }
         for (int i = 0; i < node_new->NChildren(); i++) 
         {
           R3SceneNode *child = node_new->Child(i);
-          RasterizeTriangles(grid, scene, child, transformation);
+          VisitTriangles(scene, child, transformation, callback, data);
         }
       }
     }
@@ -121,12 +136,7 @@ RasterizeTriangles(R3Grid *grid, R3Scene *scene, R3SceneNode *node, const R3Affi
       R3SceneElement *element = node->Element(i);
       const RNRgb& rn = element->Material()->Brdf()->Ambient();
       RNBoolean f = element->Material()->IsTextured();
-      R2Image *img = new R2Image();
-
-      if(f)
-      {
-        *img = *element->Material()->Texture()->Image();
-      }
+      R2Image *img = MaterialImage(element->Material());
       double r =(double)rn.R();
 	  double g =(double)rn.G();
 	  double b =(double)rn.B();
@@ -158,26 +168,107 @@ RasterizeTriangles(R3Grid *grid, R3Scene *scene, R3SceneNode *node, const R3Affi
               t1 = v1->TextureCoords();
               t2 = v2->TextureCoords();
             }
-            grid->RasterizeWorldTriangleMat(p0, p1, p2, t0, t1, t2, 1.0,label_mark2,rgb,img);
+            (*callback)(p0, p1, p2, t0, t1, t2, label_mark2, rgb, img, data);
           }
         }
       }
     }
 
-    // Rasterize children
+    // Visit children
     for (int i = 0; i < node->NChildren(); i++) 
     {
       R3SceneNode *child = node->Child(i);
-      RasterizeTriangles(grid, scene, child, transformation);
+      VisitTriangles(scene, child, transformation, callback, data);
     }
   }
 }
 
 
-static R3Grid *
-CreateGrid(R3Scene *scene,int x,int y,int z)
+
+////////////////////////////////////////////////////////////////////////
+// Texture reduction
+////////////////////////////////////////////////////////////////////////
+
+struct TextureReducer {
+  R3Affine world_to_grid;
+  RNArray<R2Image *> images;
+  RNArray<int *> levels;
+  int last;
+};
+
+static void
+FootprintTriangle(const R3Point& p0, const R3Point& p1, const R3Point& p2,
+  const R2Point& t0, const R2Point& t1, const R2Point& t2, int label, const RNRgb& rgb, R2Image *image, void *data)
 {
+  // Check image
+  if (image->RowSize() <= 0) return;
+  TextureReducer *reducer = (TextureReducer *) data;
+
+  // Compute area of triangle in voxels
+  R3Point q0 = p0; q0.Transform(reducer->world_to_grid);
+  R3Point q1 = p1; q1.Transform(reducer->world_to_grid);
+  R3Point q2 = p2; q2.Transform(reducer->world_to_grid);
+  RNArea voxel_area = ((q1 - q0) % (q2 - q0)).Length();
+  if (voxel_area <= 0) return;
+
+  // Compute mip level at which one voxel covers about one texel (as in R3Grid rasterization)
+  int level = image->FootprintLevel(t0, t1, t2, voxel_area);
+
+  // Find entry for image (consecutive triangles usually share a material)
+  int k = reducer->last;
+  if ((k < 0) || (reducer->images.Kth(k) != image)) {
+    for (k = 0; k < reducer->images.NEntries(); k++) {
+      if (reducer->images.Kth(k) == image) break;
+    }
+    if (k == reducer->images.NEntries()) {
+      reducer->images.Insert(image);
+      reducer->levels.Insert(new int(level));
+    }
+    reducer->last = k;
+  }
 
+  // Keep finest level required by any triangle
+  int *image_level = reducer->levels.Kth(k);
+  if (level < *image_level) *image_level = level;
+}
+
+
+static void
+ReduceTextures(R3Scene *scene, const R3Affine& world_to_grid)
+{
+  // Find finest mip level needed by every texture at this grid spacing
+  TextureReducer reducer;
+  reducer.world_to_grid = world_to_grid;
+  reducer.last = -1;
+  VisitTriangles(scene, scene->Root(), R3identity_affine, FootprintTriangle, &reducer);
+
+  // Replace textures by their reduced levels (frees full resolution texels)
+  for (int i = 0; i < reducer.images.NEntries(); i++) {
+    int *level = reducer.levels.Kth(i);
+    if (*level > 0) reducer.images.Kth(i)->Reduce(*level);
+    delete level;
+  }
+}
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Dense grid conversion
+////////////////////////////////////////////////////////////////////////
+
+static void
+RasterizeTriangle(const R3Point& p0, const R3Point& p1, const R3Point& p2,
+  const R2Point& t0, const R2Point& t1, const R2Point& t2, int label, const RNRgb& rgb, R2Image *image, void *data)
+{
+  // Rasterize triangle into grid
+  R3Grid *grid = (R3Grid *) data;
+  grid->RasterizeWorldTriangleMat(p0, p1, p2, t0, t1, t2, 1.0, label, rgb, image);
+}
+
+
+static R3Box
+GridBBox(R3Scene *scene)
+{
   // Get bounding box
   R3Box bbox = scene->BBox();
   if (grid_boundary_radius > 0) {
@@ -185,28 +276,54 @@ CreateGrid(R3Scene *scene,int x,int y,int z)
     bbox[1] += R3Vector(grid_boundary_radius, grid_boundary_radius, grid_boundary_radius);
   }
 
+  // Return bounding box
+  return bbox;
+}
+
+
+static void
+GridResolution(const R3Box& bbox, int max_resolution, int x, int y, int z, int resolution[3])
+{
   // Compute grid spacing
   RNLength diameter = bbox.LongestAxisLength();
-  RNLength min_grid_spacing = (grid_max_resolution > 0) ? diameter / grid_max_resolution : RN_EPSILON;
-  if (grid_spacing == 0) grid_spacing = diameter / 256;
-  if (grid_spacing < min_grid_spacing) grid_spacing = min_grid_spacing;
+  RNLength min_grid_spacing = (max_resolution > 0) ? diameter / max_resolution : RN_EPSILON;
+  RNLength spacing = grid_spacing;
+  if (spacing == 0) spacing = diameter / 256;
+  if (spacing < min_grid_spacing) spacing = min_grid_spacing;
 
   // Compute grid resolution
-  int xres = (int) (bbox.XLength() / grid_spacing + 0.5); if (xres == 0) xres = 1;
-  int yres = (int) (bbox.YLength() / grid_spacing + 0.5); if (yres == 0) yres = 1;
-  int zres = (int) (bbox.ZLength() / grid_spacing + 0.5); if (zres == 0) zres = 1;
+  int xres = (int) (bbox.XLength() / spacing + 0.5); if (xres == 0) xres = 1;
+  int yres = (int) (bbox.YLength() / spacing + 0.5); if (yres == 0) yres = 1;
+  int zres = (int) (bbox.ZLength() / spacing + 0.5); if (zres == 0) zres = 1;
   if (x>0) xres = x;
   if (y>0) yres = y;
   if (z>0) zres = z;
+  resolution[0] = xres;
+  resolution[1] = yres;
+  resolution[2] = zres;
+}
+
+
+static R3Grid *
+CreateGrid(R3Scene *scene,int x,int y,int z)
+{
+  // Compute grid bounding box and resolution
+  int resolution[3];
+  R3Box bbox = GridBBox(scene);
+  GridResolution(bbox, grid_max_resolution, x, y, z, resolution);
+
   // Allocate grid
-  R3Grid *grid = new R3Grid(xres, yres, zres, bbox);
+  R3Grid *grid = new R3Grid(resolution[0], resolution[1], resolution[2], bbox);
   if (!grid) {
     fprintf(stderr, "Unable to allocate grid\n");
     return NULL;
   }
 
+  // Reduce textures to the resolution of the grid
+  ReduceTextures(scene, grid->WorldToGridTransformation());
+
   // Rasterize scene into grid
-  RasterizeTriangles(grid, scene, scene->Root(), R3identity_affine);
+  VisitTriangles(scene, scene->Root(), R3identity_affine, RasterizeTriangle, grid);
 
   // Threshold grid (to compensate for possible double rasterization)
   grid->Threshold(0.5, 0.0, 1.0);
@@ -215,6 +332,361 @@ CreateGrid(R3Scene *scene,int x,int y,int z)
   return grid;
 }
 
+
+
+////////////////////////////////////////////////////////////////////////
+// Bricked grid conversion
+////////////////////////////////////////////////////////////////////////
+
+// Output callback (receives npoints records of i,j,k,r,g,b,label)
+
+typedef void (*PointCallback)(const double *points, int npoints, void *data);
+
+
+struct BrickTriangle {
+  double w[3][3];
+  int imin[3], imax[3];
+  R2Point t[3];
+  int label;
+  RNRgb rgb;
+  R2Image *image;
+};
+
+
+struct BrickConverter {
+  R3Affine world_to_grid;
+  int resolution[3];
+  int brick_resolution;
+  int nbricks[3];
+  BrickTriangle *triangles;
+  int ntriangles;
+  int *brick_offsets;
+  int *brick_triangles;
+  R3Grid **thread_grids;
+  double **brick_points;
+  int *brick_npoints;
+  RNBoolean *brick_done;
+  int next_brick;
+  int max_pending_bricks;
+  int npoints;
+  std::mutex mutex;
+  std::condition_variable brick_emitted;
+  PointCallback callback;
+  void *callback_data;
+};
+
+
+static R3Affine
+GridTransformation(const R3Box& world_box, const int resolution[3])
+{
+  // Compute world-to-grid transformation exactly as R3Grid does for a bounding box
+  R3Vector grid_diagonal(resolution[0]-1, resolution[1]-1, resolution[2]-1);
+  R3Vector grid_origin = 0.5 * grid_diagonal;
+  R3Vector world_diagonal(world_box.XLength(), world_box.YLength(), world_box.ZLength());
+  R3Vector world_origin = world_box.Centroid().Vector();
+  RNScalar scale = FLT_MAX;
+  for (int dim = 0; dim < 3; dim++) {
+    RNScalar dim_scale = (world_diagonal[dim] > 0) ? grid_diagonal[dim] / world_diagonal[dim] : FLT_MAX;
+    if (dim_scale < scale) scale = dim_scale;
+  }
+  if (scale == FLT_MAX) scale = 1;
+  R3Affine affine(R3identity_affine);
+  affine.Translate(grid_origin);
+  if (scale != 1) affine.Scale(scale);
+  affine.Translate(-world_origin);
+  return affine;
+}
+
+
+static void
+CountTriangle(const R3Point& p0, const R3Point& p1, const R3Point& p2,
+  const R2Point& t0, const R2Point& t1, const R2Point& t2, int label, const RNRgb& rgb, R2Image *image, void *data)
+{
+  // Count triangle
+  BrickConverter *converter = (BrickConverter *) data;
+  converter->ntriangles++;
+}
+
+
+static void
+InsertTriangle(const R3Point& p0, const R3Point& p1, const R3Point& p2,
+  const R2Point& t0, const R2Point& t1, const R2Point& t2, int label, const RNRgb& rgb, R2Image *image, void *data)
+{
+  // Compute grid coordinates (same rounding as R3Grid::RasterizeGridTriangleMat)
+  BrickConverter *converter = (BrickConverter *) data;
+  BrickTriangle *triangle = &converter->triangles[converter->ntriangles];
+  const R3Point *p[3] = { &p0, &p1, &p2 };
+  for (int v = 0; v < 3; v++) {
+    R3Point q = *p[v];
+    q.Transform(converter->world_to_grid);
+    for (int dim = 0; dim < 3; dim++) triangle->w[v][dim] = (double) q[dim];
+  }
+
+  // Skip degenerate triangles
+  const double *w1 = triangle->w[0], *w2 = triangle->w[1], *w3 = triangle->w[2];
+  double s1 = sqrt((w1[0]-w2[0])*(w1[0]-w2[0])+(w1[1]-w2[1])*(w1[1]-w2[1])+(w1[2]-w2[2])*(w1[2]-w2[2]));
+  double s2 = sqrt((w1[0]-w3[0])*(w1[0]-w3[0])+(w1[1]-w3[1])*(w1[1]-w3[1])+(w1[2]-w3[2])*(w1[2]-w3[2]));
+  double s3 = sqrt((w3[0]-w2[0])*(w3[0]-w2[0])+(w3[1]-w2[1])*(w3[1]-w2[1])+(w3[2]-w2[2])*(w3[2]-w2[2]));
+  if (!(s1<s2+s3 && s2<s1+s3 && s3<s1+s2)) return;
+
+  // Compute range of voxels touched by triangle
+  for (int dim = 0; dim < 3; dim++) {
+    for (int v = 0; v < 3; v++) {
+      int i = (int) (triangle->w[v][dim] + 0.5);
+      if ((v == 0) || (i < triangle->imin[dim])) triangle->imin[dim] = i;
+      if ((v == 0) || (i > triangle->imax[dim])) triangle->imax[dim] = i;
+    }
+  }
+
+  // Fill in material
+  triangle->t[0] = t0;
+  triangle->t[1] = t1;
+  triangle->t[2] = t2;
+  triangle->label = label;
+  triangle->rgb = rgb;
+  triangle->image = image;
+  converter->ntriangles++;
+}
+
+
+static RNBoolean
+BrickRange(const BrickConverter *converter, const BrickTriangle *triangle, int bmin[3], int bmax[3])
+{
+  // Compute range of bricks overlapped by triangle
+  for (int dim = 0; dim < 3; dim++) {
+    int imin = triangle->imin[dim];
+    int imax = triangle->imax[dim];
+    if (imin < 0) imin = 0;
+    if (imax >= converter->resolution[dim]) imax = converter->resolution[dim] - 1;
+    if (imin > imax) return FALSE;
+    bmin[dim] = imin / converter->brick_resolution;
+    bmax[dim] = imax / converter->brick_resolution;
+  }
+
+  // Return success
+  return TRUE;
+}
+
+
+static void
+BinTriangles(BrickConverter *converter)
+{
+  // Count triangles per brick
+  int nbricks = converter->nbricks[0] * converter->nbricks[1] * converter->nbricks[2];
+  int *offsets = new int [ nbricks + 1 ];
+  for (int b = 0; b <= nbricks; b++) offsets[b] = 0;
+  for (int t = 0; t < converter->ntriangles; t++) {
+    int bmin[3], bmax[3];
+    if (!BrickRange(converter, &converter->triangles[t], bmin, bmax)) continue;
+    for (int bz = bmin[2]; bz <= bmax[2]; bz++) 
+      for (int by = bmin[1]; by <= bmax[1]; by++) 
+        for (int bx = bmin[0]; bx <= bmax[0]; bx++) 
+          offsets[(bz*converter->nbricks[1] + by)*converter->nbricks[0] + bx + 1]++;
+  }
+
+  // Compute offsets
+  for (int b = 0; b < nbricks; b++) offsets[b+1] += offsets[b];
+
+  // Fill triangle indices (in traversal order within each brick)
+  int *counts = new int [ nbricks ];
+  for (int b = 0; b < nbricks; b++) counts[b] = 0;
+  int *indices = new int [ offsets[nbricks] + 1 ];
+  for (int t = 0; t < converter->ntriangles; t++) {
+    int bmin[3], bmax[3];
+    if (!BrickRange(converter, &converter->triangles[t], bmin, bmax)) continue;
+    for (int bz = bmin[2]; bz <= bmax[2]; bz++) {
+      for (int by = bmin[1]; by <= bmax[1]; by++) {
+        for (int bx = bmin[0]; bx <= bmax[0]; bx++) {
+          int b = (bz*converter->nbricks[1] + by)*converter->nbricks[0] + bx;
+          indices[offsets[b] + counts[b]++] = t;
+        }
+      }
+    }
+  }
+
+  // Set brick lists
+  converter->brick_offsets = offsets;
+  converter->brick_triangles = indices;
+  delete [] counts;
+}
+
+
+static void
+ConvertBrick(BrickConverter *converter, int b, int thread)
+{
+  // Wait until brick is within a bounded window after the next one to be emitted,
+  // so that few finished bricks are held for ordering when an earlier one is slow
+  // (bricks are started in increasing order, so the next one is always in progress)
+  {
+    std::unique_lock<std::mutex> lock(converter->mutex);
+    while (b >= converter->next_brick + converter->max_pending_bricks) converter->brick_emitted.wait(lock);
+  }
+
+  // Compute brick origin and size
+  int brick_resolution = converter->brick_resolution;
+  int origin[3], size[3];
+  origin[0] = (b % converter->nbricks[0]) * brick_resolution;
+  origin[1] = ((b / converter->nbricks[0]) % converter->nbricks[1]) * brick_resolution;
+  origin[2] = (b / (converter->nbricks[0] * converter->nbricks[1])) * brick_resolution;
+  for (int dim = 0; dim < 3; dim++) {
+    size[dim] = converter->resolution[dim] - origin[dim];
+    if (size[dim] > brick_resolution) size[dim] = brick_resolution;
+  }
+
+  // Skip the last row and sheet, like the dense conversion does
+  if (origin[1] + size[1] > converter->resolution[1] - 1) size[1] = converter->resolution[1] - 1 - origin[1];
+  if (origin[2] + size[2] > converter->resolution[2] - 1) size[2] = converter->resolution[2] - 1 - origin[2];
+
+  // Rasterize triangles overlapping brick
+  double *points = NULL;
+  int npoints = 0;
+  int start = converter->brick_offsets[b];
+  int stop = converter->brick_offsets[b+1];
+  if ((start < stop) && (size[1] > 0) && (size[2] > 0)) {
+    // Rasterize triangles into thread's brick grid with brick-local coordinates
+    R3Grid *grid = converter->thread_grids[thread];
+    grid->Clear(0);
+    for (int t = start; t < stop; t++) {
+      BrickTriangle *triangle = &converter->triangles[converter->brick_triangles[t]];
+      int i[3][3];
+      double w[3][3];
+      for (int v = 0; v < 3; v++) {
+        for (int dim = 0; dim < 3; dim++) {
+          i[v][dim] = (int) (triangle->w[v][dim] + 0.5) - origin[dim];
+          w[v][dim] = triangle->w[v][dim] - origin[dim];
+        }
+      }
+      grid->RasterizeGridTriangleMat(i[0], i[1], i[2], w[0], w[1], w[2],
+        triangle->t[0], triangle->t[1], triangle->t[2], 1.0,
+        triangle->label, triangle->rgb, triangle->image);
+    }
+
+    // Count occupied voxels (thresholded at 0.5 to compensate for double rasterization)
+    for (int k = 0; k < size[2]; k++) 
+      for (int j = 0; j < size[1]; j++) 
+        for (int i = 0; i < size[0]; i++) 
+          if (grid->GridValue(i, j, k) > 0.5) npoints++;
+
+    // Gather occupied voxels with global grid indices
+    if (npoints > 0) {
+      points = new double [ 7 * npoints ];
+      double *pointsp = points;
+      for (int k = 0; k < size[2]; k++) {
+        for (int j = 0; j < size[1]; j++) {
+          for (int i = 0; i < size[0]; i++) {
+            if (grid->GridValue(i, j, k) <= 0.5) continue;
+            RNRgb RGB = grid->RgbValue(i, j, k);
+            *(pointsp++) = (double) (origin[0] + i);
+            *(pointsp++) = (double) (origin[1] + j);
+            *(pointsp++) = (double) (origin[2] + k);
+            *(pointsp++) = (double) RGB.R();
+            *(pointsp++) = (double) RGB.G();
+            *(pointsp++) = (double) RGB.B();
+            *(pointsp++) = (double) grid->LabelValue(i, j, k);
+          }
+        }
+      }
+    }
+  }
+
+  // Emit finished bricks in order, so that output is deterministic
+  std::unique_lock<std::mutex> lock(converter->mutex);
+  converter->brick_points[b] = points;
+  converter->brick_npoints[b] = npoints;
+  converter->brick_done[b] = TRUE;
+  int nbricks = converter->nbricks[0] * converter->nbricks[1] * converter->nbricks[2];
+  int first_brick = converter->next_brick;
+  while ((converter->next_brick < nbricks) && converter->brick_done[converter->next_brick]) {
+    int next = converter->next_brick++;
+    if (converter->brick_npoints[next] > 0) {
+      (*converter->callback)(converter->brick_points[next], converter->brick_npoints[next], converter->callback_data);
+      converter->npoints += converter->brick_npoints[next];
+      delete [] converter->brick_points[next];
+      converter->brick_points[next] = NULL;
+    }
+  }
+
+  // Wake threads waiting for the window of pending bricks to advance
+  if (converter->next_brick > first_brick) converter->brick_emitted.notify_all();
+}
+
+
+static int
+ConvertBricks(R3Scene *scene, int x, int y, int z, int brick_resolution, PointCallback callback, void *callback_data)
+{
+  // Check brick resolution
+  if (brick_resolution <= 0) brick_resolution = 64;
+
+  // Compute grid bounding box and resolution (not limited by grid_max_resolution)
+  BrickConverter converter;
+  R3Box bbox = GridBBox(scene);
+  GridResolution(bbox, 0, x, y, z, converter.resolution);
+  converter.world_to_grid = GridTransformation(bbox, converter.resolution);
+  converter.brick_resolution = brick_resolution;
+  for (int dim = 0; dim < 3; dim++) {
+    converter.nbricks[dim] = (converter.resolution[dim] + brick_resolution - 1) / brick_resolution;
+  }
+
+  // Reduce textures to the resolution of the grid
+  ReduceTextures(scene, converter.world_to_grid);
+
+  // Gather triangles in grid coordinates
+  converter.ntriangles = 0;
+  VisitTriangles(scene, scene->Root(), R3identity_affine, CountTriangle, &converter);
+  converter.triangles = new BrickTriangle [ converter.ntriangles + 1 ];
+  converter.ntriangles = 0;
+  VisitTriangles(scene, scene->Root(), R3identity_affine, InsertTriangle, &converter);
+
+  // Bin triangles into bricks
+  BinTriangles(&converter);
+
+  // Allocate one brick grid per thread (no larger than the whole grid)
+  int brick_size[3];
+  for (int dim = 0; dim < 3; dim++) {
+    brick_size[dim] = brick_resolution;
+    if (brick_size[dim] > converter.resolution[dim]) brick_size[dim] = converter.resolution[dim];
+  }
+  int nthreads = RNNumThreads();
+  converter.thread_grids = new R3Grid * [ nthreads ];
+  for (int t = 0; t < nthreads; t++) {
+    converter.thread_grids[t] = new R3Grid(brick_size[0], brick_size[1], brick_size[2]);
+  }
+
+  // Allocate brick results
+  int nbricks = converter.nbricks[0] * converter.nbricks[1] * converter.nbricks[2];
+  converter.brick_points = new double * [ nbricks ];
+  converter.brick_npoints = new int [ nbricks ];
+  converter.brick_done = new RNBoolean [ nbricks ];
+  for (int b = 0; b < nbricks; b++) {
+    converter.brick_points[b] = NULL;
+    converter.brick_npoints[b] = 0;
+    converter.brick_done[b] = FALSE;
+  }
+  converter.next_brick = 0;
+  converter.max_pending_bricks = 2 * nthreads;
+  converter.npoints = 0;
+  converter.callback = callback;
+  converter.callback_data = callback_data;
+
+  // Convert bricks in parallel
+  RNParallelFor(0, nbricks, [&](int b, int thread) { ConvertBrick(&converter, b, thread); });
+
+  // Delete temporary data
+  for (int t = 0; t < nthreads; t++) delete converter.thread_grids[t];
+  delete [] converter.thread_grids;
+  delete [] converter.brick_points;
+  delete [] converter.brick_npoints;
+  delete [] converter.brick_done;
+  delete [] converter.brick_offsets;
+  delete [] converter.brick_triangles;
+  delete [] converter.triangles;
+
+  // Return number of points
+  return converter.npoints;
+}
+
+
+
 void GetLabel(const char* name)
 {
   FILE *fp = fopen(name, "r");
@@ -299,3 +771,228 @@ extern "C" double * get_data(const char * s,int * b,int x,int y,int z,const char
   return res;
 }
 
+
+
+
+static void
+WritePoints(const double *points, int npoints, void *data)
+{
+  // Append point records to file
+  FILE *fp = (FILE *) data;
+  fwrite(points, sizeof(double), 7 * npoints, fp);
+}
+
+
+extern "C" int stream_data(const char * s,int x,int y,int z,const char * label_file,int brick_resolution,PointCallback callback,void * data)
+{
+  // Stream points to callback one brick at a time (returns number of points, or -1 on error)
+  input_scene_name=s;
+
+  if(label_num==0)
+    GetLabel(label_file);
+  // Read scene
+  R3Scene *scene = ReadScene(input_scene_name);
+  if (!scene) return -1;
+
+  // Convert scene brick by brick
+  int num = ConvertBricks(scene, x, y, z, brick_resolution, callback, data);
+
+  // Delete scene
+  delete scene;
+
+  return num;
+}
+
+
+extern "C" int write_data(const char * s,int x,int y,int z,const char * label_file,int brick_resolution,const char * output_file)
+{
+  // Write points as binary records of 7 doubles (returns number of points, or -1 on error)
+  FILE *fp = fopen(output_file, "wb");
+  if (!fp) {
+    fprintf(stderr, "Unable to open output file %s\n", output_file);
+    return -1;
+  }
+
+  // Stream points to file
+  int num = stream_data(s, x, y, z, label_file, brick_resolution, WritePoints, fp);
+
+  // Close file
+  fclose(fp);
+
+  return num;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Surfel scene export
+////////////////////////////////////////////////////////////////////////
+
+struct SurfelExporter {
+  R3SurfelScene *scene;
+  R3Affine grid_to_world;
+  RNLength spacing;
+  RNArray<R3SurfelObject *> objects;
+  RNArray<R3SurfelNode *> label_nodes;
+  int *object_labels;
+  int nblocks;
+};
+
+
+static R3SurfelObject *
+ExportObject(SurfelExporter *exporter, int label_value, R3SurfelNode **label_node)
+{
+  // Find object for label
+  for (int i = 0; i < exporter->objects.NEntries(); i++) {
+    if (exporter->object_labels[i] != label_value) continue;
+    *label_node = exporter->label_nodes.Kth(i);
+    return exporter->objects.Kth(i);
+  }
+
+  // Create object and node for label
+  char name[256];
+  sprintf(name, "%d", label_value);
+  R3SurfelScene *scene = exporter->scene;
+  R3SurfelObject *object = new R3SurfelObject(name);
+  scene->InsertObject(object, scene->RootObject());
+  R3SurfelNode *node = new R3SurfelNode(name);
+  scene->Tree()->InsertNode(node, scene->Tree()->RootNode());
+
+  // Assign label (label 0 means the node matched no entry of the label file)
+  if (label_value != 0) {
+    R3SurfelLabel *surfel_label = new R3SurfelLabel(name);
+    scene->InsertLabel(surfel_label, scene->RootLabel());
+    R3SurfelLabelAssignment *assignment = new R3SurfelLabelAssignment(object, surfel_label, 1.0, R3_SURFEL_LABEL_ASSIGNMENT_GROUND_TRUTH_ORIGINATOR);
+    scene->InsertLabelAssignment(assignment);
+  }
+
+  // Remember object
+  int nobjects = exporter->objects.NEntries();
+  exporter->object_labels = (int *) realloc(exporter->object_labels, (nobjects + 1) * sizeof(int));
+  exporter->object_labels[nobjects] = label_value;
+  exporter->objects.Insert(object);
+  exporter->label_nodes.Insert(node);
+
+  // Return object
+  *label_node = node;
+  return object;
+}
+
+
+static void
+ExportPoints(const double *points, int npoints, void *data)
+{
+  // Get convenient variables
+  SurfelExporter *exporter = (SurfelExporter *) data;
+  R3SurfelTree *tree = exporter->scene->Tree();
+  R3SurfelDatabase *database = tree->Database();
+  R3Surfel *surfels = new R3Surfel [ npoints ];
+  RNBoolean *done = new RNBoolean [ npoints ];
+  for (int i = 0; i < npoints; i++) done[i] = FALSE;
+
+  // Create one block for each label in this brick
+  for (int first = 0; first < npoints; first++) {
+    if (done[first]) continue;
+    int label_value = (int) points[7*first+6];
+
+    // Block origin is the first point, so surfel coordinates are multiples of the spacing
+    R3Point origin(points[7*first+0], points[7*first+1], points[7*first+2]);
+    origin.Transform(exporter->grid_to_world);
+
+    // Create surfels with label
+    int nsurfels = 0;
+    for (int i = first; i < npoints; i++) {
+      const double *point = &points[7*i];
+      if (done[i] || ((int) point[6] != label_value)) continue;
+      R3Point position(point[0], point[1], point[2]);
+      position.Transform(exporter->grid_to_world);
+      R3Vector offset = position - origin;
+      unsigned char rgb[3];
+      for (int c = 0; c < 3; c++) {
+        RNScalar value = 255.0 * point[3+c] + 0.5;
+        rgb[c] = (value < 0) ? 0 : ((value > 255) ? 255 : (unsigned char) value);
+      }
+      R3Surfel *surfel = &surfels[nsurfels++];
+      *surfel = R3Surfel(offset.X(), offset.Y(), offset.Z(), rgb[0], rgb[1], rgb[2]);
+      surfel->SetRadius(0.5 * exporter->spacing);
+      done[i] = TRUE;
+    }
+
+    // Create block
+    R3SurfelBlock *block = new R3SurfelBlock(surfels, nsurfels, origin);
+    block->UpdateProperties();
+    database->InsertBlock(block);
+
+    // Create node for block
+    char name[256];
+    R3SurfelNode *label_node = NULL;
+    R3SurfelObject *object = ExportObject(exporter, label_value, &label_node);
+    sprintf(name, "%d_%d", label_value, exporter->nblocks++);
+    R3SurfelNode *node = new R3SurfelNode(name);
+    node->InsertBlock(block);
+    node->UpdateProperties();
+    tree->InsertNode(node, label_node);
+    object->InsertNode(node);
+
+    // Release block (writes it to the database file)
+    database->ReleaseBlock(block);
+  }
+
+  // Delete temporary data
+  delete [] surfels;
+  delete [] done;
+}
+
+
+extern "C" int write_surfels(const char * s,int x,int y,int z,const char * label_file,int brick_resolution,const char * scene_file,const char * database_file)
+{
+  // Write points to surfel scene with one object per label (returns number of points, or -1 on error)
+  input_scene_name=s;
+
+  if(label_num==0)
+    GetLabel(label_file);
+  // Read scene
+  R3Scene *scene = ReadScene(input_scene_name);
+  if (!scene) return -1;
+
+  // Open surfel scene
+  R3SurfelScene *surfel_scene = new R3SurfelScene(input_scene_name);
+  if (!surfel_scene->OpenFile(scene_file, database_file, "w", "w")) {
+    delete surfel_scene;
+    delete scene;
+    return -1;
+  }
+
+  // Compute grid transformation (same as in ConvertBricks)
+  int resolution[3];
+  R3Box bbox = GridBBox(scene);
+  GridResolution(bbox, 0, x, y, z, resolution);
+  R3Affine world_to_grid = GridTransformation(bbox, resolution);
+
+  // Compress blocks with positions quantized to the grid spacing
+  SurfelExporter exporter;
+  exporter.scene = surfel_scene;
+  exporter.grid_to_world = world_to_grid.Inverse();
+  exporter.spacing = 1.0 / world_to_grid.ScaleFactor();
+  exporter.object_labels = NULL;
+  exporter.nblocks = 0;
+  surfel_scene->Tree()->Database()->SetCompressionPrecision(exporter.spacing);
+
+  // Convert scene brick by brick
+  int num = ConvertBricks(scene, x, y, z, brick_resolution, ExportPoints, &exporter);
+
+  // Update object properties
+  for (int i = 0; i < exporter.objects.NEntries(); i++) {
+    exporter.objects.Kth(i)->UpdateProperties();
+  }
+
+  // Close surfel scene
+  if (!surfel_scene->CloseFile()) num = -1;
+
+  // Delete data
+  if (exporter.object_labels) free(exporter.object_labels);
+  delete surfel_scene;
+  delete scene;
+
+  return num;
+}
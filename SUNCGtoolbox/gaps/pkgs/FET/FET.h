@@ -12,6 +12,7 @@
 ////////////////////////////////////////////////////////////////////////
 
 struct FETDescriptor;
+struct FETDescriptorIndex;
 struct FETFeature;
 struct FETCorrespondence;
 struct FETShape;
@@ -26,6 +27,7 @@ struct FETReconstruction;
 
 #include "FETDescriptor.h"
 #include "FETFeature.h"
+#include "FETDescriptorIndex.h"
 #include "FETCorrespondence.h"
 #include "FETShape.h"
 #include "FETMatch.h"
@@ -3,6 +3,9 @@
 ////////////////////////////////////////////////////////////////////////
 
 #include "FET.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 
 
@@ -214,16 +217,8 @@ float FETDescriptor::
 SquaredDistance(const FETDescriptor& descriptor, float unknown_penalty) const
 {
   // Return squared distance in descriptor space
-  float sum = 0.0;
   assert(nvalues == descriptor.nvalues);
-  for (int i = 0; i < nvalues; i++) {
-    float delta;
-    if (values[i] == RN_UNKNOWN) delta = unknown_penalty;
-    else if (descriptor.values[i] == RN_UNKNOWN) delta = unknown_penalty;
-    else delta = values[i] - descriptor.values[i];
-    sum += delta * delta;
-  }
-  return sum;
+  return FETSquaredDescriptorDistance(values, descriptor.values, nvalues, unknown_penalty);
 }
 
 
@@ -237,3 +232,43 @@ Distance(const FETDescriptor& descriptor, float unknown_penalty) const
 
 
 
+////////////////////////////////////////////////////////////////////////
+// Descriptor distance kernel
+////////////////////////////////////////////////////////////////////////
+
+float 
+FETSquaredDescriptorDistance(const float *values1, const float *values2, int nvalues, float unknown_penalty)
+{
+  // Sum squared differences (unknown values contribute penalty)
+  float sum = 0.0;
+  int i = 0;
+
+#if defined(__SSE2__)
+  // Process four values at a time
+  const __m128 unknown4 = _mm_set1_ps((float) RN_UNKNOWN);
+  const __m128 penalty4 = _mm_set1_ps(unknown_penalty);
+  __m128 sum4 = _mm_setzero_ps();
+  for ( ; i + 4 <= nvalues; i += 4) {
+    __m128 a = _mm_loadu_ps(&values1[i]);
+    __m128 b = _mm_loadu_ps(&values2[i]);
+    __m128 unknown = _mm_or_ps(_mm_cmpeq_ps(a, unknown4), _mm_cmpeq_ps(b, unknown4));
+    __m128 delta = _mm_or_ps(_mm_and_ps(unknown, penalty4), _mm_andnot_ps(unknown, _mm_sub_ps(a, b)));
+    sum4 = _mm_add_ps(sum4, _mm_mul_ps(delta, delta));
+  }
+  float sums[4];
+  _mm_storeu_ps(sums, sum4);
+  sum = (sums[0] + sums[1]) + (sums[2] + sums[3]);
+#endif
+
+  // Process remaining values
+  for ( ; i < nvalues; i++) {
+    float delta;
+    if (values1[i] == RN_UNKNOWN) delta = unknown_penalty;
+    else if (values2[i] == RN_UNKNOWN) delta = unknown_penalty;
+    else delta = values1[i] - values2[i];
+    sum += delta * delta;
+  }
+
+  // Return squared distance
+  return sum;
+}
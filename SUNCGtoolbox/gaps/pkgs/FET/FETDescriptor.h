@@ -34,3 +34,11 @@ public:
   float *values;
   int nvalues;
 };
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Descriptor distance kernel (SSE2 when available)
+////////////////////////////////////////////////////////////////////////
+
+float FETSquaredDescriptorDistance(const float *values1, const float *values2, int nvalues, float unknown_penalty = 10);
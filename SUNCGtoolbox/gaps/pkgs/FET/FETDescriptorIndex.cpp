@@ -0,0 +1,327 @@
+////////////////////////////////////////////////////////////////////////
+// Include files
+////////////////////////////////////////////////////////////////////////
+
+#include "FET.h"
+#include <algorithm>
+#include <queue>
+#include <vector>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Utility functions
+////////////////////////////////////////////////////////////////////////
+
+static unsigned long long
+FETNextRandom(unsigned long long& state)
+{
+  // Return next value of splitmix64 generator
+  unsigned long long z = (state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+
+
+static float
+FETDotProduct(const float *values1, const float *values2, int nvalues)
+{
+  // Return dot product of two descriptor rows
+  float sum = 0.0;
+  int i = 0;
+
+#if defined(__SSE2__)
+  // Process four values at a time
+  __m128 sum4 = _mm_setzero_ps();
+  for ( ; i + 4 <= nvalues; i += 4) {
+    sum4 = _mm_add_ps(sum4, _mm_mul_ps(_mm_loadu_ps(&values1[i]), _mm_loadu_ps(&values2[i])));
+  }
+  float sums[4];
+  _mm_storeu_ps(sums, sum4);
+  sum = (sums[0] + sums[1]) + (sums[2] + sums[3]);
+#endif
+
+  // Process remaining values
+  for ( ; i < nvalues; i++) sum += values1[i] * values2[i];
+  return sum;
+}
+
+
+
+static int
+FETCompareFeatureGroups(const void *data1, const void *data2)
+{
+  // Sort features by generator type, then by descriptor size
+  FETFeature *feature1 = *((FETFeature **) data1);
+  FETFeature *feature2 = *((FETFeature **) data2);
+  if (feature1->generator_type < feature2->generator_type) return -1;
+  if (feature1->generator_type > feature2->generator_type) return 1;
+  if (feature1->descriptor.nvalues < feature2->descriptor.nvalues) return -1;
+  if (feature1->descriptor.nvalues > feature2->descriptor.nvalues) return 1;
+  if (feature1->shape_index < feature2->shape_index) return -1;
+  if (feature1->shape_index > feature2->shape_index) return 1;
+  return 0;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Constructors
+////////////////////////////////////////////////////////////////////////
+
+FETDescriptorIndex::
+FETDescriptorIndex(const RNArray<FETFeature *>& input_features, int ntrees, int max_leaf_size)
+  : features(),
+    values(NULL),
+    stride(0),
+    groups(NULL),
+    ngroups(0),
+    ntrees(ntrees),
+    max_leaf_size((max_leaf_size > 1) ? max_leaf_size : 2),
+    rows(NULL),
+    nodes(NULL),
+    nnodes(0),
+    nallocated_nodes(0),
+    normals(NULL),
+    nnormals(0),
+    nallocated_normals(0)
+{
+  // Gather features with descriptors, sorted into contiguous groups
+  for (int i = 0; i < input_features.NEntries(); i++) {
+    FETFeature *feature = input_features.Kth(i);
+    if (feature->descriptor.nvalues == 0) continue;
+    features.Insert(feature);
+    if (feature->descriptor.nvalues > stride) stride = feature->descriptor.nvalues;
+  }
+  features.Sort(FETCompareFeatureGroups);
+  if (features.IsEmpty()) return;
+
+  // Pack descriptors into matrix (rows padded with zeros to multiple of four floats)
+  stride = (stride + 3) & ~3;
+  values = new float [ features.NEntries() * stride ];
+  for (int i = 0; i < features.NEntries(); i++) {
+    const FETDescriptor& descriptor = features.Kth(i)->descriptor;
+    float *row = &values[i * stride];
+    for (int j = 0; j < descriptor.nvalues; j++) row[j] = descriptor.values[j];
+    for (int j = descriptor.nvalues; j < stride; j++) row[j] = 0;
+  }
+
+  // Create groups
+  groups = new Group [ features.NEntries() ];
+  for (int i = 0; i < features.NEntries(); i++) {
+    FETFeature *feature = features.Kth(i);
+    if ((ngroups == 0) ||
+        (groups[ngroups-1].generator_type != feature->generator_type) ||
+        (groups[ngroups-1].nvalues != feature->descriptor.nvalues)) {
+      Group& group = groups[ngroups++];
+      group.generator_type = feature->generator_type;
+      group.nvalues = feature->descriptor.nvalues;
+      group.first_row = i;
+      group.nrows = 0;
+      group.roots = new int [ ntrees ];
+    }
+    groups[ngroups-1].nrows++;
+  }
+
+  // Build random projection trees for every group (deterministic seed)
+  unsigned long long random_state = 0x5EED5EED5EED5EEDULL;
+  rows = new int [ ntrees * features.NEntries() ];
+  for (int t = 0; t < ntrees; t++) {
+    int *tree_rows = &rows[t * features.NEntries()];
+    for (int i = 0; i < features.NEntries(); i++) tree_rows[i] = i;
+    for (int g = 0; g < ngroups; g++) {
+      Group& group = groups[g];
+      group.roots[t] = BuildTree(group, tree_rows, group.first_row, group.nrows, random_state);
+    }
+  }
+}
+
+
+
+FETDescriptorIndex::
+~FETDescriptorIndex(void)
+{
+  // Delete everything
+  for (int g = 0; g < ngroups; g++) delete [] groups[g].roots;
+  if (groups) delete [] groups;
+  if (values) delete [] values;
+  if (rows) delete [] rows;
+  if (nodes) free(nodes);
+  if (normals) free(normals);
+}
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Tree building
+////////////////////////////////////////////////////////////////////////
+
+int FETDescriptorIndex::
+AllocateNode(void)
+{
+  // Grow node array if necessary
+  if (nnodes == nallocated_nodes) {
+    nallocated_nodes = (nallocated_nodes > 0) ? 2 * nallocated_nodes : 1024;
+    nodes = (Node *) realloc(nodes, nallocated_nodes * sizeof(Node));
+    if (!nodes) RNAbort("Unable to allocate descriptor index nodes");
+  }
+
+  // Return index of new node
+  return nnodes++;
+}
+
+
+
+int FETDescriptorIndex::
+AllocateNormal(int nvalues)
+{
+  // Grow normal array if necessary
+  if (nnormals + nvalues > nallocated_normals) {
+    while (nnormals + nvalues > nallocated_normals) {
+      nallocated_normals = (nallocated_normals > 0) ? 2 * nallocated_normals : 16 * nvalues;
+    }
+    normals = (float *) realloc(normals, nallocated_normals * sizeof(float));
+    if (!normals) RNAbort("Unable to allocate descriptor index normals");
+  }
+
+  // Return index of first value of new normal
+  int result = nnormals;
+  nnormals += nvalues;
+  return result;
+}
+
+
+
+int FETDescriptorIndex::
+BuildTree(const Group& group, int *tree_rows, int first_row, int nrows, unsigned long long& random_state)
+{
+  // Create leaf node
+  int node_index = AllocateNode();
+  nodes[node_index].children[0] = nodes[node_index].children[1] = -1;
+  nodes[node_index].first_row = first_row;
+  nodes[node_index].nrows = nrows;
+  nodes[node_index].first_normal = -1;
+  nodes[node_index].offset = 0;
+  nodes[node_index].normal_squared_length = 0;
+  if (nrows <= max_leaf_size) return node_index;
+
+  // Choose split direction through two random rows with different descriptors
+  int nvalues = group.nvalues;
+  int first_normal = AllocateNormal(nvalues);
+  float *normal = &normals[first_normal];
+  float normal_squared_length = 0;
+  for (int attempt = 0; (attempt < 8) && (normal_squared_length == 0); attempt++) {
+    const float *a = Values(tree_rows[first_row + FETNextRandom(random_state) % nrows]);
+    const float *b = Values(tree_rows[first_row + FETNextRandom(random_state) % nrows]);
+    for (int j = 0; j < nvalues; j++) normal[j] = a[j] - b[j];
+    normal_squared_length = FETDotProduct(normal, normal, nvalues);
+  }
+
+  // Keep leaf if all descriptors seem to be identical
+  if (normal_squared_length == 0) {
+    nnormals -= nvalues;
+    return node_index;
+  }
+
+  // Split rows at median projection onto normal
+  std::vector< std::pair<float, int> > projected(nrows);
+  for (int i = 0; i < nrows; i++) {
+    int row = tree_rows[first_row + i];
+    projected[i] = std::pair<float, int>(FETDotProduct(normal, Values(row), nvalues), row);
+  }
+  int nleft = nrows / 2;
+  std::nth_element(projected.begin(), projected.begin() + nleft, projected.end());
+  for (int i = 0; i < nrows; i++) tree_rows[first_row + i] = projected[i].second;
+  float offset = projected[nleft].first;
+
+  // Create children (node array may be reallocated while building them)
+  int child0 = BuildTree(group, tree_rows, first_row, nleft, random_state);
+  int child1 = BuildTree(group, tree_rows, first_row + nleft, nrows - nleft, random_state);
+  nodes[node_index].children[0] = child0;
+  nodes[node_index].children[1] = child1;
+  nodes[node_index].first_normal = first_normal;
+  nodes[node_index].offset = offset;
+  nodes[node_index].normal_squared_length = normal_squared_length;
+
+  // Return index of node
+  return node_index;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Search
+////////////////////////////////////////////////////////////////////////
+
+FETFeature *FETDescriptorIndex::
+FindClosest(const FETDescriptor& query, int generator_type,
+  RNScalar max_squared_distance, int max_checks, RNScalar *squared_distance) const
+{
+  // Find group of features comparable to query
+  const Group *group = NULL;
+  for (int g = 0; g < ngroups; g++) {
+    if (groups[g].generator_type != generator_type) continue;
+    if (groups[g].nvalues != query.nvalues) continue;
+    group = &groups[g];
+    break;
+  }
+
+  // Check group
+  if (!group) return NULL;
+  int nvalues = group->nvalues;
+  const float *query_values = query.values;
+
+  // Initialize result
+  int best_row = -1;
+  float best_dd = (max_squared_distance < FLT_MAX) ? max_squared_distance : FLT_MAX;
+
+  if ((max_checks <= 0) || (group->nrows <= max_checks)) {
+    // Compare with every row
+    for (int row = group->first_row; row < group->first_row + group->nrows; row++) {
+      float dd = FETSquaredDescriptorDistance(query_values, Values(row), nvalues);
+      if (dd < best_dd) { best_dd = dd; best_row = row; }
+    }
+  }
+  else {
+    // Search trees best-bin-first, ordered by squared distance to splitting planes
+    typedef std::pair<float, int> Entry;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > queue;
+    for (int t = 0; t < ntrees; t++) queue.push(Entry(0.0f, t * nnodes + group->roots[t]));
+    int nchecks = 0;
+    while (!queue.empty() && (nchecks < max_checks)) {
+      Entry entry = queue.top();
+      queue.pop();
+      if (entry.first >= best_dd) break;
+      int t = entry.second / nnodes;
+      const int *tree_rows = &rows[t * features.NEntries()];
+      const Node *node = &nodes[entry.second % nnodes];
+
+      // Descend to leaf, remembering other sides
+      while (node->children[0] >= 0) {
+        float margin = FETDotProduct(&normals[node->first_normal], query_values, nvalues) - node->offset;
+        int near_side = (margin < 0) ? 0 : 1;
+        float bound = margin * margin / node->normal_squared_length;
+        if (bound < best_dd) queue.push(Entry(bound, t * nnodes + node->children[1 - near_side]));
+        node = &nodes[node->children[near_side]];
+      }
+
+      // Compare with rows in leaf
+      for (int i = 0; i < node->nrows; i++) {
+        int row = tree_rows[node->first_row + i];
+        float dd = FETSquaredDescriptorDistance(query_values, Values(row), nvalues);
+        if (dd < best_dd) { best_dd = dd; best_row = row; }
+      }
+      nchecks += node->nrows;
+    }
+  }
+
+  // Return closest feature
+  if (best_row < 0) return NULL;
+  if (squared_distance) *squared_distance = best_dd;
+  return features.Kth(best_row);
+}
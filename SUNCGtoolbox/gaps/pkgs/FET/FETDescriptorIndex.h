@@ -0,0 +1,93 @@
+////////////////////////////////////////////////////////////////////////
+// Class definition
+////////////////////////////////////////////////////////////////////////
+
+struct FETDescriptorIndex {
+public:
+  // Constructors
+  FETDescriptorIndex(const RNArray<FETFeature *>& features, int ntrees = 4, int max_leaf_size = 16);
+  ~FETDescriptorIndex(void);
+
+  // Properties
+  int NFeatures(void) const;
+  FETFeature *Feature(int k) const;
+  const float *Values(int k) const;
+
+  // Search (approximate with max_checks > 0, exact otherwise)
+  FETFeature *FindClosest(const FETDescriptor& query, int generator_type,
+    RNScalar max_squared_distance = FLT_MAX, int max_checks = 256,
+    RNScalar *squared_distance = NULL) const;
+
+public:
+  // Random projection tree node (leaves have children[0] < 0)
+  struct Node {
+    int children[2];
+    int first_row, nrows;
+    int first_normal;
+    float offset;
+    float normal_squared_length;
+  };
+
+  // Features with same generator type and descriptor size (one forest each)
+  struct Group {
+    int generator_type;
+    int nvalues;
+    int first_row, nrows;
+    int *roots;
+  };
+
+  // Internal tree building
+  int BuildTree(const Group& group, int *tree_rows, int first_row, int nrows, unsigned long long& random_state);
+  int AllocateNode(void);
+  int AllocateNormal(int nvalues);
+
+public:
+  // Packed descriptor matrix (one row of stride floats per feature)
+  RNArray<FETFeature *> features;
+  float *values;
+  int stride;
+
+  // Groups
+  Group *groups;
+  int ngroups;
+
+  // Random projection trees (ntrees row permutations of features)
+  int ntrees;
+  int max_leaf_size;
+  int *rows;
+  Node *nodes;
+  int nnodes, nallocated_nodes;
+  float *normals;
+  int nnormals, nallocated_normals;
+};
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Inline functions
+////////////////////////////////////////////////////////////////////////
+
+inline int FETDescriptorIndex::
+NFeatures(void) const
+{
+  // Return number of indexed features
+  return features.NEntries();
+}
+
+
+
+inline FETFeature *FETDescriptorIndex::
+Feature(int k) const
+{
+  // Return kth indexed feature
+  return features.Kth(k);
+}
+
+
+
+inline const float *FETDescriptorIndex::
+Values(int k) const
+{
+  // Return packed descriptor values of kth indexed feature
+  return &values[k * stride];
+}
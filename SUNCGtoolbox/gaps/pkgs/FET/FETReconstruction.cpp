@@ -3,6 +3,13 @@
 ////////////////////////////////////////////////////////////////////////
 
 #include "FET.h"
+#include <vector>
+#if (RN_OS != RN_WINDOWS)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 
 
@@ -31,8 +38,14 @@ FETReconstruction(void)
     total_match_weight(0),
     total_trajectory_weight(0),
     total_inertia_weight(0),
-    solver(RN_CSPARSE_SOLVER),
-    bbox(FLT_MAX, FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX)
+    solver(RN_LEVENBERG_MARQUARDT_SOLVER),
+    bbox(FLT_MAX, FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX),
+    mapped_data(NULL),
+    mapped_size(0),
+    mapped_feature_offset(0),
+    mapped_descriptor_offset(0),
+    nmapped_features(0),
+    nmapped_descriptor_values(0)
 {
   // Initialize parameters
   InitializeFeatureParameters();
@@ -68,7 +81,13 @@ FETReconstruction(const FETReconstruction& reconstruction)
     total_trajectory_weight(reconstruction.total_trajectory_weight),
     total_inertia_weight(reconstruction.total_inertia_weight),
     solver(reconstruction.solver),
-    bbox(reconstruction.bbox)
+    bbox(reconstruction.bbox),
+    mapped_data(NULL),
+    mapped_size(0),
+    mapped_feature_offset(0),
+    mapped_descriptor_offset(0),
+    nmapped_features(0),
+    nmapped_descriptor_values(0)
 {
   // Copy other stuff
   for (int i = 0; i < NUM_FEATURE_TYPES; i++) {
@@ -82,6 +101,10 @@ FETReconstruction(const FETReconstruction& reconstruction)
 FETReconstruction::
 ~FETReconstruction(void) 
 {
+  // Discard features never read from mapped file
+  for (int i = 0; i < NShapes(); i++) Shape(i)->npending_features = 0;
+  ReleaseMappedFile();
+
   // Delete correspondences 
   while (NCorrespondences() > 0) {
     FETCorrespondence *correspondence = Correspondence(NCorrespondences()-1);
@@ -1444,7 +1467,20 @@ ReadBinaryFile(const char *filename)
     return 0;
   }
 
+  // Check version (major version 1 is the sectioned format read via memory map)
+  int major_version = 0;
+  if (fread(&major_version, sizeof(int), 1, fp) != 1) {
+    fprintf(stderr, "Unable to read reconstruction file %s\n", filename);
+    fclose(fp);
+    return 0;
+  }
+  if (major_version == 1) {
+    fclose(fp);
+    return ReadMappedFile(filename);
+  }
+
   // Read file contents
+  rewind(fp);
   if (!ReadBinary(fp)) return 0;
 
   // Close file
@@ -1462,6 +1498,9 @@ WriteBinaryFile(const char *filename) const
   // Check filename
   if (!filename) return 0;
 
+  // Read features still in mapped file (which may be the one being written)
+  if (mapped_data) ((FETReconstruction *) this)->LoadFeatures();
+
   // Open file
   FILE *fp = fopen(filename, "wb");
   if (!fp) {
@@ -1469,8 +1508,8 @@ WriteBinaryFile(const char *filename) const
     return 0;
   }
 
-  // Read file contents
-  if (!WriteBinary(fp)) return 0;
+  // Write file contents
+  if (!WriteMappedBinary(fp)) { fclose(fp); return 0; }
 
   // Close file
   fclose(fp);
@@ -1597,6 +1636,587 @@ WriteBinary(FILE *fp) const
 
   
 
+////////////////////////////////////////////////////////////////////////
+// Mapped binary input and output
+////////////////////////////////////////////////////////////////////////
+
+// Version 1 binary files start with a header and a table of sections.
+// Sections hold fixed-size records at 8-byte aligned offsets, so they 
+// can be used directly from a memory mapped file.  Features are stored 
+// contiguously per shape (followed by features without a shape), and
+// are only read when the features of the shape are first accessed.
+
+enum {
+  FET_SHAPE_SECTION = 1,
+  FET_PARENT_SECTION,
+  FET_MATCH_SECTION,
+  FET_FEATURE_SECTION,
+  FET_DESCRIPTOR_SECTION,
+  FET_CORRESPONDENCE_SECTION,
+  FET_NUM_SECTION_TYPES
+};
+
+struct FETFileHeader {
+  int major_version, minor_version;
+  int nsections, reserved0;
+  double avg_feature_radius;
+  int reserved[24];
+};
+
+struct FETFileSection {
+  int type, count;
+  long long offset, size;
+};
+
+struct FETShapeRecord {
+  char name[256];
+  double origin[3];
+  double current_matrix[16];
+  double ground_truth_matrix[16];
+  double variable_inertias[FETShape::max_variables];
+  float viewpoint[3], towards[3], up[3];
+  int first_parent, nparents;
+  int first_feature, nfeatures;
+  int reserved[7];
+};
+
+struct FETMatchRecord {
+  int shapes[2];
+  double current_matrix[16];
+  double ground_truth_matrix[16];
+  double affinity;
+  int reserved[8];
+};
+
+struct FETFeatureRecord {
+  double position[3], direction[3], normal[3], color[3];
+  double radius, salience, distinction;
+  long long first_descriptor_value;
+  unsigned long long flags;
+  int shape_type, generator_type, primitive_marker;
+  int ndescriptor_values;
+  int reserved[6];
+};
+
+struct FETCorrespondenceRecord {
+  int match;
+  int shapes[2];
+  int features[2]; // index within shape (or within features without shape)
+  int relationship_type;
+  double affinity;
+  int reserved[8];
+};
+
+
+
+static long long
+FETAlignedOffset(long long offset)
+{
+  // Round up to multiple of eight bytes
+  return (offset + 7) & ~7LL;
+}
+
+
+
+static int
+FETWritePadding(FILE *fp, long long position, long long offset)
+{
+  // Write zeros from position up to aligned offset (less than eight bytes)
+  static const char padding[8] = { 0 };
+  size_t npadding = (size_t) (offset - position);
+  if (npadding == 0) return 1;
+  return (fwrite(padding, 1, npadding, fp) == npadding) ? 1 : 0;
+}
+
+
+
+static const FETFileSection *
+FETFindSection(const FETFileSection *sections, int nsections, int type, size_t record_size)
+{
+  // Find section of type (with expected record size)
+  for (int i = 0; i < nsections; i++) {
+    if (sections[i].type != type) continue;
+    if (sections[i].count < 0) return NULL;
+    if (sections[i].size != (long long) record_size * sections[i].count) return NULL;
+    return &sections[i];
+  }
+
+  // Section not found
+  return NULL;
+}
+
+
+
+int FETReconstruction::
+ReadMappedFile(const char *filename)
+{
+  // Check filename
+  if (!filename) return 0;
+
+  // Release previous mapped file
+  LoadFeatures();
+
+#if (RN_OS != RN_WINDOWS)
+  // Map file into memory
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "Unable to open reconstruction file %s\n", filename);
+    return 0;
+  }
+  struct stat st;
+  if ((fstat(fd, &st) != 0) || (st.st_size <= 0)) {
+    fprintf(stderr, "Unable to read reconstruction file %s\n", filename);
+    close(fd);
+    return 0;
+  }
+  void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    fprintf(stderr, "Unable to map reconstruction file %s\n", filename);
+    return 0;
+  }
+  mapped_data = data;
+  mapped_size = st.st_size;
+#else
+  // Read file into memory
+  FILE *fp = fopen(filename, "rb");
+  if (!fp) {
+    fprintf(stderr, "Unable to open reconstruction file %s\n", filename);
+    return 0;
+  }
+  fseek(fp, 0, SEEK_END);
+  long size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  void *data = (size > 0) ? malloc(size) : NULL;
+  if (!data || (fread(data, 1, size, fp) != (size_t) size)) {
+    fprintf(stderr, "Unable to read reconstruction file %s\n", filename);
+    if (data) free(data);
+    fclose(fp);
+    return 0;
+  }
+  fclose(fp);
+  mapped_data = data;
+  mapped_size = size;
+#endif
+
+  // Read everything except features of shapes
+  if (!ReadMappedBinary()) {
+    fprintf(stderr, "Invalid reconstruction file %s\n", filename);
+    ReleaseMappedFile();
+    return 0;
+  }
+
+  // Return success
+  return 1;
+}
+
+
+
+int FETReconstruction::
+ReadMappedBinary(void)
+{
+  // Read header
+  const char *data = (const char *) mapped_data;
+  if (mapped_size < sizeof(FETFileHeader)) return 0;
+  const FETFileHeader *header = (const FETFileHeader *) data;
+  if ((header->major_version != 1) || (header->minor_version != 0)) {
+    fprintf(stderr, "Unrecognized version %d %d\n", header->major_version, header->minor_version);
+    return 0;
+  }
+
+  // Read section table
+  int nsections = header->nsections;
+  if ((nsections < 0) || (sizeof(FETFileHeader) + nsections * sizeof(FETFileSection) > mapped_size)) return 0;
+  const FETFileSection *sections = (const FETFileSection *) (data + sizeof(FETFileHeader));
+  for (int i = 0; i < nsections; i++) {
+    if ((sections[i].offset < 0) || (sections[i].size < 0)) return 0;
+    if ((sections[i].offset & 7) || (sections[i].offset + sections[i].size > (long long) mapped_size)) return 0;
+  }
+
+  // Find sections
+  const FETFileSection *shape_section = FETFindSection(sections, nsections, FET_SHAPE_SECTION, sizeof(FETShapeRecord));
+  const FETFileSection *parent_section = FETFindSection(sections, nsections, FET_PARENT_SECTION, sizeof(int));
+  const FETFileSection *match_section = FETFindSection(sections, nsections, FET_MATCH_SECTION, sizeof(FETMatchRecord));
+  const FETFileSection *feature_section = FETFindSection(sections, nsections, FET_FEATURE_SECTION, sizeof(FETFeatureRecord));
+  const FETFileSection *descriptor_section = FETFindSection(sections, nsections, FET_DESCRIPTOR_SECTION, sizeof(float));
+  const FETFileSection *correspondence_section = FETFindSection(sections, nsections, FET_CORRESPONDENCE_SECTION, sizeof(FETCorrespondenceRecord));
+  if (!shape_section || !parent_section || !match_section) return 0;
+  if (!feature_section || !descriptor_section || !correspondence_section) return 0;
+
+  // Remember where features are
+  mapped_feature_offset = feature_section->offset;
+  mapped_descriptor_offset = descriptor_section->offset;
+  nmapped_features = feature_section->count;
+  nmapped_descriptor_values = descriptor_section->count;
+
+  // Read parameters
+  avg_feature_radius = header->avg_feature_radius;
+
+  // Read shapes (features are only remembered for now)
+  int nshapes = shape_section->count;
+  int first_shape = NShapes();
+  int nshape_features = 0;
+  const FETShapeRecord *shape_records = (const FETShapeRecord *) (data + shape_section->offset);
+  for (int i = 0; i < nshapes; i++) {
+    const FETShapeRecord& record = shape_records[i];
+    if ((record.first_feature < 0) || (record.nfeatures < 0)) return 0;
+    if (record.first_feature + record.nfeatures > nmapped_features) return 0;
+    FETShape *shape = new FETShape(this);
+    char name_buffer[256];
+    strncpy(name_buffer, record.name, 255);
+    name_buffer[255] = '\0';
+    if (name_buffer[0] != '\0') shape->name = strdup(name_buffer);
+    shape->current_transformation.Reset(R4Matrix(record.current_matrix), 0);
+    shape->initial_transformation.Reset(R4Matrix(record.current_matrix), 0);
+    shape->ground_truth_transformation.Reset(R4Matrix(record.ground_truth_matrix), 0);
+    for (int k = 0; k < FETShape::max_variables; k++) shape->variable_inertias[k] = record.variable_inertias[k];
+    shape->viewpoint.Reset(record.viewpoint[0], record.viewpoint[1], record.viewpoint[2]);
+    shape->towards.Reset(record.towards[0], record.towards[1], record.towards[2]);
+    shape->up.Reset(record.up[0], record.up[1], record.up[2]);
+    shape->origin.Reset(record.origin[0], record.origin[1], record.origin[2]);
+    shape->first_pending_feature = record.first_feature;
+    shape->npending_features = record.nfeatures;
+    nshape_features += record.nfeatures;
+  }
+
+  // Read parents
+  const int *parent_records = (const int *) (data + parent_section->offset);
+  for (int i = 0; i < nshapes; i++) {
+    const FETShapeRecord& record = shape_records[i];
+    if ((record.first_parent < 0) || (record.nparents < 0)) return 0;
+    if (record.first_parent + record.nparents > parent_section->count) return 0;
+    FETShape *shape = Shape(first_shape + i);
+    for (int j = 0; j < record.nparents; j++) {
+      int p = parent_records[record.first_parent + j];
+      if ((p < 0) || (p >= nshapes)) return 0;
+      FETShape *parent = Shape(first_shape + p);
+      parent->InsertChild(shape);
+    }
+  }
+
+  // Read matches
+  int first_match = NMatches();
+  const FETMatchRecord *match_records = (const FETMatchRecord *) (data + match_section->offset);
+  for (int i = 0; i < match_section->count; i++) {
+    const FETMatchRecord& record = match_records[i];
+    FETMatch *match = new FETMatch(this);
+    for (int k = 0; k < 2; k++) {
+      if (record.shapes[k] >= nshapes) return 0;
+      if (record.shapes[k] < 0) continue;
+      FETShape *shape = Shape(first_shape + record.shapes[k]);
+      shape->InsertMatch(match, k);
+    }
+    match->current_transformation.Reset(R4Matrix(record.current_matrix), 0);
+    match->initial_transformation.Reset(R4Matrix(record.current_matrix), 0);
+    match->ground_truth_transformation.Reset(R4Matrix(record.ground_truth_matrix), 0);
+    match->affinity = record.affinity;
+  }
+
+  // Read features without shape
+  if (nshape_features > nmapped_features) return 0;
+  int first_shapeless_feature = features.NEntries();
+  int nshapeless_features = nmapped_features - nshape_features;
+  if (!ReadMappedFeatures(NULL, nshape_features, nshapeless_features)) return 0;
+
+  // Read correspondences (features of shapes they refer to are read now)
+  const FETCorrespondenceRecord *correspondence_records = (const FETCorrespondenceRecord *) (data + correspondence_section->offset);
+  for (int i = 0; i < correspondence_section->count; i++) {
+    const FETCorrespondenceRecord& record = correspondence_records[i];
+    if (record.match >= match_section->count) return 0;
+    FETFeature *correspondence_features[2] = { NULL, NULL };
+    for (int k = 0; k < 2; k++) {
+      if (record.features[k] < 0) continue;
+      if (record.shapes[k] >= nshapes) return 0;
+      if (record.shapes[k] >= 0) {
+        FETShape *shape = Shape(first_shape + record.shapes[k]);
+        if (record.features[k] >= shape->NFeatures()) return 0;
+        correspondence_features[k] = shape->Feature(record.features[k]);
+      }
+      else {
+        if (record.features[k] >= nshapeless_features) return 0;
+        correspondence_features[k] = features.Kth(first_shapeless_feature + record.features[k]);
+      }
+    }
+    FETCorrespondence *correspondence = new FETCorrespondence(this, correspondence_features[0], correspondence_features[1],
+      record.affinity, record.relationship_type);
+    if (record.match >= 0) Match(first_match + record.match)->InsertCorrespondence(correspondence);
+  }
+
+  // Release mapped file if nothing is left to read
+  RNBoolean pending = FALSE;
+  for (int i = 0; i < NShapes(); i++) {
+    if (Shape(i)->npending_features > 0) { pending = TRUE; break; }
+  }
+  if (!pending) ReleaseMappedFile();
+  
+  // Update parameters
+  if (avg_feature_radius <= 0) InitializeFeatureParameters();
+  InitializeCorrespondenceParameters();
+  InitializeOptimizationParameters();
+
+  // Return success
+  return 1;
+}
+
+
+
+int FETReconstruction::
+ReadMappedFeatures(FETShape *shape, int first_feature, int nfeatures)
+{
+  // Check mapped file
+  if (nfeatures == 0) return 1;
+  if (!mapped_data) return 0;
+  if ((first_feature < 0) || (first_feature + nfeatures > nmapped_features)) return 0;
+
+  // Get records
+  const char *data = (const char *) mapped_data;
+  const FETFeatureRecord *records = (const FETFeatureRecord *) (data + mapped_feature_offset) + first_feature;
+  const float *descriptor_values = (const float *) (data + mapped_descriptor_offset);
+
+  // Create features
+  for (int i = 0; i < nfeatures; i++) {
+    const FETFeatureRecord& record = records[i];
+    FETFeature *feature = new FETFeature(this);
+    feature->shape_type = record.shape_type;
+    feature->position.Reset(record.position[0], record.position[1], record.position[2]);
+    feature->direction.Reset(record.direction[0], record.direction[1], record.direction[2]);
+    feature->normal.Reset(record.normal[0], record.normal[1], record.normal[2]);
+    feature->color.Reset(record.color[0], record.color[1], record.color[2]);
+    feature->radius = record.radius;
+    feature->salience = record.salience;
+    feature->distinction = record.distinction;
+    feature->flags = (unsigned long) record.flags;
+    feature->generator_type = record.generator_type;
+    feature->primitive_marker = record.primitive_marker;
+    if ((record.ndescriptor_values > 0) && (record.first_descriptor_value >= 0) &&
+        (record.first_descriptor_value + record.ndescriptor_values <= nmapped_descriptor_values)) {
+      feature->descriptor.Reset(record.ndescriptor_values, (float *) &descriptor_values[record.first_descriptor_value]);
+    }
+    if (shape) shape->InsertFeature(feature);
+  }
+
+  // Return success
+  return 1;
+}
+
+
+
+void FETReconstruction::
+LoadFeatures(void)
+{
+  // Check mapped file
+  if (!mapped_data) return;
+
+  // Read features of all shapes
+  for (int i = 0; i < NShapes(); i++) {
+    FETShape *shape = Shape(i);
+    shape->LoadFeatures();
+  }
+
+  // Release mapped file
+  ReleaseMappedFile();
+}
+
+
+
+void FETReconstruction::
+ReleaseMappedFile(void)
+{
+  // Check mapped file
+  if (!mapped_data) return;
+
+  // Release memory
+#if (RN_OS != RN_WINDOWS)
+  munmap(mapped_data, mapped_size);
+#else
+  free(mapped_data);
+#endif
+
+  // Reset everything
+  mapped_data = NULL;
+  mapped_size = 0;
+  mapped_feature_offset = 0;
+  mapped_descriptor_offset = 0;
+  nmapped_features = 0;
+  nmapped_descriptor_values = 0;
+}
+
+
+
+int FETReconstruction::
+WriteMappedBinary(FILE *fp) const
+{
+  // Count stuff (reads all features)
+  int nshapes = NShapes();
+  int nmatches = NMatches();
+  int nfeatures = NFeatures();
+  int ncorrespondences = NCorrespondences();
+  int nparents = 0;
+  for (int i = 0; i < nshapes; i++) nparents += Shape(i)->NParents();
+  long long ndescriptor_values = 0;
+  for (int i = 0; i < nfeatures; i++) ndescriptor_values += Feature(i)->descriptor.nvalues;
+
+  // Order features by shape (features without shape go last)
+  RNArray<FETFeature *> ordered_features;
+  std::vector<int> shapeless_indices(nfeatures, -1);
+  for (int i = 0; i < nshapes; i++) {
+    FETShape *shape = Shape(i);
+    for (int j = 0; j < shape->NFeatures(); j++) ordered_features.Insert(shape->Feature(j));
+  }
+  int nshape_features = ordered_features.NEntries();
+  for (int i = 0; i < nfeatures; i++) {
+    FETFeature *feature = Feature(i);
+    if (feature->shape) continue;
+    shapeless_indices[i] = ordered_features.NEntries() - nshape_features;
+    ordered_features.Insert(feature);
+  }
+  if (ordered_features.NEntries() != nfeatures) {
+    fprintf(stderr, "Features of shapes are not in reconstruction\n");
+    return 0;
+  }
+
+  // Fill section table
+  const int nsections = FET_NUM_SECTION_TYPES - 1;
+  FETFileSection sections[nsections];
+  long long counts[nsections] = { nshapes, nparents, nmatches, nfeatures, ndescriptor_values, ncorrespondences };
+  long long record_sizes[nsections] = { sizeof(FETShapeRecord), sizeof(int), sizeof(FETMatchRecord),
+    sizeof(FETFeatureRecord), sizeof(float), sizeof(FETCorrespondenceRecord) };
+  long long offset = sizeof(FETFileHeader) + nsections * sizeof(FETFileSection);
+  for (int i = 0; i < nsections; i++) {
+    memset(&sections[i], 0, sizeof(FETFileSection));
+    sections[i].type = FET_SHAPE_SECTION + i;
+    sections[i].count = (int) counts[i];
+    sections[i].offset = FETAlignedOffset(offset);
+    sections[i].size = counts[i] * record_sizes[i];
+    offset = sections[i].offset + sections[i].size;
+  }
+
+  // Write header
+  FETFileHeader header;
+  memset(&header, 0, sizeof(FETFileHeader));
+  header.major_version = 1;
+  header.minor_version = 0;
+  header.nsections = nsections;
+  FETReconstruction *tmp = (FETReconstruction *) this;
+  if (avg_feature_radius <= 0) tmp->InitializeFeatureParameters();
+  header.avg_feature_radius = avg_feature_radius;
+  if (fwrite(&header, sizeof(FETFileHeader), 1, fp) != 1) return 0;
+  if (fwrite(sections, sizeof(FETFileSection), nsections, fp) != (size_t) nsections) return 0;
+  long long position = sizeof(FETFileHeader) + nsections * sizeof(FETFileSection);
+
+  // Write shapes
+  if (!FETWritePadding(fp, position, sections[0].offset)) return 0;
+  int first_parent = 0, first_feature = 0;
+  for (int i = 0; i < nshapes; i++) {
+    FETShape *shape = Shape(i);
+    FETShapeRecord record;
+    memset(&record, 0, sizeof(FETShapeRecord));
+    if (shape->name) strncpy(record.name, shape->name, 255);
+    R4Matrix current_matrix = shape->current_transformation.Matrix();
+    R4Matrix ground_truth_matrix = shape->ground_truth_transformation.Matrix();
+    for (int k = 0; k < 3; k++) record.origin[k] = shape->origin[k];
+    for (int k = 0; k < 16; k++) record.current_matrix[k] = current_matrix[k/4][k%4];
+    for (int k = 0; k < 16; k++) record.ground_truth_matrix[k] = ground_truth_matrix[k/4][k%4];
+    for (int k = 0; k < FETShape::max_variables; k++) record.variable_inertias[k] = shape->variable_inertias[k];
+    for (int k = 0; k < 3; k++) record.viewpoint[k] = (float) shape->viewpoint[k];
+    for (int k = 0; k < 3; k++) record.towards[k] = (float) shape->towards[k];
+    for (int k = 0; k < 3; k++) record.up[k] = (float) shape->up[k];
+    record.first_parent = first_parent;
+    record.nparents = shape->NParents();
+    record.first_feature = first_feature;
+    record.nfeatures = shape->NFeatures();
+    first_parent += record.nparents;
+    first_feature += record.nfeatures;
+    if (fwrite(&record, sizeof(FETShapeRecord), 1, fp) != 1) return 0;
+  }
+  position = sections[0].offset + sections[0].size;
+
+  // Write parents
+  if (!FETWritePadding(fp, position, sections[1].offset)) return 0;
+  for (int i = 0; i < nshapes; i++) {
+    FETShape *shape = Shape(i);
+    for (int j = 0; j < shape->NParents(); j++) {
+      int p = shape->Parent(j)->reconstruction_index;
+      if (fwrite(&p, sizeof(int), 1, fp) != 1) return 0;
+    }
+  }
+  position = sections[1].offset + sections[1].size;
+
+  // Write matches
+  if (!FETWritePadding(fp, position, sections[2].offset)) return 0;
+  for (int i = 0; i < nmatches; i++) {
+    FETMatch *match = Match(i);
+    FETMatchRecord record;
+    memset(&record, 0, sizeof(FETMatchRecord));
+    R4Matrix current_matrix = match->current_transformation.Matrix();
+    R4Matrix ground_truth_matrix = match->ground_truth_transformation.Matrix();
+    for (int k = 0; k < 2; k++) record.shapes[k] = (match->shapes[k]) ? match->shapes[k]->reconstruction_index : -1;
+    for (int k = 0; k < 16; k++) record.current_matrix[k] = current_matrix[k/4][k%4];
+    for (int k = 0; k < 16; k++) record.ground_truth_matrix[k] = ground_truth_matrix[k/4][k%4];
+    record.affinity = match->affinity;
+    if (fwrite(&record, sizeof(FETMatchRecord), 1, fp) != 1) return 0;
+  }
+  position = sections[2].offset + sections[2].size;
+
+  // Write features
+  if (!FETWritePadding(fp, position, sections[3].offset)) return 0;
+  long long first_descriptor_value = 0;
+  for (int i = 0; i < nfeatures; i++) {
+    FETFeature *feature = ordered_features.Kth(i);
+    FETFeatureRecord record;
+    memset(&record, 0, sizeof(FETFeatureRecord));
+    for (int k = 0; k < 3; k++) record.position[k] = feature->position[k];
+    for (int k = 0; k < 3; k++) record.direction[k] = feature->direction[k];
+    for (int k = 0; k < 3; k++) record.normal[k] = feature->normal[k];
+    for (int k = 0; k < 3; k++) record.color[k] = feature->color[k];
+    record.radius = feature->radius;
+    record.salience = feature->salience;
+    record.distinction = feature->distinction;
+    record.first_descriptor_value = first_descriptor_value;
+    record.flags = (unsigned long) feature->flags;
+    record.shape_type = feature->shape_type;
+    record.generator_type = feature->generator_type;
+    record.primitive_marker = feature->primitive_marker;
+    record.ndescriptor_values = feature->descriptor.nvalues;
+    first_descriptor_value += record.ndescriptor_values;
+    if (fwrite(&record, sizeof(FETFeatureRecord), 1, fp) != 1) return 0;
+  }
+  position = sections[3].offset + sections[3].size;
+
+  // Write descriptors
+  if (!FETWritePadding(fp, position, sections[4].offset)) return 0;
+  for (int i = 0; i < nfeatures; i++) {
+    const FETDescriptor& descriptor = ordered_features.Kth(i)->descriptor;
+    if (descriptor.nvalues == 0) continue;
+    if (fwrite(descriptor.values, sizeof(float), descriptor.nvalues, fp) != (size_t) descriptor.nvalues) return 0;
+  }
+  position = sections[4].offset + sections[4].size;
+
+  // Write correspondences
+  if (!FETWritePadding(fp, position, sections[5].offset)) return 0;
+  for (int i = 0; i < ncorrespondences; i++) {
+    FETCorrespondence *correspondence = Correspondence(i);
+    FETCorrespondenceRecord record;
+    memset(&record, 0, sizeof(FETCorrespondenceRecord));
+    record.match = (correspondence->match) ? correspondence->match->reconstruction_index : -1;
+    for (int k = 0; k < 2; k++) {
+      FETFeature *feature = correspondence->features[k];
+      record.shapes[k] = (feature && feature->shape) ? feature->shape->reconstruction_index : -1;
+      if (!feature) record.features[k] = -1;
+      else if (feature->shape) record.features[k] = feature->shape_index;
+      else record.features[k] = shapeless_indices[feature->reconstruction_index];
+    }
+    record.relationship_type = correspondence->relationship_type;
+    record.affinity = correspondence->affinity;
+    if (fwrite(&record, sizeof(FETCorrespondenceRecord), 1, fp) != 1) return 0;
+  }
+
+  // Return success
+  return 1;
+}
+
+  
+
 ////////////////////////////////////////////////////////////////////////
 // Update functions
 ////////////////////////////////////////////////////////////////////////
@@ -1635,76 +2255,171 @@ UpdateBBox(void)
 // Correspondence creation
 ////////////////////////////////////////////////////////////////////////
 
-void FETReconstruction::
-CreateCorrespondences(FETShape *shape1, FETShape *shape2, RNScalar num_correspondences)
+struct FETCorrespondencePair {
+  FETShape *shape1, *shape2;
+  RNScalar num_correspondences;
+  RNScalar total_salience;
+  RNArray<FETFeature *> query_features2;
+};
+
+struct FETCorrespondenceCandidate {
+  FETFeature *feature1, *feature2;
+  RNScalar affinity;
+};
+
+struct FETCorrespondenceTask {
+  FETCorrespondencePair *pair;
+  int begin, end;
+  unsigned long long random_state;
+  std::vector<FETCorrespondenceCandidate> candidates;
+};
+
+
+
+static RNScalar
+FETRandomScalar(unsigned long long& state)
 {
-  // Check number of correspondences
-  if (num_correspondences == 0) return;
+  // Return random number in [0,1) from caller's splitmix64 state
+  unsigned long long z = (state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  z = z ^ (z >> 31);
+  return (RNScalar) (z >> 11) / 9007199254740992.0;
+}
+
 
+
+static int
+InternalFindQueryFeatures(FETReconstruction *reconstruction, FETCorrespondencePair *pair)
+{
   // Check bounding box distance
-  if (max_euclidean_distance > 0) {
-    R3Box bbox1 = shape1->BBox();
-    R3Box bbox2 = shape2->BBox();
-    if (R3Distance(bbox1, bbox2) > max_euclidean_distance) return;
+  if (reconstruction->max_euclidean_distance > 0) {
+    R3Box bbox1 = pair->shape1->BBox();
+    R3Box bbox2 = pair->shape2->BBox();
+    if (R3Distance(bbox1, bbox2) > reconstruction->max_euclidean_distance) return 0;
   }
 
   // Find query features
-  RNScalar total_salience = 0;
-  RNArray<FETFeature *> query_features2;
-  for (int i = 0; i < shape2->NFeatures(); i++) {
-    FETFeature *feature2 = shape2->Feature(i);
-    if ((min_salience > 0) && (feature2->Salience() < min_salience)) continue;
-    if ((min_distinction > 0) && (feature2->Distinction() < min_distinction)) continue;
-    if ((feature2->generator_type >= 0) && (total_correspondence_weights[feature2->generator_type] <= 0)) continue;
+  pair->total_salience = 0;
+  for (int i = 0; i < pair->shape2->NFeatures(); i++) {
+    FETFeature *feature2 = pair->shape2->Feature(i);
+    if ((reconstruction->min_salience > 0) && (feature2->Salience() < reconstruction->min_salience)) continue;
+    if ((reconstruction->min_distinction > 0) && (feature2->Distinction() < reconstruction->min_distinction)) continue;
+    if ((feature2->generator_type >= 0) && (reconstruction->total_correspondence_weights[feature2->generator_type] <= 0)) continue;
     if (feature2->IsOnBoundary() && (!feature2->IsOnSilhouetteBoundary())) continue;
-    query_features2.Insert(feature2);
-    total_salience += feature2->Salience();
+    pair->query_features2.Insert(feature2);
+    pair->total_salience += feature2->Salience();
   }
-  
+
+  // Return number of query features
+  return pair->query_features2.NEntries();
+}
+
+
+
+static void
+InternalSearchCorrespondences(FETReconstruction *reconstruction, FETCorrespondenceTask *task)
+{
+  // Get convenient variables
+  FETCorrespondencePair *pair = task->pair;
+  FETShape *shape1 = pair->shape1;
+  FETShape *shape2 = pair->shape2;
+  RNScalar num_correspondences = pair->num_correspondences;
+  RNScalar total_salience = pair->total_salience;
+
   // Compute correspondences for shape2 -> shape1
-  for (int i = 0; i < query_features2.NEntries(); i++) {
-    FETFeature *feature2 = query_features2.Kth(i);
+  for (int i = task->begin; i < task->end; i++) {
+    FETFeature *feature2 = pair->query_features2.Kth(i);
 
     // Subsample features randomly
     if ((num_correspondences != RN_UNKNOWN) && (total_salience > 0)) {
       const RNScalar expected_inlier_probability = 0.1;
       RNScalar p = num_correspondences * feature2->Salience() / total_salience;
       p /= expected_inlier_probability;
-      if ((p < 1.0) && (RNRandomScalar() > p)) continue;
+      if ((p < 1.0) && (FETRandomScalar(task->random_state) > p)) continue;
     }
 
     // Find closest feature on shape1
     FETFeature *feature1 = shape1->FindClosestFeature(feature2, shape2->Transformation(), 
-      0.0, max_euclidean_distance, max_descriptor_distances, max_normal_angle,
-      min_distinction, min_salience, discard_boundaries);
+      0.0, reconstruction->max_euclidean_distance, reconstruction->max_descriptor_distances, reconstruction->max_normal_angle,
+      reconstruction->min_distinction, reconstruction->min_salience, reconstruction->discard_boundaries);
     if (!feature1) continue;
 
     // Check if should discard because on boundary
-    if (discard_boundaries && feature1->IsOnBoundary()) {  
+    if (reconstruction->discard_boundaries && feature1->IsOnBoundary()) {  
       if (!feature1->IsOnSilhouetteBoundary() || !feature2->IsOnSilhouetteBoundary()) {
         continue;
       }
     }
 
     // Compute/check affinity
-    RNScalar affinity = Affinity(feature1, feature2);
+    RNScalar affinity = reconstruction->Affinity(feature1, feature2);
     if (affinity <= 0) continue;
 
     // Check if mutually closest
-    if (discard_not_mutually_closest) {
+    if (reconstruction->discard_not_mutually_closest) {
       FETFeature *feature2a = shape2->FindClosestFeature(feature1, shape1->Transformation(), 
-        0.0, max_euclidean_distance, max_descriptor_distances, max_normal_angle,
-        min_distinction, min_salience, discard_boundaries);
+        0.0, reconstruction->max_euclidean_distance, reconstruction->max_descriptor_distances, reconstruction->max_normal_angle,
+        reconstruction->min_distinction, reconstruction->min_salience, reconstruction->discard_boundaries);
       if (feature2a != feature2) continue;
     }
 
-    // Create correspondence with sorted shapes
+    // Remember candidate with sorted shapes
+    FETCorrespondenceCandidate candidate;
     if (shape1->reconstruction_index < shape2->reconstruction_index) {
-      FETCorrespondence *correspondence = new FETCorrespondence(this, feature1, feature2, affinity);
-      if (!correspondence) RNAbort("Unable to create correspondence");
+      candidate.feature1 = feature1;
+      candidate.feature2 = feature2;
     }
     else {
-      FETCorrespondence *correspondence = new FETCorrespondence(this, feature2, feature1, affinity);
+      candidate.feature1 = feature2;
+      candidate.feature2 = feature1;
+    }
+    candidate.affinity = affinity;
+    task->candidates.push_back(candidate);
+  }
+}
+
+
+
+static void
+InternalCreateCorrespondences(FETReconstruction *reconstruction, FETCorrespondencePair *pairs, int npairs)
+{
+  // Build kdtrees of searched shapes (so that searches do not build them concurrently)
+  for (int i = 0; i < npairs; i++) {
+    if (pairs[i].query_features2.IsEmpty()) continue;
+    if (!pairs[i].shape1->kdtree) pairs[i].shape1->UpdateKdtree();
+    if (reconstruction->discard_not_mutually_closest) {
+      if (!pairs[i].shape2->kdtree) pairs[i].shape2->UpdateKdtree();
+    }
+  }
+
+  // Split query features of all pairs into tasks (each with its own random state)
+  const int max_queries_per_task = 256;
+  unsigned long long random_seed = (unsigned long long) (RNRandomScalar() * 9007199254740992.0);
+  std::vector<FETCorrespondenceTask> tasks;
+  for (int i = 0; i < npairs; i++) {
+    int nqueries = pairs[i].query_features2.NEntries();
+    for (int begin = 0; begin < nqueries; begin += max_queries_per_task) {
+      FETCorrespondenceTask task;
+      task.pair = &pairs[i];
+      task.begin = begin;
+      task.end = (begin + max_queries_per_task < nqueries) ? begin + max_queries_per_task : nqueries;
+      task.random_state = random_seed ^ (0xD1B54A32D192ED03ULL * (tasks.size() + 1));
+      tasks.push_back(task);
+    }
+  }
+
+  // Search for correspondences in parallel
+  RNParallelFor(0, (int) tasks.size(), [&](int i, int thread) {
+    InternalSearchCorrespondences(reconstruction, &tasks[i]);
+  });
+
+  // Create correspondences in task order (so result does not depend on thread scheduling)
+  for (unsigned int i = 0; i < tasks.size(); i++) {
+    for (unsigned int j = 0; j < tasks[i].candidates.size(); j++) {
+      const FETCorrespondenceCandidate& candidate = tasks[i].candidates[j];
+      FETCorrespondence *correspondence = new FETCorrespondence(reconstruction, 
+        candidate.feature1, candidate.feature2, candidate.affinity);
       if (!correspondence) RNAbort("Unable to create correspondence");
     }
   }
@@ -1712,6 +2427,25 @@ CreateCorrespondences(FETShape *shape1, FETShape *shape2, RNScalar num_correspon
 
 
 
+void FETReconstruction::
+CreateCorrespondences(FETShape *shape1, FETShape *shape2, RNScalar num_correspondences)
+{
+  // Check number of correspondences
+  if (num_correspondences == 0) return;
+
+  // Find query features
+  FETCorrespondencePair pair;
+  pair.shape1 = shape1;
+  pair.shape2 = shape2;
+  pair.num_correspondences = num_correspondences;
+  if (!InternalFindQueryFeatures(this, &pair)) return;
+
+  // Create correspondences for shape2 -> shape1
+  InternalCreateCorrespondences(this, &pair, 1);
+}
+
+
+
 void FETReconstruction::
 CreateCorrespondences(void)
 {
@@ -1746,7 +2480,8 @@ CreateCorrespondences(void)
     }
   }
 
-  // Create correspondences 
+  // Find query features of overlapping shape pairs
+  std::vector<FETCorrespondencePair> pairs;
   for (int i = 0; i < NShapes(); i++) {
     FETShape *shape1 = Shape(i);
     R3Box bbox1 = shape1->BBox();
@@ -1758,11 +2493,20 @@ CreateCorrespondences(void)
       if (R3Intersects(bbox1, bbox2, &intersection)) {
         RNScalar allocation = shape_saliences[i] * shape_saliences[j] * intersection.Volume();
         RNScalar num_correspondences = (total_allocation > 0) ? max_correspondences * allocation / total_allocation : RN_UNKNOWN;
-        CreateCorrespondences(shape1, shape2, num_correspondences);
+        if (num_correspondences == 0) continue;
+        pairs.push_back(FETCorrespondencePair());
+        FETCorrespondencePair *pair = &pairs.back();
+        pair->shape1 = shape1;
+        pair->shape2 = shape2;
+        pair->num_correspondences = num_correspondences;
+        if (!InternalFindQueryFeatures(this, pair)) pairs.pop_back();
       }
     }
   }
 
+  // Create correspondences for all pairs in parallel
+  if (!pairs.empty()) InternalCreateCorrespondences(this, &pairs[0], (int) pairs.size());
+
   // Discard outliers
   if (discard_outliers) DiscardOutlierCorrespondences();
 
@@ -2887,22 +3631,13 @@ CreateMatchWithRANSAC(FETReconstruction *reconstruction,
 
     ////////
 
-    // Get first feature point on shape2
-    // Do this with ANN
+    // Get first feature point on shape2 (approximate nearest neighbor in descriptor space)
     listA.Empty();
     listB.Empty();
-    // for (int j = 0; j < shape2->NFeatures(); j++) {
-    //   FETFeature *feature = shape2->Feature(j);
     int generator_type = features1[0]->GeneratorType();
-    RNScalar best_descriptor_distance_squared = max_descriptor_distance_squared[generator_type];
-    for (int j = 0; j < num_feature2_samples; j++) {
-      FETFeature *feature = SelectRandomFeature(features[generator_type][1]);
-      RNScalar descriptor_distance_squared = feature->descriptor.SquaredDistance(features1[0]->descriptor);
-      if (descriptor_distance_squared < best_descriptor_distance_squared) {
-        best_descriptor_distance_squared = descriptor_distance_squared;
-        features2[0] = feature;
-      }
-    }
+    RNLength max_descriptor_distance = RN_UNKNOWN;
+    if (max_descriptor_distance_squared[generator_type] < FLT_MAX) max_descriptor_distance = sqrt(max_descriptor_distance_squared[generator_type]);
+    features2[0] = shape2->FindClosestFeatureByDescriptor(features1[0], max_descriptor_distance, num_feature2_samples);
 
     // Check if found first feature
     if (!features2[0]) continue;
@@ -41,6 +41,8 @@ public:
   int WriteBinaryFile(const char *filename) const;
   int WriteAscii(FILE *fp) const;
   int WriteBinary(FILE *fp) const;
+  int ReadMappedFile(const char *filename);
+  int WriteMappedBinary(FILE *fp) const;
 
 public:
   // Internal property functions
@@ -70,6 +72,12 @@ public:
   void InvalidateBBox();
   void UpdateBBox();
 
+  // Internal mapped file functions
+  int ReadMappedBinary(void);
+  int ReadMappedFeatures(FETShape *shape, int first_feature, int nfeatures);
+  void LoadFeatures(void);
+  void ReleaseMappedFile(void);
+
   // Internal optimization
   void OptimizeTransformationsWithGlobalRelaxation(void);
   void OptimizeTransformationsWithRANSAC(void);
@@ -153,6 +161,14 @@ public:
 
   // Geometry parameters
   R3Box bbox;
+
+  // Mapped binary file (released after all features have been read)
+  void *mapped_data;
+  size_t mapped_size;
+  long long mapped_feature_offset;
+  long long mapped_descriptor_offset;
+  int nmapped_features;
+  long long nmapped_descriptor_values;
 };
 
 
@@ -184,6 +200,7 @@ inline int FETReconstruction::
 NFeatures(void) const
 {
   // Return number of features
+  if (mapped_data) ((FETReconstruction *) this)->LoadFeatures();
   return features.NEntries();
 }
 
@@ -193,6 +210,7 @@ inline FETFeature *FETReconstruction::
 Feature(int k) const
 {
   // Return kth feature
+  if (mapped_data) ((FETReconstruction *) this)->LoadFeatures();
   return features.Kth(k);
 }
 
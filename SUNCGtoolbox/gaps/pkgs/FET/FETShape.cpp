@@ -18,10 +18,13 @@ FETShape(FETReconstruction *reconstruction)
     children(),
     features(),
     matches(),
+    first_pending_feature(-1),
+    npending_features(0),
     initial_transformation(R3identity_affine),
     current_transformation(R3identity_affine),
     ground_truth_transformation(R3identity_affine),
     kdtree(NULL),
+    descriptor_index(NULL),
     viewpoint(0, 0, 0),
     towards(0, 0, 0),
     up(0, 0, 0),
@@ -52,10 +55,13 @@ FETShape(const FETShape& shape)
     children(),
     features(),
     matches(),
+    first_pending_feature(-1),
+    npending_features(0),
     initial_transformation(shape.initial_transformation),
     current_transformation(shape.current_transformation),
     ground_truth_transformation(shape.ground_truth_transformation),
     kdtree(NULL),
+    descriptor_index(NULL),
     viewpoint(shape.viewpoint),
     towards(shape.towards),
     up(shape.up),
@@ -107,8 +113,13 @@ FETShape::
   // Delete name
   if (name) free(name);
   
-  // Delete kdtree
+  // Delete search structures
   if (kdtree) delete kdtree;
+  if (descriptor_index) delete descriptor_index;
+
+  // Discard features never read from mapped file
+  first_pending_feature = -1;
+  npending_features = 0;
   
   // Remove from parents
   while (NParents() > 0) {
@@ -217,11 +228,18 @@ InsertFeature(FETFeature *feature)
   assert(feature->shape_index == -1);
   assert(feature->shape == NULL);
   
+  // Read features waiting in mapped file first (preserves feature order)
+  if (npending_features > 0) LoadFeatures();
+
   // Insert feature
   feature->shape = this;
   feature->shape_index = features.NEntries();
   features.Insert(feature);
 
+  // Invalidate search structures
+  if (kdtree) { delete kdtree; kdtree = NULL; }
+  if (descriptor_index) { delete descriptor_index; descriptor_index = NULL; }
+
   // Update bounding box
   if (!bbox.IsEmpty()) {
     bbox.Union(feature->Position(TRUE));
@@ -247,6 +265,10 @@ RemoveFeature(FETFeature *feature)
   feature->shape_index = -1;
   feature->shape = NULL;
 
+  // Invalidate search structures
+  if (kdtree) { delete kdtree; kdtree = NULL; }
+  if (descriptor_index) { delete descriptor_index; descriptor_index = NULL; }
+
   // Reset bounding box
   InvalidateBBox();
 }
@@ -632,11 +654,7 @@ UpdateFeatureProperties(void)
   RNLength max_neighbor_distance = RN_INFINITY;
 
   // Build shape's feature kdtree 
-  if (!kdtree) {
-    FETFeature tmp; int position_offset = (unsigned char *) &(tmp.position) - (unsigned char *) &tmp;
-    kdtree = new R3Kdtree<FETFeature *>(features, position_offset);
-    if (!kdtree) RNAbort("Cannot build kdtree");
-  }
+  if (!kdtree) UpdateKdtree();
 
   // Update normal and radius for every feature (if none already)
   for (int i = 0; i < NFeatures(); i++) {
@@ -697,6 +715,50 @@ UpdateBBox(void)
 
 
 
+void FETShape::
+LoadFeatures(void)
+{
+  // Check if features are waiting in mapped file
+  if (npending_features == 0) return;
+  int first_feature = first_pending_feature;
+  int nfeatures = npending_features;
+  first_pending_feature = -1;
+  npending_features = 0;
+
+  // Read features (not thread-safe, so done before concurrent searches)
+  if (!reconstruction) return;
+  if (!reconstruction->ReadMappedFeatures(this, first_feature, nfeatures)) {
+    fprintf(stderr, "Unable to read features of shape %s from mapped file\n", (name) ? name : "");
+  }
+}
+
+
+
+void FETShape::
+UpdateKdtree(void)
+{
+  // Build kdtree of features (must be done before concurrent searches)
+  LoadFeatures();
+  if (kdtree) delete kdtree;
+  FETFeature tmp; int position_offset = (unsigned char *) &(tmp.position) - (unsigned char *) &tmp;
+  kdtree = new R3Kdtree<FETFeature *>(features, position_offset);
+  if (!kdtree) RNAbort("Cannot build kdtree");
+}
+
+
+
+void FETShape::
+UpdateDescriptorIndex(void)
+{
+  // Build approximate nearest neighbor index of feature descriptors
+  LoadFeatures();
+  if (descriptor_index) delete descriptor_index;
+  descriptor_index = new FETDescriptorIndex(features);
+  if (!descriptor_index) RNAbort("Cannot build descriptor index");
+}
+
+
+
 void FETShape::
 InvalidateBBox(void)
 {
@@ -724,11 +786,7 @@ FindClosestFeature(const R3Point& query_position,
   RNLength min_euclidean_distance, RNLength max_euclidean_distance) 
 {
   // Build shape's feature kdtree 
-  if (!kdtree) {
-    FETFeature tmp; int position_offset = (unsigned char *) &(tmp.position) - (unsigned char *) &tmp;
-    kdtree = new R3Kdtree<FETFeature *>(features, position_offset);
-    if (!kdtree) RNAbort("Cannot build kdtree");
-  }
+  if (!kdtree) UpdateKdtree();
 
   // Find closest feature
   return kdtree->FindClosest(query_position, min_euclidean_distance, max_euclidean_distance);
@@ -748,32 +806,25 @@ FindClosestFeature(FETFeature *query_feature, const R3Affine& query_transformati
    min_distinction, min_salience, discard_boundaries);
 
   // Build kdtree 
-  if (!kdtree) {
-    FETFeature tmp; int position_offset = (unsigned char *) &(tmp.position) - (unsigned char *) &tmp;
-    kdtree = new R3Kdtree<FETFeature *>(features, position_offset);
-    if (!kdtree) RNAbort("Cannot build kdtree");
-  }
-
-  // Temporarily transform query feature
-  R3Point saved_query_position = query_feature->position;
-  R3Vector saved_query_direction = query_feature->direction;
-  R3Vector saved_query_normal = query_feature->normal;
-  query_feature->position.Transform(query_transformation);
-  query_feature->direction.Transform(query_transformation);
-  query_feature->normal.Transform(query_transformation);
-  query_feature->position.InverseTransform(current_transformation);
-  query_feature->direction.InverseTransform(current_transformation);
-  query_feature->normal.InverseTransform(current_transformation);
+  if (!kdtree) UpdateKdtree();
+
+  // Transform copy of query feature (so that concurrent searches can share query features)
+  FETFeature query(*query_feature);
+  query.shape = query_feature->shape;
+  query.position.Transform(query_transformation);
+  query.direction.Transform(query_transformation);
+  query.normal.Transform(query_transformation);
+  query.position.InverseTransform(current_transformation);
+  query.direction.InverseTransform(current_transformation);
+  query.normal.InverseTransform(current_transformation);
 
   // Find closest feature
-  FETFeature *closest_feature = kdtree->FindClosest(query_feature, 
+  FETFeature *closest_feature = kdtree->FindClosest(&query, 
     min_euclidean_distance, max_euclidean_distance, 
     AreFeaturesCompatible, &compatibility);
 
-  // Restore query feature
-  query_feature->position = saved_query_position;
-  query_feature->direction = saved_query_direction;
-  query_feature->normal = saved_query_normal;
+  // Detach copy of query feature from shape (so deleting it does not remove shape's feature)
+  query.shape = NULL;
 
   // Return closest feature
   return closest_feature;
@@ -781,6 +832,21 @@ FindClosestFeature(FETFeature *query_feature, const R3Affine& query_transformati
 
 
 
+FETFeature *FETShape::
+FindClosestFeatureByDescriptor(FETFeature *query_feature, RNLength max_descriptor_distance, int max_checks)
+{
+  // Build descriptor index
+  if (!descriptor_index) UpdateDescriptorIndex();
+
+  // Find feature of same generator type with closest descriptor
+  RNScalar max_squared_distance = FLT_MAX;
+  if (max_descriptor_distance != RN_UNKNOWN) max_squared_distance = max_descriptor_distance * max_descriptor_distance;
+  return descriptor_index->FindClosest(query_feature->descriptor, query_feature->generator_type, 
+    max_squared_distance, max_checks);
+}
+
+
+
 int FETShape::
 FindAllFeatures(FETFeature *query_feature, const R3Affine& query_transformation, RNArray<FETFeature *>& result,
   RNLength min_euclidean_distance, RNLength max_euclidean_distance, 
@@ -794,33 +860,26 @@ FindAllFeatures(FETFeature *query_feature, const R3Affine& query_transformation,
    min_distinction, min_salience, discard_boundaries);
 
   // Build shape's feature kdtree 
-  if (!kdtree) {
-    FETFeature tmp; int position_offset = (unsigned char *) &(tmp.position) - (unsigned char *) &tmp;
-    kdtree = new R3Kdtree<FETFeature *>(features, position_offset);
-    if (!kdtree) RNAbort("Cannot build kdtree");
-  }
-
-  // Temporarily transform query feature
-  R3Point saved_query_position = query_feature->position;
-  R3Vector saved_query_direction = query_feature->direction;
-  R3Vector saved_query_normal = query_feature->normal;
-  query_feature->position.Transform(query_transformation);
-  query_feature->direction.Transform(query_transformation);
-  query_feature->normal.Transform(query_transformation);
-  query_feature->position.InverseTransform(current_transformation);
-  query_feature->direction.InverseTransform(current_transformation);
-  query_feature->normal.InverseTransform(current_transformation);
+  if (!kdtree) UpdateKdtree();
+
+  // Transform copy of query feature (so that concurrent searches can share query features)
+  FETFeature query(*query_feature);
+  query.shape = query_feature->shape;
+  query.position.Transform(query_transformation);
+  query.direction.Transform(query_transformation);
+  query.normal.Transform(query_transformation);
+  query.position.InverseTransform(current_transformation);
+  query.direction.InverseTransform(current_transformation);
+  query.normal.InverseTransform(current_transformation);
 
   // Find all features
-  kdtree->FindAll(query_feature, 
+  kdtree->FindAll(&query, 
     min_euclidean_distance, max_euclidean_distance, 
     AreFeaturesCompatible, &compatibility, 
     result);
 
-  // Restore query feature
-  query_feature->position = saved_query_position;
-  query_feature->direction = saved_query_direction;
-  query_feature->normal = saved_query_normal;
+  // Detach copy of query feature from shape (so deleting it does not remove shape's feature)
+  query.shape = NULL;
 
   // Return success
   return result.NEntries();
@@ -67,6 +67,8 @@ public:
     RNLength *max_descriptor_distances = NULL, RNAngle max_normal_angle = RN_UNKNOWN,
     RNScalar min_distinction = RN_UNKNOWN, RNScalar min_salience = RN_UNKNOWN,
     RNBoolean discard_boundaries = FALSE);
+  FETFeature *FindClosestFeatureByDescriptor(FETFeature *query_feature,
+    RNLength max_descriptor_distance = RN_UNKNOWN, int max_checks = 256);
 
 public:
   // Internal properties
@@ -89,6 +91,9 @@ public:
 
   // Internal updates
   void UpdateFeatureProperties(void);
+  void LoadFeatures(void);
+  void UpdateKdtree(void);
+  void UpdateDescriptorIndex(void);
   void InvalidateBBox(void);
   void UpdateBBox(void);
 
@@ -116,6 +121,10 @@ public:
   RNArray<FETFeature *> features;
   RNArray<FETMatch *> matches;
 
+  // Features still waiting in mapped reconstruction file (read on first access)
+  int first_pending_feature;
+  int npending_features;
+
   // Transformation properties
   R3Affine initial_transformation;
   R3Affine current_transformation;
@@ -128,6 +137,7 @@ public:
   
   // Geometric properties
   R3Kdtree<struct FETFeature *> *kdtree;
+  FETDescriptorIndex *descriptor_index;
   R3Point viewpoint; // untransformed
   R3Vector towards, up; // untransformed
   R3Box bbox; // transformed
@@ -219,6 +229,7 @@ inline int FETShape::
 NFeatures(void) const
 {
   // Return number of features
+  if (npending_features > 0) ((FETShape *) this)->LoadFeatures();
   return features.NEntries();
 }
 
@@ -228,6 +239,7 @@ inline FETFeature *FETShape::
 Feature(int k) const
 {
   // Return kth feature
+  if (npending_features > 0) ((FETShape *) this)->LoadFeatures();
   return features.Kth(k);
 }
 
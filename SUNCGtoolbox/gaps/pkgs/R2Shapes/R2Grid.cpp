@@ -13,6 +13,7 @@
 // Include files
 
 #include "R2Shapes/R2Shapes.h"
+#include <algorithm>
 
 
 
@@ -632,20 +633,21 @@ Erode(RNLength grid_distance)
 
 
 
-void R2Grid::
-Blur(RNDimension dim, RNLength grid_sigma) 
+// Number of adjacent lines gathered into one interleaved block
+
+static const int R2_GRID_FILTER_BLOCK_SIZE = 16;
+
+
+
+static RNScalar *
+R2GridGaussianFilter(RNLength grid_sigma, int& filter_radius)
 {
   // Build filter
   RNScalar sigma = grid_sigma;
-  int filter_radius = (int) (3 * sigma + 0.5);
+  filter_radius = (int) (3 * sigma + 0.5);
   RNScalar *filter = new RNScalar [ filter_radius + 1 ];
   assert(filter);
 
-  // Make buffer for temporary copy of row
-  int res = Resolution(dim);
-  RNScalar *buffer = new RNScalar [ res ];
-  assert(buffer);
-
   // Fill filter with Gaussian 
   const RNScalar sqrt_two_pi = sqrt(RN_TWO_PI);
   double a = sqrt_two_pi * sigma;
@@ -655,48 +657,115 @@ Blur(RNDimension dim, RNLength grid_sigma)
     filter[i] = fac * exp(-i * i / denom);
   }
 
-  // Convolve grid with filter 
-  for (int j = 0; j < Resolution(1-dim); j++) { 
-    for (int i = 0; i < Resolution(dim); i++) 
-      buffer[i] = (dim == RN_X) ? GridValue(i, j) : GridValue(j, i); 
-    for (int i = 0; i < Resolution(dim); i++) { 
-      if (buffer[i] == R2_GRID_UNKNOWN_VALUE) continue;
-      RNScalar sum = 0;
-      RNScalar weight = 0;
-      RNScalar value = buffer[i];
-      if (value != R2_GRID_UNKNOWN_VALUE) {
-        sum += filter[0] * value;
-        weight += filter[0];
-      }
-      int nsamples = i;
-      if (nsamples > filter_radius) nsamples = filter_radius;
-      for (int m = 1; m <= nsamples; m++) {
-        RNScalar value = buffer[i - m];;
-        if (value != R2_GRID_UNKNOWN_VALUE) {
-          sum += filter[m] * value;
-          weight += filter[m];
-        }
-      }
-      nsamples = XResolution() - 1 - i;
-      if (nsamples > filter_radius) nsamples = filter_radius;
-      for (int m = 1; m <= nsamples; m++) {
-        RNScalar value = buffer[i + m];
-        if (value != R2_GRID_UNKNOWN_VALUE) {
-          sum += filter[m] * value;
-          weight += filter[m];
-        }
-      }
-      if (weight > 0) {
-        RNScalar value = sum / weight;
-        if (dim == RN_X) SetGridValue(i, j, value);
-        else SetGridValue(j, i, value);
-      }
+  // Return filter
+  return filter;
+}
+
+
+
+static void
+R2GridFilterLines(RNScalar *values, int n, int nlines,
+  const RNScalar *filter, int filter_radius, RNScalar *buffer)
+{
+  // Convolve nlines interleaved lines of n values (values[i*nlines + b]) with
+  // symmetric filter, ignoring unknown values.  Each filter tap is applied
+  // to one contiguous run of the block, so that the inner loops vectorize.
+  int size = n * nlines;
+  RNScalar *known = buffer;
+  RNScalar *masked = known + size;
+  RNScalar *sum = masked + size;
+  RNScalar *weight = sum + size;
+
+  // Separate known values
+  for (int k = 0; k < size; k++) {
+    RNBoolean is_known = (values[k] != R2_GRID_UNKNOWN_VALUE);
+    known[k] = (is_known) ? 1.0 : 0.0;
+    masked[k] = (is_known) ? values[k] : 0.0;
+    sum[k] = 0;
+    weight[k] = 0;
+  }
+
+  // Accumulate filter taps
+  for (int m = -filter_radius; m <= filter_radius; m++) {
+    RNScalar f = filter[(m < 0) ? -m : m];
+    int offset = m * nlines;
+    int start = (m < 0) ? -offset : 0;
+    int end = (m > 0) ? size - offset : size;
+    for (int k = start; k < end; k++) {
+      sum[k] += f * masked[k + offset];
+      weight[k] += f * known[k + offset];
     }
   }
 
+  // Normalize filtered values (unknown values stay unknown)
+  for (int k = 0; k < size; k++) {
+    if (values[k] == R2_GRID_UNKNOWN_VALUE) continue;
+    if (weight[k] > 0) values[k] = sum[k] / weight[k];
+  }
+}
+
+
+
+static void
+R2GridFilterPass(RNScalar *grid_values, int xres, int yres, RNDimension dim,
+  const RNScalar *filter, int filter_radius)
+{
+  // Convolve all lines along dim with filter.  Up to block_size adjacent
+  // lines are gathered into an interleaved buffer, so that grid memory 
+  // is read and written in runs, and blocks are processed in parallel.
+  int n = (dim == RN_X) ? xres : yres;
+  int nlines = (dim == RN_X) ? yres : xres;
+  int step = (dim == RN_X) ? 1 : xres;
+  int line_step = (dim == RN_X) ? xres : 1;
+  int block_size = R2_GRID_FILTER_BLOCK_SIZE;
+  int nblocks = (nlines + block_size - 1) / block_size;
+  int buffer_size = 5 * block_size * n;
+  RNScalar *buffers = new RNScalar [ RNNumThreads() * buffer_size ];
+  assert(buffers);
+
+  // Process blocks of lines in parallel
+  RNParallelFor(0, nblocks, [&](int block, int thread) {
+    // Get block of lines
+    int first_line = block * block_size;
+    int nblock_lines = nlines - first_line;
+    if (nblock_lines > block_size) nblock_lines = block_size;
+    RNScalar *values = &buffers[thread * buffer_size];
+    RNScalar *scratch = values + block_size * n;
+
+    // Gather lines into interleaved buffer
+    for (int i = 0; i < n; i++) {
+      const RNScalar *src = &grid_values[first_line * line_step + i * step];
+      for (int b = 0; b < nblock_lines; b++) values[i*nblock_lines + b] = src[b * line_step];
+    }
+
+    // Filter lines
+    R2GridFilterLines(values, n, nblock_lines, filter, filter_radius, scratch);
+
+    // Scatter lines back into grid
+    for (int i = 0; i < n; i++) {
+      RNScalar *dst = &grid_values[first_line * line_step + i * step];
+      for (int b = 0; b < nblock_lines; b++) dst[b * line_step] = values[i*nblock_lines + b];
+    }
+  });
+
+  // Delete temporary buffers
+  delete [] buffers;
+}
+
+
+
+void R2Grid::
+Blur(RNDimension dim, RNLength grid_sigma) 
+{
+  // Build filter
+  int filter_radius;
+  RNScalar *filter = R2GridGaussianFilter(grid_sigma, filter_radius);
+
+  // Convolve grid with filter along dim
+  R2GridFilterPass(grid_values, XResolution(), YResolution(), dim, filter, filter_radius);
+
   // Deallocate memory
   delete [] filter;
-  delete [] buffer;
 }
 
 
@@ -705,99 +774,17 @@ void R2Grid::
 Blur(RNLength grid_sigma) 
 {
   // Build filter
-  RNScalar sigma = grid_sigma;
-  int filter_radius = (int) (3 * sigma + 0.5);
-  RNScalar *filter = new RNScalar [ filter_radius + 1 ];
-  assert(filter);
-
-  // Make buffer for temporary copy of row
-  int res = XResolution();
-  if (res < YResolution()) res = YResolution();
-  RNScalar *buffer = new RNScalar [ res ];
-  assert(buffer);
-
-  // Fill filter with Gaussian 
-  const RNScalar sqrt_two_pi = sqrt(RN_TWO_PI);
-  double a = sqrt_two_pi * sigma;
-  double fac = 1.0 / (a * a * a);
-  double denom = 2.0 * sigma * sigma;
-  for (int i = 0; i <= filter_radius; i++) {
-    filter[i] = fac * exp(-i * i / denom);
-  }
+  int filter_radius;
+  RNScalar *filter = R2GridGaussianFilter(grid_sigma, filter_radius);
 
   // Convolve grid with filter in X direction
-  for (int j = 0; j < YResolution(); j++) { 
-    for (int i = 0; i < XResolution(); i++) 
-      buffer[i] = GridValue(i, j); 
-    for (int i = 0; i < XResolution(); i++) { 
-      if (buffer[i] == R2_GRID_UNKNOWN_VALUE) continue;
-      RNScalar sum = 0;
-      RNScalar weight = 0;
-      RNScalar value = buffer[i];
-      if (value != R2_GRID_UNKNOWN_VALUE) {
-        sum += filter[0] * value;
-        weight += filter[0];
-      }
-      int nsamples = i;
-      if (nsamples > filter_radius) nsamples = filter_radius;
-      for (int m = 1; m <= nsamples; m++) {
-        RNScalar value = buffer[i - m];;
-        if (value != R2_GRID_UNKNOWN_VALUE) {
-          sum += filter[m] * value;
-          weight += filter[m];
-        }
-      }
-      nsamples = XResolution() - 1 - i;
-      if (nsamples > filter_radius) nsamples = filter_radius;
-      for (int m = 1; m <= nsamples; m++) {
-        RNScalar value = buffer[i + m];
-        if (value != R2_GRID_UNKNOWN_VALUE) {
-          sum += filter[m] * value;
-          weight += filter[m];
-        }
-      }
-      if (weight > 0) SetGridValue(i, j, sum / weight);
-    }
-  }
+  R2GridFilterPass(grid_values, XResolution(), YResolution(), RN_X, filter, filter_radius);
 
   // Convolve grid with filter in Y direction
-  for (int j = 0; j < XResolution(); j++) { 
-    for (int i = 0; i < YResolution(); i++) 
-      buffer[i] = GridValue(j, i); 
-    for (int i = 0; i < YResolution(); i++) { 
-      if (buffer[i] == R2_GRID_UNKNOWN_VALUE) continue;
-      RNScalar sum = 0;
-      RNScalar weight = 0;
-      RNScalar value = buffer[i];
-      if (value != R2_GRID_UNKNOWN_VALUE) {
-        sum += filter[0] * value;
-        weight += filter[0];
-      }
-      int nsamples = i;
-      if (nsamples > filter_radius) nsamples = filter_radius;
-      for (int m = 1; m <= nsamples; m++) {
-        RNScalar value = buffer[i - m];
-        if (value != R2_GRID_UNKNOWN_VALUE) {
-          sum += filter[m] * value;
-          weight += filter[m];
-        }
-      }
-      nsamples = YResolution() - 1 - i;
-      if (nsamples > filter_radius) nsamples = filter_radius;
-      for (int m = 1; m <= nsamples; m++) {
-        RNScalar value = buffer[i + m];
-        if (value != R2_GRID_UNKNOWN_VALUE) {
-          sum += filter[m] * value;
-          weight += filter[m];
-        }
-      }
-      if (weight > 0) SetGridValue(j, i, sum / weight);
-    }
-  }
+  R2GridFilterPass(grid_values, XResolution(), YResolution(), RN_Y, filter, filter_radius);
 
   // Deallocate memory
   delete [] filter;
-  delete [] buffer;
 }
 
 
@@ -824,6 +811,7 @@ BilateralFilter(RNLength grid_sigma, RNLength value_sigma)
 {
   // Make copy of grid
   R2Grid copy(*this);
+  const RNScalar *input = copy.grid_values;
 
   // Determine reasonable value sigma
   if (value_sigma == -1) {
@@ -832,50 +820,67 @@ BilateralFilter(RNLength grid_sigma, RNLength value_sigma)
   }
 
   // Get convenient variables
+  int xres = XResolution();
+  int yres = YResolution();
   double grid_denom = 2.0 * grid_sigma * grid_sigma;
   double value_denom = 2.0 * value_sigma * value_sigma;
   RNScalar grid_radius = 3 * grid_sigma;
   int r = (int) (grid_radius + 1);
   int r_squared = r * r;
 
-  // Set every sample to be filter of surrounding region in input grid
-  for (int cy = 0; cy < YResolution(); cy++) {
-    for (int cx = 0; cx < XResolution(); cx++) {
+  // Precompute spatial weights (zero outside radius)
+  int width = 2*r + 1;
+  RNScalar *grid_weights = new RNScalar [ width * width ];
+  assert(grid_weights);
+  for (int dy = -r; dy <= r; dy++) {
+    for (int dx = -r; dx <= r; dx++) {
+      int grid_distance_squared = dx*dx + dy*dy;
+      RNScalar *weightp = &grid_weights[(dy + r) * width + (dx + r)];
+      if (grid_distance_squared > r_squared) *weightp = 0;
+      else *weightp = exp(-grid_distance_squared/grid_denom);
+    }
+  }
+
+  // Set every sample to be filter of surrounding region in input grid (rows in parallel)
+  RNParallelFor(0, yres, [&](int cy, int) {
+    for (int cx = 0; cx < xres; cx++) {
       // Check if current value is unknown - if so, don't update
-      RNScalar value = copy.GridValue(cx, cy);
-      if (value != R2_GRID_UNKNOWN_VALUE) {
-        RNScalar sum = 0;
-        RNScalar weight = 0;
-        int ymin = cy - r;
-        int ymax = cy + r;
-        if (ymin < 0) ymin = 0;
-        if (ymax >= YResolution()) ymax = YResolution() - 1;
-        for (int y = ymin; y <= ymax; y++) {
-          int xmin = cx - r;
-          int xmax = cx + r;
-          if (xmin < 0) xmin = 0;
-          if (xmax >= XResolution()) xmax = XResolution() - 1;
-          int dy = y - cy;
-          for (int x = xmin; x <= xmax; x++) {
-            int dx = x - cx;
-            int grid_distance_squared = dx*dx + dy*dy;
-            if (grid_distance_squared > r_squared) continue;
-            RNScalar sample = copy.GridValue(x, y);
-            if (sample == R2_GRID_UNKNOWN_VALUE) continue;
-            RNScalar value_distance_squared = value - sample;
-            value_distance_squared *= value_distance_squared;
-            RNScalar w = exp(-grid_distance_squared/grid_denom) * exp(-value_distance_squared/value_denom);
-            sum += w * sample;
-            weight += w;
-          }
+      RNScalar value = input[cy * xres + cx];
+      if (value == R2_GRID_UNKNOWN_VALUE) continue;
+      RNScalar sum = 0;
+      RNScalar weight = 0;
+      int ymin = cy - r;
+      int ymax = cy + r;
+      if (ymin < 0) ymin = 0;
+      if (ymax >= yres) ymax = yres - 1;
+      int xmin = cx - r;
+      int xmax = cx + r;
+      if (xmin < 0) xmin = 0;
+      if (xmax >= xres) xmax = xres - 1;
+      for (int y = ymin; y <= ymax; y++) {
+        const RNScalar *samples = &input[y * xres];
+        const RNScalar *weights = &grid_weights[(y - cy + r) * width + r];
+        for (int x = xmin; x <= xmax; x++) {
+          RNScalar grid_weight = weights[x - cx];
+          if (grid_weight == 0) continue;
+          RNScalar sample = samples[x];
+          if (sample == R2_GRID_UNKNOWN_VALUE) continue;
+          RNScalar value_distance_squared = value - sample;
+          value_distance_squared *= value_distance_squared;
+          RNScalar w = grid_weight * exp(-value_distance_squared/value_denom);
+          sum += w * sample;
+          weight += w;
         }
-
-        // Set grid value
-        if (weight == 0) SetGridValue(cx, cy, R2_GRID_UNKNOWN_VALUE);
-        else SetGridValue(cx, cy, sum / weight);
       }
+
+      // Set grid value
+      if (weight == 0) grid_values[cy * xres + cx] = R2_GRID_UNKNOWN_VALUE;
+      else grid_values[cy * xres + cx] = sum / weight;
     }
-  }
+  }, 4);
+
+  // Delete temporary memory
+  delete [] grid_weights;
 }
 
 
@@ -883,7 +888,51 @@ BilateralFilter(RNLength grid_sigma, RNLength value_sigma)
 void R2Grid::
 AnisotropicDiffusion(RNLength grid_sigma, RNLength gradient_sigma)
 {
-  RNAbort("Not implemented");
+  // Determine reasonable gradient sigma
+  if (gradient_sigma == -1) {
+    RNInterval range = Range();
+    gradient_sigma = 0.01 * (range.Max() - range.Min());
+  }
+
+  // Check parameters
+  if (grid_sigma <= 0) return;
+  if (gradient_sigma <= 0) return;
+
+  // Get convenient variables (diffusing for time sigma^2/2 blurs flat regions like a Gaussian)
+  int xres = XResolution();
+  int yres = YResolution();
+  const RNScalar dt = 0.25;
+  int niterations = (int) (0.5 * grid_sigma * grid_sigma / dt + 0.5);
+  if (niterations < 1) niterations = 1;
+  RNScalar gradient_denom = gradient_sigma * gradient_sigma;
+  R2Grid copy(*this);
+
+  // Perona-Malik diffusion between 4-connected neighbors with known values
+  for (int iteration = 0; iteration < niterations; iteration++) {
+    // Copy values of previous iteration
+    const RNScalar *input = copy.grid_values;
+    if (iteration > 0) memcpy(copy.grid_values, grid_values, grid_size * sizeof(RNScalar));
+
+    // Update rows in parallel
+    RNParallelFor(0, yres, [&](int cy, int) {
+      for (int cx = 0; cx < xres; cx++) {
+        RNScalar value = input[cy * xres + cx];
+        if (value == R2_GRID_UNKNOWN_VALUE) continue;
+        RNScalar neighbors[4];
+        neighbors[0] = (cx > 0) ? input[cy * xres + cx - 1] : R2_GRID_UNKNOWN_VALUE;
+        neighbors[1] = (cx < xres - 1) ? input[cy * xres + cx + 1] : R2_GRID_UNKNOWN_VALUE;
+        neighbors[2] = (cy > 0) ? input[(cy - 1) * xres + cx] : R2_GRID_UNKNOWN_VALUE;
+        neighbors[3] = (cy < yres - 1) ? input[(cy + 1) * xres + cx] : R2_GRID_UNKNOWN_VALUE;
+        RNScalar flux = 0;
+        for (int k = 0; k < 4; k++) {
+          if (neighbors[k] == R2_GRID_UNKNOWN_VALUE) continue;
+          RNScalar delta = neighbors[k] - value;
+          flux += exp(-delta * delta / gradient_denom) * delta;
+        }
+        grid_values[cy * xres + cx] = value + dt * flux;
+      }
+    }, 4);
+  }
 }
 
 
@@ -893,62 +942,65 @@ PercentileFilter(RNLength grid_radius, RNScalar percentile)
 {
   // Make copy of grid
   R2Grid copy(*this);
+  const RNScalar *input = copy.grid_values;
 
   // Get convenient variables
+  int xres = XResolution();
+  int yres = YResolution();
   RNScalar grid_radius_squared = grid_radius * grid_radius;
   int r = (int) grid_radius;
   assert(r >= 0);
   int max_samples = (2*r+1) * (2*r+1);
-  RNScalar *samples = new RNScalar [ max_samples ];
-  assert(samples);
+  RNScalar *buffers = new RNScalar [ RNNumThreads() * max_samples ];
+  assert(buffers);
 
-  // Set every sample to be Kth percentile of surrounding region in input grid
-  for (int cy = 0; cy < YResolution(); cy++) {
-    for (int cx = 0; cx < XResolution(); cx++) {
+  // Set every sample to be Kth percentile of surrounding region in input grid (rows in parallel)
+  RNParallelFor(0, yres, [&](int cy, int thread) {
+    RNScalar *samples = &buffers[thread * max_samples];
+    for (int cx = 0; cx < xres; cx++) {
       // Check if current value is unknown - if so, don't update
-      if (GridValue(cx, cy) != R2_GRID_UNKNOWN_VALUE) {
-        // Build list of grid values in neighborhood
-        int nsamples = 0;
-        int ymin = cy - r;
-        int ymax = cy + r;
-        if (ymin < 0) ymin = 0;
-        if (ymax >= YResolution()) ymax = YResolution() - 1;
-        for (int y = ymin; y <= ymax; y++) {
-          int xmin = cx - r;
-          int xmax = cx + r;
-          if (xmin < 0) xmin = 0;
-          if (xmax >= XResolution()) xmax = XResolution() - 1;
-          int dy = y - cy;
-          for (int x = xmin; x <= xmax; x++) {
-            int dx = x - cx;
-            int d_squared = dx*dx + dy*dy;
-            if (d_squared > grid_radius_squared) continue;
-            RNScalar sample = copy.GridValue(x, y);
-            if (sample == R2_GRID_UNKNOWN_VALUE) continue;
-            samples[nsamples++] = sample;
-          }
+      if (input[cy * xres + cx] == R2_GRID_UNKNOWN_VALUE) continue;
+
+      // Build list of grid values in neighborhood
+      int nsamples = 0;
+      int ymin = cy - r;
+      int ymax = cy + r;
+      if (ymin < 0) ymin = 0;
+      if (ymax >= yres) ymax = yres - 1;
+      int xmin = cx - r;
+      int xmax = cx + r;
+      if (xmin < 0) xmin = 0;
+      if (xmax >= xres) xmax = xres - 1;
+      for (int y = ymin; y <= ymax; y++) {
+        int dy = y - cy;
+        const RNScalar *row = &input[y * xres];
+        for (int x = xmin; x <= xmax; x++) {
+          int dx = x - cx;
+          int d_squared = dx*dx + dy*dy;
+          if (d_squared > grid_radius_squared) continue;
+          RNScalar sample = row[x];
+          if (sample == R2_GRID_UNKNOWN_VALUE) continue;
+          samples[nsamples++] = sample;
         }
+      }
 
-        // Check number of grid values in neighborhood
-        if (nsamples == 0) {
-          SetGridValue(cx, cy, R2_GRID_UNKNOWN_VALUE);
-        }
-        else {
-          // Sort samples found in neighborhood
-          qsort(samples, nsamples, sizeof(RNScalar), RNCompareScalars);
-
-          // Set grid value to percentile of neighborhood
-          int index = (int) (percentile * nsamples);
-          if (index < 0) index = 0;
-          else if (index >= nsamples) index = nsamples-1;
-          SetGridValue(cx, cy, samples[index]);
-        }
+      // Check number of grid values in neighborhood
+      if (nsamples == 0) {
+        grid_values[cy * xres + cx] = R2_GRID_UNKNOWN_VALUE;
+      }
+      else {
+        // Set grid value to percentile of neighborhood (partial sort is enough)
+        int index = (int) (percentile * nsamples);
+        if (index < 0) index = 0;
+        else if (index >= nsamples) index = nsamples-1;
+        std::nth_element(samples, samples + index, samples + nsamples);
+        grid_values[cy * xres + cx] = samples[index];
       }
     }
-  }
+  }, 4);
 
   // Delete temporary memory
-  delete [] samples;
+  delete [] buffers;
 }
 
 
@@ -1124,8 +1176,8 @@ Convolve(const RNScalar filter[3][3])
     SetGridValue(XResolution()-1, j, R2_GRID_UNKNOWN_VALUE);
   }
 
-  // Convolve grid with 3x3 filter
-  for (int j = 1; j < YResolution()-1; j++) { 
+  // Convolve grid with 3x3 filter (rows in parallel)
+  RNParallelFor(1, YResolution()-1, [&](int j, int) {
     for (int i = 1; i < XResolution()-1; i++) { 
       RNScalar value = copy.GridValue(i, j);
       if (value != R2_GRID_UNKNOWN_VALUE) {
@@ -1143,7 +1195,7 @@ Convolve(const RNScalar filter[3][3])
         else SetGridValue(i, j, sum);
       }
     }
-  }
+  }, 16);
 }
 
 
@@ -1309,9 +1361,19 @@ HarrisCornerFilter(int radius, RNScalar kappa)
   // Get convenient variables
   RNScalar twice_squared_sigma = 0.5 * radius * radius;
 
-  // Create harris response function
-  for (int cx = 0; cx < XResolution(); cx++) {
-    for (int cy = 0; cy < YResolution(); cy++) {
+  // Precompute window weights
+  int width = 2*radius + 1;
+  RNScalar *weights = new RNScalar [ width * width ];
+  assert(weights);
+  for (int s = -radius; s <= radius; s++) {
+    for (int t = -radius; t <= radius; t++) {
+      weights[(s + radius) * width + (t + radius)] = exp(-(s*s + t*t)/twice_squared_sigma);
+    }
+  }
+
+  // Create harris response function (rows in parallel)
+  RNParallelFor(0, YResolution(), [&](int cy, int) {
+    for (int cx = 0; cx < XResolution(); cx++) {
       // Check this pixel
       if (xgradient.GridValue(cx, cy) == R2_GRID_UNKNOWN_VALUE) continue;
       if (ygradient.GridValue(cx, cy) == R2_GRID_UNKNOWN_VALUE) continue;
@@ -1321,18 +1383,17 @@ HarrisCornerFilter(int radius, RNScalar kappa)
       RNScalar dy2 = 0; 
       RNScalar dxdy = 0; 
       for (int s = -radius; s <= radius; s++) {
-        int s2 = s*s;
         int ix = cx + s;
         if ((ix < 0) || (ix >= XResolution())) continue;
+        const RNScalar *window_weights = &weights[(s + radius) * width + radius];
         for (int t = -radius; t <= radius; t++) {
-          int t2 = t*t;
           int iy = cy + t;
           if ((iy < 0) || (iy >= YResolution())) continue;
           RNScalar dx = xgradient.GridValue(ix, iy);
           if (dx == R2_GRID_UNKNOWN_VALUE) continue;
           RNScalar dy = ygradient.GridValue(ix, iy);
           if (dy == R2_GRID_UNKNOWN_VALUE) continue;
-          RNScalar w = exp(-(s2 + t2)/twice_squared_sigma);
+          RNScalar w = window_weights[t];
           dx2 += w * dx*dx;
           dy2 += w * dy*dy;
           dxdy += w * dx*dy;
@@ -1355,7 +1416,10 @@ HarrisCornerFilter(int radius, RNScalar kappa)
       // Set grid value
       SetGridValue(cx, cy, R);
     }
-  }
+  }, 4);
+
+  // Delete temporary memory
+  delete [] weights;
 }
 
 
@@ -15,7 +15,10 @@ R2Image(void)
     height(0),
     ncomponents(0),
     rowsize(0),
-    pixels(NULL)
+    pixels(NULL),
+    levels(NULL),
+    nlevels(0),
+    levels_mutex()
 {
 }
 
@@ -27,7 +30,10 @@ R2Image(const char *filename)
     height(0),
     ncomponents(0),
     rowsize(0),
-    pixels(NULL)
+    pixels(NULL),
+    levels(NULL),
+    nlevels(0),
+    levels_mutex()
 {
   // Read image
   Read(filename);
@@ -41,7 +47,10 @@ R2Image(int width, int height, int ncomponents)
     height(height),
     ncomponents(ncomponents),
     rowsize(0),
-    pixels(NULL)
+    pixels(NULL),
+    levels(NULL),
+    nlevels(0),
+    levels_mutex()
 {
   // Initialize pixels
   rowsize = ncomponents * width;
@@ -50,7 +59,7 @@ R2Image(int width, int height, int ncomponents)
   pixels = new unsigned char [nbytes];
   assert(pixels);
   unsigned char *p = pixels;
-  while (--nbytes) *(p++) = 0;
+  while (nbytes--) *(p++) = 0;
 }
 
 
@@ -61,7 +70,10 @@ R2Image(int width, int height, int ncomponents, unsigned char *data)
     height(height),
     ncomponents(ncomponents),
     rowsize(0),
-    pixels(NULL)
+    pixels(NULL),
+    levels(NULL),
+    nlevels(0),
+    levels_mutex()
 {
   // Copy pixels (first pixel is lower-left)
   rowsize = ncomponents * width;
@@ -70,7 +82,7 @@ R2Image(int width, int height, int ncomponents, unsigned char *data)
   pixels = new unsigned char [nbytes];
   assert(pixels);
   unsigned char *p = pixels;
-  while (--nbytes) *(p++) = *(data++);
+  while (nbytes--) *(p++) = *(data++);
 }
 
 
@@ -81,7 +93,10 @@ R2Image(const R2Image& image)
     height(image.height),
     ncomponents(image.ncomponents),
     rowsize(image.rowsize),
-    pixels(NULL)
+    pixels(NULL),
+    levels(NULL),
+    nlevels(0),
+    levels_mutex()
 {
   // Copy pixels
   int nbytes = rowsize * height;
@@ -89,7 +104,7 @@ R2Image(const R2Image& image)
   assert(pixels);
   unsigned char *p = pixels;
   unsigned char *data = image.pixels;
-  while (--nbytes) *(p++) = *(data++);
+  while (nbytes--) *(p++) = *(data++);
 }
 
 
@@ -97,6 +112,9 @@ R2Image(const R2Image& image)
 R2Image::
 ~R2Image(void)
 {
+  // Free mip levels
+  DeleteLevels();
+
   // Free image pixels
   if (pixels) delete [] pixels;
 }
@@ -132,9 +150,102 @@ PixelRGB(int x, int y) const
 
 
 
+const R2Image *R2Image::
+Level(int level) const
+{
+  // Check level
+  if (level <= 0) return this;
+  if (level >= NLevels()) level = NLevels() - 1;
+  if (level <= 0) return this;
+
+  // Check if mip levels have been built (without locking, since images may be sampled by many threads)
+  R2Image **image_levels = levels.load(std::memory_order_acquire);
+  if (image_levels) return image_levels[level];
+
+  // Build mip levels the first time they are needed (other threads wait for this image only)
+  levels_mutex.Lock();
+  image_levels = levels.load(std::memory_order_relaxed);
+  if (!image_levels) {
+    int n = NLevels();
+    image_levels = new R2Image * [ n ];
+    image_levels[0] = (R2Image *) this;
+    for (int k = 1; k < n; k++) {
+      // Average 2x2 blocks of the previous level (clamped at odd borders)
+      const R2Image *src = image_levels[k-1];
+      int w = (src->width + 1) / 2;
+      int h = (src->height + 1) / 2;
+      R2Image *dst = new R2Image(w, h, ncomponents);
+      for (int y = 0; y < h; y++) {
+        int y0 = 2*y;
+        int y1 = (2*y+1 < src->height) ? 2*y+1 : 2*y;
+        unsigned char *dstp = &dst->pixels[y*dst->rowsize];
+        for (int x = 0; x < w; x++) {
+          int x0 = 2*x;
+          int x1 = (2*x+1 < src->width) ? 2*x+1 : 2*x;
+          const unsigned char *p00 = src->Pixel(x0, y0);
+          const unsigned char *p01 = src->Pixel(x1, y0);
+          const unsigned char *p10 = src->Pixel(x0, y1);
+          const unsigned char *p11 = src->Pixel(x1, y1);
+          for (int c = 0; c < ncomponents; c++) {
+            *(dstp++) = (unsigned char) ((p00[c] + p01[c] + p10[c] + p11[c] + 2) / 4);
+          }
+        }
+      }
+      image_levels[k] = dst;
+    }
+
+    // Publish mip levels
+    nlevels = n;
+    levels.store(image_levels, std::memory_order_release);
+  }
+  levels_mutex.Unlock();
+
+  // Return image for level
+  return image_levels[level];
+}
+
+
+
+int R2Image::
+FootprintLevel(const R2Point& t1, const R2Point& t2, const R2Point& t3, RNArea sample_area) const
+{
+  // Check area of triangle in samples
+  if (sample_area <= 0) return 0;
+
+  // Compute area of triangle in texels
+  double u1 = (t2.X() - t1.X()) * width, v1 = (t2.Y() - t1.Y()) * height;
+  double u2 = (t3.X() - t1.X()) * width, v2 = (t3.Y() - t1.Y()) * height;
+  double texel_area = fabs(u1*v2 - u2*v1);
+  if (texel_area <= 0) return 0;
+
+  // Return level at which one sample covers about one texel (the mapping is affine, so this is constant over the triangle)
+  double texels_per_sample = sqrt(texel_area / sample_area);
+  if (texels_per_sample < 2) return 0;
+  return (int) floor(log(texels_per_sample) / log(2.0));
+}
+
+
+
+void R2Image::
+DeleteLevels(void)
+{
+  // Delete mip levels (level 0 is this image)
+  R2Image **image_levels = levels.load();
+  if (!image_levels) return;
+  for (int k = 1; k < nlevels; k++) delete image_levels[k];
+  delete [] image_levels;
+  levels.store(NULL);
+  nlevels = 0;
+}
+
+
+
 R2Image& R2Image::
 operator=(const R2Image& image)
 {
+  // Delete mip levels
+  DeleteLevels();
+
   // Assign values
   this->width = image.width;
   this->height = image.height;
@@ -148,7 +259,7 @@ operator=(const R2Image& image)
   assert(this->pixels);
   unsigned char *p =this-> pixels;
   unsigned char *data = image.pixels;
-  while (--nbytes) *(p++) = *(data++);
+  while (nbytes--) *(p++) = *(data++);
 
   // Return this
   return *this;
@@ -159,10 +270,11 @@ operator=(const R2Image& image)
 void R2Image::
 Add(const R2Image& image)
 {
+  DeleteLevels();
   int nbytes = rowsize * height;
   unsigned char *p1 = pixels;
   unsigned char *p2 = image.pixels;
-  while (--nbytes) {
+  while (nbytes--) {
     int value = *p1;
     value += *(p2++);
     if (value > 255) value = 255;
@@ -175,10 +287,11 @@ Add(const R2Image& image)
 void R2Image::
 Subtract(const R2Image& image)
 {
+  DeleteLevels();
   int nbytes = rowsize * height;
   unsigned char *p1 = pixels;
   unsigned char *p2 = image.pixels;
-  while (--nbytes) {
+  while (nbytes--) {
     int value = *p1 - *p2 + 128;
     if (value < 0) value = 0;
     if (value > 255) value = 255;
@@ -193,6 +306,9 @@ Subtract(const R2Image& image)
 void R2Image::
 SetPixelRGB(int x, int y, const RNRgb& rgb)
 {
+  // Delete mip levels
+  if (levels) DeleteLevels();
+
   // Set pixel color
   unsigned char *pixel = &(pixels[y*rowsize + x*ncomponents]);
   switch (ncomponents) {
@@ -222,9 +338,25 @@ SetPixelRGB(int x, int y, const RNRgb& rgb)
 
 
 
+void R2Image::
+Reduce(int level)
+{
+  // Replace image by its mip level (to release memory of finer levels)
+  if (level <= 0) return;
+  const R2Image *image = Level(level);
+  if (image == this) return;
+  R2Image copy(*image);
+  *this = copy;
+}
+
+
+
 void R2Image::
 Capture(void)
 {
+  // Delete mip levels
+  DeleteLevels();
+
   // Check image size
   GLint viewport[4];
   glGetIntegerv(GL_VIEWPORT, viewport);
@@ -283,6 +415,7 @@ int R2Image::
 Read(const char *filename)
 {
   // Initialize everything
+  DeleteLevels();
   if (pixels) { delete [] pixels; pixels = NULL; }
   width = height = 0;
 
@@ -449,6 +582,9 @@ static void LongWriteLE(int x, FILE *fp)
 int R2Image::
 ReadBMP(const char *filename)
 {
+  // Delete mip levels of previous image
+  DeleteLevels();
+
   // Open file
   FILE *fp = fopen(filename, "rb");
   if (!fp) {
@@ -622,6 +758,9 @@ WriteBMP(const char *filename) const
 int R2Image::
 ReadPPM(const char *filename)
 {
+  // Delete mip levels of previous image
+  DeleteLevels();
+
   // Open file
   FILE *fp = fopen(filename, "rb");
   if (!fp) {
@@ -848,6 +987,9 @@ WritePPM(const char *filename, int ascii) const
 int R2Image::
 ReadPFM(const char *filename)
 {
+  // Delete mip levels of previous image
+  DeleteLevels();
+
   // Open file
   FILE *fp = fopen(filename, "rb");
   if (!fp) {
@@ -1033,6 +1175,9 @@ ReadPFM(const char *filename)
 int R2Image::
 ReadJPEG(const char *filename)
 {
+  // Delete mip levels of previous image
+  DeleteLevels();
+
 #ifdef RN_USE_JPEG
   // Open file
   FILE *fp = fopen(filename, "rb");
@@ -1166,6 +1311,9 @@ WriteJPEG(const char *filename) const
 int R2Image::
 ReadTIFF(const char *filename)
 {
+  // Delete mip levels of previous image
+  DeleteLevels();
+
 #ifdef RN_USE_TIFF
   // Open file
   TIFF* tif = TIFFOpen(filename, "r");
@@ -1309,6 +1457,9 @@ WriteTIFF(const char *filename) const
 int R2Image::
 ReadPNG(const char *filename)
 {
+  // Delete mip levels of previous image
+  DeleteLevels();
+
 #ifdef RN_USE_PNG
   // Open file
   FILE *fp = fopen(filename, "rb");
@@ -1468,6 +1619,9 @@ WritePNG(const char *filename) const
 int R2Image::
 ReadRAW(const char *filename)
 {
+  // Delete mip levels of previous image
+  DeleteLevels();
+
   // Open file
   FILE *fp = fopen(filename, "rb");
   if (!fp) {
@@ -1606,6 +1760,9 @@ WriteRAW(const char *filename) const
 int R2Image::
 ReadGRD(const char *filename)
 {
+  // Delete mip levels of previous image
+  DeleteLevels();
+
   // Open file
   FILE *fp = fopen(filename, "rb");
   if (!fp) {
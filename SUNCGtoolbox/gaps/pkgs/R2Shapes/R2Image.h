@@ -26,11 +26,19 @@ class R2Image {
   int RowSize(void) const;
   int Size(void) const;
 
+  // Mip level access (level 0 is this image, each level halves the resolution)
+  int NLevels(void) const;
+  const R2Image *Level(int level) const;
+  int FootprintLevel(const R2Point& t1, const R2Point& t2, const R2Point& t3, RNArea sample_area) const;
+    // Returns level at which one sample covers about one texel, for a triangle with texture coordinates
+    // t1, t2, t3 whose doubled area (length of the cross product of its edges) is sample_area samples
+
   // Manipulation
   R2Image& operator=(const R2Image& image);
   void Add(const R2Image& image);
   void Subtract(const R2Image& image);
   void SetPixelRGB(int row, int column, const RNRgb& rgb);
+  void Reduce(int level);
 
   // Reading/writing
   int Read(const char *filename);
@@ -54,12 +62,18 @@ class R2Image {
   // Draw functions
   void Draw(int x = 0, int y = 0) const;
 
+ private:
+  void DeleteLevels(void);
+
  private:
   int width;
   int height;
   int ncomponents;
   int rowsize;
   unsigned char *pixels;
+  mutable std::atomic<R2Image **> levels;
+  mutable int nlevels;
+  mutable RNMutex levels_mutex;
 };
 
 
@@ -120,6 +134,18 @@ Size(void) const
 
 
 
+inline int R2Image::
+NLevels(void) const
+{
+  // Return number of mip levels (down to one pixel in the larger dimension)
+  int n = 1;
+  int size = (width > height) ? width : height;
+  while (size > 1) { size = (size + 1) / 2; n++; }
+  return n;
+}
+
+
+
 inline const unsigned char *R2Image::
 Pixels(void) const
 {
@@ -0,0 +1,477 @@
+// Source file for asynchronous image writer class
+
+
+
+// Include files
+
+#include "R2Shapes.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+
+
+
+// Image libraries
+
+#define RN_USE_PNG
+#ifdef RN_NO_PNG
+#undef RN_USE_PNG
+#endif
+
+#ifdef RN_USE_PNG
+# include "png/png.h"
+#endif
+
+#define RN_USE_JPEG
+#ifdef RN_NO_JPEG
+#undef RN_USE_JPEG
+#endif
+
+#ifdef RN_USE_JPEG
+  extern "C" {
+#   define XMD_H // Otherwise, a conflict with INT32
+#   if RN_OS == RN_WINDOWS
+#     define HAVE_BOOLEAN
+#     undef FAR // Otherwise, a conflict with windows.h
+#   endif
+#   include "jpeg/jpeglib.h"
+  };
+#endif
+
+
+
+// Size of stdio buffer of each encoder thread (files smaller than this are written with one system call)
+
+static const int R2_IMAGE_WRITER_BUFFER_SIZE = 4 * 1024 * 1024;
+
+
+
+// Private types
+
+struct R2ImageWriterJob {
+  R2Image *image;
+  R2Grid *grid;
+  char *filename;
+  int png_compression_level;
+  int png_compression_strategy;
+  int png_filters;
+  int jpeg_quality;
+};
+
+struct R2ImageWriterState {
+  std::mutex mutex;
+  std::condition_variable job_queued;
+  std::condition_variable job_started;
+  std::condition_variable jobs_finished;
+  std::deque<R2ImageWriterJob> queue;
+  std::vector<std::thread> threads;
+  int nbusy;
+  int nfailures;
+  RNBoolean stop;
+};
+
+struct R2ImageWriterBuffers {
+  char *file_buffer;
+  std::vector<unsigned char> pixels;
+  std::vector<unsigned char *> rows;
+};
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Encoding functions (executed by encoder threads)
+////////////////////////////////////////////////////////////////////////
+
+static FILE *
+R2ImageWriterOpenFile(const char *filename, R2ImageWriterBuffers& buffers)
+{
+  // Open file with the thread's buffer, so that output is collected into few system calls
+  FILE *fp = fopen(filename, "wb");
+  if (!fp) {
+    fprintf(stderr, "Unable to open image file %s\n", filename);
+    return NULL;
+  }
+
+  // Set buffer
+  setvbuf(fp, buffers.file_buffer, _IOFBF, R2_IMAGE_WRITER_BUFFER_SIZE);
+
+  // Return file
+  return fp;
+}
+
+
+
+static int
+R2ImageWriterCloseFile(FILE *fp, const char *filename)
+{
+  // Flush buffer and close file
+  if (fclose(fp) != 0) {
+    fprintf(stderr, "Unable to write image file %s\n", filename);
+    return 0;
+  }
+
+  // Return success
+  return 1;
+}
+
+
+
+#ifdef RN_USE_PNG
+
+static int
+R2ImageWriterEncodePNG(FILE *fp, int width, int height, int bit_depth, int color_type,
+  unsigned char **rows, const R2ImageWriterJob& job)
+{
+  // Create and initialize the png_struct (libpng cannot reset write structs for reuse)
+  png_structp png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  if (png_ptr == NULL) return 0;
+
+  // Allocate/initialize the image information data
+  png_infop info_ptr = png_create_info_struct(png_ptr);
+  if (info_ptr == NULL) {
+    png_destroy_write_struct(&png_ptr, NULL);
+    return 0;
+  }
+
+  // Catch errors
+  if (setjmp(png_jmpbuf(png_ptr))) {
+    png_destroy_write_struct(&png_ptr, &info_ptr);
+    return 0;
+  }
+
+  // Fill in the image data
+  png_set_IHDR(png_ptr, info_ptr, width, height,
+    bit_depth, color_type, PNG_INTERLACE_NONE,
+    PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
+
+  // Set compression parameters
+  if (job.png_compression_level >= 0) png_set_compression_level(png_ptr, job.png_compression_level);
+  if (job.png_compression_strategy >= 0) png_set_compression_strategy(png_ptr, job.png_compression_strategy);
+  if (job.png_filters >= 0) png_set_filter(png_ptr, PNG_FILTER_TYPE_BASE, job.png_filters);
+
+  // Write the image
+  png_init_io(png_ptr, fp);
+  png_write_info(png_ptr, info_ptr);
+  png_write_image(png_ptr, rows);
+  png_write_end(png_ptr, info_ptr);
+
+  // Clean up after the write, and free any memory allocated
+  png_destroy_write_struct(&png_ptr, &info_ptr);
+
+  // Return success
+  return 1;
+}
+
+#endif
+
+
+
+static int
+R2ImageWriterWritePNG(const R2Image *image, const R2ImageWriterJob& job, R2ImageWriterBuffers& buffers)
+{
+#ifdef RN_USE_PNG
+  // Determine color type
+  int color_type = 0;
+  if (image->NComponents() == 1) color_type = PNG_COLOR_TYPE_GRAY;
+  else if (image->NComponents() == 2) color_type = PNG_COLOR_TYPE_GRAY_ALPHA;
+  else if (image->NComponents() == 3) color_type = PNG_COLOR_TYPE_RGB;
+  else if (image->NComponents() == 4) color_type = PNG_COLOR_TYPE_RGB_ALPHA;
+  else { fprintf(stderr, "Invalid number of components for %s\n", job.filename); return 0; }
+
+  // Get row pointers (first png row is top row)
+  int height = image->Height();
+  buffers.rows.resize(height);
+  for (int i = 0; i < height; i++) buffers.rows[i] = (unsigned char *) image->Pixels(height - i - 1);
+
+  // Encode image
+  FILE *fp = R2ImageWriterOpenFile(job.filename, buffers);
+  if (!fp) return 0;
+  int status = R2ImageWriterEncodePNG(fp, image->Width(), height, 8, color_type, buffers.rows.data(), job);
+  if (!R2ImageWriterCloseFile(fp, job.filename)) return 0;
+  return status;
+#else
+  RNFail("PNG not supported");
+  return 0;
+#endif
+}
+
+
+
+static int
+R2ImageWriterWritePNG(const R2Grid *grid, const R2ImageWriterJob& job, R2ImageWriterBuffers& buffers)
+{
+#ifdef RN_USE_PNG
+  // Convert values to 16-bit samples (same as R2Grid::WritePNGFile)
+  int width = grid->XResolution();
+  int height = grid->YResolution();
+  const RNScalar *values = grid->GridValues();
+  RNScalar diameter = grid->Range().Diameter();
+  buffers.pixels.resize(2 * grid->NEntries());
+  unsigned char *datap = buffers.pixels.data();
+  for (int i = 0; i < grid->NEntries(); i++) {
+    RNScalar value = values[i];
+    if ((value == R2_GRID_UNKNOWN_VALUE) || (diameter == 0)) {
+      *datap++ = 0;
+      *datap++ = 0;
+    }
+    else {
+      if (value > UINT_MAX) value = UINT_MAX;
+      unsigned int ivalue = (unsigned int) value;
+      *datap++ = (ivalue >> 8) & 0xFF;
+      *datap++ = ivalue & 0xFF;
+    }
+  }
+
+  // Get row pointers (first png row is top row)
+  buffers.rows.resize(height);
+  for (int i = 0; i < height; i++) buffers.rows[i] = &buffers.pixels[(height - i - 1) * 2*width];
+
+  // Encode image
+  FILE *fp = R2ImageWriterOpenFile(job.filename, buffers);
+  if (!fp) return 0;
+  int status = R2ImageWriterEncodePNG(fp, width, height, 16, PNG_COLOR_TYPE_GRAY, buffers.rows.data(), job);
+  if (!R2ImageWriterCloseFile(fp, job.filename)) return 0;
+  return status;
+#else
+  RNFail("PNG not supported");
+  return 0;
+#endif
+}
+
+
+
+static int
+R2ImageWriterWriteJPEG(const R2Image *image, const R2ImageWriterJob& job, R2ImageWriterBuffers& buffers)
+{
+#ifdef RN_USE_JPEG
+  // Open file
+  FILE *fp = R2ImageWriterOpenFile(job.filename, buffers);
+  if (!fp) return 0;
+
+  // Initialize compression info (same as R2Image::WriteJPEG)
+  struct jpeg_compress_struct cinfo;
+  struct jpeg_error_mgr jerr;
+  cinfo.err = jpeg_std_error(&jerr);
+  jpeg_create_compress(&cinfo);
+  jpeg_stdio_dest(&cinfo, fp);
+  cinfo.image_width = image->Width();
+  cinfo.image_height = image->Height();
+  cinfo.input_components = image->NComponents();
+  if (image->NComponents() == 1) cinfo.in_color_space = JCS_GRAYSCALE;
+  else if (image->NComponents() == 3) cinfo.in_color_space = JCS_RGB;
+  else if (image->NComponents() == 4) cinfo.in_color_space = JCS_CMYK;
+  else cinfo.in_color_space = JCS_UNKNOWN;
+  cinfo.dct_method = JDCT_ISLOW;
+  jpeg_set_defaults(&cinfo);
+  cinfo.optimize_coding = TRUE;
+  jpeg_set_quality(&cinfo, (job.jpeg_quality >= 0) ? job.jpeg_quality : 75, TRUE);
+  jpeg_start_compress(&cinfo, TRUE);
+
+  // Output scan lines (first jpeg row is top row)
+  while (cinfo.next_scanline < cinfo.image_height) {
+    int scanline = cinfo.image_height - cinfo.next_scanline - 1;
+    unsigned char *row_pointer = (unsigned char *) image->Pixels(scanline);
+    jpeg_write_scanlines(&cinfo, &row_pointer, 1);
+  }
+
+  // Free everything
+  jpeg_finish_compress(&cinfo);
+  jpeg_destroy_compress(&cinfo);
+
+  // Close file
+  return R2ImageWriterCloseFile(fp, job.filename);
+#else
+  RNFail("JPEG not supported");
+  return 0;
+#endif
+}
+
+
+
+static int
+R2ImageWriterWriteJob(const R2ImageWriterJob& job, R2ImageWriterBuffers& buffers)
+{
+  // Get filename extension
+  const char *extension = strrchr(job.filename, '.');
+  if (!extension) {
+    fprintf(stderr, "Output file has no extension (e.g., .png).\n");
+    return 0;
+  }
+
+  // Write image with compression parameters or with file type's own function
+  if (job.image) {
+    if (!strncmp(extension, ".png", 4)) return R2ImageWriterWritePNG(job.image, job, buffers);
+    else if (!strncmp(extension, ".jpg", 4)) return R2ImageWriterWriteJPEG(job.image, job, buffers);
+    else if (!strncmp(extension, ".jpeg", 5)) return R2ImageWriterWriteJPEG(job.image, job, buffers);
+    else return job.image->Write(job.filename);
+  }
+  else if (job.grid) {
+    if (!strncmp(extension, ".png", 4)) return R2ImageWriterWritePNG(job.grid, job, buffers);
+    else return job.grid->WriteFile(job.filename);
+  }
+
+  // Should never get here
+  return 0;
+}
+
+
+
+static void
+R2ImageWriterThread(R2ImageWriterState *state)
+{
+  // Allocate buffers reused for all images written by this thread
+  R2ImageWriterBuffers buffers;
+  buffers.file_buffer = new char [ R2_IMAGE_WRITER_BUFFER_SIZE ];
+
+  // Write images until writer is stopped
+  while (TRUE) {
+    // Wait for next job
+    std::unique_lock<std::mutex> lock(state->mutex);
+    while (state->queue.empty() && !state->stop) state->job_queued.wait(lock);
+    if (state->queue.empty()) break;
+    R2ImageWriterJob job = state->queue.front();
+    state->queue.pop_front();
+    state->nbusy++;
+    state->job_started.notify_one();
+    lock.unlock();
+
+    // Write image
+    int status = R2ImageWriterWriteJob(job, buffers);
+
+    // Delete job data
+    if (job.image) delete job.image;
+    if (job.grid) delete job.grid;
+    free(job.filename);
+
+    // Update status
+    lock.lock();
+    if (!status) state->nfailures++;
+    state->nbusy--;
+    if (state->queue.empty() && (state->nbusy == 0)) state->jobs_finished.notify_all();
+  }
+
+  // Delete buffers
+  delete [] buffers.file_buffer;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Constructors
+////////////////////////////////////////////////////////////////////////
+
+R2ImageWriter::
+R2ImageWriter(int nthreads, int max_queued_images)
+  : nthreads((nthreads > 0) ? nthreads : RNNumThreads()),
+    max_queued_images((max_queued_images > 0) ? max_queued_images : 1),
+    png_compression_level(-1),
+    png_compression_strategy(-1),
+    png_filters(-1),
+    jpeg_quality(75),
+    state(NULL)
+{
+  // Create state
+  R2ImageWriterState *s = new R2ImageWriterState();
+  s->nbusy = 0;
+  s->nfailures = 0;
+  s->stop = FALSE;
+  state = s;
+
+  // Start encoder threads
+  for (int i = 0; i < this->nthreads; i++) {
+    s->threads.push_back(std::thread(R2ImageWriterThread, s));
+  }
+}
+
+
+
+R2ImageWriter::
+~R2ImageWriter(void)
+{
+  // Write remaining images
+  Flush();
+
+  // Stop encoder threads
+  R2ImageWriterState *s = (R2ImageWriterState *) state;
+  s->mutex.lock();
+  s->stop = TRUE;
+  s->job_queued.notify_all();
+  s->mutex.unlock();
+  for (unsigned int i = 0; i < s->threads.size(); i++) s->threads[i].join();
+
+  // Delete state
+  delete s;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Writing functions
+////////////////////////////////////////////////////////////////////////
+
+int R2ImageWriter::
+Write(const R2Image& image, const char *filename)
+{
+  // Queue copy of image
+  return Enqueue(new R2Image(image), NULL, filename);
+}
+
+
+
+int R2ImageWriter::
+Write(const R2Grid& grid, const char *filename)
+{
+  // Queue copy of grid
+  return Enqueue(NULL, new R2Grid(grid), filename);
+}
+
+
+
+int R2ImageWriter::
+Flush(void)
+{
+  // Wait until queue is empty and no image is being encoded
+  R2ImageWriterState *s = (R2ImageWriterState *) state;
+  std::unique_lock<std::mutex> lock(s->mutex);
+  while (!s->queue.empty() || (s->nbusy > 0)) s->jobs_finished.wait(lock);
+
+  // Check and reset failures
+  int nfailures = s->nfailures;
+  s->nfailures = 0;
+
+  // Return whether all images were written
+  return (nfailures == 0) ? 1 : 0;
+}
+
+
+
+int R2ImageWriter::
+Enqueue(R2Image *image, R2Grid *grid, const char *filename)
+{
+  // Check filename
+  if (!filename) return 0;
+
+  // Fill job (compression parameters are captured now)
+  R2ImageWriterJob job;
+  job.image = image;
+  job.grid = grid;
+  job.filename = strdup(filename);
+  job.png_compression_level = png_compression_level;
+  job.png_compression_strategy = png_compression_strategy;
+  job.png_filters = png_filters;
+  job.jpeg_quality = jpeg_quality;
+
+  // Wait for space in queue
+  R2ImageWriterState *s = (R2ImageWriterState *) state;
+  std::unique_lock<std::mutex> lock(s->mutex);
+  while ((int) s->queue.size() >= max_queued_images) s->job_started.wait(lock);
+
+  // Insert job into queue
+  s->queue.push_back(job);
+  s->job_queued.notify_one();
+
+  // Return success
+  return 1;
+}
@@ -0,0 +1,165 @@
+// Include file for asynchronous image writer class
+
+
+
+// Class definition
+
+class R2ImageWriter {
+ public:
+  // Constructors (nthreads = 0 uses RNNumThreads() encoder threads)
+  R2ImageWriter(int nthreads = 0, int max_queued_images = 16);
+  ~R2ImageWriter(void);
+
+  // Property functions
+  int NThreads(void) const;
+  int MaxQueuedImages(void) const;
+  int PNGCompressionLevel(void) const;
+  int PNGCompressionStrategy(void) const;
+  int PNGFilters(void) const;
+  int JPEGQuality(void) const;
+
+  // Compression parameters (-1 selects library default, applied to images queued afterwards)
+  void SetPNGCompressionLevel(int level);
+  void SetPNGCompressionStrategy(int strategy);
+  void SetPNGFilters(int filters);
+  void SetJPEGQuality(int quality);
+
+  // Writing functions (copy image and return immediately, unless queue is full)
+  int Write(const R2Image& image, const char *filename);
+  int Write(const R2Grid& grid, const char *filename);
+
+  // Wait until all queued images have been written (returns 0 if any write failed)
+  int Flush(void);
+
+ public:
+  // Internal functions
+  int Enqueue(R2Image *image, R2Grid *grid, const char *filename);
+
+ private:
+  int nthreads;
+  int max_queued_images;
+  int png_compression_level;
+  int png_compression_strategy;
+  int png_filters;
+  int jpeg_quality;
+  void *state;
+};
+
+
+
+// PNG row filters (may be combined, same values as libpng)
+
+enum {
+  R2_PNG_FILTER_NONE = 0x08,
+  R2_PNG_FILTER_SUB = 0x10,
+  R2_PNG_FILTER_UP = 0x20,
+  R2_PNG_FILTER_AVG = 0x40,
+  R2_PNG_FILTER_PAETH = 0x80,
+  R2_PNG_FILTER_ALL = 0xF8
+};
+
+
+
+// PNG compression strategies (same values as zlib)
+
+enum {
+  R2_PNG_DEFAULT_STRATEGY = 0,
+  R2_PNG_FILTERED_STRATEGY = 1,
+  R2_PNG_HUFFMAN_ONLY_STRATEGY = 2,
+  R2_PNG_RLE_STRATEGY = 3
+};
+
+
+
+// Inline functions
+
+inline int R2ImageWriter::
+NThreads(void) const
+{
+  // Return number of encoder threads
+  return nthreads;
+}
+
+
+
+inline int R2ImageWriter::
+MaxQueuedImages(void) const
+{
+  // Return maximum number of images waiting to be encoded
+  return max_queued_images;
+}
+
+
+
+inline int R2ImageWriter::
+PNGCompressionLevel(void) const
+{
+  // Return zlib compression level for PNG files
+  return png_compression_level;
+}
+
+
+
+inline int R2ImageWriter::
+PNGCompressionStrategy(void) const
+{
+  // Return zlib compression strategy for PNG files
+  return png_compression_strategy;
+}
+
+
+
+inline int R2ImageWriter::
+PNGFilters(void) const
+{
+  // Return mask of PNG row filters
+  return png_filters;
+}
+
+
+
+inline int R2ImageWriter::
+JPEGQuality(void) const
+{
+  // Return JPEG quality
+  return jpeg_quality;
+}
+
+
+
+inline void R2ImageWriter::
+SetPNGCompressionLevel(int level)
+{
+  // Set zlib compression level for PNG files (0-9)
+  png_compression_level = level;
+}
+
+
+
+inline void R2ImageWriter::
+SetPNGCompressionStrategy(int strategy)
+{
+  // Set zlib compression strategy for PNG files
+  png_compression_strategy = strategy;
+}
+
+
+
+inline void R2ImageWriter::
+SetPNGFilters(int filters)
+{
+  // Set mask of PNG row filters
+  png_filters = filters;
+}
+
+
+
+inline void R2ImageWriter::
+SetJPEGQuality(int quality)
+{
+  // Set JPEG quality (0-100)
+  jpeg_quality = quality;
+}
+
+
+
@@ -111,6 +111,7 @@ class R2Grid;
 
 #include "R2Shapes/R2Draw.h"
 #include "R2Shapes/R2Io.h"
+#include "R2Shapes/R2ImageWriter.h"
 
 
 
@@ -34,6 +34,9 @@ R3Scene(void)
     brdfs(),
     textures(),
     referenced_scenes(),
+    node_name_index(),
+    node_model_index(),
+    referenced_scene_index(),
     info(),
     ambient(0, 0, 0),
     background(0, 0, 0),
@@ -57,6 +60,11 @@ R3Scene::
   // Delete everything
   // ???
 
+  // Delete node index
+  for (int i = 0; i < NNodes(); i++) {
+    RemoveNodeFromIndex(Node(i));
+  }
+
   // Delete filename
   if (filename) free(filename);
 
@@ -66,18 +74,41 @@ R3Scene::
 
 
 
+static R3SceneNode *
+FirstIndexedNode(const RNArray<R3SceneNode *> *index_nodes)
+{
+  // Return node with lowest scene index (first one found by a search of all nodes)
+  R3SceneNode *first = NULL;
+  if (!index_nodes) return NULL;
+  for (int i = 0; i < index_nodes->NEntries(); i++) {
+    R3SceneNode *node = index_nodes->Kth(i);
+    if (!first || (node->SceneIndex() < first->SceneIndex())) first = node;
+  }
+  return first;
+}
+
+
+
 R3SceneNode *R3Scene::
 Node(const char *name) const
 {
-  // Search nodes for matching name
-  for (int i = 0; i < NNodes(); i++) {
-    R3SceneNode *node = Node(i);
-    if (!node->Name()) continue;
-    if (!strcmp(node->Name(), name)) return node;
-  }
+  // Find nodes with matching name in index
+  if (!name) return NULL;
+  RNArray<R3SceneNode *> *index_nodes = NULL;
+  if (!node_name_index.Find(name, &index_nodes)) return NULL;
+  return FirstIndexedNode(index_nodes);
+}
 
-  // Node not found
-  return NULL;
+
+
+const RNArray<R3SceneNode *> *R3Scene::
+ModelNodes(const char *model_id) const
+{
+  // Return nodes whose name, or part of name before or after '#', matches model_id (or NULL if none)
+  if (!model_id) return NULL;
+  RNArray<R3SceneNode *> *index_nodes = NULL;
+  if (!node_model_index.Find(model_id, &index_nodes)) return NULL;
+  return index_nodes;
 }
 
 
@@ -149,15 +180,12 @@ Texture(const char *name) const
 R3Scene *R3Scene::
 ReferencedScene(const char *name) const
 {
-  // Search textures for matching name
-  for (int i = 0; i < NReferencedScenes(); i++) {
-    R3Scene *referenced_scene = ReferencedScene(i);
-    if (!referenced_scene->Name()) continue;
-    if (!strcmp(referenced_scene->Name(), name)) return referenced_scene;
-  }
-
-  // Referenced scene not found
-  return NULL;
+  // Find referenced scene with matching name in index
+  if (!name) return NULL;
+  R3Scene *referenced_scene = NULL;
+  if (!referenced_scene_index.Find(name, &referenced_scene)) return NULL;
+  if (!referenced_scene->Name() || strcmp(referenced_scene->Name(), name)) return NULL;
+  return referenced_scene;
 }
 
 
@@ -171,6 +199,9 @@ InsertNode(R3SceneNode *node)
   node->scene = this;
   node->scene_index = nodes.NEntries();
   nodes.Insert(node);
+
+  // Insert node into index
+  InsertNodeIntoIndex(node);
 }
 
 
@@ -178,6 +209,9 @@ InsertNode(R3SceneNode *node)
 void R3Scene::
 RemoveNode(R3SceneNode *node) 
 {
+  // Remove node from index
+  RemoveNodeFromIndex(node);
+
   // Remove node
   assert(node->scene == this);
   assert(node->scene_index >= 0);
@@ -322,6 +356,12 @@ InsertReferencedScene(R3Scene *referenced_scene)
 {
   // Insert referenced scene
   referenced_scenes.Insert(referenced_scene);
+
+  // Insert referenced scene into index (first one with name is found)
+  const char *name = referenced_scene->Name();
+  if (name && !referenced_scene_index.Find(name)) {
+    referenced_scene_index.Insert(name, referenced_scene);
+  }
 }
 
 
@@ -331,6 +371,104 @@ RemoveReferencedScene(R3Scene *referenced_scene)
 {
   // Remove referenced scene
   referenced_scenes.Remove(referenced_scene);
+
+  // Remove referenced scene from index
+  const char *name = referenced_scene->Name();
+  R3Scene *indexed_scene = NULL;
+  if (name && referenced_scene_index.Find(name, &indexed_scene) && (indexed_scene == referenced_scene)) {
+    referenced_scene_index.Remove(name);
+    for (int i = 0; i < NReferencedScenes(); i++) {
+      R3Scene *other_scene = ReferencedScene(i);
+      if (!other_scene->Name() || strcmp(other_scene->Name(), name)) continue;
+      referenced_scene_index.Insert(name, other_scene);
+      break;
+    }
+  }
+}
+
+
+
+static void
+InsertIndexedNode(RNSymbolTable<RNArray<R3SceneNode *> *>& index, const char *key, R3SceneNode *node)
+{
+  // Insert node into list of nodes with key
+  RNArray<R3SceneNode *> *index_nodes = NULL;
+  if (!index.Find(key, &index_nodes)) {
+    index_nodes = new RNArray<R3SceneNode *>();
+    index.Insert(key, index_nodes);
+  }
+  index_nodes->Insert(node);
+}
+
+
+
+static void
+RemoveIndexedNode(RNSymbolTable<RNArray<R3SceneNode *> *>& index, const char *key, R3SceneNode *node)
+{
+  // Remove node from list of nodes with key
+  RNArray<R3SceneNode *> *index_nodes = NULL;
+  if (!index.Find(key, &index_nodes)) return;
+  index_nodes->Remove(node);
+  if (index_nodes->IsEmpty()) {
+    index.Remove(key);
+    delete index_nodes;
+  }
+}
+
+
+
+static int
+NodeModelIds(const char *name, char *buffer, const char **model_ids)
+{
+  // Split name into part before and after '#' (both match model ids in SUNCG files)
+  const char *separator = strchr(name, '#');
+  if (!separator) { model_ids[0] = name; return 1; }
+  int prefix_length = (int) (separator - name);
+  memcpy(buffer, name, prefix_length);
+  buffer[prefix_length] = '\0';
+  model_ids[0] = buffer;
+  model_ids[1] = separator + 1;
+  return (strcmp(model_ids[0], model_ids[1])) ? 2 : 1;
+}
+
+
+
+void R3Scene::
+InsertNodeIntoIndex(R3SceneNode *node)
+{
+  // Check name
+  const char *name = node->Name();
+  if (!name) return;
+
+  // Insert node into name index
+  InsertIndexedNode(node_name_index, name, node);
+
+  // Insert node into model id index
+  const char *model_ids[2];
+  char *buffer = new char [ strlen(name) + 1 ];
+  int nmodel_ids = NodeModelIds(name, buffer, model_ids);
+  for (int i = 0; i < nmodel_ids; i++) InsertIndexedNode(node_model_index, model_ids[i], node);
+  delete [] buffer;
+}
+
+
+
+void R3Scene::
+RemoveNodeFromIndex(R3SceneNode *node)
+{
+  // Check name
+  const char *name = node->Name();
+  if (!name) return;
+
+  // Remove node from name index
+  RemoveIndexedNode(node_name_index, name, node);
+
+  // Remove node from model id index
+  const char *model_ids[2];
+  char *buffer = new char [ strlen(name) + 1 ];
+  int nmodel_ids = NodeModelIds(name, buffer, model_ids);
+  for (int i = 0; i < nmodel_ids; i++) RemoveIndexedNode(node_model_index, model_ids[i], node);
+  delete [] buffer;
 }
 
 
@@ -3980,19 +4118,12 @@ ReadSUNCGModelFile(const char *filename)
     int model_id_length = strlen(model_id);
     if (model_id_length == 0) continue;
 
-    // Assign key-value info to nodes matching model_id
-    for (int i = 0; i < NNodes(); i++) {
-      R3SceneNode *node = Node(i);
-      if (!node->Name()) continue;
-      char node_name[1024];
-      strncpy(node_name, node->Name(), 1024);
-      char *model_name = strchr(node_name, '#');
-      if (model_name) { *model_name = '\0'; model_name++; }
-      else model_name = node_name;
-      if (!strcmp(node_name, model_id) || !strcmp(model_name, model_id)) {
-        for (int j = 0; j < keys.NEntries(); j++) {
-          node->InsertInfo(keys[j], values[j]);
-        }
+    // Assign key-value info to nodes matching model_id (found with index)
+    const RNArray<R3SceneNode *> *model_nodes = ModelNodes(model_id);
+    for (int i = 0; model_nodes && (i < model_nodes->NEntries()); i++) {
+      R3SceneNode *node = model_nodes->Kth(i);
+      for (int j = 0; j < keys.NEntries(); j++) {
+        node->InsertInfo(keys[j], values[j]);
       }
     }
 
@@ -4020,3 +4151,22 @@ ReadSUNCGModelFile(const char *filename)
   // Return success
   return 1;
 }
+
+
+
+R3SceneNode *R3Scene::
+SUNCGRoom(const R3Point& position) const
+{
+  // Return first room node (named "Room#...") whose bounding box contains position
+  R3SceneNode *room = NULL;
+  const RNArray<R3SceneNode *> *room_nodes = ModelNodes("Room");
+  for (int i = 0; room_nodes && (i < room_nodes->NEntries()); i++) {
+    R3SceneNode *node = room_nodes->Kth(i);
+    if (strncmp(node->Name(), "Room#", 5)) continue;
+    if (room && (room->SceneIndex() < node->SceneIndex())) continue;
+    if (R3Contains(node->BBox(), position)) room = node;
+  }
+
+  // Return room
+  return room;
+}
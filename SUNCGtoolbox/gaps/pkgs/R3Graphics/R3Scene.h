@@ -33,6 +33,7 @@ public:
   int NNodes(void) const;
   R3SceneNode *Node(int k) const;
   R3SceneNode *Node(const char *name) const;
+  const RNArray<R3SceneNode *> *ModelNodes(const char *model_id) const;
   R3SceneNode *Root(void) const;
   int NLights(void) const;
   R3Light *Light(int k) const;
@@ -122,6 +123,12 @@ public:
   // SUNCG utility functions
   int ReadSUNCGLightsFile(const char *filename);
   int ReadSUNCGModelFile(const char *filename);
+  R3SceneNode *SUNCGRoom(const R3Point& position) const;
+
+public:
+  // Internal index update functions (names of referenced scenes are indexed when inserted)
+  void InsertNodeIntoIndex(R3SceneNode *node);
+  void RemoveNodeFromIndex(R3SceneNode *node);
 
 private:
   R3SceneNode *root;
@@ -131,6 +138,9 @@ private:
   RNArray<R3Brdf *> brdfs;
   RNArray<R2Texture *> textures;
   RNArray<R3Scene *> referenced_scenes;
+  RNSymbolTable<RNArray<R3SceneNode *> *> node_name_index;
+  RNSymbolTable<RNArray<R3SceneNode *> *> node_model_index;
+  RNSymbolTable<R3Scene *> referenced_scene_index;
   RNSymbolTable<std::string> info;
   R3Viewer viewer;
   RNRgb ambient;
@@ -210,10 +220,10 @@ ClosestPoint(const R3Point& point) const
 inline const char *R3Scene::
 Info(const char *key) const
 {
-  // Return info associated with key
-  std::string value;
-  if (!info.Find(key, &value)) return NULL;
-  return value.c_str();
+  // Return info associated with key (stored in table, so pointer remains valid until info changes)
+  const std::string *value = info.FindValue(key);
+  if (!value) return NULL;
+  return value->c_str();
 }
 
 
@@ -491,10 +491,16 @@ Transform(const R3Affine& transformation)
 void R3SceneNode::
 SetName(const char *name)
 {
+  // Remove from scene index
+  if (scene) scene->RemoveNodeFromIndex(this);
+
   // Set name
   if (this->name) free(this->name);
   if (name) this->name = strdup(name);
   else this->name = NULL;
+
+  // Insert into scene index
+  if (scene) scene->InsertNodeIntoIndex(this);
 }
 
 
@@ -94,10 +94,10 @@ Materials(void) const
 inline const char *R3SceneReference::
 Info(const char *key) const
 {
-  // Return info associated with key
-  std::string value;
-  if (!info.Find(key, &value)) return NULL;
-  return value.c_str();
+  // Return info associated with key (stored in table, so pointer remains valid until info changes)
+  const std::string *value = info.FindValue(key);
+  if (!value) return NULL;
+  return value->c_str();
 }
 
 
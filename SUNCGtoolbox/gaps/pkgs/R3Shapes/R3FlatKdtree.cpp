@@ -0,0 +1,380 @@
+// Source file for flat KDTree class
+
+
+
+////////////////////////////////////////////////////////////////////////
+// NOTE:
+// The tree is stored implicitly in one array of points.  The node for 
+// the index range [lo, hi) stores its splitting point at mid = (lo+hi)/2,
+// the points of its children are in [lo, mid) and [mid+1, hi), and 
+// ranges with at most R3flat_kdtree_max_points_per_leaf points are leaves.
+////////////////////////////////////////////////////////////////////////
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Include files
+////////////////////////////////////////////////////////////////////////
+
+#include "R3Shapes/R3Shapes.h"
+#include <algorithm>
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Constant definitions
+////////////////////////////////////////////////////////////////////////
+
+static const int R3flat_kdtree_max_points_per_leaf = 8;
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Constructors/destructors
+////////////////////////////////////////////////////////////////////////
+
+R3FlatKdtree::
+R3FlatKdtree(const R3Point *positions, int npositions)
+  : points(NULL),
+    split_dimensions(NULL),
+    npoints(npositions),
+    bbox(R3null_box)
+{
+  // Copy positions
+  points = new R3FlatKdtreePoint [ npoints ];
+  for (int i = 0; i < npoints; i++) {
+    points[i].position[0] = positions[i].X();
+    points[i].position[1] = positions[i].Y();
+    points[i].position[2] = positions[i].Z();
+    points[i].index = i;
+  }
+
+  // Build tree
+  Build();
+}
+
+
+
+R3FlatKdtree::
+R3FlatKdtree(const float *coordinates, int npositions)
+  : points(NULL),
+    split_dimensions(NULL),
+    npoints(npositions),
+    bbox(R3null_box)
+{
+  // Copy coordinates
+  points = new R3FlatKdtreePoint [ npoints ];
+  for (int i = 0; i < npoints; i++) {
+    points[i].position[0] = coordinates[3*i+0];
+    points[i].position[1] = coordinates[3*i+1];
+    points[i].position[2] = coordinates[3*i+2];
+    points[i].index = i;
+  }
+
+  // Build tree
+  Build();
+}
+
+
+
+R3FlatKdtree::
+~R3FlatKdtree(void)
+{
+  // Delete arrays
+  if (points) delete [] points;
+  if (split_dimensions) delete [] split_dimensions;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Construction functions
+////////////////////////////////////////////////////////////////////////
+
+static void
+R3FlatKdtreeSplit(R3FlatKdtreePoint *points, unsigned char *split_dimensions, int lo, int hi)
+{
+  // Compute extent of points in range
+  float low[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+  float high[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+  for (int i = lo; i < hi; i++) {
+    for (int dim = 0; dim < 3; dim++) {
+      if (points[i].position[dim] < low[dim]) low[dim] = points[i].position[dim];
+      if (points[i].position[dim] > high[dim]) high[dim] = points[i].position[dim];
+    }
+  }
+
+  // Split at median along dimension of largest extent
+  int dim = 0;
+  if (high[1] - low[1] > high[dim] - low[dim]) dim = 1;
+  if (high[2] - low[2] > high[dim] - low[dim]) dim = 2;
+  int mid = (lo + hi) / 2;
+  std::nth_element(points + lo, points + mid, points + hi,
+    [dim](const R3FlatKdtreePoint& a, const R3FlatKdtreePoint& b) { 
+      return a.position[dim] < b.position[dim]; });
+  split_dimensions[mid] = (unsigned char) dim;
+}
+
+
+
+static void
+R3FlatKdtreeBuild(R3FlatKdtreePoint *points, unsigned char *split_dimensions, int lo, int hi)
+{
+  // Split ranges recursively until they are leaves
+  if (hi - lo <= R3flat_kdtree_max_points_per_leaf) return;
+  R3FlatKdtreeSplit(points, split_dimensions, lo, hi);
+  int mid = (lo + hi) / 2;
+  R3FlatKdtreeBuild(points, split_dimensions, lo, mid);
+  R3FlatKdtreeBuild(points, split_dimensions, mid+1, hi);
+}
+
+
+
+void R3FlatKdtree::
+Build(void)
+{
+  // Allocate split dimensions
+  split_dimensions = new unsigned char [ npoints ];
+  for (int i = 0; i < npoints; i++) split_dimensions[i] = 0;
+
+  // Compute bounding box
+  for (int i = 0; i < npoints; i++) {
+    bbox.Union(R3Point(points[i].position[0], points[i].position[1], points[i].position[2]));
+  }
+
+  // Split top levels serially until there are enough subtrees for all threads
+  RNArray<int *> ranges;
+  ranges.Insert(new int [2]);
+  ranges[0][0] = 0;
+  ranges[0][1] = npoints;
+  int nsubtrees = 4 * RNNumThreads();
+  RNBoolean split = TRUE;
+  while (split && (ranges.NEntries() < nsubtrees)) {
+    split = FALSE;
+    RNArray<int *> children;
+    for (int i = 0; i < ranges.NEntries(); i++) {
+      int *range = ranges[i];
+      int lo = range[0], hi = range[1];
+      if (hi - lo <= R3flat_kdtree_max_points_per_leaf) { children.Insert(range); continue; }
+      R3FlatKdtreeSplit(points, split_dimensions, lo, hi);
+      int mid = (lo + hi) / 2;
+      int *child = new int [2];
+      child[0] = mid + 1;
+      child[1] = hi;
+      range[1] = mid;
+      children.Insert(range);
+      children.Insert(child);
+      split = TRUE;
+    }
+    ranges = children;
+  }
+
+  // Build subtrees in parallel
+  RNParallelFor(0, ranges.NEntries(), [&](int i, int) {
+    R3FlatKdtreeBuild(points, split_dimensions, ranges[i][0], ranges[i][1]);
+  });
+
+  // Delete ranges
+  for (int i = 0; i < ranges.NEntries(); i++) delete [] ranges[i];
+}
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Search functions
+////////////////////////////////////////////////////////////////////////
+
+static inline void
+R3FlatKdtreeHeapInsert(int index, float distance_squared, int max_points, int& npoints,
+  int *heap_indices, float *heap_distances_squared)
+{
+  // Insert into bounded max-heap of closest points
+  if (npoints < max_points) {
+    // Bubble up new entry
+    int i = npoints++;
+    while (i > 0) {
+      int parent = (i - 1) / 2;
+      if (heap_distances_squared[parent] >= distance_squared) break;
+      heap_indices[i] = heap_indices[parent];
+      heap_distances_squared[i] = heap_distances_squared[parent];
+      i = parent;
+    }
+    heap_indices[i] = index;
+    heap_distances_squared[i] = distance_squared;
+  }
+  else {
+    // Replace farthest entry and bubble down
+    int i = 0;
+    while (TRUE) {
+      int child = 2*i + 1;
+      if (child >= npoints) break;
+      if ((child + 1 < npoints) && (heap_distances_squared[child+1] > heap_distances_squared[child])) child++;
+      if (heap_distances_squared[child] <= distance_squared) break;
+      heap_indices[i] = heap_indices[child];
+      heap_distances_squared[i] = heap_distances_squared[child];
+      i = child;
+    }
+    heap_indices[i] = index;
+    heap_distances_squared[i] = distance_squared;
+  }
+}
+
+
+
+static void
+R3FlatKdtreeSearch(const R3FlatKdtreePoint *points, const unsigned char *split_dimensions, int lo, int hi,
+  const float query_position[3], float min_distance_squared, float max_distance_squared, 
+  int max_points, int& npoints, int *heap_indices, float *heap_distances_squared)
+{
+  // Search leaf points
+  if (hi - lo <= R3flat_kdtree_max_points_per_leaf) {
+    for (int i = lo; i < hi; i++) {
+      const float *p = points[i].position;
+      float dx = p[0] - query_position[0];
+      float dy = p[1] - query_position[1];
+      float dz = p[2] - query_position[2];
+      float distance_squared = dx*dx + dy*dy + dz*dz;
+      if (distance_squared < min_distance_squared) continue;
+      float bound = (npoints == max_points) ? heap_distances_squared[0] : max_distance_squared;
+      if ((npoints == max_points) ? (distance_squared >= bound) : (distance_squared > bound)) continue;
+      R3FlatKdtreeHeapInsert(points[i].index, distance_squared, max_points, npoints, heap_indices, heap_distances_squared);
+    }
+    return;
+  }
+
+  // Check splitting point
+  int mid = (lo + hi) / 2;
+  const float *p = points[mid].position;
+  float dx = p[0] - query_position[0];
+  float dy = p[1] - query_position[1];
+  float dz = p[2] - query_position[2];
+  float distance_squared = dx*dx + dy*dy + dz*dz;
+  if (distance_squared >= min_distance_squared) {
+    if ((npoints < max_points) ? (distance_squared <= max_distance_squared) : (distance_squared < heap_distances_squared[0])) {
+      R3FlatKdtreeHeapInsert(points[mid].index, distance_squared, max_points, npoints, heap_indices, heap_distances_squared);
+    }
+  }
+
+  // Search near side first, then far side if it can contain closer points
+  int dim = split_dimensions[mid];
+  float side = query_position[dim] - p[dim];
+  if (side <= 0) {
+    R3FlatKdtreeSearch(points, split_dimensions, lo, mid, query_position, min_distance_squared, max_distance_squared, 
+      max_points, npoints, heap_indices, heap_distances_squared);
+    float bound = (npoints == max_points) ? heap_distances_squared[0] : max_distance_squared;
+    if (side*side <= bound) {
+      R3FlatKdtreeSearch(points, split_dimensions, mid+1, hi, query_position, min_distance_squared, max_distance_squared, 
+        max_points, npoints, heap_indices, heap_distances_squared);
+    }
+  }
+  else {
+    R3FlatKdtreeSearch(points, split_dimensions, mid+1, hi, query_position, min_distance_squared, max_distance_squared, 
+      max_points, npoints, heap_indices, heap_distances_squared);
+    float bound = (npoints == max_points) ? heap_distances_squared[0] : max_distance_squared;
+    if (side*side <= bound) {
+      R3FlatKdtreeSearch(points, split_dimensions, lo, mid, query_position, min_distance_squared, max_distance_squared, 
+        max_points, npoints, heap_indices, heap_distances_squared);
+    }
+  }
+}
+
+
+
+int R3FlatKdtree::
+FindClosest(const float query_position[3], 
+  float min_distance_squared, float max_distance_squared, int max_points, 
+  int *heap_indices, float *heap_distances_squared) const
+{
+  // Search tree
+  int n = 0;
+  if (max_points <= 0) return 0;
+  R3FlatKdtreeSearch(points, split_dimensions, 0, npoints, query_position, 
+    min_distance_squared, max_distance_squared, max_points, n, heap_indices, heap_distances_squared);
+
+  // Sort heap by increasing distance
+  for (int last = n - 1; last > 0; last--) {
+    int index = heap_indices[last];
+    float distance_squared = heap_distances_squared[last];
+    heap_indices[last] = heap_indices[0];
+    heap_distances_squared[last] = heap_distances_squared[0];
+    int count = last;
+    R3FlatKdtreeHeapInsert(index, distance_squared, count, count, heap_indices, heap_distances_squared);
+  }
+
+  // Return number of points found
+  return n;
+}
+
+
+
+int R3FlatKdtree::
+FindClosest(const R3Point& query_position, 
+  RNLength min_distance, RNLength max_distance, int max_points, 
+  int *point_indices, RNLength *distances) const
+{
+  // Check distances
+  if (max_distance < 0) return 0;
+  if (min_distance < 0) min_distance = 0;
+
+  // Search tree
+  float query[3] = { (float) query_position.X(), (float) query_position.Y(), (float) query_position.Z() };
+  float *distances_squared = new float [ max_points ];
+  int n = FindClosest(query, (float) (min_distance * min_distance), 
+    (float) (max_distance * max_distance), max_points, point_indices, distances_squared);
+
+  // Update return distances
+  if (distances) {
+    for (int i = 0; i < n; i++) distances[i] = sqrt(distances_squared[i]);
+  }
+
+  // Delete temporary memory
+  delete [] distances_squared;
+
+  // Return number of points
+  return n;
+}
+
+
+
+size_t R3FlatKdtree::
+FindAllClosest(RNLength min_distance, RNLength max_distance, int max_points, 
+  size_t *offsets, int *indices) const
+{
+  // Check distances
+  if (max_points <= 0) max_distance = -1;
+  if (min_distance < 0) min_distance = 0;
+  float min_distance_squared = (float) (min_distance * min_distance);
+  float max_distance_squared = (float) (max_distance * max_distance);
+
+  // Allocate temporary distances for each thread
+  int nthreads = RNNumThreads();
+  float *distances_squared = new float [ (size_t) nthreads * ((max_points > 0) ? max_points : 1) ];
+  
+  // Search for neighbors of points in tree order (so that successive queries are nearby)
+  RNParallelFor(0, npoints, [&](int i, int thread) {
+    const R3FlatKdtreePoint& point = points[i];
+    int *row = &indices[(size_t) point.index * max_points];
+    int n = 0;
+    if (max_distance >= 0) {
+      n = FindClosest(point.position, min_distance_squared, max_distance_squared, max_points,
+        row, &distances_squared[(size_t) thread * max_points]);
+    }
+    offsets[point.index + 1] = n;
+  }, 256);
+
+  // Compute offsets and compact rows (rows only move toward the front)
+  offsets[0] = 0;
+  for (int i = 0; i < npoints; i++) {
+    size_t n = offsets[i+1];
+    int *src = &indices[(size_t) i * max_points];
+    int *dst = &indices[offsets[i]];
+    if (dst != src) memmove(dst, src, n * sizeof(int));
+    offsets[i+1] = offsets[i] + n;
+  }
+
+  // Delete temporary memory
+  delete [] distances_squared;
+
+  // Return total number of neighbors
+  return offsets[npoints];
+}
@@ -0,0 +1,77 @@
+// Include file for flat KDTree class
+
+#ifndef __R3FLATKDTREE__H__
+#define __R3FLATKDTREE__H__
+
+
+
+// Point record stored inline in the tree array
+
+struct R3FlatKdtreePoint {
+  float position[3];
+  int index;
+};
+
+
+
+// Class declaration
+
+class R3FlatKdtree {
+public:
+  // Constructor/destructors
+  R3FlatKdtree(const R3Point *positions, int npositions);
+  R3FlatKdtree(const float *coordinates, int npositions);
+  ~R3FlatKdtree(void);
+
+  // Property functions
+  const R3Box& BBox(void) const;
+  int NPoints(void) const;
+
+  // Search for closest K to a query position (returns sorted point indices)
+  int FindClosest(const R3Point& query_position, 
+    RNLength min_distance, RNLength max_distance, int max_points, 
+    int *point_indices, RNLength *distances = NULL) const;
+
+  // Search for closest K to every point in parallel (returns compressed rows:
+  // neighbors of point i are indices[offsets[i]] ... indices[offsets[i+1]-1],
+  // offsets must have npoints+1 entries and indices npoints*max_points entries)
+  size_t FindAllClosest(RNLength min_distance, RNLength max_distance, int max_points, 
+    size_t *offsets, int *indices) const;
+
+public:
+  // Internal functions
+  void Build(void);
+  int FindClosest(const float query_position[3], 
+    float min_distance_squared, float max_distance_squared, int max_points, 
+    int *heap_indices, float *heap_distances_squared) const;
+
+private:
+  R3FlatKdtreePoint *points;
+  unsigned char *split_dimensions;
+  int npoints;
+  R3Box bbox;
+};
+
+
+
+// Inline functions
+
+inline const R3Box& R3FlatKdtree::
+BBox(void) const
+{
+  // Return bounding box of all points
+  return bbox;
+}
+
+
+
+inline int R3FlatKdtree::
+NPoints(void) const
+{
+  // Return number of points
+  return npoints;
+}
+
+
+
+#endif
@@ -35,7 +35,7 @@ R3Grid(int xresolution, int yresolution, int zresolution)
   grid_size = grid_sheet_size * zresolution;
 
   // Allocate grid values
-  if (grid_size == 0) grid_values = NULL;
+  if (grid_size == 0) { grid_values = NULL; rgb_values = NULL; label_values = NULL; }
   else
   {
     grid_values = new RNScalar [ grid_size ];
@@ -68,7 +68,7 @@ R3Grid(int xresolution, int yresolution, int zresolution, const R3Box& bbox)
   grid_size = grid_sheet_size * zresolution;
 
   // Allocate grid values
-  if (grid_size == 0) grid_values = NULL;
+  if (grid_size == 0) { grid_values = NULL; rgb_values = NULL; label_values = NULL; }
   else 
   {
     grid_values = new RNScalar [ grid_size ];
@@ -90,7 +90,9 @@ R3Grid(int xresolution, int yresolution, int zresolution, const R3Box& bbox)
 
 R3Grid::
 R3Grid(const R3Grid& voxels)
-  : grid_values(NULL)
+  : grid_values(NULL),
+    rgb_values(NULL),
+    label_values(NULL)
 {
   // Copy everything
   *this = voxels;
@@ -103,6 +105,8 @@ R3Grid::
 {
   // Deallocate memory for grid values
   if (grid_values) delete [] grid_values;
+  if (rgb_values) delete [] rgb_values;
+  if (label_values) delete [] label_values;
 }
 
 
@@ -451,6 +455,10 @@ operator=(const R3Grid& voxels)
     if (grid_size != voxels.grid_size) {
       delete [] grid_values;
       grid_values = NULL;
+      if (rgb_values) delete [] rgb_values;
+      rgb_values = NULL;
+      if (label_values) delete [] label_values;
+      label_values = NULL;
     }
   }
 
@@ -460,6 +468,10 @@ operator=(const R3Grid& voxels)
     assert(grid_values);
   }
 
+  // Allocate new material values
+  if (!rgb_values && voxels.rgb_values) rgb_values = new RNRgb [ voxels.grid_size ];
+  if (!label_values && voxels.label_values) label_values = new int [ voxels.grid_size ];
+
   // Copy grid resolution
   grid_resolution[0] = voxels.grid_resolution[0];
   grid_resolution[1] = voxels.grid_resolution[1];
@@ -473,6 +485,14 @@ operator=(const R3Grid& voxels)
     grid_values[i] = voxels.grid_values[i];
   }
 
+  // Copy material values
+  if (rgb_values && voxels.rgb_values) {
+    for (int i = 0; i < grid_size; i++) rgb_values[i] = voxels.rgb_values[i];
+  }
+  if (label_values && voxels.label_values) {
+    for (int i = 0; i < grid_size; i++) label_values[i] = voxels.label_values[i];
+  }
+
   // Copy transforms
   grid_to_world_transform = voxels.grid_to_world_transform;
   world_to_grid_transform = voxels.world_to_grid_transform;
@@ -583,7 +603,7 @@ void R3Grid::
 Dilate(RNLength grid_distance) 
 {
   // Set voxels (to one) within grid_distance from some non-zero voxel
-  SquaredDistanceTransform();
+  SquaredDistanceTransform(grid_distance);
   Threshold(grid_distance * grid_distance, 1, 0);
 }
 
@@ -594,7 +614,7 @@ Erode(RNLength grid_distance)
 {
   // Keep only voxels at least distance from some zero voxel
   Threshold(1.0E-20, 1, 0);
-  SquaredDistanceTransform();
+  SquaredDistanceTransform(grid_distance);
   Threshold(grid_distance * grid_distance, 0, 1);
 }
 
@@ -896,9 +916,301 @@ DetectEdges(void)
 
 
 
+////////////////////////////////////////////////////////////////////////
+// Percentile filter utility functions
+////////////////////////////////////////////////////////////////////////
+
+// Largest number of distinct values filtered with a sliding histogram
+static const int R3_GRID_MAX_HISTOGRAM_BINS = (1 << 20);
+
+
+
+static int
+R3GridFilterRows(RNLength grid_radius, int *dys, int *dzs, int *ws)
+{
+  // Decompose spherical neighborhood into x spans of half-width w at offsets (dy, dz)
+  RNScalar grid_radius_squared = grid_radius * grid_radius;
+  int r = (int) grid_radius;
+  int nrows = 0;
+  for (int dz = -r; dz <= r; dz++) {
+    for (int dy = -r; dy <= r; dy++) {
+      int d_squared = dy*dy + dz*dz;
+      if (d_squared > grid_radius_squared) continue;
+      int w = 0;
+      while ((w < r) && (d_squared + (w+1)*(w+1) <= grid_radius_squared)) w++;
+      dys[nrows] = dy;
+      dzs[nrows] = dz;
+      ws[nrows] = w;
+      nrows++;
+    }
+  }
+
+  // Return number of spans
+  return nrows;
+}
+
+
+
+static void
+R3GridMinFilter(RNScalar *grid_values, const int resolution[3], RNLength grid_radius, RNScalar sign)
+{
+  // Get convenient variables
+  int row_size = resolution[0];
+  int sheet_size = resolution[0] * resolution[1];
+  int grid_size = sheet_size * resolution[2];
+  int r = (int) grid_radius;
+  assert(r >= 0);
+
+  // Decompose neighborhood into spans
+  int max_rows = (2*r+1) * (2*r+1);
+  int *dys = new int [ max_rows ];
+  int *dzs = new int [ max_rows ];
+  int *ws = new int [ max_rows ];
+  int nrows = R3GridFilterRows(grid_radius, dys, dzs, ws);
+
+  // Copy input values (negated for a max filter)
+  RNScalar *input = new RNScalar [ grid_size ];
+  for (int i = 0; i < grid_size; i++) input[i] = sign * grid_values[i];
+
+  // Allocate buffers for each thread
+  int buffer_size = resolution[0] + 2*r;
+  RNScalar *buffers = new RNScalar [ RNNumThreads() * 4 * buffer_size ];
+  assert(dys && dzs && ws && input && buffers);
+
+  // Compute minimum over spans with van Herk/Gil-Werman running minima, one z slab per task
+  RNParallelFor(0, resolution[2], [&](int cz, int thread) {
+    RNScalar *padded = &buffers[thread * 4 * buffer_size];
+    RNScalar *g = padded + buffer_size;
+    RNScalar *h = g + buffer_size;
+    RNScalar *result = h + buffer_size;
+    for (int cy = 0; cy < resolution[1]; cy++) {
+      for (int x = 0; x < resolution[0]; x++) result[x] = DBL_MAX;
+      for (int k = 0; k < nrows; k++) {
+        int y = cy + dys[k];
+        int z = cz + dzs[k];
+        if ((y < 0) || (y >= resolution[1])) continue;
+        if ((z < 0) || (z >= resolution[2])) continue;
+        const RNScalar *src = &input[z * sheet_size + y * row_size];
+        int w = ws[k];
+
+        // Check for single-voxel span
+        if (w == 0) {
+          for (int x = 0; x < resolution[0]; x++) 
+            if (src[x] < result[x]) result[x] = src[x];
+          continue;
+        }
+
+        // Pad row so that windows of size 2w+1 never leave the buffer
+        int n = resolution[0] + 2*w;
+        int window = 2*w + 1;
+        for (int i = 0; i < w; i++) padded[i] = padded[n-1-i] = DBL_MAX;
+        for (int x = 0; x < resolution[0]; x++) padded[w+x] = src[x];
+
+        // Compute running minima forward and backward within blocks of window size
+        for (int i = 0; i < n; i++) {
+          if ((i % window) == 0) g[i] = padded[i];
+          else g[i] = (padded[i] < g[i-1]) ? padded[i] : g[i-1];
+        }
+        for (int i = n-1; i >= 0; i--) {
+          if ((i == n-1) || ((i % window) == window-1)) h[i] = padded[i];
+          else h[i] = (padded[i] < h[i+1]) ? padded[i] : h[i+1];
+        }
+
+        // Combine minima of the (at most two) blocks overlapping each window
+        for (int x = 0; x < resolution[0]; x++) {
+          RNScalar value = (h[x] < g[x+window-1]) ? h[x] : g[x+window-1];
+          if (value < result[x]) result[x] = value;
+        }
+      }
+
+      // Copy result into grid
+      RNScalar *dst = &grid_values[cz * sheet_size + cy * row_size];
+      for (int x = 0; x < resolution[0]; x++) dst[x] = sign * result[x];
+    }
+  });
+
+  // Delete temporary memory
+  delete [] dys;
+  delete [] dzs;
+  delete [] ws;
+  delete [] input;
+  delete [] buffers;
+}
+
+
+
+static int
+R3GridHistogramFilter(RNScalar *grid_values, const int resolution[3], RNLength grid_radius, RNScalar percentile)
+{
+  // Get convenient variables
+  int row_size = resolution[0];
+  int sheet_size = resolution[0] * resolution[1];
+  int grid_size = sheet_size * resolution[2];
+  int r = (int) grid_radius;
+  assert(r >= 0);
+  if (grid_size == 0) return 1;
+
+  // Check whether values are integers in a small range
+  RNBoolean integers = TRUE;
+  RNScalar min_value = grid_values[0];
+  RNScalar max_value = grid_values[0];
+  for (int i = 0; i < grid_size; i++) {
+    RNScalar value = grid_values[i];
+    if (value != floor(value)) { integers = FALSE; break; }
+    if (value < min_value) min_value = value;
+    if (value > max_value) max_value = value;
+  }
+
+  // Map grid values to histogram bins
+  int nbins = 0;
+  RNScalar *bin_values = NULL;
+  int *bins = new int [ grid_size ];
+  assert(bins);
+  if (integers && (max_value - min_value < R3_GRID_MAX_HISTOGRAM_BINS)) {
+    // One bin per integer in range
+    nbins = (int) (max_value - min_value) + 1;
+    bin_values = new RNScalar [ nbins ];
+    for (int b = 0; b < nbins; b++) bin_values[b] = min_value + b;
+    for (int i = 0; i < grid_size; i++) bins[i] = (int) (grid_values[i] - min_value);
+  }
+  else {
+    // One bin per distinct value, in sorted order
+    bin_values = new RNScalar [ grid_size ];
+    for (int i = 0; i < grid_size; i++) bin_values[i] = grid_values[i];
+    qsort(bin_values, grid_size, sizeof(RNScalar), RNCompareScalars);
+    for (int i = 0; i < grid_size; i++) {
+      if ((nbins > 0) && (bin_values[i] == bin_values[nbins-1])) continue;
+      bin_values[nbins++] = bin_values[i];
+    }
+
+    // Check number of distinct values
+    if (nbins > R3_GRID_MAX_HISTOGRAM_BINS) {
+      delete [] bin_values;
+      delete [] bins;
+      return 0;
+    }
+
+    // Find bin of every grid value
+    for (int i = 0; i < grid_size; i++) {
+      int lo = 0, hi = nbins - 1;
+      while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (bin_values[mid] < grid_values[i]) lo = mid + 1;
+        else hi = mid;
+      }
+      bins[i] = lo;
+    }
+  }
+
+  // Decompose neighborhood into spans
+  int max_rows = (2*r+1) * (2*r+1);
+  int *dys = new int [ max_rows ];
+  int *dzs = new int [ max_rows ];
+  int *ws = new int [ max_rows ];
+  int nrows = R3GridFilterRows(grid_radius, dys, dzs, ws);
+
+  // Allocate an empty histogram and span list for each thread
+  int nthreads = RNNumThreads();
+  int *histograms = new int [ nthreads * nbins ];
+  const int **spans = new const int * [ nthreads * max_rows ];
+  int *span_widths = new int [ nthreads * max_rows ];
+  assert(dys && dzs && ws && histograms && spans && span_widths);
+  for (int i = 0; i < nthreads * nbins; i++) histograms[i] = 0;
+
+  // Slide a histogram of the neighborhood along x, one z slab per task
+  RNParallelFor(0, resolution[2], [&](int cz, int thread) {
+    int *histogram = &histograms[thread * nbins];
+    const int **span = &spans[thread * max_rows];
+    int *span_width = &span_widths[thread * max_rows];
+    for (int cy = 0; cy < resolution[1]; cy++) {
+      // Find spans of neighborhood inside grid
+      int nspans = 0;
+      for (int k = 0; k < nrows; k++) {
+        int y = cy + dys[k];
+        int z = cz + dzs[k];
+        if ((y < 0) || (y >= resolution[1])) continue;
+        if ((z < 0) || (z >= resolution[2])) continue;
+        span[nspans] = &bins[z * sheet_size + y * row_size];
+        span_width[nspans] = ws[k];
+        nspans++;
+      }
+
+      // Fill histogram with neighborhood of first voxel in row
+      int nsamples = 0, pivot = 0, nbelow = 0;
+      for (int k = 0; k < nspans; k++) {
+        for (int x = 0; (x <= span_width[k]) && (x < resolution[0]); x++) {
+          histogram[span[k][x]]++;
+          nsamples++;
+        }
+      }
+
+      // Visit voxels along row
+      RNScalar *dst = &grid_values[cz * sheet_size + cy * row_size];
+      for (int cx = 0; cx < resolution[0]; cx++) {
+        // Slide spans by one voxel
+        if (cx > 0) {
+          for (int k = 0; k < nspans; k++) {
+            int w = span_width[k];
+            if (cx - 1 - w >= 0) {
+              int bin = span[k][cx - 1 - w];
+              histogram[bin]--;
+              if (bin < pivot) nbelow--;
+              nsamples--;
+            }
+            if (cx + w < resolution[0]) {
+              int bin = span[k][cx + w];
+              histogram[bin]++;
+              if (bin < pivot) nbelow++;
+              nsamples++;
+            }
+          }
+        }
+
+        // Move pivot to bin containing the sample at percentile index
+        int index = (int) (percentile * nsamples);
+        if (index < 0) index = 0;
+        else if (index >= nsamples) index = nsamples-1;
+        while (nbelow > index) nbelow -= histogram[--pivot];
+        while (nbelow + histogram[pivot] <= index) nbelow += histogram[pivot++];
+        dst[cx] = bin_values[pivot];
+      }
+
+      // Empty histogram for next row
+      for (int k = 0; k < nspans; k++) {
+        int w = span_width[k];
+        int xmin = resolution[0] - 1 - w;
+        if (xmin < 0) xmin = 0;
+        for (int x = xmin; x < resolution[0]; x++) histogram[span[k][x]]--;
+      }
+    }
+  });
+
+  // Delete temporary memory
+  delete [] bins;
+  delete [] bin_values;
+  delete [] dys;
+  delete [] dzs;
+  delete [] ws;
+  delete [] histograms;
+  delete [] spans;
+  delete [] span_widths;
+
+  // Return success
+  return 1;
+}
+
+
+
 void R3Grid::
 PercentileFilter(RNLength grid_radius, RNScalar percentile)
 {
+  // Use running minima/maxima for extreme percentiles
+  if (percentile <= 0) { R3GridMinFilter(grid_values, grid_resolution, grid_radius, 1); return; }
+  if (percentile >= 1) { R3GridMinFilter(grid_values, grid_resolution, grid_radius, -1); return; }
+
+  // Use sliding histogram unless there are too many distinct values
+  if (R3GridHistogramFilter(grid_values, grid_resolution, grid_radius, percentile)) return;
+
   // Make copy of grid
   R3Grid copy(*this);
 
@@ -907,11 +1219,12 @@ PercentileFilter(RNLength grid_radius, RNScalar percentile)
   int r = (int) grid_radius;
   assert(r >= 0);
   int max_samples = (2*r+1) * (2*r+1) * (2*r+1);
-  RNScalar *samples = new RNScalar [ max_samples ];
+  RNScalar *samples = new RNScalar [ RNNumThreads() * max_samples ];
   assert(samples);
 
   // Set every sample to be Kth percentile of surrounding region in input grid
-  for (int cz = 0; cz < ZResolution(); cz++) {
+  RNParallelFor(0, ZResolution(), [&](int cz, int thread) {
+    RNScalar *thread_samples = &samples[thread * max_samples];
     for (int cy = 0; cy < YResolution(); cy++) {
       for (int cx = 0; cx < XResolution(); cx++) {
         // Build list of grid values in neighborhood
@@ -937,7 +1250,7 @@ PercentileFilter(RNLength grid_radius, RNScalar percentile)
               int d_squared = dx*dx + dy*dy + dz*dz;
               if (d_squared > grid_radius_squared) continue;
               RNScalar sample = copy.GridValue(x, y, z);
-              samples[nsamples++] = sample;
+              thread_samples[nsamples++] = sample;
             }
           }
         }
@@ -948,17 +1261,17 @@ PercentileFilter(RNLength grid_radius, RNScalar percentile)
         }
         else {
           // Sort samples found in neighborhood
-          qsort(samples, nsamples, sizeof(RNScalar), RNCompareScalars);
+          qsort(thread_samples, nsamples, sizeof(RNScalar), RNCompareScalars);
 
           // Set grid value to percentile of neighborhood
           int index = (int) (percentile * nsamples);
           if (index < 0) index = 0;
           else if (index >= nsamples) index = nsamples-1;
-          SetGridValue(cx, cy, cz, samples[index]);
+          SetGridValue(cx, cy, cz, thread_samples[index]);
         }
       }
     }
-  }
+  });
 
   // Delete temporary memory
   delete [] samples;
@@ -1229,203 +1542,191 @@ Threshold(RNScalar threshold, RNScalar low, RNScalar high)
 
 
 
+////////////////////////////////////////////////////////////////////////
+// Distance transform utility functions
+////////////////////////////////////////////////////////////////////////
+
+// Number of adjacent lines gathered into one transposed block
+static const int R3_GRID_DISTANCE_BLOCK_SIZE = 16;
+
+
+
+static int
+R3GridSquaredDistanceLine(const RNScalar *f, const RNScalar *fvalues, int n, 
+  RNScalar band_squared, RNScalar far_value,
+  RNScalar *d, RNScalar *dvalues, int *v, RNScalar *z)
+{
+  // Compute 1D squared distance transform with the lower envelope of 
+  // parabolas rooted at finite entries (Felzenszwalb and Huttenlocher).
+  // Entries with f >= far_value (or beyond the band) are not sources.
+  int k = -1;
+  for (int q = 0; q < n; q++) {
+    RNScalar fq = f[q];
+    if ((fq >= far_value) || (fq > band_squared)) continue;
+    if (k < 0) { k = 0; v[0] = q; z[0] = -FLT_MAX; z[1] = FLT_MAX; continue; }
+    RNScalar s;
+    while (TRUE) {
+      int p = v[k];
+      s = ((fq + q*q) - (f[p] + p*p)) / (2 * (q - p));
+      if (s > z[k]) break;
+      k--;
+    }
+    k++;
+    v[k] = q;
+    z[k] = s;
+    z[k+1] = FLT_MAX;
+  }
+
+  // Check if there are no sources on this line
+  if (k < 0) {
+    for (int q = 0; q < n; q++) d[q] = far_value;
+    if (dvalues) for (int q = 0; q < n; q++) dvalues[q] = fvalues[q];
+    return 0;
+  }
+
+  // Fill in distances from lower envelope
+  k = 0;
+  for (int q = 0; q < n; q++) {
+    while (z[k+1] < q) k++;
+    int p = v[k];
+    RNScalar dist = (q - p) * (q - p) + f[p];
+    if (dist > band_squared) {
+      d[q] = far_value;
+      if (dvalues) dvalues[q] = fvalues[q];
+    }
+    else {
+      d[q] = dist;
+      if (dvalues) dvalues[q] = fvalues[p];
+    }
+  }
+
+  // Return success
+  return 1;
+}
+
+
+
+static void
+R3GridSquaredDistancePass(RNScalar *distances, RNScalar *values, 
+  int n, int step, int nouter, int outer_step, int ninner, int inner_step, int block_size,
+  RNScalar band_squared, RNScalar far_value)
+{
+  // Execute 1D transforms along all lines parallel to one axis.  Lines are
+  // indexed by (outer, inner) and run for n entries with the given step.
+  // Up to block_size lines with adjacent inner indices are gathered into
+  // a transposed buffer so that grid memory is read and written in runs.
+  int nblocks = (ninner + block_size - 1) / block_size;
+  int nthreads = RNNumThreads();
+  int buffer_size = block_size * n;
+  RNScalar *f = new RNScalar [ nthreads * buffer_size ];
+  RNScalar *d = new RNScalar [ nthreads * buffer_size ];
+  RNScalar *fv = (values) ? new RNScalar [ nthreads * buffer_size ] : NULL;
+  RNScalar *dv = (values) ? new RNScalar [ nthreads * buffer_size ] : NULL;
+  RNScalar *z = new RNScalar [ nthreads * (n + 1) ];
+  int *v = new int [ nthreads * n ];
+  assert(f && d && z && v);
+
+  // Process blocks of lines in parallel
+  RNParallelFor(0, nouter * nblocks, [&](int task, int thread) {
+    // Get block of lines
+    int outer = task / nblocks;
+    int inner_start = (task % nblocks) * block_size;
+    int nlines = ninner - inner_start;
+    if (nlines > block_size) nlines = block_size;
+    int base = outer * outer_step + inner_start * inner_step;
+
+    // Get thread buffers
+    RNScalar *tf = &f[thread * buffer_size];
+    RNScalar *td = &d[thread * buffer_size];
+    RNScalar *tfv = (values) ? &fv[thread * buffer_size] : NULL;
+    RNScalar *tdv = (values) ? &dv[thread * buffer_size] : NULL;
+    RNScalar *tz = &z[thread * (n + 1)];
+    int *tv = &v[thread * n];
+
+    // Gather lines into transposed buffer
+    for (int q = 0; q < n; q++) {
+      const RNScalar *src = &distances[base + q * step];
+      for (int b = 0; b < nlines; b++) tf[b*n + q] = src[b * inner_step];
+      if (values) {
+        const RNScalar *vsrc = &values[base + q * step];
+        for (int b = 0; b < nlines; b++) tfv[b*n + q] = vsrc[b * inner_step];
+      }
+    }
+
+    // Compute 1D distance transform of each line
+    int nchanged = 0;
+    for (int b = 0; b < nlines; b++) {
+      nchanged += R3GridSquaredDistanceLine(&tf[b*n], (values) ? &tfv[b*n] : NULL, 
+        n, band_squared, far_value, &td[b*n], (values) ? &tdv[b*n] : NULL, tv, tz);
+    }
+
+    // Scatter lines back into grid (unless no line had any source)
+    if (nchanged == 0) return;
+    for (int q = 0; q < n; q++) {
+      RNScalar *dst = &distances[base + q * step];
+      for (int b = 0; b < nlines; b++) dst[b * inner_step] = td[b*n + q];
+      if (values) {
+        RNScalar *vdst = &values[base + q * step];
+        for (int b = 0; b < nlines; b++) vdst[b * inner_step] = tdv[b*n + q];
+      }
+    }
+  });
+
+  // Delete temporary buffers
+  delete [] f;
+  delete [] d;
+  if (fv) delete [] fv;
+  if (dv) delete [] dv;
+  delete [] z;
+  delete [] v;
+}
+
+
+
+static void
+R3GridSquaredDistanceTransform(RNScalar *distances, RNScalar *values, const int resolution[3],
+  RNScalar band_squared, RNScalar far_value)
+{
+  // Compute exact squared distance transform with separable passes along z, y, and x
+  int row_size = resolution[0];
+  int sheet_size = resolution[0] * resolution[1];
+  int block_size = R3_GRID_DISTANCE_BLOCK_SIZE;
+  R3GridSquaredDistancePass(distances, values, resolution[2], sheet_size, 
+    resolution[1], row_size, resolution[0], 1, block_size, band_squared, far_value);
+  R3GridSquaredDistancePass(distances, values, resolution[1], row_size, 
+    resolution[2], sheet_size, resolution[0], 1, block_size, band_squared, far_value);
+  R3GridSquaredDistancePass(distances, values, resolution[0], 1, 
+    resolution[2], sheet_size, resolution[1], row_size, 1, band_squared, far_value);
+}
+
+
+
 void R3Grid::
 Voronoi(R3Grid *squared_distance_grid)
 {
-  int dist;
-  int* old_dist;
-  int* new_dist;
-  RNScalar value;
-  RNScalar *old_value;
-  RNScalar *new_value;
-  R3Grid *dgrid;
-  int res,square,tmp_dist,first;
-  int x,y,z,s,t,i;
-
   // Allocate distance grid
+  R3Grid *dgrid;
   if (squared_distance_grid) dgrid = squared_distance_grid;
   else dgrid = new R3Grid(XResolution(), YResolution(), ZResolution());
   assert(dgrid);
+  assert(dgrid->grid_size == grid_size);
   dgrid->SetWorldToGridTransformation(WorldToGridTransformation());
 
-  // Allocate temporary buffers
-  res = XResolution();
+  // Initalize distance grid values (0 if was set, max_value if not)
+  int res = XResolution();
   if (res < YResolution()) res = YResolution();
   if (res < ZResolution()) res = ZResolution();
-  old_dist = new int[res];
-  new_dist = new int[res];
-  old_value = new RNScalar[res];
-  new_value = new RNScalar[res];
-  assert(old_dist && new_dist && old_value && new_value);
-
-  // Initalize distance grid values (0 if was set, max_value if not)
   RNScalar max_value = 3 * (res+1) * (res+1) * (res+1);
-  for (i = 0; i < grid_size; i++) {
+  for (int i = 0; i < grid_size; i++) {
     if (grid_values[i] == 0.0) dgrid->grid_values[i] = max_value;
     else dgrid->grid_values[i] = 0.0;
   }
 
-  // Scan along z axis
-  for (x = 0; x < XResolution(); x++) {
-    for (y = 0; y < YResolution(); y++) {
-      first = 1;
-      value = 0;
-      dist = 0;
-      for (z = 0; z < ZResolution(); z++) {
-        if (dgrid->GridValue(x,y,z) == 0.0) {
-          first=0;
-          dist=0;
-          value = GridValue(x,y,z);
-          assert(value != 0);
-        }
-        else if (first == 0) {
-          dist++;
-          square = dist*dist;
-          dgrid->SetGridValue(x, y, z, square);
-          SetGridValue(x, y, z, value);
-          assert(value != 0);
-        }
-      }
-			
-      // backward scan
-      dist = 0;
-      first = 1;
-      for (z = ZResolution()-1; z >= 0; z--) {
-        if (dgrid->GridValue(x,y,z) == 0.0){
-          dist = 0;
-          first = 0;
-          value = GridValue(x,y,z);
-          assert(value != 0);
-        }
-        else if (first == 0) {
-          dist++;
-          square = dist*dist;
-          if (square < dgrid->GridValue(x, y, z)) {
-            dgrid->SetGridValue(x, y, z, square);
-            SetGridValue(x, y, z, value);
-            assert(value != 0);
-          }
-        }
-      }
-    }
-  } 
-
-  // Scan along x axis
-  for (z = 0; z < ZResolution(); z++) {
-    for (y = 0; y < YResolution(); y++) {
-      // Copy grid values
-      for(x = 0; x < XResolution(); x++) {
-        old_dist[x] = (int) (dgrid->GridValue(x, y, z) + 0.5);
-        old_value[x] = GridValue(x, y, z);
-      }
-		
-      // forward scan
-      s = 0;
-      for (x = 0; x < XResolution(); x++) {
-        dist = old_dist[x];
-        value = old_value[x];
-        if (dist) {
-          for(t = s; t <= x; t++) {
-            tmp_dist = old_dist[t] + (x - t) * (x - t);
-            if (tmp_dist <= dist) {
-              dist = tmp_dist;
-              value = old_value[t];
-              s = t;
-            }
-          }
-        }
-        else {
-          s = x;
-        }
-        new_dist[x] = dist;
-        new_value[x] = value;
-      }
-			
-      // backwards scan
-      s = XResolution() - 1;
-      for (x = XResolution()-1; x >= 0 ; x--) {
-        dist = new_dist[x];
-        value = new_value[x];
-        if (dist) {
-          for (t = s; t >= x; t--) {
-            tmp_dist = old_dist[t] + (x - t) * (x - t);
-            if (tmp_dist <= dist) {
-              dist = tmp_dist;
-              value = old_value[t];
-              s = t;
-            }
-          }
-          dgrid->SetGridValue(x, y, z, dist);
-          SetGridValue(x, y, z, value);
-        }
-        else {
-          s=x;
-        }
-      }
-    }
-  }
-		
-  // along y axis
-  for (z = 0; z < ZResolution(); z++) {
-    for (x = 0; x < XResolution(); x++) {
-      // Copy grid values
-      for (y = 0; y < YResolution(); y++) {
-        old_dist[y] = (int) (dgrid->GridValue(x, y, z));
-        old_value[y] = GridValue(x, y, z);
-      }
-			
-      // forward scan
-      s = 0;
-      for (y = 0; y < YResolution(); y++) {
-        dist = old_dist[y];
-        value = old_value[y];
-        if (dist) {
-          for (t = s; t <= y ; t++) {
-            tmp_dist = old_dist[t] + (y - t) * (y - t);
-            if (tmp_dist <= dist){
-              dist = tmp_dist;
-              value = old_value[t];
-              s = t;
-            }
-          }
-        }
-        else { 
-          s = y;
-        }
-        new_dist[y] = dist;
-        new_value[y] = value;
-      }
+  // Propagate values of nearest nonzero voxels along with squared distances
+  R3GridSquaredDistanceTransform(dgrid->grid_values, grid_values, grid_resolution, max_value, max_value);
 
-      // backward scan
-      s = YResolution() - 1;
-      for(y = YResolution()-1; y >=0 ; y--) {
-        dist = new_dist[y];
-        value = new_value[y];
-        if (dist) {
-          for (t = s; t > y ; t--) {
-            tmp_dist = old_dist[t] + (y - t) * (y - t);
-            if (tmp_dist <= dist){
-              dist = tmp_dist;
-              value = old_value[t];
-              s = t;
-            }
-          }
-          dgrid->SetGridValue(x, y, z, dist);
-          SetGridValue(x, y, z, value);
-        }
-        else { 
-          s = y; 
-        }
-      }
-    }
-  }
-	
-  // Delete temporary buffers
+  // Delete temporary distance grid
   if (!squared_distance_grid) delete dgrid;
-  delete[] old_dist;
-  delete[] new_dist;
-  delete[] old_value;
-  delete[] new_value;
 }
 
 
@@ -1447,168 +1748,29 @@ SignedDistanceTransform(void)
 
 
 void R3Grid::
-SquaredDistanceTransform(void)
+SquaredDistanceTransform(RNLength max_grid_distance)
 {
-  int x,y,z,s,t;
-  int dist,square,new_dist;
-  int* oldBuffer;
-  int* newBuffer;
-  int first;
-  int i;
-
-  // Allocate temporary buffers
+  // Determine value assigned to voxels with no nonzero voxel in range
   int res = XResolution();
   if (res < YResolution()) res = YResolution();
   if (res < ZResolution()) res = ZResolution();
-  oldBuffer = new int[res];
-  assert(oldBuffer);
-  newBuffer = new int[res];
-  assert(newBuffer);
+  RNScalar max_value = 3 * (res+1) * (res+1) * (res+1);
+
+  // Determine narrow band (0 means no limit)
+  RNScalar band_squared = max_value;
+  if ((max_grid_distance > 0) && (max_grid_distance * max_grid_distance < band_squared)) 
+    band_squared = max_grid_distance * max_grid_distance;
 
   // Initalize values (0 if was set, max_value if not)
-  RNScalar max_value = 3 * (res+1) * (res+1) * (res+1);
   RNScalar *grid_valuesp = grid_values;
-  for (i = 0; i < grid_size; i++) {
+  for (int i = 0; i < grid_size; i++) {
     if (*grid_valuesp == 0.0) *grid_valuesp = max_value;
     else *grid_valuesp = 0.0;
     grid_valuesp++;
   }
 
-  // Scan along z axis
-  for (x = 0; x < XResolution(); x++) {
-    for (y = 0; y < YResolution(); y++) {
-      first = 1;
-      dist = 0;
-      for (z = 0; z < ZResolution(); z++) {
-        if (GridValue(x,y,z) == 0.0) {
-          dist=0;
-          first=0;
-          SetGridValue(x, y, z, 0);
-        }
-        else if (first == 0) {
-          dist++;
-          square = dist*dist;
-          SetGridValue(x, y, z, square);
-        }
-      }
-			
-      // backward scan
-      dist = 0;
-      first = 1;
-      for (z = ZResolution()-1; z >= 0; z--) {
-        if (GridValue(x,y,z) == 0.0){
-          dist = 0;
-          first = 0;
-          SetGridValue(x, y, z, 0);
-        }
-        else if (first == 0) {
-          dist++;
-          square = dist*dist;
-          if (square < GridValue(x, y, z)) {
-            SetGridValue(x, y, z, square);
-          }
-        }
-      }
-    }
-  } 
-
-  // Scan along x axis
-  for (z = 0; z < ZResolution(); z++) {
-    for (y = 0; y < YResolution(); y++) {
-      // Copy grid values
-      for(x = 0; x < XResolution(); x++) 
-        oldBuffer[x] = (int) (GridValue(x, y, z) + 0.5);
-		
-      // forward scan
-      s = 0;
-      for (x = 0; x < XResolution(); x++) {
-        dist = oldBuffer[x];
-        if (dist) {
-          for(t = s; t <= x; t++) {
-            new_dist = oldBuffer[t] + (x - t) * (x - t);
-            if (new_dist <= dist) {
-              dist = new_dist;
-              s = t;
-            }
-          }
-        }
-        else {
-          s = x;
-        }
-        newBuffer[x] = dist;
-      }
-			
-      // backwards scan
-      s = XResolution() - 1;
-      for (x = XResolution()-1; x >= 0 ; x--) {
-        dist = newBuffer[x];
-        if (dist) {
-          for (t = s; t >= x; t--) {
-            new_dist = oldBuffer[t] + (x - t) * (x - t);
-            if (new_dist <= dist) {
-              dist = new_dist;
-              s = t;
-            }
-          }
-          SetGridValue(x, y, z, dist);
-        }
-        else {
-          s=x;
-        }
-      }
-    }
-  }
-		
-  // along y axis
-  for (z = 0; z < ZResolution(); z++) {
-    for (x = 0; x < XResolution(); x++) {
-      // Copy grid values
-      for (y = 0; y < YResolution(); y++)
-        oldBuffer[y] = (int) (GridValue(x, y, z) + 0.5);
-			
-      // forward scan
-      s = 0;
-      for (y = 0; y < YResolution(); y++) {
-        dist = oldBuffer[y];
-        if (dist) {
-          for (t = s; t <= y ; t++) {
-            new_dist = oldBuffer[t] + (y - t) * (y - t);
-            if (new_dist <= dist){
-              dist = new_dist;
-              s = t;
-            }
-          }
-        }
-        else { 
-          s = y;
-        }
-        newBuffer[y] = dist;
-      }
-
-      // backward scan
-      s = YResolution() - 1;
-      for(y = YResolution()-1; y >=0 ; y--) {
-        dist = newBuffer[y];
-        if (dist) {
-          for (t = s; t > y ; t--) {
-            new_dist = oldBuffer[t] + (y - t) * (y - t);
-            if (new_dist <= dist){
-              dist = new_dist;
-              s = t;
-            }
-          }
-          SetGridValue(x, y, z, dist);
-        }
-        else { 
-          s = y; 
-        }
-      }
-    }
-  }
-	
-  // Delete temporary buffers
-  delete[] oldBuffer;
-  delete[] newBuffer;
+  // Compute squared distances to nearest nonzero voxel
+  R3GridSquaredDistanceTransform(grid_values, NULL, grid_resolution, band_squared, max_value);
 }
 
 
@@ -2387,6 +2549,22 @@ RasterizeGridSpan(const int p1[3], const int p2[3], RNScalar value, int operatio
   }
 }
 
+static int
+R3GridTextureLevel(const double w1[3], const double w2[3], const double w3[3],
+  const R2Point& t1, const R2Point& t2, const R2Point& t3, const R2Image *image)
+{
+  // Compute area of triangle in voxels
+  double a[3] = { w2[0] - w1[0], w2[1] - w1[1], w2[2] - w1[2] };
+  double b[3] = { w3[0] - w1[0], w3[1] - w1[1], w3[2] - w1[2] };
+  double c[3] = { a[1]*b[2] - a[2]*b[1], a[2]*b[0] - a[0]*b[2], a[0]*b[1] - a[1]*b[0] };
+  double voxel_area = sqrt(c[0]*c[0] + c[1]*c[1] + c[2]*c[2]);
+
+  // Return mip level at which one voxel covers about one texel
+  return image->FootprintLevel(t1, t2, t3, voxel_area);
+}
+
+
+
 RNRgb R3Grid::
 ChangeRGB(const int p[3],const double r1[3],const double r2[3],const double r3[3],const R2Point& t1,const R2Point& t2,const R2Point& t3,R2Image *image,RNRgb rgb_origin)
 {
@@ -2700,6 +2878,11 @@ void R3Grid::
 RasterizeGridTriangleMat(const int p1[3], const int p2[3], const int p3[3],const double w1[3], const double w2[3], const double w3[3],const R2Point& t1, const R2Point& t2, const R2Point& t3, RNScalar value,int label, RNRgb RGB, R2Image *image, int operation)
 {
   int i,j;
+  // Sample texture from mip level matching the voxel footprint (to avoid aliasing)
+  if (image && (image->RowSize() > 0)) {
+    image = (R2Image *) image->Level(R3GridTextureLevel(w1, w2, w3, t1, t2, t3, image));
+  }
+
   // Figure out the min, max, and delta in each dimension
   int mn[3], mx[3], delta[3];
   for (i = 0; i < 3; i++) {
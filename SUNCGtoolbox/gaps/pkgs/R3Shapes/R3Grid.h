@@ -97,7 +97,7 @@ public:
   void Mask(const R3Grid& grid);
   void Threshold(RNScalar threshold, RNScalar low, RNScalar high);
   void SignedDistanceTransform(void);
-  void SquaredDistanceTransform(void);
+  void SquaredDistanceTransform(RNLength max_grid_distance = 0);
   void Voronoi(R3Grid *squared_distance_grid = NULL);
   void Gauss(RNLength sigma = sqrt(8.0), RNBoolean square = TRUE);
   void Resample(int xres, int yres, int zres);
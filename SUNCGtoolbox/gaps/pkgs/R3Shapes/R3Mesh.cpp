@@ -7,6 +7,8 @@
 
 #include "R3Shapes/R3Shapes.h"
 #include "ply.h"
+#include <algorithm>
+#include <atomic>
 
 
 
@@ -22,9 +24,20 @@ RNMark R3mesh_mark = 1;
 
 R3Mesh::
 R3Mesh(void) 
-  : vertex_block(NULL),
-    edge_block(NULL),
-    face_block(NULL),
+  : vertex_positions(NULL),
+    vertex_normals(NULL),
+    vertex_edge_ranges(NULL),
+    nallocated_vertices(0),
+    vertex_edges(NULL),
+    nvertex_edges(0),
+    nunused_vertex_edges(0),
+    nallocated_vertex_edges(0),
+    halfedge_vertices(NULL),
+    halfedge_faces(NULL),
+    nallocated_edges(0),
+    face_vertices(NULL),
+    face_edges(NULL),
+    nallocated_faces(0),
     bbox(R3null_box),
     data(NULL)
 {
@@ -39,26 +52,38 @@ R3Mesh(void)
 
 R3Mesh::
 R3Mesh(const R3Mesh& mesh)
-  : vertex_block(NULL),
-    edge_block(NULL),
-    face_block(NULL),
+  : vertex_positions(NULL),
+    vertex_normals(NULL),
+    vertex_edge_ranges(NULL),
+    nallocated_vertices(0),
+    vertex_edges(NULL),
+    nvertex_edges(0),
+    nunused_vertex_edges(0),
+    nallocated_vertex_edges(0),
+    halfedge_vertices(NULL),
+    halfedge_faces(NULL),
+    nallocated_edges(0),
+    face_vertices(NULL),
+    face_edges(NULL),
+    nallocated_faces(0),
     bbox(mesh.bbox),
     data(NULL)
 {
+  // Allocate storage
+  Reserve(mesh.NVertices(), mesh.NEdges(), mesh.NFaces());
+
   // Copy vertices 
-  vertex_block = new R3MeshVertex [ mesh.NVertices() ];
   for (int i = 0; i < mesh.NVertices(); i++) {
     R3MeshVertex *vertex = mesh.Vertex(i);
     const R3Point& position = mesh.VertexPosition(vertex);
     const R3Vector& normal = mesh.VertexNormal(vertex);
     const RNRgb& color = mesh.VertexColor(vertex);
     const R2Point& texcoords = mesh.VertexTextureCoords(vertex);
-    R3MeshVertex *copy_vertex = this->CreateVertex(position, normal, color, texcoords, &vertex_block[i] );
+    R3MeshVertex *copy_vertex = this->CreateVertex(position, normal, color, texcoords);
     if (this->VertexID(copy_vertex) != i) RNAbort("Mismatching vertex id"); 
   }
 
   // Copy edges
-  edge_block = new R3MeshEdge [ mesh.NEdges() ];
   for (int i = 0; i < mesh.NEdges(); i++) {
     R3MeshEdge *edge = mesh.Edge(i);
     R3MeshVertex *v0 = mesh.VertexOnEdge(edge, 0);
@@ -67,12 +92,11 @@ R3Mesh(const R3Mesh& mesh)
     int i1 = mesh.VertexID(v1);
     R3MeshVertex *copy_v0 = this->Vertex(i0);
     R3MeshVertex *copy_v1 = this->Vertex(i1);
-    R3MeshEdge *copy_edge = this->CreateEdge(copy_v0, copy_v1, &edge_block[i] );
+    R3MeshEdge *copy_edge = this->CreateEdge(copy_v0, copy_v1);
     if (this->EdgeID(copy_edge) != i) RNAbort("Mismatching edge id"); 
   }
 
   // Copy faces
-  face_block = new R3MeshFace [ mesh.NFaces() ];
   for (int i = 0; i < mesh.NFaces(); i++) {
     R3MeshFace *face = mesh.Face(i);
     R3MeshVertex *v0 = mesh.VertexOnFace(face, 0);
@@ -84,7 +108,7 @@ R3Mesh(const R3Mesh& mesh)
     R3MeshVertex *copy_v0 = this->Vertex(i0);
     R3MeshVertex *copy_v1 = this->Vertex(i1);
     R3MeshVertex *copy_v2 = this->Vertex(i2);
-    R3MeshFace *copy_face = this->CreateFace(copy_v0, copy_v1, copy_v2, &face_block[i]);
+    R3MeshFace *copy_face = this->CreateFace(copy_v0, copy_v1, copy_v2);
     if (this->FaceID(copy_face) != i) RNAbort("Mismatching face id"); 
   }
 }
@@ -501,7 +525,7 @@ EdgeAspect(const R3MeshEdge *e) const
   // Get distances between opposite vertices
   R3MeshVertex *v0 = VertexAcrossFace(f0, e);
   R3MeshVertex *v1 = VertexAcrossFace(f1, e);
-  RNScalar opposite_length = R3Distance(v0->position, v1->position);
+  RNScalar opposite_length = R3Distance(VertexPosition(v0), VertexPosition(v1));
 
   // Return ratio
   return opposite_length / edge_length;
@@ -532,9 +556,9 @@ FaceCentroid(const R3MeshFace *f) const
 {
   // Return face centroid
   R3Point centroid = R3zero_point;
-  centroid += f->vertex[0]->position;
-  centroid += f->vertex[1]->position;
-  centroid += f->vertex[2]->position;
+  centroid += VertexPosition(VertexOnFace(f, 0));
+  centroid += VertexPosition(VertexOnFace(f, 1));
+  centroid += VertexPosition(VertexOnFace(f, 2));
   return centroid / 3.0;
 }
 
@@ -545,9 +569,9 @@ FacePoint(const R3MeshFace *f, RNMagnitude barycentrics[3]) const
 {
   // Return point on the face with the given barycentric coordinates
   R3Point point = R3zero_point;
-  point += barycentrics[0] * f->vertex[0]->position;
-  point += barycentrics[1] * f->vertex[1]->position;
-  point += barycentrics[2] * f->vertex[2]->position;
+  point += barycentrics[0] * VertexPosition(VertexOnFace(f, 0));
+  point += barycentrics[1] * VertexPosition(VertexOnFace(f, 1));
+  point += barycentrics[2] * VertexPosition(VertexOnFace(f, 2));
   return point;
 }
 
@@ -557,9 +581,9 @@ R3Point R3Mesh::
 FaceBarycentric(const R3MeshFace *f, const R3Point &point) const
 {
   // From http://www.devmaster.net/wiki/Ray-triangle_intersection
-  R3Point p0 = f->vertex[0]->position;
-  R3Point p1 = f->vertex[1]->position;
-  R3Point p2 = f->vertex[2]->position;
+  R3Point p0 = VertexPosition(VertexOnFace(f, 0));
+  R3Point p1 = VertexPosition(VertexOnFace(f, 1));
+  R3Point p2 = VertexPosition(VertexOnFace(f, 2));
   R3Vector b = p1 - p0;
   R3Vector c = p2 - p0;
   R3Vector p = point - p0;
@@ -628,22 +652,22 @@ void R3Mesh::
 SetVertexPosition(R3MeshVertex *v, const R3Point& position)
 {
   // Set vertex position
-  v->position = position;
+  vertex_positions[v->id] = position;
 
   // Mark vertex in need of update to normal and curvature
   v->flags.Remove(R3_MESH_VERTEX_NORMAL_UPTODATE);
   v->flags.Remove(R3_MESH_VERTEX_CURVATURE_UPTODATE);
 
   // Mark edges/faces in need of update
-  for (int i = 0; i < v->edges.NEntries(); i++) {
-    R3MeshEdge *e = v->edges[i];
+  for (int i = 0; i < VertexValence(v); i++) {
+    R3MeshEdge *e = EdgeOnVertex(v, i);
     e->flags.Remove(R3_MESH_EDGE_LENGTH_UPTODATE);
     R3MeshVertex *neighbor = VertexAcrossEdge(e, v);
     neighbor->flags.Remove(R3_MESH_VERTEX_NORMAL_UPTODATE);
     neighbor->flags.Remove(R3_MESH_VERTEX_CURVATURE_UPTODATE);
-    R3MeshFace *f0 = e->face[0];
+    R3MeshFace *f0 = FaceOnEdge(e, 0);
     if (f0) f0->flags.Remove(R3_MESH_FACE_PLANE_UPTODATE | R3_MESH_FACE_BBOX_UPTODATE);
-    R3MeshFace *f1 = e->face[1];
+    R3MeshFace *f1 = FaceOnEdge(e, 1);
     if (f1) f1->flags.Remove(R3_MESH_FACE_PLANE_UPTODATE | R3_MESH_FACE_BBOX_UPTODATE);
   }
 
@@ -664,9 +688,11 @@ EdgeBetweenVertices(const R3MeshVertex *v1, const R3MeshVertex *v2) const
   if (v1 == v2) return NULL;
 
   // Search for edge in v1's list
-  for (int i = 0; i < v1->edges.NEntries(); i++) {
-    R3MeshEdge *e = v1->edges[i];
-    if (IsVertexOnEdge(v2, e)) return e;
+  const R3MeshVertexEdgeRange& range = vertex_edge_ranges[v1->id];
+  for (int i = 0; i < range.count; i++) {
+    int edge_id = vertex_edges[range.start + i];
+    if (halfedge_vertices[2*edge_id] == v2->id) return edges[edge_id];
+    if (halfedge_vertices[2*edge_id+1] == v2->id) return edges[edge_id];
   }
 
   // Not found
@@ -679,17 +705,17 @@ R3MeshEdge *R3Mesh::
 EdgeOnVertex(const R3MeshVertex *v, const R3MeshFace *f, RNDirection dir) const
 {
   // Return edge on v in dir with respect to f
-  if (f->vertex[0] == v) {
-    if (dir == RN_CCW) return f->edge[2];
-    else return f->edge[0];
+  if (VertexOnFace(f, 0) == v) {
+    if (dir == RN_CCW) return EdgeOnFace(f, 2);
+    else return EdgeOnFace(f, 0);
   }
-  else if (f->vertex[1] == v) {
-    if (dir == RN_CCW) return f->edge[0];
-    else return f->edge[1];
+  else if (VertexOnFace(f, 1) == v) {
+    if (dir == RN_CCW) return EdgeOnFace(f, 0);
+    else return EdgeOnFace(f, 1);
   }
-  else if (f->vertex[2] == v) {
-    if (dir == RN_CCW) return f->edge[1];
-    else return f->edge[2];
+  else if (VertexOnFace(f, 2) == v) {
+    if (dir == RN_CCW) return EdgeOnFace(f, 1);
+    else return EdgeOnFace(f, 2);
   }
   else {
     // Vertex is not on face
@@ -703,17 +729,17 @@ R3MeshEdge *R3Mesh::
 EdgeAcrossVertex(const R3MeshVertex *v, const R3MeshEdge *e, const R3MeshFace *f) const
 {
   // Returns edge on the other side of a vertex from an edge on the same face 
-  if (v == f->vertex[0]) {
-    if (e == f->edge[0]) return f->edge[2];
-    else if (e == f->edge[2]) return f->edge[0];
+  if (v == VertexOnFace(f, 0)) {
+    if (e == EdgeOnFace(f, 0)) return EdgeOnFace(f, 2);
+    else if (e == EdgeOnFace(f, 2)) return EdgeOnFace(f, 0);
   }
-  else if (v == f->vertex[1]) {
-    if (e == f->edge[1]) return f->edge[0];
-    else if (e == f->edge[0]) return f->edge[1];
+  else if (v == VertexOnFace(f, 1)) {
+    if (e == EdgeOnFace(f, 1)) return EdgeOnFace(f, 0);
+    else if (e == EdgeOnFace(f, 0)) return EdgeOnFace(f, 1);
   }
-  else if (v == f->vertex[2]) {
-    if (e == f->edge[2]) return f->edge[1];
-    else if (e == f->edge[1]) return f->edge[2];
+  else if (v == VertexOnFace(f, 2)) {
+    if (e == EdgeOnFace(f, 2)) return EdgeOnFace(f, 1);
+    else if (e == EdgeOnFace(f, 1)) return EdgeOnFace(f, 2);
   }
   return NULL;
 }
@@ -734,8 +760,8 @@ VertexBetweenEdges(const R3MeshEdge *e1, const R3MeshEdge *e2) const
 {
   // Return vertex shared by edges
   if (e1 == e2) return NULL;
-  if ((e1->vertex[0] == e2->vertex[0]) || (e1->vertex[0] == e2->vertex[1])) return e1->vertex[0];
-  else if ((e1->vertex[1] == e2->vertex[0]) || (e1->vertex[1] == e2->vertex[1])) return e1->vertex[1];
+  if ((VertexOnEdge(e1, 0) == VertexOnEdge(e2, 0)) || (VertexOnEdge(e1, 0) == VertexOnEdge(e2, 1))) return VertexOnEdge(e1, 0);
+  else if ((VertexOnEdge(e1, 1) == VertexOnEdge(e2, 0)) || (VertexOnEdge(e1, 1) == VertexOnEdge(e2, 1))) return VertexOnEdge(e1, 1);
   else return NULL;
 }
 
@@ -746,8 +772,8 @@ FaceBetweenEdges(const R3MeshEdge *e1, const R3MeshEdge *e2) const
 {
   // Return face shared by edges
   if (e1 == e2) return NULL;
-  if ((e1->face[0]) && ((e1->face[0] == e2->face[0]) || (e1->face[0] == e2->face[1]))) return e1->face[0];
-  else if ((e1->face[1]) && ((e1->face[1] == e2->face[0]) || (e1->face[1] == e2->face[1]))) return e1->face[1];
+  if ((FaceOnEdge(e1, 0)) && ((FaceOnEdge(e1, 0) == FaceOnEdge(e2, 0)) || (FaceOnEdge(e1, 0) == FaceOnEdge(e2, 1)))) return FaceOnEdge(e1, 0);
+  else if ((FaceOnEdge(e1, 1)) && ((FaceOnEdge(e1, 1) == FaceOnEdge(e2, 0)) || (FaceOnEdge(e1, 1) == FaceOnEdge(e2, 1)))) return FaceOnEdge(e1, 1);
   else return NULL;
 }
 
@@ -767,15 +793,15 @@ VertexBetweenFaces(const R3MeshFace *f1, const R3MeshFace *f2, RNDirection dir)
   }
   else {
     // Faces do not lie on the same edge, check if they share a vertex
-    if (f1->vertex[0] == f2->vertex[0]) return f1->vertex[0];
-    if (f1->vertex[0] == f2->vertex[1]) return f1->vertex[0];
-    if (f1->vertex[0] == f2->vertex[2]) return f1->vertex[0];
-    if (f1->vertex[1] == f2->vertex[0]) return f1->vertex[1];
-    if (f1->vertex[1] == f2->vertex[1]) return f1->vertex[1];
-    if (f1->vertex[1] == f2->vertex[2]) return f1->vertex[1];
-    if (f1->vertex[2] == f2->vertex[0]) return f1->vertex[2];
-    if (f1->vertex[2] == f2->vertex[1]) return f1->vertex[2];
-    if (f1->vertex[2] == f2->vertex[2]) return f1->vertex[2];
+    if (VertexOnFace(f1, 0) == VertexOnFace(f2, 0)) return VertexOnFace(f1, 0);
+    if (VertexOnFace(f1, 0) == VertexOnFace(f2, 1)) return VertexOnFace(f1, 0);
+    if (VertexOnFace(f1, 0) == VertexOnFace(f2, 2)) return VertexOnFace(f1, 0);
+    if (VertexOnFace(f1, 1) == VertexOnFace(f2, 0)) return VertexOnFace(f1, 1);
+    if (VertexOnFace(f1, 1) == VertexOnFace(f2, 1)) return VertexOnFace(f1, 1);
+    if (VertexOnFace(f1, 1) == VertexOnFace(f2, 2)) return VertexOnFace(f1, 1);
+    if (VertexOnFace(f1, 2) == VertexOnFace(f2, 0)) return VertexOnFace(f1, 2);
+    if (VertexOnFace(f1, 2) == VertexOnFace(f2, 1)) return VertexOnFace(f1, 2);
+    if (VertexOnFace(f1, 2) == VertexOnFace(f2, 2)) return VertexOnFace(f1, 2);
     return NULL;
   }
 }
@@ -786,9 +812,9 @@ R3MeshEdge *R3Mesh::
 EdgeBetweenFaces(const R3MeshFace *f1, const R3MeshFace *f2) const
 {
   if (f1 == f2) return NULL;
-  if (FaceAcrossEdge(f1->edge[0], f1) == f2) return f1->edge[0];
-  if (FaceAcrossEdge(f1->edge[1], f1) == f2) return f1->edge[1];
-  if (FaceAcrossEdge(f1->edge[2], f1) == f2) return f1->edge[2];
+  if (FaceAcrossEdge(EdgeOnFace(f1, 0), f1) == f2) return EdgeOnFace(f1, 0);
+  if (FaceAcrossEdge(EdgeOnFace(f1, 1), f1) == f2) return EdgeOnFace(f1, 1);
+  if (FaceAcrossEdge(EdgeOnFace(f1, 2), f1) == f2) return EdgeOnFace(f1, 2);
   return NULL;
 }
 
@@ -850,15 +876,44 @@ FindConnectedFaces(R3MeshFace *seed, RNArray<R3MeshFace *>& faces)
 void R3Mesh::
 Empty(void)
 {
-  // Delete all faces, edges, vertices
-  while (NFaces() > 0) DeleteFace(Face(0));
-  while (NEdges() > 0) DeleteEdge(Edge(0));
-  while (NVertices() > 0) DeleteVertex(Vertex(0));
+  // Delete all faces, edges, vertices (from the tail, so that no elements are moved)
+  while (NFaces() > 0) DeleteFace(Face(NFaces()-1));
+  while (NEdges() > 0) DeleteEdge(Edge(NEdges()-1));
+  while (NVertices() > 0) DeleteVertex(Vertex(NVertices()-1));
 
-  // Delete the blocks of data
-  if (vertex_block) { delete [] vertex_block; vertex_block = NULL; }
-  if (edge_block) { delete [] edge_block; edge_block = NULL; }
-  if (face_block) { delete [] face_block; face_block = NULL; }
+  // Delete the storage
+  vertex_pool.Empty();
+  edge_pool.Empty();
+  face_pool.Empty();
+  ResizeVertexStorage(0);
+  ResizeEdgeStorage(0);
+  ResizeFaceStorage(0);
+  ResizeVertexEdgeStorage(0);
+}
+
+
+
+void R3Mesh::
+Reserve(int nvertices, int nedges, int nfaces)
+{
+  // Allocate storage for vertices, edges, faces in a few large blocks
+  if (nvertices > 0) {
+    vertices.Resize(NVertices() + nvertices);
+    vertex_pool.Reserve(nvertices);
+    if (NVertices() + nvertices > nallocated_vertices) ResizeVertexStorage(NVertices() + nvertices);
+  }
+  if (nedges > 0) {
+    edges.Resize(NEdges() + nedges);
+    edge_pool.Reserve(nedges);
+    if (NEdges() + nedges > nallocated_edges) ResizeEdgeStorage(NEdges() + nedges);
+    // Each edge is in two vertex ranges, which start with room for 8 edges (typical valence is 6)
+    if (nvertex_edges + 3*nedges > nallocated_vertex_edges) ResizeVertexEdgeStorage(nvertex_edges + 3*nedges);
+  }
+  if (nfaces > 0) {
+    faces.Resize(NFaces() + nfaces);
+    face_pool.Reserve(nfaces);
+    if (NFaces() + nfaces > nallocated_faces) ResizeFaceStorage(NFaces() + nfaces);
+  }
 }
 
 
@@ -951,9 +1006,9 @@ AddRandomNoise(RNScalar factor)
     R3MeshVertex *vertex = Vertex(i);
     RNLength max_distance = factor * VertexAverageEdgeLength(vertex);
     R3Vector random_vector(RNRandomScalar(), RNRandomScalar(), RNRandomScalar());
-    vertex->position += max_distance * random_vector;
+    vertex_positions[vertex->id] += max_distance * random_vector;
     vertex->flags.Remove(R3_MESH_VERTEX_NORMAL_UPTODATE);
-    bbox.Union(vertex->position);
+    bbox.Union(VertexPosition(vertex));
   }
 
   // Mark every edge out of date
@@ -980,9 +1035,9 @@ Inflate(RNScalar factor)
     R3MeshVertex *vertex = Vertex(i);
     RNLength distance = factor * VertexAverageEdgeLength(vertex);
     R3Vector normal_vector = VertexNormal(vertex);
-    vertex->position += distance * normal_vector;
+    vertex_positions[vertex->id] += distance * normal_vector;
     vertex->flags.Remove(R3_MESH_VERTEX_NORMAL_UPTODATE);
-    bbox.Union(vertex->position);
+    bbox.Union(VertexPosition(vertex));
   }
 
   // Mark every edge out of date
@@ -1007,9 +1062,9 @@ Transform(const R3Transformation& transformation)
   bbox = R3null_box;
   for (int i = 0; i < NVertices(); i++) {
     R3MeshVertex *vertex = Vertex(i);
-    vertex->position.Transform(transformation);
+    vertex_positions[vertex->id].Transform(transformation);
     vertex->flags.Remove(R3_MESH_VERTEX_NORMAL_UPTODATE);
-    bbox.Union(vertex->position);
+    bbox.Union(VertexPosition(vertex));
   }
 
   // Mark every edge out of date
@@ -1037,16 +1092,30 @@ CreateVertex(const R3Point& position, R3MeshVertex *v)
 {
   // Create vertex
   if (!v) {
-    v = new R3MeshVertex();
+    v = vertex_pool.Allocate();
     v->flags.Add(R3_MESH_VERTEX_ALLOCATED);
   }
 
-  // Set position of new vertex
-  SetVertexPosition(v, position);
+  // Copy position (it could be stored in the array that is resized below)
+  R3Point vertex_position(position);
+
+  // Make room for new vertex in vertex arrays
+  if (vertices.NEntries() >= nallocated_vertices) {
+    ResizeVertexStorage((nallocated_vertices > 0) ? 2 * nallocated_vertices : 16);
+  }
 
   // Set ID of new vertex
   v->id = vertices.NEntries();
 
+  // Initialize array entries of new vertex
+  vertex_normals[v->id] = R3zero_vector;
+  vertex_edge_ranges[v->id].start = 0;
+  vertex_edge_ranges[v->id].count = 0;
+  vertex_edge_ranges[v->id].capacity = 0;
+
+  // Set position of new vertex
+  SetVertexPosition(v, vertex_position);
+
   // Insert vertex into array
   vertices.Insert(v);
 
@@ -1059,21 +1128,14 @@ CreateVertex(const R3Point& position, R3MeshVertex *v)
 R3MeshVertex *R3Mesh::
 CreateVertex(const R3Point& position, const R3Vector& normal, R3MeshVertex *v)
 {
-  // Create vertex
-  if (!v) {
-    v = new R3MeshVertex();
-    v->flags.Add(R3_MESH_VERTEX_ALLOCATED);
-  }
-
-  // Set position/normal of new vertex
-  SetVertexPosition(v, position);
-  SetVertexNormal(v, normal);
+  // Copy normal (it could be stored in a vertex array that is resized)
+  R3Vector vertex_normal(normal);
 
-  // Set ID of new vertex
-  v->id = vertices.NEntries();
+  // Create vertex
+  v = CreateVertex(position, v);
 
-  // Insert vertex into array
-  vertices.Insert(v);
+  // Set normal of new vertex
+  SetVertexNormal(v, vertex_normal);
 
   // Return vertex
   return v;
@@ -1085,22 +1147,11 @@ R3MeshVertex *R3Mesh::
 CreateVertex(const R3Point& position, const R3Vector& normal, const RNRgb& color, R3MeshVertex *v)
 {
   // Create vertex
-  if (!v) {
-    v = new R3MeshVertex();
-    v->flags.Add(R3_MESH_VERTEX_ALLOCATED);
-  }
+  v = CreateVertex(position, normal, v);
 
-  // Set position/normal of new vertex
-  SetVertexPosition(v, position);
-  SetVertexNormal(v, normal);
+  // Set color of new vertex
   SetVertexColor(v, color);
 
-  // Set ID of new vertex
-  v->id = vertices.NEntries();
-
-  // Insert vertex into array
-  vertices.Insert(v);
-
   // Return vertex
   return v;
 }
@@ -1111,23 +1162,12 @@ R3MeshVertex *R3Mesh::
 CreateVertex(const R3Point& position, const R3Vector& normal, const RNRgb& color, const R2Point& texcoords, R3MeshVertex *v)
 {
   // Create vertex
-  if (!v) {
-    v = new R3MeshVertex();
-    v->flags.Add(R3_MESH_VERTEX_ALLOCATED);
-  }
+  v = CreateVertex(position, normal, v);
 
-  // Set position/normal of new vertex
-  SetVertexPosition(v, position);
-  SetVertexNormal(v, normal);
+  // Set color/texcoords of new vertex
   SetVertexColor(v, color);
   SetVertexTextureCoords(v, texcoords);
 
-  // Set ID of new vertex
-  v->id = vertices.NEntries();
-
-  // Insert vertex into array
-  vertices.Insert(v);
-
   // Return vertex
   return v;
 }
@@ -1139,20 +1179,27 @@ CreateEdge(R3MeshVertex *v1, R3MeshVertex *v2, R3MeshEdge *e)
 {
   // Create edge
   if (!e) {
-    e = new R3MeshEdge();
+    e = edge_pool.Allocate();
     e->flags.Add(R3_MESH_EDGE_ALLOCATED);
   }
 
-  // Update edge-vertex relations
-  e->vertex[0] = v1;
-  e->vertex[1] = v2;
+  // Make room for new edge in half-edge arrays
+  if (edges.NEntries() >= nallocated_edges) {
+    ResizeEdgeStorage((nallocated_edges > 0) ? 2 * nallocated_edges : 16);
+  }
 
   // Set ID of new edge
   e->id = edges.NEntries();
 
+  // Update edge-vertex relations
+  halfedge_vertices[2*e->id+0] = v1->id;
+  halfedge_vertices[2*e->id+1] = v2->id;
+  halfedge_faces[2*e->id+0] = -1;
+  halfedge_faces[2*e->id+1] = -1;
+
   // Insert edge into vertex lists
-  v1->edges.Insert(e);
-  v2->edges.Insert(e);
+  InsertVertexEdge(v1, e);
+  InsertVertexEdge(v2, e);
 
   // Insert edge into array
   edges.Insert(e);
@@ -1201,25 +1248,30 @@ CreateFace(R3MeshVertex *v1, R3MeshVertex *v2, R3MeshVertex *v3,
            R3MeshEdge *e1, R3MeshEdge *e2, R3MeshEdge *e3, R3MeshFace *f)
 {
   // Check if two faces share same side of same edge
-  if ((e1->vertex[0] == v1) && e1->face[0]) return NULL;
-  if ((e1->vertex[0] == v2) && e1->face[1]) return NULL;
-  if ((e2->vertex[0] == v2) && e2->face[0]) return NULL;
-  if ((e2->vertex[0] == v3) && e2->face[1]) return NULL;
-  if ((e3->vertex[0] == v3) && e3->face[0]) return NULL;
-  if ((e3->vertex[0] == v1) && e3->face[1]) return NULL;
+  if ((VertexOnEdge(e1, 0) == v1) && FaceOnEdge(e1, 0)) return NULL;
+  if ((VertexOnEdge(e1, 0) == v2) && FaceOnEdge(e1, 1)) return NULL;
+  if ((VertexOnEdge(e2, 0) == v2) && FaceOnEdge(e2, 0)) return NULL;
+  if ((VertexOnEdge(e2, 0) == v3) && FaceOnEdge(e2, 1)) return NULL;
+  if ((VertexOnEdge(e3, 0) == v3) && FaceOnEdge(e3, 0)) return NULL;
+  if ((VertexOnEdge(e3, 0) == v1) && FaceOnEdge(e3, 1)) return NULL;
 
   // Create face
   if (!f) {
-    f = new R3MeshFace();
+    f = face_pool.Allocate();
     f->flags.Add(R3_MESH_FACE_ALLOCATED);
   }
 
-  // Update face pointers
-  UpdateFaceRefs(f, v1, v2, v3, e1, e2, e3);
+  // Make room for new face in face arrays
+  if (faces.NEntries() >= nallocated_faces) {
+    ResizeFaceStorage((nallocated_faces > 0) ? 2 * nallocated_faces : 16);
+  }
 
   // Set face ID
   f->id = faces.NEntries();
 
+  // Update face pointers
+  UpdateFaceRefs(f, v1, v2, v3, e1, e2, e3);
+
   // Insert face into array
   faces.Insert(f);
 
@@ -1242,11 +1294,36 @@ DeallocateVertex(R3MeshVertex *v)
   tail->id = index;
   vertices.RemoveTail();
 
+  // Abandon range of edges attached to vertex
+  nunused_vertex_edges += vertex_edge_ranges[index].capacity;
+
+  // Move array entries of last vertex
+  if (tail != v) {
+    int tail_index = vertices.NEntries();
+    vertex_positions[index] = vertex_positions[tail_index];
+    vertex_normals[index] = vertex_normals[tail_index];
+    vertex_edge_ranges[index] = vertex_edge_ranges[tail_index];
+
+    // Update references to last vertex in edge and face arrays
+    const R3MeshVertexEdgeRange& range = vertex_edge_ranges[index];
+    for (int i = 0; i < range.count; i++) {
+      int edge_id = vertex_edges[range.start + i];
+      for (int j = 0; j < 2; j++) {
+        if (halfedge_vertices[2*edge_id+j] == tail_index) halfedge_vertices[2*edge_id+j] = index;
+        int face_id = halfedge_faces[2*edge_id+j];
+        if ((face_id < 0) || (face_id >= faces.NEntries())) continue;
+        for (int k = 0; k < 3; k++) {
+          if (face_vertices[3*face_id+k] == tail_index) face_vertices[3*face_id+k] = index;
+        }
+      }
+    }
+  }
+
   // Reset ID to ease debugging
   v->id = -1;
 
   // Deallocate vertex
-  if (v->flags[R3_MESH_VERTEX_ALLOCATED]) delete v;
+  if (v->flags[R3_MESH_VERTEX_ALLOCATED]) vertex_pool.Deallocate(v);
 }
 
 
@@ -1264,11 +1341,33 @@ DeallocateEdge(R3MeshEdge *e)
   tail->id = index;
   edges.RemoveTail();
 
+  // Move half-edges of last edge
+  if (tail != e) {
+    int tail_index = edges.NEntries();
+    for (int j = 0; j < 2; j++) {
+      halfedge_vertices[2*index+j] = halfedge_vertices[2*tail_index+j];
+      halfedge_faces[2*index+j] = halfedge_faces[2*tail_index+j];
+    }
+
+    // Update references to last edge in vertex and face arrays
+    for (int j = 0; j < 2; j++) {
+      const R3MeshVertexEdgeRange& range = vertex_edge_ranges[halfedge_vertices[2*index+j]];
+      for (int k = 0; k < range.count; k++) {
+        if (vertex_edges[range.start + k] == tail_index) vertex_edges[range.start + k] = index;
+      }
+      int face_id = halfedge_faces[2*index+j];
+      if ((face_id < 0) || (face_id >= faces.NEntries())) continue;
+      for (int k = 0; k < 3; k++) {
+        if (face_edges[3*face_id+k] == tail_index) face_edges[3*face_id+k] = index;
+      }
+    }
+  }
+
   // Reset ID to ease debugging
   e->id = -1;
 
   // Deallocate edge
-  if (e->flags[R3_MESH_EDGE_ALLOCATED]) delete e;
+  if (e->flags[R3_MESH_EDGE_ALLOCATED]) edge_pool.Deallocate(e);
 }
 
 
@@ -1286,11 +1385,29 @@ DeallocateFace(R3MeshFace *f)
   tail->id = index;
   faces.RemoveTail();
 
+  // Move array entries of last face
+  if (tail != f) {
+    int tail_index = faces.NEntries();
+    for (int k = 0; k < 3; k++) {
+      face_vertices[3*index+k] = face_vertices[3*tail_index+k];
+      face_edges[3*index+k] = face_edges[3*tail_index+k];
+    }
+
+    // Update references to last face in half-edge array
+    for (int k = 0; k < 3; k++) {
+      int edge_id = face_edges[3*index+k];
+      if ((edge_id < 0) || (edge_id >= edges.NEntries())) continue;
+      for (int j = 0; j < 2; j++) {
+        if (halfedge_faces[2*edge_id+j] == tail_index) halfedge_faces[2*edge_id+j] = index;
+      }
+    }
+  }
+
   // Reset ID to ease debugging
   f->id = -1;
 
   // Deallocate face
-  if (f->flags[R3_MESH_FACE_ALLOCATED]) delete f;
+  if (f->flags[R3_MESH_FACE_ALLOCATED]) face_pool.Deallocate(f);
 }
 
 
@@ -1299,9 +1416,10 @@ void R3Mesh::
 DeleteVertex(R3MeshVertex *v)
 {
   // Delete edges attached to vertex
-  RNArray<R3MeshEdge *> vertex_edges = v->edges;
-  for (int i = 0; i < vertex_edges.NEntries(); i++) 
-    DeleteEdge(vertex_edges.Kth(i));
+  RNArray<R3MeshEdge *> attached_edges;
+  for (int i = 0; i < VertexValence(v); i++) attached_edges.Insert(EdgeOnVertex(v, i));
+  for (int i = 0; i < attached_edges.NEntries(); i++) 
+    DeleteEdge(attached_edges.Kth(i));
 
   // Deallocate vertex
   DeallocateVertex(v);
@@ -1313,12 +1431,12 @@ void R3Mesh::
 DeleteEdge(R3MeshEdge *e)
 {
   // Delete faces attached to edge
-  if (e->face[0]) DeleteFace(e->face[0]);
-  if (e->face[1]) DeleteFace(e->face[1]);
+  if (FaceOnEdge(e, 0)) DeleteFace(FaceOnEdge(e, 0));
+  if (FaceOnEdge(e, 1)) DeleteFace(FaceOnEdge(e, 1));
 
   // Remove edge from vertex arrays
-  e->vertex[0]->edges.Remove(e);
-  e->vertex[1]->edges.Remove(e);
+  RemoveVertexEdge(VertexOnEdge(e, 0), e);
+  RemoveVertexEdge(VertexOnEdge(e, 1), e);
 
   // Deallocate edge
   DeallocateEdge(e);
@@ -1330,12 +1448,11 @@ void R3Mesh::
 DeleteFace(R3MeshFace *f)
 {
   // Update edge-face relations
-  if (f->edge[0]->face[0] == f) f->edge[0]->face[0] = NULL;
-  if (f->edge[0]->face[1] == f) f->edge[0]->face[1] = NULL;
-  if (f->edge[1]->face[0] == f) f->edge[1]->face[0] = NULL;
-  if (f->edge[1]->face[1] == f) f->edge[1]->face[1] = NULL;
-  if (f->edge[2]->face[0] == f) f->edge[2]->face[0] = NULL;
-  if (f->edge[2]->face[1] == f) f->edge[2]->face[1] = NULL;
+  for (int k = 0; k < 3; k++) {
+    int edge_id = face_edges[3*f->id+k];
+    if (halfedge_faces[2*edge_id+0] == f->id) halfedge_faces[2*edge_id+0] = -1;
+    if (halfedge_faces[2*edge_id+1] == f->id) halfedge_faces[2*edge_id+1] = -1;
+  }
 
   // Deallocate face
   DeallocateFace(f);
@@ -1524,46 +1641,248 @@ MergeVertex(R3MeshVertex *v1, R3MeshVertex *v2)
 
 
 
+struct R3MeshWeldEntry {
+  unsigned long long cell;
+  const R3Point *position;
+  int index;
+};
+
+
+
+static bool
+R3CompareMeshWeldEntries(const R3MeshWeldEntry& entry1, const R3MeshWeldEntry& entry2)
+{
+  // Sort by cell, then by position (so that coincident vertices are adjacent), then by index
+  if (entry1.cell != entry2.cell) return entry1.cell < entry2.cell;
+  for (int dim = 0; dim < 3; dim++) {
+    RNCoord c1 = (*entry1.position)[dim];
+    RNCoord c2 = (*entry2.position)[dim];
+    if (c1 != c2) return c1 < c2;
+  }
+  return entry1.index < entry2.index;
+}
+
+
+
+static int
+R3FindMeshWeldRoot(std::atomic<int> *parents, int index)
+{
+  // Find root of set (with path halving, parents always have smaller indices)
+  while (TRUE) {
+    int parent = parents[index].load();
+    if (parent == index) return index;
+    int grandparent = parents[parent].load();
+    if (grandparent != parent) parents[index].compare_exchange_weak(parent, grandparent);
+    index = parent;
+  }
+}
+
+
+
+static void
+R3UnionMeshWeldSets(std::atomic<int> *parents, int index1, int index2)
+{
+  // Link root with larger index to root with smaller index (so roots are set minimums)
+  while (TRUE) {
+    int root1 = R3FindMeshWeldRoot(parents, index1);
+    int root2 = R3FindMeshWeldRoot(parents, index2);
+    if (root1 == root2) return;
+    if (root1 < root2) { int swap = root1; root1 = root2; root2 = swap; }
+    if (parents[root1].compare_exchange_strong(root1, root2)) return;
+  }
+}
+
+
+
 void R3Mesh::
 MergeCoincidentVertices(RNLength epsilon)
 {
+  // Check vertices
+  int nvertices = NVertices();
+  if (nvertices < 2) return;
+
+  // Compute bounding box of vertices
+  R3Box box = R3null_box;
+  for (int i = 0; i < nvertices; i++) box.Union(VertexPosition(vertices[i]));
+
   // Compute epsilon
-  if (epsilon < 0.0) epsilon = 0.0001 * bbox.DiagonalLength();
+  if (epsilon < 0.0) epsilon = 0.0001 * box.DiagonalLength();
+
+  // Compute cell size (at least epsilon, so coincident vertices are in same or neighbor cells)
+  const int max_cells = (1 << 20);
+  RNLength cell_size = epsilon;
+  if (cell_size < box.LongestAxisLength() / max_cells) cell_size = box.LongestAxisLength() / max_cells;
+  if (cell_size <= 0) cell_size = 1;
+
+  // Sort vertices by cell and position
+  R3MeshWeldEntry *entries = new R3MeshWeldEntry [ nvertices ];
+  RNParallelFor(0, nvertices, [&](int i, int) {
+    const R3Point& p = VertexPosition(vertices[i]);
+    unsigned long long ix = (unsigned long long) ((p.X() - box.XMin()) / cell_size);
+    unsigned long long iy = (unsigned long long) ((p.Y() - box.YMin()) / cell_size);
+    unsigned long long iz = (unsigned long long) ((p.Z() - box.ZMin()) / cell_size);
+    entries[i].cell = (ix << 42) | (iy << 21) | iz;
+    entries[i].position = &p;
+    entries[i].index = i;
+  }, 4096);
+  std::sort(entries, entries + nvertices, R3CompareMeshWeldEntries);
+
+  // Find start of every occupied cell
+  RNArray<R3MeshWeldEntry *> cells;
+  for (int i = 0; i < nvertices; i++) {
+    if ((i == 0) || (entries[i].cell != entries[i-1].cell)) cells.Insert(&entries[i]);
+  }
+  cells.Insert(&entries[nvertices]);
+
+  // Initialize disjoint sets
+  std::atomic<int> *parents = new std::atomic<int> [ nvertices ];
+  for (int i = 0; i < nvertices; i++) parents[i].store(i);
+
+  // Merge sets of vertices within epsilon in same or neighbor cells
+  RNLength squared_epsilon = epsilon * epsilon;
+  RNParallelFor(0, cells.NEntries()-1, [&](int c, int) {
+    R3MeshWeldEntry *cell_start = cells[c];
+    R3MeshWeldEntry *cell_end = cells[c+1];
+    unsigned long long cell = cell_start->cell;
+
+    // Merge vertices at identical positions (they are adjacent after sorting)
+    for (R3MeshWeldEntry *entry = cell_start + 1; entry < cell_end; entry++) {
+      if (*(entry->position) == *((entry-1)->position)) {
+        R3UnionMeshWeldSets(parents, (entry-1)->index, entry->index);
+      }
+    }
 
-  // Load all vertices into a regular grid
-  const int NUM_GRID_CELLS = 32;
-  RNArray<R3MeshVertex *> grid[NUM_GRID_CELLS][NUM_GRID_CELLS][NUM_GRID_CELLS];
-  for (int i = 0; i < vertices.NEntries(); i++) {
-    R3MeshVertex *v = vertices[i];
-    const R3Point& p = v->position;
-    int ix = (int) (NUM_GRID_CELLS * (p.X() - bbox.XMin()) / bbox.XLength());
-    int iy = (int) (NUM_GRID_CELLS * (p.Y() - bbox.YMin()) / bbox.YLength());
-    int iz = (int) (NUM_GRID_CELLS * (p.Z() - bbox.ZMin()) / bbox.ZLength());
-    if (ix < 0) ix = 0; else if (ix > NUM_GRID_CELLS-1) ix = NUM_GRID_CELLS-1;
-    if (iy < 0) iy = 0; else if (iy > NUM_GRID_CELLS-1) iy = NUM_GRID_CELLS-1;
-    if (iz < 0) iz = 0; else if (iz > NUM_GRID_CELLS-1) iz = NUM_GRID_CELLS-1;
-    grid[ix][iy][iz].Insert(v);
-  }
-
-  // Merge coincident vertices in same grid cell
-  for (int ix = 0; ix < NUM_GRID_CELLS; ix++) {
-    for (int iy = 0; iy < NUM_GRID_CELLS; iy++) {
-      for (int iz = 0; iz < NUM_GRID_CELLS; iz++) {
-        // Consider all pairs of vertices in same cell
-        for (int j = 0; j < grid[ix][iy][iz].NEntries(); j++) {
-          R3MeshVertex *v1 = grid[ix][iy][iz].Kth(j);
-          for (int k = j+1; k < grid[ix][iy][iz].NEntries(); k++) {
-            R3MeshVertex *v2 = grid[ix][iy][iz].Kth(k);
-            // Check if vertices are coincident
-            if (R3Contains(v1->position, v2->position)) {
-              // Merge coincident vertices
-              MergeVertex(v1, v2);
+    // Visit this cell and neighbor cells with larger keys (so every pair of cells is visited once)
+    for (int dx = -1; dx <= 1; dx++) {
+      for (int dy = -1; dy <= 1; dy++) {
+        for (int dz = -1; dz <= 1; dz++) {
+          // Compute neighbor cell key
+          unsigned long long ix = (cell >> 42) + dx;
+          unsigned long long iy = ((cell >> 21) & (max_cells*2-1)) + dy;
+          unsigned long long iz = (cell & (max_cells*2-1)) + dz;
+          if ((ix >= (unsigned long long) max_cells*2) || (iy >= (unsigned long long) max_cells*2) || (iz >= (unsigned long long) max_cells*2)) continue;
+          unsigned long long neighbor_cell = (ix << 42) | (iy << 21) | iz;
+          if (neighbor_cell < cell) continue;
+
+          // Find neighbor cell
+          int lo = c, hi = cells.NEntries()-1;
+          while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            if (cells[mid]->cell < neighbor_cell) lo = mid + 1;
+            else hi = mid;
+          }
+          if ((lo == cells.NEntries()-1) || (cells[lo]->cell != neighbor_cell)) continue;
+          R3MeshWeldEntry *neighbor_start = cells[lo];
+          R3MeshWeldEntry *neighbor_end = cells[lo+1];
+
+          // Compare vertices at distinct positions
+          for (R3MeshWeldEntry *entry1 = cell_start; entry1 < cell_end; entry1++) {
+            if ((entry1 > cell_start) && (*(entry1->position) == *((entry1-1)->position))) continue;
+            R3MeshWeldEntry *start = (neighbor_cell == cell) ? entry1 + 1 : neighbor_start;
+            for (R3MeshWeldEntry *entry2 = start; entry2 < neighbor_end; entry2++) {
+              if ((entry2 > neighbor_start) && (*(entry2->position) == *((entry2-1)->position))) continue;
+              if (R3SquaredDistance(*(entry1->position), *(entry2->position)) > squared_epsilon) continue;
+              R3UnionMeshWeldSets(parents, entry1->index, entry2->index);
             }
           }
         }
       }
     }
+  });
+
+  // Find representative of every vertex (the one with smallest index in its set)
+  R3MeshVertex **representatives = new R3MeshVertex * [ nvertices ];
+  RNBoolean merged = FALSE;
+  for (int i = 0; i < nvertices; i++) {
+    int root = R3FindMeshWeldRoot(parents, i);
+    representatives[i] = vertices[root];
+    if (root != i) merged = TRUE;
+  }
+
+  // Delete temporary data
+  delete [] parents;
+  delete [] entries;
+
+  // Check if any vertices were merged
+  if (!merged) {
+    delete [] representatives;
+    return;
+  }
+
+  // Remember original vertices of faces and remove all edges
+  int nfaces = NFaces();
+  R3MeshVertex **original_face_vertices = new R3MeshVertex * [ 3 * nfaces ];
+  for (int i = 0; i < nfaces; i++) {
+    R3MeshFace *f = faces[i];
+    for (int k = 0; k < 3; k++) {
+      original_face_vertices[3*i+k] = VertexOnFace(f, k);
+      face_edges[3*i+k] = -1;
+    }
+  }
+  while (NEdges() > 0) DeallocateEdge(edges.Tail());
+  for (int i = 0; i < nvertices; i++) vertex_edge_ranges[i].count = 0;
+
+  // Reconnect faces to representative vertices
+  RNArray<R3MeshFace *> degenerate_faces;
+  for (int i = 0; i < nfaces; i++) {
+    R3MeshFace *f = faces[i];
+    R3MeshVertex *v[3];
+    for (int k = 0; k < 3; k++) v[k] = representatives[original_face_vertices[3*i+k]->id];
+
+    // Check for collapsed face
+    if ((v[0] == v[1]) || (v[1] == v[2]) || (v[2] == v[0])) {
+      degenerate_faces.Insert(f);
+      continue;
+    }
+
+    // Try both orientations, then fall back to copies of vertices (e.g., three faces sharing an edge)
+    for (int attempt = 0; attempt < 3; attempt++) {
+      if (attempt == 1) { R3MeshVertex *swap = v[1]; v[1] = v[2]; v[2] = swap; }
+      else if (attempt == 2) {
+        for (int k = 0; k < 3; k++) {
+          v[k] = CreateVertex(VertexPosition(v[k]), vertex_normals[v[k]->id], VertexColor(v[k]), VertexTextureCoords(v[k]));
+        }
+      }
+
+      // Get/create edges
+      R3MeshEdge *e[3];
+      for (int k = 0; k < 3; k++) {
+        e[k] = EdgeBetweenVertices(v[k], v[(k+1)%3]);
+        if (!e[k]) e[k] = CreateEdge(v[k], v[(k+1)%3]);
+      }
+
+      // Check if another face is on same side of any edge
+      RNBoolean shared = FALSE;
+      for (int k = 0; k < 3; k++) {
+        if (FaceOnEdge(e[k], (VertexOnEdge(e[k], 0) == v[k]) ? 0 : 1)) shared = TRUE;
+      }
+      if (shared) continue;
+
+      // Connect face
+      UpdateFaceRefs(f, v[0], v[1], v[2], e[0], e[1], e[2]);
+      break;
+    }
+  }
+
+  // Delete collapsed faces, and edges left over from failed attempts
+  for (int i = 0; i < degenerate_faces.NEntries(); i++) {
+    DeallocateFace(degenerate_faces.Kth(i));
+  }
+  DeleteUnusedEdges();
+
+  // Delete merged vertices
+  RNArray<R3MeshVertex *> merged_vertices;
+  for (int i = 0; i < nvertices; i++) {
+    R3MeshVertex *vertex = vertices[i];
+    if (representatives[i] != vertex) merged_vertices.Insert(vertex);
+  }
+  for (int i = 0; i < merged_vertices.NEntries(); i++) {
+    DeleteVertex(merged_vertices.Kth(i));
   }
+
+  // Delete temporary data
+  delete [] original_face_vertices;
+  delete [] representatives;
 }
 
 
@@ -1573,13 +1892,13 @@ CollapseEdge(R3MeshEdge *edge, const R3Point& point)
 {
   // Get vertices on edge
   R3MeshVertex *v[2];
-  v[0] = edge->vertex[0];
-  v[1] = edge->vertex[1];
+  v[0] = VertexOnEdge(edge, 0);
+  v[1] = VertexOnEdge(edge, 1);
 
   // Get faces on edge
   R3MeshFace *f[2];
-  f[0] = edge->face[0];
-  f[1] = edge->face[1];
+  f[0] = FaceOnEdge(edge, 0);
+  f[1] = FaceOnEdge(edge, 1);
 
 #if 1
   // Get other edges and vertex on faces
@@ -1617,28 +1936,28 @@ CollapseEdge(R3MeshEdge *edge, const R3Point& point)
   }
 
   // Update vertex-edge relations
-  v[0]->edges.Remove(edge);
-  for (int i = 0; i < v[1]->edges.NEntries(); i++) {
-    R3MeshEdge *ev1 = v[1]->edges[i];
+  RemoveVertexEdge(v[0], edge);
+  for (int i = 0; i < VertexValence(v[1]); i++) {
+    R3MeshEdge *ev1 = EdgeOnVertex(v[1], i);
     if (ev1 == edge) continue;
     if (ev1 == ef[0][1]) continue;
     if (ev1 == ef[1][1]) continue;
-    v[0]->edges.Insert(ev1);
+    InsertVertexEdge(v[0], ev1);
   }
   if (f[0]) {
     assert(vf[0] && ef[0][1]);
-    vf[0]->edges.Remove(ef[0][1]);
+    RemoveVertexEdge(vf[0], ef[0][1]);
   }
   if (f[1]) {
     assert(vf[1] && ef[1][1]);
-    vf[1]->edges.Remove(ef[1][1]);
+    RemoveVertexEdge(vf[1], ef[1][1]);
   }
 
   // Update edge-vertex relations (v[1]->v[0]) 
-  for (int i = 0; i < v[1]->edges.NEntries(); i++) {
-    R3MeshEdge *ev = v[1]->edges[i];
+  for (int i = 0; i < VertexValence(v[1]); i++) {
+    R3MeshEdge *ev = EdgeOnVertex(v[1], i);
     for (int j = 0; j < 2; j++) {
-      if (ev->vertex[j] == v[1]) ev->vertex[j] = v[0];
+      if (VertexOnEdge(ev, j) == v[1]) halfedge_vertices[2*ev->id+j] = v[0]->id;
     }
   }
   
@@ -1647,18 +1966,18 @@ CollapseEdge(R3MeshEdge *edge, const R3Point& point)
     if (!f[i]) continue;
     assert(ef[i][0]);
     for (int j = 0; j < 2; j++) {
-      if (ef[i][0]->face[j] == f[i]) ef[i][0]->face[j] = ff[i][1];
+      if (FaceOnEdge(ef[i][0], j) == f[i]) halfedge_faces[2*ef[i][0]->id+j] = (ff[i][1]) ? ff[i][1]->id : -1;
     }
   }
 
   // Update face-vertex relations (v[1]->v[0])
-  for (int i = 0; i < v[1]->edges.NEntries(); i++) {
-    R3MeshEdge *ev = v[1]->edges[i];
+  for (int i = 0; i < VertexValence(v[1]); i++) {
+    R3MeshEdge *ev = EdgeOnVertex(v[1], i);
     for (int j = 0; j < 2; j++) {
-      R3MeshFace *fv = ev->face[j];
+      R3MeshFace *fv = FaceOnEdge(ev, j);
       if (fv) {
         for (int k = 0; k < 3; k++) {
-          if (fv->vertex[k] == v[1]) fv->vertex[k] = v[0];
+          if (VertexOnFace(fv, k) == v[1]) face_vertices[3*fv->id+k] = v[0]->id;
         }
       }
     }
@@ -1669,8 +1988,8 @@ CollapseEdge(R3MeshEdge *edge, const R3Point& point)
     if (!f[i]) continue;
     if (!ff[i][1]) continue;
     for (int j = 0; j < 3; j++) {
-      if (ff[i][1]->edge[j] == ef[i][1]) {
-        ff[i][1]->edge[j] = ef[i][0];
+      if (EdgeOnFace(ff[i][1], j) == ef[i][1]) {
+        face_edges[3*ff[i][1]->id+j] = ef[i][0]->id;
       }
     }
   }
@@ -1685,6 +2004,9 @@ CollapseEdge(R3MeshEdge *edge, const R3Point& point)
     SetVertexColor(v[0], d1*VertexColor(v[0]) + d0*VertexColor(v[1])); 
   }
 
+  // Copy point (it could be the position of a vertex moved by deallocation)
+  R3Point position(point);
+
   // Deallocate faces 
   if (f[0]) DeallocateFace(f[0]);
   if (f[1]) DeallocateFace(f[1]);
@@ -1698,7 +2020,7 @@ CollapseEdge(R3MeshEdge *edge, const R3Point& point)
   DeallocateVertex(v[1]);
 
   // Set position of remaining vertex
-  SetVertexPosition(v[0], point);
+  SetVertexPosition(v[0], position);
 
   // Return remaining vertex
   return v[0];
@@ -1712,8 +2034,8 @@ CollapseEdge(R3MeshEdge *edge, const R3Point& point)
   RNArray<R3MeshEdge *> edges_to_remove;
   RNArray<R3MeshVertex *> cw_vertices;
   RNArray<R3MeshVertex *> ccw_vertices;
-  for (int i = 0; i < v[1]->edges.NEntries(); i++) {
-    R3MeshEdge *v1_e = v[1]->edges[i];
+  for (int i = 0; i < VertexValence(v[1]); i++) {
+    R3MeshEdge *v1_e = EdgeOnVertex(v[1], i);
     edges_to_remove.Insert(v1_e);
     R3MeshFace *v1_f = FaceOnEdge(v1_e, v[1], RN_CCW);
     if (v1_f) {
@@ -1782,18 +2104,21 @@ CollapseFace(R3MeshFace *face)
 R3MeshVertex *R3Mesh::
 SplitEdge(R3MeshEdge *edge, const R3Point& point, R3MeshEdge **e0, R3MeshEdge **e1)
 {
+  // Copy point (it could be a vertex position, which moves when vertex arrays grow)
+  R3Point position(point);
+
   // Create vertex at split point
   R3MeshVertex *vertex = CreateVertex(R3zero_point);
 
   // Get vertices on edge
   R3MeshVertex *v[2];
-  v[0] = edge->vertex[0];
-  v[1] = edge->vertex[1];
+  v[0] = VertexOnEdge(edge, 0);
+  v[1] = VertexOnEdge(edge, 1);
 
   // Get faces on edge
   R3MeshFace *f[2];
-  f[0] = edge->face[0];
-  f[1] = edge->face[1];
+  f[0] = FaceOnEdge(edge, 0);
+  f[1] = FaceOnEdge(edge, 1);
 
   // Get other edges and vertex on f[0]
   R3MeshEdge *ef[2][2] = { { NULL, NULL }, { NULL, NULL } };
@@ -1866,8 +2191,8 @@ SplitEdge(R3MeshEdge *edge, const R3Point& point, R3MeshEdge **e0, R3MeshEdge **
   }
 
   // Interpolate vertex properties
-  RNScalar d0 = R3Distance(point, VertexPosition(v[0]));
-  RNScalar d1 = R3Distance(point, VertexPosition(v[1]));
+  RNScalar d0 = R3Distance(position, VertexPosition(v[0]));
+  RNScalar d1 = R3Distance(position, VertexPosition(v[1]));
   RNScalar dsum = d0 + d1;
   if (RNIsPositive(dsum)) {
     d0 /= dsum;  d1 /= dsum;
@@ -1876,7 +2201,7 @@ SplitEdge(R3MeshEdge *edge, const R3Point& point, R3MeshEdge **e0, R3MeshEdge **
   }
 
   // Set vertex position (also marks things in need of update)
-  SetVertexPosition(vertex, point);
+  SetVertexPosition(vertex, position);
 
   // Return edges
   if (e0) *e0 = e[0];
@@ -1926,11 +2251,14 @@ SplitFace(R3MeshFace *f, const R3Point& point, R3MeshFace **f0, R3MeshFace **f1,
   int m = FaceMaterial(f);
   int s = FaceSegment(f);
 
+  // Copy point (it could be a vertex position, which moves when vertex arrays grow)
+  R3Point position(point);
+
   // Delete face
   DeleteFace(f);
 
   // Create new vertex at point
-  R3MeshVertex *vertex = CreateVertex(point);
+  R3MeshVertex *vertex = CreateVertex(position);
 
   // Create three new edges
   R3MeshEdge *s0 = CreateEdge(v0, vertex);
@@ -1953,9 +2281,9 @@ SplitFace(R3MeshFace *f, const R3Point& point, R3MeshFace **f0, R3MeshFace **f1,
   SetFaceSegment(t2, s);
 
   // Interpolate vertex properties
-  RNScalar d0 = R3Distance(point, VertexPosition(v0));
-  RNScalar d1 = R3Distance(point, VertexPosition(v1));
-  RNScalar d2 = R3Distance(point, VertexPosition(v2));
+  RNScalar d0 = R3Distance(position, VertexPosition(v0));
+  RNScalar d1 = R3Distance(position, VertexPosition(v1));
+  RNScalar d2 = R3Distance(position, VertexPosition(v2));
   RNScalar dsum = d0 + d1 + d2;
   if (RNIsPositive(dsum)) {
     RNScalar t0 = (d1+d2)/dsum;   RNScalar t1 = (d0+d2)/dsum;  RNScalar t2 = (d0+d1)/dsum;
@@ -2024,13 +2352,13 @@ SwapEdge(R3MeshEdge *edge)
 {
   // Get vertices on edge
   R3MeshVertex *v[2];
-  v[0] = edge->vertex[0];
-  v[1] = edge->vertex[1];
+  v[0] = VertexOnEdge(edge, 0);
+  v[1] = VertexOnEdge(edge, 1);
 
   // Get faces on edge
   R3MeshFace *f[2];
-  f[0] = edge->face[0];
-  f[1] = edge->face[1];
+  f[0] = FaceOnEdge(edge, 0);
+  f[1] = FaceOnEdge(edge, 1);
   if (!f[0] || !f[1]) return 0;
 
   // Get edges and vertices across faces
@@ -2047,14 +2375,14 @@ SwapEdge(R3MeshEdge *edge)
   if (EdgeBetweenVertices(vf[0], vf[1])) return 0;
 
   // Update vertices
-  v[0]->edges.Remove(edge);
-  v[1]->edges.Remove(edge);
-  vf[0]->edges.Insert(edge);
-  vf[1]->edges.Insert(edge);
+  RemoveVertexEdge(v[0], edge);
+  RemoveVertexEdge(v[1], edge);
+  InsertVertexEdge(vf[0], edge);
+  InsertVertexEdge(vf[1], edge);
 
   // Update edge
-  edge->vertex[0] = vf[0];
-  edge->vertex[1] = vf[1];
+  halfedge_vertices[2*edge->id+0] = vf[0]->id;
+  halfedge_vertices[2*edge->id+1] = vf[1]->id;
   edge->length = 0;
   edge->flags = 0;
 
@@ -2076,14 +2404,14 @@ void R3Mesh::
 FlipEdge(R3MeshEdge *e)
 {
   // Reverse order of vertices
-  R3MeshVertex *v = e->vertex[0];
-  e->vertex[0] = e->vertex[1];
-  e->vertex[1] = v;
+  int vswap = halfedge_vertices[2*e->id+0];
+  halfedge_vertices[2*e->id+0] = halfedge_vertices[2*e->id+1];
+  halfedge_vertices[2*e->id+1] = vswap;
 
   // Reverse order of faces
-  R3MeshFace *f = e->face[0];
-  e->face[0] = e->face[1];
-  e->face[1] = f;
+  int fswap = halfedge_faces[2*e->id+0];
+  halfedge_faces[2*e->id+0] = halfedge_faces[2*e->id+1];
+  halfedge_faces[2*e->id+1] = fswap;
 }
 
 
@@ -2095,14 +2423,14 @@ FlipFace(R3MeshFace *f)
   f->plane.Flip();
 
   // Reverse order of vertices
-  R3MeshVertex *vswap = f->vertex[0];
-  f->vertex[0] = f->vertex[2];
-  f->vertex[2] = vswap;
+  int vswap = face_vertices[3*f->id+0];
+  face_vertices[3*f->id+0] = face_vertices[3*f->id+2];
+  face_vertices[3*f->id+2] = vswap;
 
   // Reverse order of edges
-  R3MeshEdge *eswap = f->edge[0];
-  f->edge[0] = f->edge[1];
-  f->edge[1] = eswap;
+  int eswap = face_edges[3*f->id+0];
+  face_edges[3*f->id+0] = face_edges[3*f->id+1];
+  face_edges[3*f->id+1] = eswap;
 }
 
 
@@ -2765,7 +3093,7 @@ DrawVertex(R3MeshVertex *v) const
 {
   // Draw box around vertex 
   RNScalar d = 0.001 * BBox().LongestAxisLength();
-  R3Sphere(v->position, d).Draw();
+  R3Sphere(VertexPosition(v), d).Draw();
 }
 
 
@@ -2775,8 +3103,8 @@ DrawEdge(R3MeshEdge *e) const
 {
   // Draw edge
   R3BeginLine();
-  R3LoadPoint(e->vertex[0]->position);
-  R3LoadPoint(e->vertex[1]->position);
+  R3LoadPoint(VertexPosition(VertexOnEdge(e, 0)));
+  R3LoadPoint(VertexPosition(VertexOnEdge(e, 1)));
   R3EndLine();
 }
 
@@ -2788,9 +3116,9 @@ DrawFace(R3MeshFace *f) const
   // Draw polygon
   R3BeginPolygon();
   R3LoadNormal(FaceNormal(f));
-  R3LoadPoint(f->vertex[0]->position);
-  R3LoadPoint(f->vertex[1]->position);
-  R3LoadPoint(f->vertex[2]->position);
+  R3LoadPoint(VertexPosition(VertexOnFace(f, 0)));
+  R3LoadPoint(VertexPosition(VertexOnFace(f, 1)));
+  R3LoadPoint(VertexPosition(VertexOnFace(f, 2)));
   R3EndPolygon();
 }
 
@@ -2861,9 +3189,9 @@ Intersection(const R3Ray& ray, R3MeshFace *f, R3MeshIntersection *intersection)
     if (R3Contains(FaceBBox(f), p)) {
 #if 1
       // Get convenient variables
-      R3Point& p0 = f->vertex[0]->position;
-      R3Point& p1 = f->vertex[1]->position;
-      R3Point& p2 = f->vertex[2]->position;
+      const R3Point& p0 = VertexPosition(VertexOnFace(f, 0));
+      const R3Point& p1 = VertexPosition(VertexOnFace(f, 1));
+      const R3Point& p2 = VertexPosition(VertexOnFace(f, 2));
 
       // Check side of first edge
       R3Vector e0 = p1 - p0;
@@ -2907,9 +3235,9 @@ Intersection(const R3Ray& ray, R3MeshFace *f, R3MeshIntersection *intersection)
       RNDimension dim = FaceNormal(f).MaxDimension();
       RNDimension dim1 = (dim + 1) % 3;
       RNDimension dim2 = (dim + 2) % 3;
-      R3Point& p0 = f->vertex[0]->position;
-      R3Point& p1 = f->vertex[1]->position;
-      R3Point& p2 = f->vertex[2]->position;
+      const R3Point& p0 = VertexPosition(VertexOnFace(f, 0));
+      const R3Point& p1 = VertexPosition(VertexOnFace(f, 1));
+      const R3Point& p2 = VertexPosition(VertexOnFace(f, 2));
       RNScalar u0 = p[dim1] - p0[dim1];
       RNScalar v0 = p[dim2] - p0[dim2];
       RNScalar u1 = p1[dim1] - p0[dim1];
@@ -2945,8 +3273,8 @@ Intersection(const R3Ray& ray, R3MeshFace *f, R3MeshIntersection *intersection)
             if (intersection) {
               intersection->type = type;
               intersection->point = p;
-              intersection->vertex = f->vertex[0];
-              intersection->edge = f->edge[0];
+              intersection->vertex = VertexOnFace(f, 0);
+              intersection->edge = EdgeOnFace(f, 0);
               intersection->face = f;
               intersection->t = t;
             }
@@ -2956,8 +3284,8 @@ Intersection(const R3Ray& ray, R3MeshFace *f, R3MeshIntersection *intersection)
             if (intersection) {
               intersection->type = type;
               intersection->point = p;
-              intersection->vertex = f->vertex[2];
-              intersection->edge = f->edge[2];
+              intersection->vertex = VertexOnFace(f, 2);
+              intersection->edge = EdgeOnFace(f, 2);
               intersection->face = f;
               intersection->t = t;
             }
@@ -2968,7 +3296,7 @@ Intersection(const R3Ray& ray, R3MeshFace *f, R3MeshIntersection *intersection)
               intersection->type = type;
               intersection->point = p;
               intersection->vertex = NULL;
-              intersection->edge = f->edge[2];
+              intersection->edge = EdgeOnFace(f, 2);
               intersection->face = f;
               intersection->t = t;
             }
@@ -2979,8 +3307,8 @@ Intersection(const R3Ray& ray, R3MeshFace *f, R3MeshIntersection *intersection)
           if (intersection) {
             intersection->type = type;
             intersection->point = p;
-            intersection->vertex = f->vertex[1];
-            intersection->edge = f->edge[1];
+            intersection->vertex = VertexOnFace(f, 1);
+            intersection->edge = EdgeOnFace(f, 1);
             intersection->face = f;
             intersection->t = t;
           }
@@ -2992,7 +3320,7 @@ Intersection(const R3Ray& ray, R3MeshFace *f, R3MeshIntersection *intersection)
               intersection->type = type;
               intersection->point = p;
               intersection->vertex = NULL;
-              intersection->edge = f->edge[0];
+              intersection->edge = EdgeOnFace(f, 0);
               intersection->face = f;
               intersection->t = t;
             }
@@ -3003,7 +3331,7 @@ Intersection(const R3Ray& ray, R3MeshFace *f, R3MeshIntersection *intersection)
               intersection->type = type;
               intersection->point = p;
               intersection->vertex = NULL;
-              intersection->edge = f->edge[1];
+              intersection->edge = EdgeOnFace(f, 1);
               intersection->face = f;
               intersection->t = t;
             }
@@ -3099,8 +3427,8 @@ ClosestPointOnFace(const R3MeshFace *face, const R3Point& point, R3MeshIntersect
     R3MeshEdge *edge = EdgeOnFace(face, i);
     R3MeshVertex *v0 = VertexOnEdge(edge, face, RN_CW);
     R3MeshVertex *v1 = VertexOnEdge(edge, face, RN_CCW);
-    R3Point p0 = v0->position;
-    R3Point p1 = v1->position;
+    R3Point p0 = VertexPosition(v0);
+    R3Point p1 = VertexPosition(v1);
     R3Vector edge_vector = p1 - p0;
     edge_vector.Normalize();
     R3Vector edge_normal = face_normal % edge_vector;
@@ -3526,13 +3854,154 @@ struct DijkstraData {
   double distance_to_destination;
   DijkstraData **heappointer;
   double distance;
+  unsigned int stamp;
+};
+
+
+
+struct DijkstraWorkspace {
+  // Reusable temporary data for one thread (entries are initialized lazily when stamp is old)
+  DijkstraWorkspace(void);
+  ~DijkstraWorkspace(void);
+  void Begin(const R3Mesh *mesh);
+  const R3Mesh *mesh;
+  DijkstraData *vertex_data;
+  int nallocated;
+  unsigned int stamp;
+  RNHeap<DijkstraData *> heap;
 };
 
 
 
-RNScalar DijkstraDataValue(DijkstraData *data, void *)
+DijkstraWorkspace::
+DijkstraWorkspace(void)
+  : mesh(NULL),
+    vertex_data(NULL),
+    nallocated(0),
+    stamp(0),
+    heap((int) offsetof(DijkstraData, distance), (int) offsetof(DijkstraData, heappointer))
+{
+}
+
+
+
+DijkstraWorkspace::
+~DijkstraWorkspace(void)
+{
+  // Delete temporary data
+  if (vertex_data) delete [] vertex_data;
+}
+
+
+
+void DijkstraWorkspace::
+Begin(const R3Mesh *mesh)
 {
-  return data->distance;
+  // Remember mesh
+  this->mesh = mesh;
+
+  // Allocate temporary data (grows, but is never shrunk)
+  if (nallocated < mesh->NVertices()) {
+    if (vertex_data) delete [] vertex_data;
+    nallocated = mesh->NVertices();
+    vertex_data = new DijkstraData [ nallocated ];
+    for (int i = 0; i < nallocated; i++) vertex_data[i].stamp = 0;
+    stamp = 0;
+  }
+
+  // Invalidate all entries by incrementing stamp (reset stamps only on wraparound)
+  if (++stamp == 0) {
+    for (int i = 0; i < nallocated; i++) vertex_data[i].stamp = 0;
+    stamp = 1;
+  }
+
+  // Empty priority queue
+  heap.Empty();
+}
+
+
+
+static inline DijkstraData *
+DijkstraVertexData(const R3Mesh *mesh, DijkstraData *vertex_data, unsigned int stamp, R3MeshVertex *vertex)
+{
+  // Get data for vertex, initializing it on first access in this search
+  // (workspace members are passed by value so that they stay in registers across heap calls)
+  DijkstraData *data = &vertex_data[ mesh->VertexID(vertex) ];
+  if (data->stamp != stamp) {
+    data->stamp = stamp;
+    data->vertex = vertex;
+    data->edge = NULL;
+    data->distance_to_destination = RN_UNKNOWN;
+    data->heappointer = NULL;
+    data->distance = FLT_MAX;
+  }
+  return data;
+}
+
+
+
+static inline RNLength
+DijkstraEdgeLength(const R3Mesh *mesh, const R3Point& position, const R3MeshVertex *neighbor_vertex)
+{
+  // Compute edge length from positions of the visited vertex and its neighbor
+  // (the cached edge length is not used, because updating it is not thread-safe)
+  return R3Distance(position, mesh->VertexPosition(neighbor_vertex));
+}
+
+
+
+static DijkstraWorkspace&
+DijkstraThreadWorkspace(void)
+{
+  // Return workspace for current thread (so that searches are reentrant)
+  static thread_local DijkstraWorkspace workspace;
+  return workspace;
+}
+
+
+
+static void
+DijkstraSearch(const R3Mesh *mesh, DijkstraWorkspace& workspace,
+  const RNArray<R3MeshVertex *>& source_vertices, RNLength max_distance,
+  RNLength *distances, RNArray<R3MeshVertex *> *visited_vertices, R3MeshEdge **edges)
+{
+  // Initialize workspace
+  workspace.Begin(mesh);
+  RNHeap<DijkstraData *>& heap = workspace.heap;
+  DijkstraData *vertex_data = workspace.vertex_data;
+  unsigned int stamp = workspace.stamp;
+
+  // Initialize priority queue
+  for (int i = 0; i < source_vertices.NEntries(); i++) {
+    DijkstraData *data = DijkstraVertexData(mesh, vertex_data, stamp, source_vertices[i]);
+    if (data->distance == 0) continue;
+    data->distance = 0;
+    heap.Push(data);
+  }
+
+  // Visit vertices computing shortest distance to closest source vertex
+  while (!heap.IsEmpty()) {
+    DijkstraData *data = heap.Pop();
+    R3MeshVertex *vertex = data->vertex;
+    if ((max_distance > 0) && (data->distance > max_distance)) break;
+    if (visited_vertices) visited_vertices->Insert(vertex);
+    if (distances) distances[ mesh->VertexID(vertex) ] = data->distance;
+    if (edges) edges[ mesh->VertexID(vertex) ] = data->edge;
+    const R3Point& position = mesh->VertexPosition(vertex);
+    for (int i = 0; i < mesh->VertexValence(vertex); i++) {
+      R3MeshEdge *edge = mesh->EdgeOnVertex(vertex, i);
+      R3MeshVertex *neighbor_vertex = mesh->VertexAcrossEdge(edge, vertex);
+      DijkstraData *neighbor_data = DijkstraVertexData(mesh, vertex_data, stamp, neighbor_vertex);
+      RNScalar old_distance = neighbor_data->distance;
+      RNScalar new_distance = DijkstraEdgeLength(mesh, position, neighbor_vertex) + data->distance;
+      if (new_distance < old_distance) {
+        neighbor_data->edge = edge;
+        neighbor_data->distance = new_distance;
+        if (old_distance < FLT_MAX) heap.Update(neighbor_data);
+        else heap.Push(neighbor_data);
+      }
+    }
+  }
 }
 
 
@@ -3544,26 +4013,15 @@ DijkstraDistance(const R3MeshVertex *source_vertex, const R3MeshVertex *destinat
   RNLength destination_distance = RN_INFINITY;
   R3Point destination_position = VertexPosition(destination_vertex);
 
-  // Allocate temporary data
-  DijkstraData *vertex_data = new DijkstraData [ NVertices() ];
-  if (!vertex_data) {
-    fprintf(stderr, "Unable to allocate temporary data for geodesic distances.\n");
-    return RN_INFINITY;
-  }
-
-  // Initialize all data
-  for (int i = 0; i < NVertices(); i++) {
-    vertex_data[i].vertex = Vertex(i);
-    vertex_data[i].edge = NULL;
-    vertex_data[i].distance_to_destination = RN_UNKNOWN;
-    vertex_data[i].heappointer = NULL;
-    vertex_data[i].distance = FLT_MAX;
-  }
+  // Initialize workspace
+  DijkstraWorkspace& workspace = DijkstraThreadWorkspace();
+  workspace.Begin(this);
+  RNHeap<DijkstraData *>& heap = workspace.heap;
+  DijkstraData *vertex_data = workspace.vertex_data;
+  unsigned int stamp = workspace.stamp;
 
   // Initialize priority queue
-  DijkstraData tmp;
-  static RNHeap<DijkstraData *> heap(&tmp, &(tmp.distance), &(tmp.heappointer));
-  DijkstraData *data = &vertex_data[ VertexID(source_vertex) ];
+  DijkstraData *data = DijkstraVertexData(this, vertex_data, stamp, (R3MeshVertex *) source_vertex);
   data->distance_to_destination = R3Distance(VertexPosition(source_vertex), destination_position);
   data->distance = data->distance_to_destination;
   heap.Push(data);
@@ -3573,16 +4031,17 @@ DijkstraDistance(const R3MeshVertex *source_vertex, const R3MeshVertex *destinat
     DijkstraData *data = heap.Pop();
     R3MeshVertex *vertex = data->vertex;
     if (vertex == destination_vertex) { destination_distance = data->distance; break; }
+    const R3Point& position = VertexPosition(vertex);
     for (int i = 0; i < VertexValence(vertex); i++) {
       R3MeshEdge *edge = EdgeOnVertex(vertex, i);
       R3MeshVertex *neighbor_vertex = VertexAcrossEdge(edge, vertex);
-      DijkstraData *neighbor_data = &vertex_data [ VertexID(neighbor_vertex) ];
+      DijkstraData *neighbor_data = DijkstraVertexData(this, vertex_data, stamp, neighbor_vertex);
       if (neighbor_data->distance_to_destination == RN_UNKNOWN) {
         const R3Point& neighbor_position = VertexPosition(neighbor_vertex);
         neighbor_data->distance_to_destination = R3Distance(neighbor_position, destination_position);
       }
       RNScalar old_distance = neighbor_data->distance;
-      RNScalar new_distance = EdgeLength(edge) + data->distance - data->distance_to_destination + neighbor_data->distance_to_destination;
+      RNScalar new_distance = DijkstraEdgeLength(this, position, neighbor_vertex) + data->distance - data->distance_to_destination + neighbor_data->distance_to_destination;
       if (new_distance < old_distance) {
         neighbor_data->edge = edge;
         neighbor_data->distance = new_distance;
@@ -3596,17 +4055,13 @@ DijkstraDistance(const R3MeshVertex *source_vertex, const R3MeshVertex *destinat
   if (edges) {
     const R3MeshVertex *vertex = destination_vertex;
     while (vertex != source_vertex) {
-      DijkstraData *data = &vertex_data [ VertexID(vertex) ];
+      DijkstraData *data = DijkstraVertexData(this, vertex_data, stamp, (R3MeshVertex *) vertex);
       if (!data->edge) break;
       edges->Insert(data->edge);
       vertex = VertexAcrossEdge(data->edge, vertex);
     }
   }
 
-  // Delete temporary data
-  heap.Empty();
-  delete [] vertex_data;
-
   // Return distance
   return destination_distance;
 }
@@ -3634,59 +4089,11 @@ DijkstraDistances(const RNArray<R3MeshVertex *>& source_vertices, RNLength max_d
     return NULL;
   }
 
-  // Allocate temporary data
-  DijkstraData *vertex_data = new DijkstraData [ NVertices() ];
-  if (!vertex_data) {
-    fprintf(stderr, "Unable to allocate temporary data for geodesic distances.\n");
-    delete [] distances;
-    return NULL;
-  }
+  // Initialize distances
+  for (int i = 0; i < NVertices(); i++) distances[i] = FLT_MAX;
 
-  // Initialize all data
-  for (int i = 0; i < NVertices(); i++) {
-    vertex_data[i].vertex = Vertex(i);
-    vertex_data[i].edge = NULL;
-    vertex_data[i].distance_to_destination = RN_UNKNOWN;
-    vertex_data[i].heappointer = NULL;
-    vertex_data[i].distance = FLT_MAX;
-    distances[i] = FLT_MAX;
-  }
-
-  // Initialize priority queue
-  DijkstraData tmp;
-  static RNHeap<DijkstraData *> heap(&tmp, &(tmp.distance), &(tmp.heappointer));
-  for (int i = 0; i < source_vertices.NEntries(); i++) {
-    R3MeshVertex *source_vertex = source_vertices[i];
-    DijkstraData *data = &vertex_data[ VertexID(source_vertex) ];
-    data->distance = 0;
-    heap.Push(data);
-  }
-
-  // Visit vertices computing shortest distance to closest source vertex
-  while (!heap.IsEmpty()) {
-    DijkstraData *data = heap.Pop();
-    R3MeshVertex *vertex = data->vertex;
-    if ((max_distance > 0) && (data->distance > max_distance)) break;
-    distances[ VertexID(vertex) ] = data->distance;
-    if (edges) edges[ VertexID(vertex) ] = data->edge;
-    for (int i = 0; i < VertexValence(vertex); i++) {
-      R3MeshEdge *edge = EdgeOnVertex(vertex, i);
-      R3MeshVertex *neighbor_vertex = VertexAcrossEdge(edge, vertex);
-      DijkstraData *neighbor_data = &vertex_data [ VertexID(neighbor_vertex) ];
-      RNScalar old_distance = neighbor_data->distance;
-      RNScalar new_distance = EdgeLength(edge) + data->distance;
-      if (new_distance < old_distance) {
-        neighbor_data->edge = edge;
-        neighbor_data->distance = new_distance;
-        if (old_distance < FLT_MAX) heap.Update(neighbor_data);
-        else heap.Push(neighbor_data);
-      }
-    }
-  }
-
-  // Delete temporary data
-  heap.Empty();
-  delete [] vertex_data;
+  // Compute distances to closest source vertex
+  DijkstraSearch(this, DijkstraThreadWorkspace(), source_vertices, max_distance, distances, NULL, edges);
 
   // Return distances
   return distances;
@@ -3718,71 +4125,59 @@ DijkstraDistances(const RNArray<R3MeshVertex *>& source_vertices, RNLength max_d
     return NULL;
   }
 
-  // Allocate temporary data
-  DijkstraData *vertex_data = new DijkstraData [ NVertices() ];
-  if (!vertex_data) {
-    fprintf(stderr, "Unable to allocate temporary data for geodesic distances.\n");
-    delete [] distances;
-    return NULL;
+  // Compute distances to closest source vertex (only for vertices within max_distance)
+  DijkstraSearch(this, DijkstraThreadWorkspace(), source_vertices, max_distance, distances, &neighbor_vertices, edges);
+
+  // Return distances
+  return distances;
+}
+
+
+
+RNLength **R3Mesh::
+DijkstraDistanceFields(const RNArray<R3MeshVertex *> *source_vertex_sets, int nsets, RNLength max_distance) const
+{
+  // Allocate array of distance fields (to return)
+  RNLength **fields = new RNLength * [ nsets ];
+  for (int i = 0; i < nsets; i++) {
+    fields[i] = new RNLength [ NVertices() ];
   }
 
-  // Increment mesh mark
-  R3mesh_mark++;
+  // Allocate one workspace per thread
+  DijkstraWorkspace *workspaces = new DijkstraWorkspace [ RNNumThreads() ];
 
-  // Initialize priority queue
-  DijkstraData tmp;
-  static RNHeap<DijkstraData *> heap(&tmp, &(tmp.distance), &(tmp.heappointer));
+  // Compute distance fields in parallel
+  RNParallelFor(0, nsets, [&](int i, int thread) {
+    for (int j = 0; j < NVertices(); j++) fields[i][j] = FLT_MAX;
+    DijkstraSearch(this, workspaces[thread], source_vertex_sets[i], max_distance, fields[i], NULL, NULL);
+  });
+
+  // Delete workspaces
+  delete [] workspaces;
+
+  // Return distance fields
+  return fields;
+}
+
+
+
+RNLength **R3Mesh::
+DijkstraDistanceFields(const RNArray<R3MeshVertex *>& source_vertices, RNLength max_distance) const
+{
+  // Make one set for each source vertex
+  RNArray<R3MeshVertex *> *source_vertex_sets = new RNArray<R3MeshVertex *> [ source_vertices.NEntries() ];
   for (int i = 0; i < source_vertices.NEntries(); i++) {
-    R3MeshVertex *source_vertex = source_vertices[i];
-    source_vertex->mark = R3mesh_mark;
-    DijkstraData *data = &vertex_data[ VertexID(source_vertex) ];
-    data->vertex = source_vertex;
-    data->edge = NULL;
-    data->distance_to_destination = 0;
-    data->heappointer = NULL;
-    data->distance = 0;
-    heap.Push(data);
+    source_vertex_sets[i].Insert(source_vertices.Kth(i));
   }
 
-  // Visit vertices computing shortest distance to closest source vertex
-  while (!heap.IsEmpty()) {
-    DijkstraData *data = heap.Pop();
-    R3MeshVertex *vertex = data->vertex;
-    if ((max_distance > 0) && (data->distance > max_distance)) break;
-    neighbor_vertices.Insert(vertex);
-    distances[ VertexID(vertex) ] = data->distance;
-    if (edges) edges[ VertexID(vertex) ] = data->edge;
-    for (int i = 0; i < VertexValence(vertex); i++) {
-      R3MeshEdge *edge = EdgeOnVertex(vertex, i);
-      R3MeshVertex *neighbor_vertex = VertexAcrossEdge(edge, vertex);
-      DijkstraData *neighbor_data = &vertex_data [ VertexID(neighbor_vertex) ];
-      RNScalar new_distance = EdgeLength(edge) + data->distance;
-      if (VertexMark(neighbor_vertex) != R3mesh_mark) {
-        neighbor_vertex->mark = R3mesh_mark;
-        neighbor_data->vertex = neighbor_vertex;
-        neighbor_data->edge = edge;
-        neighbor_data->distance_to_destination = RN_UNKNOWN;
-        neighbor_data->heappointer = NULL;
-        neighbor_data->distance = new_distance;
-        heap.Push(neighbor_data);
-      }
-      else {
-        RNScalar old_distance = neighbor_data->distance;
-        if (new_distance < old_distance) {
-          neighbor_data->edge = edge;
-          neighbor_data->distance = new_distance;
-          heap.Update(neighbor_data);
-        }
-      }
-    }
-  }
+  // Compute distance field for each source vertex
+  RNLength **fields = DijkstraDistanceFields(source_vertex_sets, source_vertices.NEntries(), max_distance);
 
-  // Delete temporary data
-  heap.Empty();
-  delete [] vertex_data;
+  // Delete sets
+  delete [] source_vertex_sets;
 
-  // Return distances
-  return distances;
+  // Return distance fields
+  return fields;
 }
 
 
@@ -4215,6 +4610,9 @@ ReadOffFile(const char *filename)
           return 0;
         }
       }
+
+      // Allocate storage for vertices, edges, and faces (V - E + F = 2 for closed manifolds)
+      if (nverts > 0) Reserve(nverts, nverts + nfaces, nfaces);
     }
     else if (vertex_count < nverts) {
       // Read vertex coordinates
@@ -4532,11 +4930,8 @@ ReadPlyFile(const char *filename)
 
     // Check element type
     if (equal_strings ("vertex", elem_name)) {
-      // Allocate block of vertices
-      vertex_block = new R3MeshVertex [num_elems];
-
-      // Resize array of vertices
-      vertices.Resize(num_elems);
+      // Allocate storage for vertices
+      Reserve(num_elems, 0, 0);
 
       // set up for getting vertex elements 
       RNBoolean has_normals = 0;
@@ -4563,7 +4958,7 @@ ReadPlyFile(const char *filename)
 
         // Create mesh vertex
         R3Point position(plyvertex.x, plyvertex.y, plyvertex.z);
-        R3MeshVertex *v = CreateVertex(position, &vertex_block[j]);
+        R3MeshVertex *v = CreateVertex(position);
         if (has_normals) {
           R3Vector normal(plyvertex.nx, plyvertex.ny, plyvertex.nz);
           SetVertexNormal(v, normal);
@@ -4575,8 +4970,8 @@ ReadPlyFile(const char *filename)
       }
     }
     else if (equal_strings ("face", elem_name)) {
-      // Resize array of faces
-      faces.Resize(num_elems);
+      // Allocate storage for faces and edges (V - E + F = 2 for closed manifolds)
+      Reserve(0, NVertices() + num_elems, num_elems);
 
       // set up for getting face elements 
       for (j = 0; j < nprops; j++) {
@@ -4979,11 +5374,8 @@ ReadIfsFile(const char *filename)
     return 0;
   }
 
-  // Allocate block of vertices
-  vertex_block = new R3MeshVertex [nverts];
-  
-  // Resize array of vertices
-  vertices.Resize(nverts);
+  // Allocate storage for vertices
+  Reserve(nverts, 0, 0);
 
   // Read vertices
   for (unsigned int i = 0; i < nverts; i++) {
@@ -4994,7 +5386,7 @@ ReadIfsFile(const char *filename)
     }
 
     // Create mesh vertex
-    if (!CreateVertex(R3Point(p[0], p[1], p[2]), &vertex_block[i])) {
+    if (!CreateVertex(R3Point(p[0], p[1], p[2]))) {
       RNFail("Unable to create vertex %d in %s", i, filename);
       return 0;
     }
@@ -5017,11 +5409,8 @@ ReadIfsFile(const char *filename)
     return 0;
   }
 
-  // Allocate block of faces
-  face_block = new R3MeshFace [nfaces];
-
-  // Resize array of faces
-  faces.Resize(nfaces);
+  // Allocate storage for faces and edges (V - E + F = 2 for closed manifolds)
+  Reserve(0, nverts + nfaces, nfaces);
 
   // Allocate array for degenerate triangles
   RNArray<R3MeshVertex *> degenerate_triangle_vertices;
@@ -5043,7 +5432,7 @@ ReadIfsFile(const char *filename)
     if ((v0 == v1) || (v1 == v2) || (v0 == v2)) continue;
 
     // Create mesh face
-    if (!CreateFace(v0, v1, v2, &face_block[i])) {
+    if (!CreateFace(v0, v1, v2)) {
       // Must have been degeneracy (e.g., flips or three faces sharing an edge)
       // Remember for later processing (to preserve vertex indices)
       degenerate_triangle_vertices.Insert(v0);
@@ -5722,8 +6111,8 @@ IsValid(R3MeshVertex *v) const
   for (int j = 0; j < VertexValence(v); j++) {
     R3MeshEdge *e = EdgeOnVertex(v, j);
     assert(IsVertexOnEdge(v, e));
-    assert((!e->face[0]) || IsVertexOnFace(v, e->face[0]));
-    assert((!e->face[1]) || IsVertexOnFace(v, e->face[1]));
+    assert((!FaceOnEdge(e, 0)) || IsVertexOnFace(v, FaceOnEdge(e, 0)));
+    assert((!FaceOnEdge(e, 1)) || IsVertexOnFace(v, FaceOnEdge(e, 1)));
   }
 #endif
 
@@ -5741,20 +6130,24 @@ IsValid(R3MeshEdge *e) const
   assert(IsEdgeOnMesh(e));
 
   // Check vertices
-  assert(e->vertex[0]);
-  assert(e->vertex[1]);
-  assert(e->vertex[0] != e->vertex[1]);
+  assert(VertexOnEdge(e, 0));
+  assert(VertexOnEdge(e, 1));
+  assert(VertexOnEdge(e, 0) != VertexOnEdge(e, 1));
 
   // Check each edge-vertex relation
   for (int j = 0; j < 2; j++) {
-    R3MeshVertex *v = e->vertex[j];
-    assert(v && v->edges.FindEntry(e));
+    R3MeshVertex *v = VertexOnEdge(e, j);
+    RNBoolean found = FALSE;
+    for (int k = 0; k < VertexValence(v); k++) {
+      if (EdgeOnVertex(v, k) == e) found = TRUE;
+    }
+    assert(found);
   }
 
   // Check each edge-face relation
   for (int j = 0; j < 2; j++) {
-    R3MeshFace *f = e->face[j];
-    assert(!f || (f->edge[0] == e) || (f->edge[1] == e) || (f->edge[2] == e));
+    R3MeshFace *f = FaceOnEdge(e, j);
+    assert(!f || (EdgeOnFace(f, 0) == e) || (EdgeOnFace(f, 1) == e) || (EdgeOnFace(f, 2) == e));
   }
 #endif
 
@@ -5772,27 +6165,27 @@ IsValid(R3MeshFace *f) const
   assert(IsFaceOnMesh(f));
 
   // Check vertices
-  assert(f->vertex[0]);
-  assert(f->vertex[1]);
-  assert(f->vertex[1]);
-  assert(f->vertex[0] != f->vertex[1]);
-  assert(f->vertex[1] != f->vertex[2]);
-  assert(f->vertex[0] != f->vertex[2]);
+  assert(VertexOnFace(f, 0));
+  assert(VertexOnFace(f, 1));
+  assert(VertexOnFace(f, 1));
+  assert(VertexOnFace(f, 0) != VertexOnFace(f, 1));
+  assert(VertexOnFace(f, 1) != VertexOnFace(f, 2));
+  assert(VertexOnFace(f, 0) != VertexOnFace(f, 2));
 
   // Check edges
-  assert(f->edge[0]);
-  assert(f->edge[1]);
-  assert(f->edge[1]);
-  assert(f->edge[0] != f->edge[1]);
-  assert(f->edge[1] != f->edge[2]);
-  assert(f->edge[0] != f->edge[2]);
+  assert(EdgeOnFace(f, 0));
+  assert(EdgeOnFace(f, 1));
+  assert(EdgeOnFace(f, 1));
+  assert(EdgeOnFace(f, 0) != EdgeOnFace(f, 1));
+  assert(EdgeOnFace(f, 1) != EdgeOnFace(f, 2));
+  assert(EdgeOnFace(f, 0) != EdgeOnFace(f, 2));
 
   // Check each face-vertex and face-edge relation
   for (int j = 0; j < 3; j++) {
-    R3MeshVertex *v = f->vertex[j];
-    R3MeshEdge *e = f->edge[j];
-    assert(v && ((e->vertex[0] == v) || (e->vertex[1] == v)));
-    assert(e && ((e->face[0] == f) || (e->face[1] == f)));
+    R3MeshVertex *v = VertexOnFace(f, j);
+    R3MeshEdge *e = EdgeOnFace(f, j);
+    assert(v && ((VertexOnEdge(e, 0) == v) || (VertexOnEdge(e, 1) == v)));
+    assert(e && ((FaceOnEdge(e, 0) == f) || (FaceOnEdge(e, 1) == f)));
     assert(v == VertexOnFace(f, e, RN_CW));
     assert(e == EdgeOnFace(f, v, RN_CCW));
   }
@@ -5828,19 +6221,20 @@ void R3Mesh::
 UpdateVertexNormal(R3MeshVertex *v) const
 {
   // Average face normals
-  v->normal = R3zero_vector;
-  for (int i = 0; i < v->edges.NEntries(); i++) {
-    R3MeshEdge *e = v->edges[i];
-    if (e->vertex[0] == v) {
-      if (e->face[0]) 
-        v->normal += FaceNormal(e->face[0]);
+  R3Vector& normal = vertex_normals[v->id];
+  normal = R3zero_vector;
+  for (int i = 0; i < VertexValence(v); i++) {
+    R3MeshEdge *e = EdgeOnVertex(v, i);
+    if (VertexOnEdge(e, 0) == v) {
+      if (FaceOnEdge(e, 0)) 
+        normal += FaceNormal(FaceOnEdge(e, 0));
     }
     else {
-      if (e->face[1]) 
-        v->normal += FaceNormal(e->face[1]);
+      if (FaceOnEdge(e, 1)) 
+        normal += FaceNormal(FaceOnEdge(e, 1));
     }
   }
-  v->normal.Normalize();
+  normal.Normalize();
 
   // Update flags
   v->flags.Add(R3_MESH_VERTEX_NORMAL_UPTODATE);
@@ -5864,7 +6258,8 @@ void R3Mesh::
 UpdateEdgeLength(R3MeshEdge *e) const
 {
   // Reset length
-  e->length = R3Distance(e->vertex[0]->position, e->vertex[1]->position);
+  const int *v = &halfedge_vertices[2*e->id];
+  e->length = R3Distance(vertex_positions[v[0]], vertex_positions[v[1]]);
 
   // Update flags
   e->flags.Add(R3_MESH_EDGE_LENGTH_UPTODATE);
@@ -5876,8 +6271,9 @@ void R3Mesh::
 UpdateFaceArea(R3MeshFace *f) const
 {
   // Compute area of face
-  R3Vector v1 = f->vertex[1]->position - f->vertex[0]->position;
-  R3Vector v2 = f->vertex[2]->position - f->vertex[0]->position;
+  const int *v = &face_vertices[3*f->id];
+  R3Vector v1 = vertex_positions[v[1]] - vertex_positions[v[0]];
+  R3Vector v2 = vertex_positions[v[2]] - vertex_positions[v[0]];
   R3Vector v3 = v1 % v2;
   f->area = 0.5 * v3.Length();
 
@@ -5891,7 +6287,8 @@ void R3Mesh::
 UpdateFacePlane(R3MeshFace *f) const
 {
   // Reset plane 
-  f->plane = R3Plane(f->vertex[0]->position, f->vertex[1]->position, f->vertex[2]->position);
+  const int *v = &face_vertices[3*f->id];
+  f->plane = R3Plane(vertex_positions[v[0]], vertex_positions[v[1]], vertex_positions[v[2]]);
 
   // Update flags
   f->flags.Add(R3_MESH_FACE_PLANE_UPTODATE);
@@ -5903,10 +6300,11 @@ void R3Mesh::
 UpdateFaceBBox(R3MeshFace *f) const
 {
   // Update face bbox
+  const int *v = &face_vertices[3*f->id];
   f->bbox = R3null_box;
-  f->bbox.Union(f->vertex[0]->position);
-  f->bbox.Union(f->vertex[1]->position);
-  f->bbox.Union(f->vertex[2]->position);
+  f->bbox.Union(vertex_positions[v[0]]);
+  f->bbox.Union(vertex_positions[v[1]]);
+  f->bbox.Union(vertex_positions[v[2]]);
 
   // Update flags
   f->flags.Add(R3_MESH_FACE_BBOX_UPTODATE);
@@ -5920,22 +6318,22 @@ UpdateFaceRefs(R3MeshFace *f,
                R3MeshEdge *e1, R3MeshEdge *e2, R3MeshEdge *e3)
 {
   // Update face-vertex relations
-  f->vertex[0] = v1;
-  f->vertex[1] = v2;
-  f->vertex[2] = v3;
+  face_vertices[3*f->id+0] = v1->id;
+  face_vertices[3*f->id+1] = v2->id;
+  face_vertices[3*f->id+2] = v3->id;
 
   // Update face-edge relations
-  f->edge[0] = e1;
-  f->edge[1] = e2;
-  f->edge[2] = e3;
+  face_edges[3*f->id+0] = e1->id;
+  face_edges[3*f->id+1] = e2->id;
+  face_edges[3*f->id+2] = e3->id;
 
   // Update edge-face relations
-  if (e1->vertex[0] == v1) e1->face[0] = f;
-  else { assert(e1->vertex[1] == v1); e1->face[1] = f; }
-  if (e2->vertex[0] == v2) e2->face[0] = f;
-  else { assert(e2->vertex[1] == v2); e2->face[1] = f; }
-  if (e3->vertex[0] == v3) e3->face[0] = f;
-  else { assert(e3->vertex[1] == v3); e3->face[1] = f; }
+  if (VertexOnEdge(e1, 0) == v1) halfedge_faces[2*e1->id+0] = f->id;
+  else { assert(VertexOnEdge(e1, 1) == v1); halfedge_faces[2*e1->id+1] = f->id; }
+  if (VertexOnEdge(e2, 0) == v2) halfedge_faces[2*e2->id+0] = f->id;
+  else { assert(VertexOnEdge(e2, 1) == v2); halfedge_faces[2*e2->id+1] = f->id; }
+  if (VertexOnEdge(e3, 0) == v3) halfedge_faces[2*e3->id+0] = f->id;
+  else { assert(VertexOnEdge(e3, 1) == v3); halfedge_faces[2*e3->id+1] = f->id; }
 
   // Invalidate face properties
   f->flags.Remove(R3_MESH_FACE_AREA_UPTODATE | R3_MESH_FACE_PLANE_UPTODATE | R3_MESH_FACE_BBOX_UPTODATE);
@@ -5948,6 +6346,170 @@ UpdateFaceRefs(R3MeshFace *f,
  
    
 
+////////////////////////////////////////////////////////////////////////
+// INTERNAL STORAGE FUNCTIONS
+////////////////////////////////////////////////////////////////////////
+
+void R3Mesh::
+ResizeVertexStorage(int nallocated)
+{
+  // Allocate arrays indexed by vertex ID
+  R3Point *positions = (nallocated > 0) ? new R3Point [ nallocated ] : NULL;
+  R3Vector *normals = (nallocated > 0) ? new R3Vector [ nallocated ] : NULL;
+  R3MeshVertexEdgeRange *ranges = (nallocated > 0) ? new R3MeshVertexEdgeRange [ nallocated ] : NULL;
+
+  // Copy entries of existing vertices
+  assert(NVertices() <= nallocated);
+  for (int i = 0; i < NVertices(); i++) {
+    positions[i] = vertex_positions[i];
+    normals[i] = vertex_normals[i];
+    ranges[i] = vertex_edge_ranges[i];
+  }
+
+  // Replace arrays
+  if (vertex_positions) delete [] vertex_positions;
+  if (vertex_normals) delete [] vertex_normals;
+  if (vertex_edge_ranges) delete [] vertex_edge_ranges;
+  vertex_positions = positions;
+  vertex_normals = normals;
+  vertex_edge_ranges = ranges;
+  nallocated_vertices = nallocated;
+}
+
+
+
+void R3Mesh::
+ResizeEdgeStorage(int nallocated)
+{
+  // Allocate half-edge arrays
+  int *vertices = (nallocated > 0) ? new int [ 2 * nallocated ] : NULL;
+  int *faces = (nallocated > 0) ? new int [ 2 * nallocated ] : NULL;
+
+  // Copy half-edges of existing edges
+  assert(NEdges() <= nallocated);
+  if (NEdges() > 0) {
+    memcpy(vertices, halfedge_vertices, 2 * NEdges() * sizeof(int));
+    memcpy(faces, halfedge_faces, 2 * NEdges() * sizeof(int));
+  }
+
+  // Replace arrays
+  if (halfedge_vertices) delete [] halfedge_vertices;
+  if (halfedge_faces) delete [] halfedge_faces;
+  halfedge_vertices = vertices;
+  halfedge_faces = faces;
+  nallocated_edges = nallocated;
+}
+
+
+
+void R3Mesh::
+ResizeFaceStorage(int nallocated)
+{
+  // Allocate face arrays
+  int *vertices = (nallocated > 0) ? new int [ 3 * nallocated ] : NULL;
+  int *edges = (nallocated > 0) ? new int [ 3 * nallocated ] : NULL;
+
+  // Copy entries of existing faces
+  assert(NFaces() <= nallocated);
+  if (NFaces() > 0) {
+    memcpy(vertices, face_vertices, 3 * NFaces() * sizeof(int));
+    memcpy(edges, face_edges, 3 * NFaces() * sizeof(int));
+  }
+
+  // Replace arrays
+  if (face_vertices) delete [] face_vertices;
+  if (face_edges) delete [] face_edges;
+  face_vertices = vertices;
+  face_edges = edges;
+  nallocated_faces = nallocated;
+}
+
+
+
+void R3Mesh::
+ResizeVertexEdgeStorage(int nallocated)
+{
+  // Allocate array of edge IDs
+  int *ids = (nallocated > 0) ? new int [ nallocated ] : NULL;
+
+  // Copy ranges of existing vertices contiguously (dropping abandoned ranges)
+  int n = 0;
+  for (int i = 0; i < NVertices(); i++) {
+    R3MeshVertexEdgeRange& range = vertex_edge_ranges[i];
+    assert(range.count <= range.capacity);
+    assert(n + range.capacity <= nallocated);
+    if (range.count > 0) memcpy(&ids[n], &vertex_edges[range.start], range.count * sizeof(int));
+    range.start = n;
+    n += range.capacity;
+  }
+
+  // Replace array
+  if (vertex_edges) delete [] vertex_edges;
+  vertex_edges = ids;
+  nvertex_edges = n;
+  nunused_vertex_edges = 0;
+  nallocated_vertex_edges = nallocated;
+}
+
+
+
+void R3Mesh::
+InsertVertexEdge(R3MeshVertex *v, R3MeshEdge *e)
+{
+  // Check if range of vertex is full
+  R3MeshVertexEdgeRange& range = vertex_edge_ranges[v->id];
+  if (range.count == range.capacity) {
+    int capacity = (range.capacity > 0) ? 2 * range.capacity : 8;
+    if ((range.capacity > 0) && (range.start + range.capacity == nvertex_edges) &&
+        (range.start + capacity <= nallocated_vertex_edges)) {
+      // Grow range in place at end of array
+      nvertex_edges += capacity - range.capacity;
+      range.capacity = capacity;
+    }
+    else {
+      // Make room at end of array (compacting if necessary)
+      if (nvertex_edges + capacity > nallocated_vertex_edges) {
+        int nallocated = 2 * (nvertex_edges - nunused_vertex_edges + capacity);
+        ResizeVertexEdgeStorage((nallocated < 1024) ? 1024 : nallocated);
+      }
+
+      // Move range to end of array
+      if (range.count > 0) memcpy(&vertex_edges[nvertex_edges], &vertex_edges[range.start], range.count * sizeof(int));
+      nunused_vertex_edges += range.capacity;
+      range.start = nvertex_edges;
+      range.capacity = capacity;
+      nvertex_edges += capacity;
+    }
+  }
+
+  // Insert edge at end of range
+  vertex_edges[range.start + range.count] = e->id;
+  range.count++;
+}
+
+
+
+void R3Mesh::
+RemoveVertexEdge(R3MeshVertex *v, R3MeshEdge *e)
+{
+  // Find edge in range of vertex
+  R3MeshVertexEdgeRange& range = vertex_edge_ranges[v->id];
+  int *ids = &vertex_edges[range.start];
+  for (int i = 0; i < range.count; i++) {
+    if (ids[i] != e->id) continue;
+
+    // Shift subsequent edges down (preserving order)
+    for (int j = i+1; j < range.count; j++) ids[j-1] = ids[j];
+    range.count--;
+    return;
+  }
+
+  // Edge not found
+  assert(0);
+}
+
+
+
 ////////////////////////////////////////////////////////////////////////
 // EUCLIDEAN DISTANCE FUNCTIONS
 ////////////////////////////////////////////////////////////////////////
@@ -6072,9 +6634,7 @@ R3Distance(R3Mesh *mesh, R3MeshFace *face, const R3Point& point, R3MeshIntersect
 
 R3MeshVertex::
 R3MeshVertex(void) 
-  : position(0.0, 0.0, 0.0),
-    normal(0.0, 0.0, 0.0),
-    texcoords(0.0, 0.0),
+  : texcoords(0.0, 0.0),
     color(0.0, 0.0, 0.0),
     curvature(0),
     id(-1),
@@ -6103,9 +6663,6 @@ R3MeshEdge(void)
     mark(0),
     data(NULL)
 {
-  // Initialize edge fields
-  vertex[0] = vertex[1] = NULL;
-  face[0] = face[1] = NULL;
 }
 
 
@@ -6129,9 +6686,6 @@ R3MeshFace(void)
     mark(0),
     data(NULL)
 {
-  // Initialize face fields
-  vertex[0] = vertex[1] = vertex[2] = NULL;
-  edge[0] = edge[1] = edge[2] = NULL;
 }
 
 
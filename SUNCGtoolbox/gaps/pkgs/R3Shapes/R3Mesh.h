@@ -21,7 +21,7 @@ class R3MeshFace;
 
 
 
-// Mesh vertex definition
+// Mesh vertex definition (position, normal, and attached edges are stored in arrays of the mesh indexed by id)
 
 class R3MeshVertex {
   friend class R3Mesh;
@@ -29,9 +29,6 @@ class R3MeshVertex {
     R3MeshVertex(void);
     virtual ~R3MeshVertex(void);
   protected:
-    RNArray<R3MeshEdge *> edges;
-    R3Point position;
-    R3Vector normal;
     R2Point texcoords;
     RNRgb color;
     RNScalar curvature;
@@ -44,7 +41,7 @@ class R3MeshVertex {
   
   
   
-// Mesh edge definition
+// Mesh edge definition (vertices and faces are stored in the half-edge arrays of the mesh indexed by id)
 
 class R3MeshEdge {
   friend class R3Mesh;
@@ -52,8 +49,6 @@ class R3MeshEdge {
     R3MeshEdge(void);
     virtual ~R3MeshEdge(void);
   protected:
-    class R3MeshVertex *vertex[2];
-    class R3MeshFace *face[2];
     RNLength length;
     int id;
     RNFlags flags;
@@ -64,7 +59,7 @@ class R3MeshEdge {
   
 
 
-// Mesh face definition
+// Mesh face definition (vertices and edges are stored in arrays of the mesh indexed by id)
 
 class R3MeshFace {
   friend class R3Mesh;
@@ -72,8 +67,6 @@ class R3MeshFace {
     R3MeshFace(void);
     virtual ~R3MeshFace(void);
   protected:
-    class R3MeshVertex *vertex[3];
-    class R3MeshEdge *edge[3];
     R3Plane plane;
     R3Box bbox;
     RNArea area;
@@ -88,6 +81,39 @@ class R3MeshFace {
 
 
 
+// Mesh element pool definition (vertices, edges, and faces are allocated in contiguous chunks)
+
+template <class Element>
+class R3MeshPool {
+  public:
+    R3MeshPool(void);
+    ~R3MeshPool(void);
+    Element *Allocate(void);
+    void Deallocate(Element *element);
+    void Reserve(int count);
+    void Empty(void);
+  private:
+    R3MeshPool(const R3MeshPool& pool);
+    R3MeshPool& operator=(const R3MeshPool& pool);
+    RNArray<Element *> chunks;
+    RNArray<Element *> free_elements;
+    Element *next_element;
+    int nunused;
+    int nallocated;
+};
+
+
+
+// Mesh vertex edge range definition (the edges attached to a vertex are a range of the mesh vertex edge array)
+
+struct R3MeshVertexEdgeRange {
+  int start;
+  int count;
+  int capacity;
+};
+
+
+
 // Mesh interesection definition
 
 struct R3MeshIntersection {
@@ -157,7 +183,7 @@ class R3Mesh {
 
     // VERTEX PROPERTIES
     const R3Point& VertexPosition(const R3MeshVertex *vertex) const;
-      // Returns the position of the vertex
+      // Returns the position of the vertex (the reference is invalidated when vertices are created)
     const R3Vector& VertexNormal(const R3MeshVertex *vertex) const;
       // Returns the normal of the surface at the vertex
     const RNRgb& VertexColor(const R3MeshVertex *vertex) const;
@@ -412,6 +438,8 @@ class R3Mesh {
     // TOPOLOGY MANIPULATION FUNCTIONS
     virtual void Empty(void);
       // Delete all vertices, edges, faces
+    virtual void Reserve(int nvertices, int nedges, int nfaces);
+      // Allocate storage for the given numbers of additional vertices, edges, faces
     virtual R3MeshVertex *CreateVertex(const R3Point& position, R3MeshVertex *vertex = NULL);
       // Create a new vertex at a position (compute normal)
     virtual R3MeshVertex *CreateVertex(const R3Point& position, const R3Vector& normal, R3MeshVertex *vertex = NULL);
@@ -553,6 +581,12 @@ class R3Mesh {
       // If "edges" is non-NULL (it should have already been allocated with size NVertices),
       // then it will be filled in with the edge from each vertex (indexed by VertexID) to its ancestor in the
       // shortest spanning tree back to the source_vertex
+    RNLength **DijkstraDistanceFields(const RNArray<R3MeshVertex *> *source_vertex_sets, int nsets, RNLength max_distance = 0) const;
+      // Returns nsets arrays of approximate geodesic distances, each from the closest vertex of one source set (arrays are indexed by VertexID).
+      // The fields are computed in parallel.  If max_distance is non-zero, distances beyond it are left at FLT_MAX.
+      // The caller must delete each array and the array of arrays.
+    RNLength **DijkstraDistanceFields(const RNArray<R3MeshVertex *>& source_vertices, RNLength max_distance = 0) const;
+      // Returns one array of approximate geodesic distances for each source vertex (same as above with one vertex per set)
     RNLength TracePath(const R3MeshVertex *source_vertex, const R3Vector& source_direction, RNLength max_distance,
       R3Point *position = NULL, R3MeshFace **face = NULL, R3MeshIntersection *intersections = NULL, int *nintersections = NULL) const;
       // Traces a path from the source_vertex starting in the source_direction along the mesh surface for max_distance.
@@ -627,6 +661,14 @@ class R3Mesh {
     virtual void UpdateFaceBBox(R3MeshFace *f) const;  
     virtual void UpdateFaceRefs(R3MeshFace *f, R3MeshVertex *v1, R3MeshVertex *v2, R3MeshVertex *v3,
                                 R3MeshEdge *e1, R3MeshEdge *e2, R3MeshEdge *e3);
+
+    // INTERNAL STORAGE FUNCTIONS
+    void ResizeVertexStorage(int nallocated);
+    void ResizeEdgeStorage(int nallocated);
+    void ResizeFaceStorage(int nallocated);
+    void ResizeVertexEdgeStorage(int nallocated);
+    void InsertVertexEdge(R3MeshVertex *v, R3MeshEdge *e);
+    void RemoveVertexEdge(R3MeshVertex *v, R3MeshEdge *e);
   
   protected:
     // Arrays of all vertices, edges, faces
@@ -634,10 +676,32 @@ class R3Mesh {
     RNArray<R3MeshEdge *> edges;
     RNArray<R3MeshFace *> faces;
 
-    // Storage (if allocated stuff in blocks)
-    R3MeshVertex *vertex_block;
-    R3MeshEdge *edge_block;
-    R3MeshFace *face_block;
+    // Vertex positions, normals, and ranges of attached edges (indexed by vertex id)
+    R3Point *vertex_positions;
+    R3Vector *vertex_normals;
+    R3MeshVertexEdgeRange *vertex_edge_ranges;
+    int nallocated_vertices;
+
+    // Edge ids attached to vertices (each vertex owns one range, abandoned ranges are reclaimed when the array is resized)
+    int *vertex_edges;
+    int nvertex_edges;
+    int nunused_vertex_edges;
+    int nallocated_vertex_edges;
+
+    // Half-edges (half-edge 2*id+k of an edge leaves edge vertex k and has edge face k on its left, its twin is 2*id+1-k)
+    int *halfedge_vertices;
+    int *halfedge_faces;
+    int nallocated_edges;
+
+    // Face vertex and edge ids (indexed by 3*id+k, edge k spans from vertex k to vertex k+1)
+    int *face_vertices;
+    int *face_edges;
+    int nallocated_faces;
+
+    // Storage for vertices, edges, faces allocated by mesh
+    R3MeshPool<R3MeshVertex> vertex_pool;
+    R3MeshPool<R3MeshEdge> edge_pool;
+    R3MeshPool<R3MeshFace> face_pool;
 
     // Other attributes
     char name[R3_MESH_NAME_LENGTH];
@@ -768,7 +832,7 @@ inline const R3Point& R3Mesh::
 VertexPosition(const R3MeshVertex *v) const
 { 
   // Return the position of the vertex
-  return v->position;
+  return vertex_positions[v->id];
 }
 
 
@@ -781,7 +845,7 @@ VertexNormal(const R3MeshVertex *v) const
     UpdateVertexNormal((R3MeshVertex *) v);
 
   // Return the normal at the vertex
-  return v->normal;
+  return vertex_normals[v->id];
 }
 
 
@@ -830,7 +894,7 @@ inline int R3Mesh::
 VertexValence(const R3MeshVertex *v) const
 {
   // Returns the number of edges attached to vertex
-  return v->edges.NEntries(); 
+  return vertex_edge_ranges[v->id].count; 
 }
 
 
@@ -901,8 +965,7 @@ inline R3Point R3Mesh::
 EdgeMidpoint(const R3MeshEdge *e) const
 {
   // Returns the midpoint of the edge
-  assert(e->vertex[0] && e->vertex[1]);
-  return 0.5 * (e->vertex[0]->position + e->vertex[1]->position);
+  return 0.5 * (VertexPosition(VertexOnEdge(e, 0)) + VertexPosition(VertexOnEdge(e, 1)));
 }
 
 
@@ -911,8 +974,7 @@ inline R3Vector R3Mesh::
 EdgeVector(const R3MeshEdge *e) const
 {
   // Returns the vector pointing in direction of the edge
-  assert(e->vertex[0] && e->vertex[1]);
-  return e->vertex[1]->position - e->vertex[0]->position;
+  return VertexPosition(VertexOnEdge(e, 1)) - VertexPosition(VertexOnEdge(e, 0));
 }
 
 
@@ -921,8 +983,7 @@ inline R3Span R3Mesh::
 EdgeSpan(const R3MeshEdge *e) const
 {
   // Returns the span covering the edge
-  assert(e->vertex[0] && e->vertex[1]);
-  return R3Span(e->vertex[0]->position, e->vertex[1]->position);
+  return R3Span(VertexPosition(VertexOnEdge(e, 0)), VertexPosition(VertexOnEdge(e, 1)));
 }
 
 
@@ -931,8 +992,7 @@ inline R3Line R3Mesh::
 EdgeLine(const R3MeshEdge *e) const
 {
   // Returns the line supporting the edge
-  assert(e->vertex[0] && e->vertex[1]);
-  return R3Line(e->vertex[0]->position, e->vertex[1]->position);
+  return R3Line(VertexPosition(VertexOnEdge(e, 0)), VertexPosition(VertexOnEdge(e, 1)));
 }
 
 
@@ -941,7 +1001,7 @@ inline R3Box R3Mesh::
 EdgeBBox(const R3MeshEdge *e) const
 {
   // Returns the bounding box of the edge
-  return R3Box(e->vertex[0]->position, e->vertex[1]->position);
+  return R3Box(VertexPosition(VertexOnEdge(e, 0)), VertexPosition(VertexOnEdge(e, 1)));
 }
 
 
@@ -1114,7 +1174,7 @@ inline void R3Mesh::
 SetVertexNormal(R3MeshVertex *v, const R3Vector& normal)
 {
   // Set new normal for vertex
-  v->normal = normal;
+  vertex_normals[v->id] = normal;
 
   // Remember that vertex normal is up-to-date
   v->flags.Add(R3_MESH_VERTEX_NORMAL_UPTODATE);
@@ -1294,8 +1354,9 @@ inline R3MeshEdge *R3Mesh::
 EdgeOnVertex(const R3MeshVertex *v) const
 {
   // Returns any edge connected to vertex
-  if (v->edges.IsEmpty()) return NULL;
-  else return v->edges[0];
+  const R3MeshVertexEdgeRange& range = vertex_edge_ranges[v->id];
+  if (range.count == 0) return NULL;
+  else return edges[vertex_edges[range.start]];
 }
 
 
@@ -1303,9 +1364,9 @@ EdgeOnVertex(const R3MeshVertex *v) const
 inline R3MeshEdge *R3Mesh:: 
 EdgeOnVertex(const R3MeshVertex *v, int k) const
 {
-  // Returns any face connected to vertex
-  assert((0 <= k) && (k < edges.NEntries()));
-  return v->edges[k];
+  // Returns kth edge connected to vertex
+  assert((0 <= k) && (k < VertexValence(v)));
+  return edges[vertex_edges[vertex_edge_ranges[v->id].start + k]];
 }
 
 
@@ -1374,7 +1435,7 @@ inline R3MeshVertex *R3Mesh::
 VertexOnEdge(const R3MeshEdge *e) const
 {
   // Returns any vertex on edge 
-  return e->vertex[1]; 
+  return vertices[halfedge_vertices[2*e->id+1]]; 
 }
 
 
@@ -1384,7 +1445,7 @@ VertexOnEdge(const R3MeshEdge *e, int k) const
 {
   // Returns kth vertex on edge 
   assert((k >= 0) && (k <= 1));
-  return e->vertex[k]; 
+  return vertices[halfedge_vertices[2*e->id+k]]; 
 }
 
 
@@ -1393,8 +1454,9 @@ inline R3MeshVertex *R3Mesh::
 VertexAcrossEdge(const R3MeshEdge *e, const R3MeshVertex *v) const
 {
   // Returns vertex across edge 
-  assert((v == e->vertex[0]) || (v == e->vertex[1]));
-  return (v == e->vertex[0]) ? e->vertex[1] : e->vertex[0];
+  assert(IsVertexOnEdge(v, e));
+  int v0 = halfedge_vertices[2*e->id];
+  return (v->id == v0) ? vertices[halfedge_vertices[2*e->id+1]] : vertices[v0];
 }
 
 
@@ -1403,8 +1465,8 @@ inline R3MeshVertex *R3Mesh::
 VertexOnEdge(const R3MeshEdge *e, const R3MeshFace *f, RNDirection dir) const
 {
   // Returns vertex of edge in dir with respect to face
-  assert((f == e->face[0]) || (f == e->face[1]));
-  return (f == e->face[0]) ? e->vertex[1-dir] : e->vertex[dir];
+  assert((f == FaceOnEdge(e, 0)) || (f == FaceOnEdge(e, 1)));
+  return (f == FaceOnEdge(e, 0)) ? VertexOnEdge(e, 1-dir) : VertexOnEdge(e, dir);
 }
 
 
@@ -1413,7 +1475,7 @@ inline R3MeshFace *R3Mesh::
 FaceOnEdge(const R3MeshEdge *e) const
 {
   // Returns any face on edge 
-  return (e->face[1]) ? e->face[1] : e->face[0]; 
+  return (FaceOnEdge(e, 1)) ? FaceOnEdge(e, 1) : FaceOnEdge(e, 0); 
 }
 
 
@@ -1422,7 +1484,8 @@ inline R3MeshFace *R3Mesh::
 FaceOnEdge(const R3MeshEdge *e, int k) const
 {
   // Returns kth face on edge 
-  return e->face[k]; 
+  int face_id = halfedge_faces[2*e->id+k];
+  return (face_id >= 0) ? faces[face_id] : NULL; 
   
 }
 
@@ -1432,8 +1495,8 @@ inline R3MeshFace *R3Mesh::
 FaceOnEdge(const R3MeshEdge *e, const R3MeshVertex *v, RNDirection dir) const
 {
   // Returns face on edge in dir with respect to vertex
-  assert((v == e->vertex[0]) || (v == e->vertex[1]));
-  return (v == e->vertex[0]) ? e->face[dir] : e->face[1-dir];
+  assert(IsVertexOnEdge(v, e));
+  return (v->id == halfedge_vertices[2*e->id]) ? FaceOnEdge(e, dir) : FaceOnEdge(e, 1-dir);
 }
 
 
@@ -1442,8 +1505,8 @@ inline R3MeshFace *R3Mesh::
 FaceAcrossEdge(const R3MeshEdge *e, const R3MeshFace *f) const
 {
   // Returns face across edge 
-  // assert((f == e->face[0]) || (f == e->face[1]));
-  return (f == e->face[0]) ? e->face[1] : e->face[0];
+  // assert((f == FaceOnEdge(e, 0)) || (f == FaceOnEdge(e, 1)));
+  return (f == FaceOnEdge(e, 0)) ? FaceOnEdge(e, 1) : FaceOnEdge(e, 0);
 }
 
 
@@ -1472,7 +1535,7 @@ inline R3MeshVertex *R3Mesh::
 VertexOnFace(const R3MeshFace *f) const
 {
   // Returns any vertex on face
-  return f->vertex[0];
+  return vertices[face_vertices[3*f->id]];
 }
 
 
@@ -1481,7 +1544,7 @@ inline R3MeshVertex *R3Mesh::
 VertexOnFace(const R3MeshFace *f, int k) const
 {
   // Returns kth vertex on face
-  return f->vertex[k];
+  return vertices[face_vertices[3*f->id+k]];
 }
 
 
@@ -1509,9 +1572,9 @@ VertexAcrossFace(const R3MeshFace *f, const R3MeshEdge *e) const
 {
   // Returns the vertex across a triangle from an edge (the edge is the base and the vertex is the apex)
   assert(IsEdgeOnFace(e, f));
-  if (!IsVertexOnEdge(f->vertex[0], e)) return f->vertex[0];
-  if (!IsVertexOnEdge(f->vertex[1], e)) return f->vertex[1];
-  if (!IsVertexOnEdge(f->vertex[2], e)) return f->vertex[2];
+  if (!IsVertexOnEdge(VertexOnFace(f, 0), e)) return VertexOnFace(f, 0);
+  if (!IsVertexOnEdge(VertexOnFace(f, 1), e)) return VertexOnFace(f, 1);
+  if (!IsVertexOnEdge(VertexOnFace(f, 2), e)) return VertexOnFace(f, 2);
   return NULL;
 }
 
@@ -1521,7 +1584,7 @@ inline R3MeshEdge *R3Mesh::
 EdgeOnFace(const R3MeshFace *f) const
 {
   // Returns any edge connected to face
-  return f->edge[0]; 
+  return edges[face_edges[3*f->id]]; 
 }
 
 
@@ -1530,7 +1593,7 @@ inline R3MeshEdge *R3Mesh::
 EdgeOnFace(const R3MeshFace *f, int k) const
 {
   // Returns kth edge connected to face
-  return f->edge[k]; 
+  return edges[face_edges[3*f->id+k]]; 
 }
 
 
@@ -1539,17 +1602,18 @@ inline R3MeshEdge *R3Mesh::
 EdgeOnFace(const R3MeshFace *f, const R3MeshVertex *v, RNDirection dir) const
 {
   // Returns edge on face in dir with respect to vertex
-  if (f->vertex[0] == v) {
-    if (dir == RN_CCW) return f->edge[0];
-    else return f->edge[2];
+  const int *fv = &face_vertices[3*f->id];
+  if (fv[0] == v->id) {
+    if (dir == RN_CCW) return EdgeOnFace(f, 0);
+    else return EdgeOnFace(f, 2);
   }
-  else if (f->vertex[1] == v) {
-    if (dir == RN_CCW) return f->edge[1];
-    else return f->edge[0];
+  else if (fv[1] == v->id) {
+    if (dir == RN_CCW) return EdgeOnFace(f, 1);
+    else return EdgeOnFace(f, 0);
   }
-  else if (f->vertex[2] == v) {
-    if (dir == RN_CCW) return f->edge[2];
-    else return f->edge[1];
+  else if (fv[2] == v->id) {
+    if (dir == RN_CCW) return EdgeOnFace(f, 2);
+    else return EdgeOnFace(f, 1);
   }
   else {
     // Vertex not found
@@ -1563,17 +1627,18 @@ inline R3MeshEdge *R3Mesh::
 EdgeOnFace(const R3MeshFace *f, const R3MeshEdge *e, RNDirection dir) const
 {
   // Return edge on face in dir with respect to edge
-  if (f->edge[0] == e) {
-    if (dir == RN_CCW) return f->edge[1];
-    else return f->edge[2];
+  const int *fe = &face_edges[3*f->id];
+  if (fe[0] == e->id) {
+    if (dir == RN_CCW) return EdgeOnFace(f, 1);
+    else return EdgeOnFace(f, 2);
   }
-  else if (f->edge[1] == e) {
-    if (dir == RN_CCW) return f->edge[2];
-    else return f->edge[0];
+  else if (fe[1] == e->id) {
+    if (dir == RN_CCW) return EdgeOnFace(f, 2);
+    else return EdgeOnFace(f, 0);
   }
-  else if (f->edge[2] == e) {
-    if (dir == RN_CCW) return f->edge[0];
-    else return f->edge[1];
+  else if (fe[2] == e->id) {
+    if (dir == RN_CCW) return EdgeOnFace(f, 0);
+    else return EdgeOnFace(f, 1);
   }
   else {
     // Edge not found
@@ -1588,9 +1653,9 @@ EdgeAcrossFace(const R3MeshFace *f, const R3MeshVertex *v) const
 {
   // Returns the edge across a triangle from a vertex (the edge is the base and the vertex is the apex)
   assert(IsVertexOnFace(v, f));
-  if (!IsVertexOnEdge(v, f->edge[0]))return f->edge[0];
-  if (!IsVertexOnEdge(v, f->edge[1]))return f->edge[1];
-  if (!IsVertexOnEdge(v, f->edge[2]))return f->edge[2];
+  if (!IsVertexOnEdge(v, EdgeOnFace(f, 0)))return EdgeOnFace(f, 0);
+  if (!IsVertexOnEdge(v, EdgeOnFace(f, 1)))return EdgeOnFace(f, 1);
+  if (!IsVertexOnEdge(v, EdgeOnFace(f, 2)))return EdgeOnFace(f, 2);
   return NULL;
 }
 
@@ -1601,11 +1666,11 @@ FaceOnFace(const R3MeshFace *f) const
 {
   // Returns any face connected to face
   R3MeshFace *face;
-  face = FaceAcrossEdge(f->edge[0], f);
+  face = FaceAcrossEdge(EdgeOnFace(f, 0), f);
   if (face) return face;
-  face = FaceAcrossEdge(f->edge[1], f);
+  face = FaceAcrossEdge(EdgeOnFace(f, 1), f);
   if (face) return face;
-  face = FaceAcrossEdge(f->edge[2], f);
+  face = FaceAcrossEdge(EdgeOnFace(f, 2), f);
   if (face) return face;
   return NULL;
 }
@@ -1616,7 +1681,7 @@ inline R3MeshFace *R3Mesh::
 FaceOnFace(const R3MeshFace *f, int k) const
 {
   // Returns kth face connected to face
-  return FaceAcrossEdge(f->edge[k], f);
+  return FaceAcrossEdge(EdgeOnFace(f, k), f);
 }
 
 
@@ -1629,7 +1694,7 @@ inline RNBoolean R3Mesh::
 IsVertexOnEdge(const R3MeshVertex *v, const R3MeshEdge *e) const
 {
   // Returns whether vertex lies on edge
-  return ((v == e->vertex[0]) || (v == e->vertex[1])); 
+  return ((v->id == halfedge_vertices[2*e->id]) || (v->id == halfedge_vertices[2*e->id+1])); 
 }
 
 
@@ -1638,7 +1703,8 @@ inline RNBoolean R3Mesh::
 IsVertexOnFace(const R3MeshVertex *v, const R3MeshFace *f) const
 {
   // Return whether vertex lies on face
-  return (f->vertex[0] == v) || (f->vertex[1] == v) || (f->vertex[2] == v);
+  const int *fv = &face_vertices[3*f->id];
+  return (fv[0] == v->id) || (fv[1] == v->id) || (fv[2] == v->id);
 }
 
 
@@ -1647,7 +1713,7 @@ inline RNBoolean R3Mesh::
 IsEdgeOnFace(const R3MeshEdge *e, const R3MeshFace *f) const
 {
   // Returns whether edge lies on face
-  return ((f == e->face[0]) || (f == e->face[1]));
+  return ((f == FaceOnEdge(e, 0)) || (f == FaceOnEdge(e, 1)));
 } 
 
 
@@ -1656,7 +1722,7 @@ inline RNBoolean R3Mesh::
 IsEdgeOnBoundary(const R3MeshEdge *e) const
 {
   // Returns whether edge lies on boundary 
-  return ((e->face[0] == NULL) || (e->face[1] == NULL));
+  return ((halfedge_faces[2*e->id] < 0) || (halfedge_faces[2*e->id+1] < 0));
 } 
 
 
@@ -1697,6 +1763,98 @@ IsFaceOnMesh(const R3MeshFace *f) const
 
 
 
+////////////////////////////////////////////////////////////////////////
+// POOL FUNCTIONS
+////////////////////////////////////////////////////////////////////////
+
+template <class Element>
+inline R3MeshPool<Element>::
+R3MeshPool(void)
+  : next_element(NULL),
+    nunused(0),
+    nallocated(0)
+{
+}
+
+
+
+template <class Element>
+inline R3MeshPool<Element>::
+~R3MeshPool(void)
+{
+  // Delete all chunks
+  Empty();
+}
+
+
+
+template <class Element>
+inline Element *R3MeshPool<Element>::
+Allocate(void)
+{
+  // Reuse deallocated element
+  if (!free_elements.IsEmpty()) {
+    Element *element = free_elements.Tail();
+    free_elements.RemoveTail();
+    return element;
+  }
+
+  // Allocate new chunk (doubling size of pool)
+  if (nunused == 0) Reserve((nallocated < 1024) ? 1024 : nallocated);
+
+  // Return next unused element of chunk
+  nunused--;
+  return next_element++;
+}
+
+
+
+template <class Element>
+inline void R3MeshPool<Element>::
+Deallocate(Element *element)
+{
+  // Reset element and remember it for reuse
+  *element = Element();
+  free_elements.Insert(element);
+}
+
+
+
+template <class Element>
+inline void R3MeshPool<Element>::
+Reserve(int count)
+{
+  // Check if have enough storage already
+  int needed = count - nunused - free_elements.NEntries();
+  if (needed <= 0) return;
+
+  // Move unused elements of last chunk to free list
+  while (nunused > 0) { free_elements.Insert(next_element++); nunused--; }
+
+  // Allocate chunk of elements
+  next_element = new Element [ needed ];
+  chunks.Insert(next_element);
+  nunused = needed;
+  nallocated += needed;
+}
+
+
+
+template <class Element>
+inline void R3MeshPool<Element>::
+Empty(void)
+{
+  // Delete all chunks
+  for (int i = 0; i < chunks.NEntries(); i++) delete [] chunks[i];
+  chunks.Empty(TRUE);
+  free_elements.Empty(TRUE);
+  next_element = NULL;
+  nunused = 0;
+  nallocated = 0;
+}
+
+
+
 ////////////////////////////////////////////////////////////////////////
 // DRAW FUNCTIONS
 ////////////////////////////////////////////////////////////////////////
@@ -132,6 +132,7 @@ class R3Grid;
 #include "R3Shapes/R3Relate.h"
 #include "R3Shapes/R3Align.h"
 #include "R3Shapes/R3Kdtree.h"
+#include "R3Shapes/R3FlatKdtree.h"
 
 
 
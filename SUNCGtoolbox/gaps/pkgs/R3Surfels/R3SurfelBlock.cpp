@@ -27,6 +27,10 @@ R3SurfelBlock(void)
     file_surfels_offset(0),
     file_surfels_count(0),
     file_read_count(0),
+    cache_previous(NULL),
+    cache_next(NULL),
+    cache_prefetched(FALSE),
+    prefetch_queued(FALSE),
     node(NULL),
     opengl_id(0)
 {
@@ -47,6 +51,10 @@ R3SurfelBlock(const R3SurfelBlock& block)
     file_surfels_offset(0),
     file_surfels_count(0),
     file_read_count(0),
+    cache_previous(NULL),
+    cache_next(NULL),
+    cache_prefetched(FALSE),
+    prefetch_queued(FALSE),
     node(NULL),
     opengl_id(0)
 {
@@ -72,6 +80,10 @@ R3SurfelBlock(const R3SurfelPointSet *set)
     file_surfels_offset(0),
     file_surfels_count(0),
     file_read_count(0),
+    cache_previous(NULL),
+    cache_next(NULL),
+    cache_prefetched(FALSE),
+    prefetch_queued(FALSE),
     node(NULL),
     opengl_id(0)
 {
@@ -106,6 +118,10 @@ R3SurfelBlock(const R3SurfelPointSet *set, const R3Point& origin)
     file_surfels_offset(0),
     file_surfels_count(0),
     file_read_count(0),
+    cache_previous(NULL),
+    cache_next(NULL),
+    cache_prefetched(FALSE),
+    prefetch_queued(FALSE),
     node(NULL),
     opengl_id(0)
 {
@@ -140,6 +156,10 @@ R3SurfelBlock(const R3Surfel *surfels, int nsurfels, const R3Point& origin)
     file_surfels_offset(0),
     file_surfels_count(0),
     file_read_count(0),
+    cache_previous(NULL),
+    cache_next(NULL),
+    cache_prefetched(FALSE),
+    prefetch_queued(FALSE),
     node(NULL),
     opengl_id(0)
 {
@@ -165,6 +185,10 @@ R3SurfelBlock(const RNArray<const R3Surfel *>& array, const R3Point& origin)
     file_surfels_offset(0),
     file_surfels_count(0),
     file_read_count(0),
+    cache_previous(NULL),
+    cache_next(NULL),
+    cache_prefetched(FALSE),
+    prefetch_queued(FALSE),
     node(NULL),
     opengl_id(0)
 {
@@ -190,6 +214,10 @@ R3SurfelBlock(const R3Point *points, int npoints)
     file_surfels_offset(0),
     file_surfels_count(0),
     file_read_count(0),
+    cache_previous(NULL),
+    cache_next(NULL),
+    cache_prefetched(FALSE),
+    prefetch_queued(FALSE),
     node(NULL),
     opengl_id(0)
 {
@@ -231,6 +259,10 @@ R3SurfelBlock(const RNArray<R3Point *>& points)
     file_surfels_offset(0),
     file_surfels_count(0),
     file_read_count(0),
+    cache_previous(NULL),
+    cache_next(NULL),
+    cache_prefetched(FALSE),
+    prefetch_queued(FALSE),
     node(NULL),
     opengl_id(0)
 {
@@ -266,6 +298,7 @@ R3SurfelBlock::
   assert(!database);
   assert(database_index == -1);
   assert(file_read_count == 0);
+  assert(!cache_previous && !cache_next);
   assert(!node);
 
   // Delete surfels
@@ -203,6 +203,10 @@ private:
   unsigned long long file_surfels_offset;
   unsigned int file_surfels_count;
   unsigned int file_read_count;
+  R3SurfelBlock *cache_previous;
+  R3SurfelBlock *cache_next;
+  RNBoolean cache_prefetched;
+  RNBoolean prefetch_queued;
 
   // Node data
   friend class R3SurfelNode;
@@ -231,6 +235,7 @@ private:
 #define R3_SURFEL_BLOCK_DATABASE_FLAGS                 0xFF00
 #define R3_SURFEL_BLOCK_DIRTY_FLAG                     0x0100
 #define R3_SURFEL_BLOCK_DELETE_PENDING_FLAG            0x0200
+#define R3_SURFEL_BLOCK_COMPRESSED_FLAG                0x0400
 
 
 
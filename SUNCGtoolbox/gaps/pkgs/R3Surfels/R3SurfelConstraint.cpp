@@ -7,6 +7,152 @@
 ////////////////////////////////////////////////////////////////////////
 
 #include "R3Surfels/R3Surfels.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+
+
+////////////////////////////////////////////////////////////////////////
+// SURFEL MASK UTILITY FUNCTIONS
+////////////////////////////////////////////////////////////////////////
+
+// Surfels are checked 64 at a time (one mask word), after decoding their
+// positions into small SoA arrays that stay in L1 cache
+
+static int
+DecodeSurfels(const R3SurfelBlock *block, int start, float *x, float *y, float *z)
+{
+  // Copy positions of up to 64 surfels starting at start (pad with zeros)
+  int n = block->NSurfels() - start;
+  if (n > 64) n = 64;
+  const R3Surfel *surfels = block->Surfels() + start;
+  for (int i = 0; i < n; i++) {
+    const float *coords = surfels[i].Coords();
+    x[i] = coords[0];
+    y[i] = coords[1];
+    z[i] = coords[2];
+  }
+  for (int i = n; i < 64; i++) {
+    x[i] = y[i] = z[i] = 0;
+  }
+
+  // Return number of surfels decoded
+  return n;
+}
+
+
+
+static RNUInt64
+WordMask(int n)
+{
+  // Return mask with lowest n bits set
+  return (n >= 64) ? ~0ULL : (1ULL << n) - 1;
+}
+
+
+
+static int
+CheckBlockBBox(const R3SurfelConstraint *constraint, const R3SurfelBlock *block, RNUInt64 *mask)
+{
+  // Fill mask and return TRUE if block bounding box decides all surfels
+  int nsurfels = block->NSurfels();
+  int nwords = (nsurfels + 63) / 64;
+  int status = constraint->Check(block->BBox());
+  if (status == R3_SURFEL_CONSTRAINT_FAIL) {
+    for (int w = 0; w < nwords; w++) mask[w] = 0;
+    return TRUE;
+  }
+  else if (status == R3_SURFEL_CONSTRAINT_PASS) {
+    for (int w = 0; w < nwords; w++) mask[w] = WordMask(nsurfels - 64 * w);
+    return TRUE;
+  }
+
+  // Surfels must be checked individually
+  return FALSE;
+}
+
+
+
+static RNUInt64
+BoxMask(const float *x, const float *y, const float *z, const float *lo, const float *hi)
+{
+  // Return bits of 64 positions inside [lo, hi]
+  RNUInt64 bits = 0;
+#if defined(__SSE2__)
+  __m128 xlo = _mm_set1_ps(lo[0]), ylo = _mm_set1_ps(lo[1]), zlo = _mm_set1_ps(lo[2]);
+  __m128 xhi = _mm_set1_ps(hi[0]), yhi = _mm_set1_ps(hi[1]), zhi = _mm_set1_ps(hi[2]);
+  for (int i = 0; i < 64; i += 4) {
+    __m128 px = _mm_loadu_ps(&x[i]), py = _mm_loadu_ps(&y[i]), pz = _mm_loadu_ps(&z[i]);
+    __m128 c = _mm_and_ps(_mm_cmpge_ps(px, xlo), _mm_cmple_ps(px, xhi));
+    c = _mm_and_ps(c, _mm_and_ps(_mm_cmpge_ps(py, ylo), _mm_cmple_ps(py, yhi)));
+    c = _mm_and_ps(c, _mm_and_ps(_mm_cmpge_ps(pz, zlo), _mm_cmple_ps(pz, zhi)));
+    bits |= (RNUInt64) _mm_movemask_ps(c) << i;
+  }
+#else
+  for (int i = 0; i < 64; i++) {
+    if ((x[i] < lo[0]) || (x[i] > hi[0])) continue;
+    if ((y[i] < lo[1]) || (y[i] > hi[1])) continue;
+    if ((z[i] < lo[2]) || (z[i] > hi[2])) continue;
+    bits |= 1ULL << i;
+  }
+#endif
+  return bits;
+}
+
+
+
+static RNUInt64
+CylinderMask(const float *x, const float *y, const float *z, float xc, float yc, float rr, float zlo, float zhi)
+{
+  // Return bits of 64 positions within vertical cylinder
+  RNUInt64 bits = 0;
+#if defined(__SSE2__)
+  __m128 xc4 = _mm_set1_ps(xc), yc4 = _mm_set1_ps(yc), rr4 = _mm_set1_ps(rr);
+  __m128 zlo4 = _mm_set1_ps(zlo), zhi4 = _mm_set1_ps(zhi);
+  for (int i = 0; i < 64; i += 4) {
+    __m128 dx = _mm_sub_ps(_mm_loadu_ps(&x[i]), xc4);
+    __m128 dy = _mm_sub_ps(_mm_loadu_ps(&y[i]), yc4);
+    __m128 pz = _mm_loadu_ps(&z[i]);
+    __m128 dd = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+    __m128 c = _mm_and_ps(_mm_cmple_ps(dd, rr4), _mm_and_ps(_mm_cmpge_ps(pz, zlo4), _mm_cmple_ps(pz, zhi4)));
+    bits |= (RNUInt64) _mm_movemask_ps(c) << i;
+  }
+#else
+  for (int i = 0; i < 64; i++) {
+    if ((z[i] < zlo) || (z[i] > zhi)) continue;
+    float dx = x[i] - xc;
+    float dy = y[i] - yc;
+    if (dx*dx + dy*dy > rr) continue;
+    bits |= 1ULL << i;
+  }
+#endif
+  return bits;
+}
+
+
+
+static RNUInt64
+HalfspaceMask(const float *x, const float *y, const float *z, float a, float b, float c, float threshold)
+{
+  // Return bits of 64 positions with a*x + b*y + c*z >= threshold
+  RNUInt64 bits = 0;
+#if defined(__SSE2__)
+  __m128 a4 = _mm_set1_ps(a), b4 = _mm_set1_ps(b), c4 = _mm_set1_ps(c), t4 = _mm_set1_ps(threshold);
+  for (int i = 0; i < 64; i += 4) {
+    __m128 d = _mm_mul_ps(_mm_loadu_ps(&x[i]), a4);
+    d = _mm_add_ps(d, _mm_mul_ps(_mm_loadu_ps(&y[i]), b4));
+    d = _mm_add_ps(d, _mm_mul_ps(_mm_loadu_ps(&z[i]), c4));
+    bits |= (RNUInt64) _mm_movemask_ps(_mm_cmpge_ps(d, t4)) << i;
+  }
+#else
+  for (int i = 0; i < 64; i++) {
+    float d = (x[i] * a + y[i] * b) + z[i] * c;
+    if (d >= threshold) bits |= 1ULL << i;
+  }
+#endif
+  return bits;
+}
 
 
 
@@ -93,6 +239,25 @@ Check(const R3Point& point) const
 
 
 
+void R3SurfelConstraint::
+CheckSurfels(const R3SurfelBlock *block, RNUInt64 *mask) const
+{
+  // Check block bounding box
+  if (CheckBlockBBox(this, block, mask)) return;
+
+  // Check every surfel
+  int nsurfels = block->NSurfels();
+  for (int w = 0; w < (nsurfels + 63) / 64; w++) {
+    RNUInt64 bits = 0;
+    for (int i = 64 * w; (i < nsurfels) && (i < 64 * w + 64); i++) {
+      if (Check(block, block->Surfel(i))) bits |= 1ULL << (i % 64);
+    }
+    mask[w] = bits;
+  }
+}
+
+
+
 ////////////////////////////////////////////////////////////////////////
 // COORDINATE CONSTRAINT FUNCTIONS
 ////////////////////////////////////////////////////////////////////////
@@ -160,6 +325,30 @@ Check(const R3Point& point) const
 
 
 
+void R3SurfelBoxConstraint::
+CheckSurfels(const R3SurfelBlock *block, RNUInt64 *mask) const
+{
+  // Check block bounding box
+  if (CheckBlockBBox(this, block, mask)) return;
+
+  // Translate box (with tolerance of R3Contains) to block coordinate system
+  const R3Point& origin = block->Origin();
+  float lo[3], hi[3];
+  for (int dim = 0; dim < 3; dim++) {
+    lo[dim] = box[0][dim] - RN_EPSILON - origin[dim];
+    hi[dim] = box[1][dim] + RN_EPSILON - origin[dim];
+  }
+
+  // Check surfels 64 at a time
+  float x[64], y[64], z[64];
+  for (int w = 0; w < (block->NSurfels() + 63) / 64; w++) {
+    int n = DecodeSurfels(block, 64 * w, x, y, z);
+    mask[w] = BoxMask(x, y, z, lo, hi) & WordMask(n);
+  }
+}
+
+
+
 ////////////////////////////////////////////////////////////////////////
 // CYLINDER CONSTRAINT FUNCTIONS
 ////////////////////////////////////////////////////////////////////////
@@ -211,6 +400,30 @@ Check(const R3Point& point) const
 
 
 
+void R3SurfelCylinderConstraint::
+CheckSurfels(const R3SurfelBlock *block, RNUInt64 *mask) const
+{
+  // Check block bounding box
+  if (CheckBlockBBox(this, block, mask)) return;
+
+  // Translate cylinder to block coordinate system (and store in floats)
+  const R3Point& origin = block->Origin();
+  float xc = center[0] - origin[0];
+  float yc = center[1] - origin[1];
+  float zlo = zmin - origin[2];
+  float zhi = zmax - origin[2];
+  float rr = radius_squared;
+
+  // Check surfels 64 at a time
+  float x[64], y[64], z[64];
+  for (int w = 0; w < (block->NSurfels() + 63) / 64; w++) {
+    int n = DecodeSurfels(block, 64 * w, x, y, z);
+    mask[w] = CylinderMask(x, y, z, xc, yc, rr, zlo, zhi) & WordMask(n);
+  }
+}
+
+
+
 ////////////////////////////////////////////////////////////////////////
 // SPHERE CONSTRAINT FUNCTIONS
 ////////////////////////////////////////////////////////////////////////
@@ -277,6 +490,28 @@ Check(const R3Point& point) const
 
 
 
+void R3SurfelHalfspaceConstraint::
+CheckSurfels(const R3SurfelBlock *block, RNUInt64 *mask) const
+{
+  // Check block bounding box
+  if (CheckBlockBBox(this, block, mask)) return;
+
+  // Translate plane (with tolerance of R3Contains) to block coordinate system
+  const R3Plane& plane = halfspace.Plane();
+  const R3Point& origin = block->Origin();
+  RNScalar d = plane.D() + plane.A() * origin[0] + plane.B() * origin[1] + plane.C() * origin[2];
+  float threshold = -RN_EPSILON - d;
+
+  // Check surfels 64 at a time
+  float x[64], y[64], z[64];
+  for (int w = 0; w < (block->NSurfels() + 63) / 64; w++) {
+    int n = DecodeSurfels(block, 64 * w, x, y, z);
+    mask[w] = HalfspaceMask(x, y, z, plane.A(), plane.B(), plane.C(), threshold) & WordMask(n);
+  }
+}
+
+
+
 ////////////////////////////////////////////////////////////////////////
 // LINE CONSTRAINT FUNCTIONS
 ////////////////////////////////////////////////////////////////////////
@@ -428,6 +663,36 @@ Check(const R3Point& point) const
 
 
 
+void R3SurfelGridConstraint::
+CheckSurfels(const R3SurfelBlock *block, RNUInt64 *mask) const
+{
+  // Check block bounding box
+  if (CheckBlockBBox(this, block, mask)) return;
+
+  // Check whether result is same for all surfels
+  const R3Point& origin = block->Origin();
+  int nsurfels = block->NSurfels();
+  if ((grid_value_type == R3_SURFEL_CONSTRAINT_OPERAND) && (surfel_value_type == R3_SURFEL_CONSTRAINT_OPERAND)) {
+    int status = R3SurfelGridConstraint::Check(origin);
+    for (int w = 0; w < (nsurfels + 63) / 64; w++) mask[w] = (status) ? WordMask(nsurfels - 64 * w) : 0;
+    return;
+  }
+
+  // Check surfels 64 at a time (grid lookups are not vectorized)
+  float x[64], y[64], z[64];
+  for (int w = 0; w < (nsurfels + 63) / 64; w++) {
+    int n = DecodeSurfels(block, 64 * w, x, y, z);
+    RNUInt64 bits = 0;
+    for (int i = 0; i < n; i++) {
+      R3Point position(origin[0] + x[i], origin[1] + y[i], origin[2] + z[i]);
+      if (R3SurfelGridConstraint::Check(position)) bits |= 1ULL << i;
+    }
+    mask[w] = bits;
+  }
+}
+
+
+
 ////////////////////////////////////////////////////////////////////////
 // PLANAR GRID CONSTRAINT FUNCTIONS
 ////////////////////////////////////////////////////////////////////////
@@ -590,6 +855,36 @@ Check(const R3Point& point) const
 
 
 
+void R3SurfelOverheadGridConstraint::
+CheckSurfels(const R3SurfelBlock *block, RNUInt64 *mask) const
+{
+  // Check block bounding box
+  if (CheckBlockBBox(this, block, mask)) return;
+
+  // Check whether result is same for all surfels
+  const R3Point& origin = block->Origin();
+  int nsurfels = block->NSurfels();
+  if ((grid_value_type == R3_SURFEL_CONSTRAINT_OPERAND) && (surfel_value_type == R3_SURFEL_CONSTRAINT_OPERAND)) {
+    int status = R3SurfelOverheadGridConstraint::Check(origin);
+    for (int w = 0; w < (nsurfels + 63) / 64; w++) mask[w] = (status) ? WordMask(nsurfels - 64 * w) : 0;
+    return;
+  }
+
+  // Check surfels 64 at a time (grid lookups are not vectorized)
+  float x[64], y[64], z[64];
+  for (int w = 0; w < (nsurfels + 63) / 64; w++) {
+    int n = DecodeSurfels(block, 64 * w, x, y, z);
+    RNUInt64 bits = 0;
+    for (int i = 0; i < n; i++) {
+      R3Point position(origin[0] + x[i], origin[1] + y[i], origin[2] + z[i]);
+      if (R3SurfelOverheadGridConstraint::Check(position)) bits |= 1ULL << i;
+    }
+    mask[w] = bits;
+  }
+}
+
+
+
 ////////////////////////////////////////////////////////////////////////
 // MESH CONSTRAINT FUNCTIONS
 ////////////////////////////////////////////////////////////////////////
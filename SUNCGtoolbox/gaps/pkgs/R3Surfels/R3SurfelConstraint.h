@@ -19,6 +19,9 @@ public:
   virtual int Check(const R3SurfelBlock *block, const R3Surfel *surfel) const;
   virtual int Check(const R3Box& box) const;
   virtual int Check(const R3Point& point) const;
+
+  // Surfel mask functions (sets bit i of mask if ith surfel of resident block passes)
+  virtual void CheckSurfels(const R3SurfelBlock *block, RNUInt64 *mask) const;
 };
 
 
@@ -92,6 +95,7 @@ public:
   // Surfel check functions
   virtual int Check(const R3Point& point) const;
   virtual int Check(const R3Box& box) const;
+  virtual void CheckSurfels(const R3SurfelBlock *block, RNUInt64 *mask) const;
 
 private:
   R3Box box;
@@ -107,6 +111,7 @@ public:
   // Surfel check functions
   virtual int Check(const R3Point& point) const;
   virtual int Check(const R3Box& box) const;
+  virtual void CheckSurfels(const R3SurfelBlock *block, RNUInt64 *mask) const;
 
 private:
   R3Point center;
@@ -139,6 +144,7 @@ public:
   // Surfel check functions
   virtual int Check(const R3Point& point) const;
   virtual int Check(const R3Box& box) const;
+  virtual void CheckSurfels(const R3SurfelBlock *block, RNUInt64 *mask) const;
 
 private:
   R3Halfspace halfspace;
@@ -198,6 +204,7 @@ public:
   // Surfel check functions
   virtual int Check(const R3Point& point) const;
   virtual int Check(const R3Box& box) const;
+  virtual void CheckSurfels(const R3SurfelBlock *block, RNUInt64 *mask) const;
 
 private:
   const R3Grid *grid;
@@ -254,6 +261,7 @@ public:
   // Surfel check functions
   virtual int Check(const R3Box& box) const;
   virtual int Check(const R3Point& point) const;
+  virtual void CheckSurfels(const R3SurfelBlock *block, RNUInt64 *mask) const;
 
 private:
   const R2Grid *grid;
@@ -7,6 +7,15 @@
 ////////////////////////////////////////////////////////////////////////
 
 #include "R3Surfels/R3Surfels.h"
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#if (RN_OS != RN_WINDOWS)
+#include <unistd.h>
+#endif
 
 
 
@@ -23,7 +32,31 @@
 ////////////////////////////////////////////////////////////////////////
 
 static unsigned int current_major_version = 3;
-static unsigned int current_minor_version = 1;
+static unsigned int current_minor_version = 2;
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Block cache variables
+////////////////////////////////////////////////////////////////////////
+
+static const unsigned long long default_cache_budget = 256ULL * 1024ULL * 1024ULL;
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Prefetch state
+////////////////////////////////////////////////////////////////////////
+
+struct R3SurfelPrefetchState {
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::deque<R3SurfelBlock *> queue;
+  std::vector<std::thread> threads;
+  unsigned long prefetched_surfels;
+  int nbusy;
+  bool stop;
+};
 
 
 
@@ -46,8 +79,22 @@ R3SurfelDatabase(void)
     bbox(FLT_MAX,FLT_MAX,FLT_MAX,-FLT_MAX,-FLT_MAX,-FLT_MAX),
     name(NULL),
     tree(NULL),
-    resident_surfels(0)
+    resident_surfels(0),
+    compression_precision(0),
+    cache_head(NULL),
+    cache_tail(NULL),
+    cache_budget(default_cache_budget),
+    cached_surfels(0),
+    cache_hits(0),
+    cache_misses(0),
+    prefetch_state(NULL)
 {
+  // Create prefetch state
+  R3SurfelPrefetchState *state = new R3SurfelPrefetchState();
+  state->prefetched_surfels = 0;
+  state->nbusy = 0;
+  state->stop = false;
+  prefetch_state = state;
 }
 
 
@@ -67,7 +114,15 @@ R3SurfelDatabase(const R3SurfelDatabase& database)
     bbox(FLT_MAX,FLT_MAX,FLT_MAX,-FLT_MAX,-FLT_MAX,-FLT_MAX),
     name(strdup(database.name)),
     tree(NULL),
-    resident_surfels(0)
+    resident_surfels(0),
+    compression_precision(database.compression_precision),
+    cache_head(NULL),
+    cache_tail(NULL),
+    cache_budget(database.cache_budget),
+    cached_surfels(0),
+    cache_hits(0),
+    cache_misses(0),
+    prefetch_state(NULL)
 {
   RNAbort("Not implemented");
 }
@@ -77,6 +132,9 @@ R3SurfelDatabase(const R3SurfelDatabase& database)
 R3SurfelDatabase::
 ~R3SurfelDatabase(void)
 {
+  // Stop prefetch threads
+  StopPrefetch();
+
   // Delete tree
   if (tree) delete tree;
 
@@ -106,6 +164,15 @@ SetName(const char *name)
 
 
 
+void R3SurfelDatabase::
+SetCompressionPrecision(RNLength precision)
+{
+  // Set precision of quantized positions for blocks written from now on
+  compression_precision = (precision > 0) ? precision : 0;
+}
+
+
+
 ////////////////////////////////////////////////////////////////////////
 // SURFEL MANIPULATION FUNCTIONS
 ////////////////////////////////////////////////////////////////////////
@@ -173,13 +240,37 @@ InsertBlock(R3SurfelBlock *block)
 void R3SurfelDatabase::
 RemoveBlock(R3SurfelBlock *block)
 {
-  // Just checking
+  // Remove block with database locked
+  mutex.Lock();
+  InternalRemoveBlock(block);
+  mutex.Unlock();
+}
+
+
+
+void R3SurfelDatabase::
+InternalRemoveBlock(R3SurfelBlock *block)
+{
+  // Just checking (called with database locked)
   assert(block->file_read_count == 0);
   assert(block->database == this);
   assert(block->node == NULL);
     
   // Update resident surfels
   if (block->surfels) resident_surfels -= block->NSurfels();
+
+  // Remove block from cache
+  if (IsBlockCached(block)) RemoveCachedBlock(block);
+
+  // Remove block from prefetch queue
+  R3SurfelPrefetchState *state = (R3SurfelPrefetchState *) prefetch_state;
+  if (block->cache_prefetched) ConsumePrefetchedBlock(block);
+  if (state && block->prefetch_queued) {
+    state->mutex.lock();
+    state->queue.erase(std::remove(state->queue.begin(), state->queue.end(), block), state->queue.end());
+    block->prefetch_queued = FALSE;
+    state->mutex.unlock();
+  }
     
   // Update block
   block->UpdateBeforeRemove(this);
@@ -221,14 +312,17 @@ void R3SurfelDatabase::
 RemoveAndDeleteBlock(R3SurfelBlock *block)
 {
   // Check if still referenced
+  mutex.Lock();
   if (block->file_read_count == 0) {
     // Block is not referenced, can simply delete it
-    RemoveBlock(block);
+    InternalRemoveBlock(block);
+    mutex.Unlock();
     delete block;
   }
   else {
     // Block is referenced, mark for delete later
     block->flags.Add(R3_SURFEL_BLOCK_DELETE_PENDING_FLAG);
+    mutex.Unlock();
   }
 }
 
@@ -261,7 +355,28 @@ InsertSubsetBlocks(R3SurfelBlock *block,
   R3SurfelBlock *block1 = new R3SurfelBlock(subset1, block->Origin());
   R3SurfelBlock *block2 = new R3SurfelBlock(subset2, block->Origin());
     
-  // Insert new blocks 
+  // Update block properties
+  block1->UpdateProperties();
+  block2->UpdateProperties();
+
+  // Insert new blocks
+  InsertSubsetBlocks(block, block1, block2);
+
+  // Return new blocks
+  if (blockA) *blockA = block1;
+  if (blockB) *blockB = block2;
+
+  // Return success
+  return 1;
+}
+
+
+
+int R3SurfelDatabase::
+InsertSubsetBlocks(R3SurfelBlock *block, R3SurfelBlock *block1, R3SurfelBlock *block2)
+{
+  // Insert blocks created from subsets of surfels in block (properties must be uptodate)
+  assert(block1 && block2);
   InsertBlock(block1);
   InsertBlock(block2);
 
@@ -281,18 +396,10 @@ InsertSubsetBlocks(R3SurfelBlock *block,
     block2->file_read_count = block->file_read_count;
   }
     
-  // Update block properties
-  block1->UpdateProperties();
-  block2->UpdateProperties();
-
   // Release blocks
   ReleaseBlock(block1);
   ReleaseBlock(block2);
       
-  // Return new blocks
-  if (blockA) *blockA = block1;
-  if (blockB) *blockB = block2;
-
   // Return success
   return 1;
 }
@@ -647,12 +754,25 @@ ReadUnsignedLongLong(FILE *fp, unsigned long long *ptr, int count, int swap_endi
 
 
 
+static void
+SwapSurfel(R3Surfel *ptr, int count)
+{
+  // Swap endian of surfel fields
+  for (int i = 0; i < count; i++) {
+    float *coords = ptr[i].PositionPtr(); swap4(coords, 3);
+    RNInt16 *normals = ptr[i].NormalPtr(); swap2(normals, 3);
+    RNUInt16 *radius = ptr[i].RadiusPtr(); swap2(radius, 1);
+  }
+}
+
+
+
 static int
 ReadSurfel(FILE *fp, R3Surfel *ptr, int count, int swap_endian, 
   unsigned int major_version, unsigned int minor_version)
 {
-  // Check database version
-  if ((major_version == current_major_version) && (minor_version == current_minor_version)) {
+  // Check database version (all minor versions of current major version share surfel layout)
+  if (major_version == current_major_version) {
     // Read surfels all at once into struct
     int sofar = 0;
     while (sofar < count) {
@@ -694,13 +814,7 @@ ReadSurfel(FILE *fp, R3Surfel *ptr, int count, int swap_endian,
   }
 
   // Swap endian
-  if (swap_endian) {
-    for (int i = 0; i < count; i++) {
-      float *coords = ptr[i].PositionPtr(); swap4(coords, 3);
-      RNInt16 *normals = ptr[i].NormalPtr(); swap2(normals, 3);
-      RNUInt16 *radius = ptr[i].RadiusPtr(); swap2(radius, 1);
-    }
-  }
+  if (swap_endian) SwapSurfel(ptr, count);
 
   // Return success
   return 1;
@@ -915,6 +1029,164 @@ WriteSurfel(FILE *fp, R3Surfel *ptr, int count, int swap_endian,
 
 
 
+////////////////////////////////////////////////////////////////////////
+// COMPRESSED SURFEL I/O FUNCTIONS
+////////////////////////////////////////////////////////////////////////
+
+// Compressed blocks store a byte count, the quantization precision, 
+// and then one record per surfel: the differences from the previous surfel 
+// of the quantized position, normal, radius, and id (zigzag varints),
+// followed by the color and flags bytes.  Surfel order is preserved.
+
+static const int max_compressed_surfel_size = 3*5 + 3*3 + 3 + 5 + 4;
+
+
+
+static unsigned char *
+EncodeVarint(unsigned char *ptr, int value)
+{
+  // Zigzag encode value, then write seven bits per byte
+  unsigned int u = ((unsigned int) value << 1) ^ (unsigned int) (value >> 31);
+  while (u >= 0x80) { *(ptr++) = (unsigned char) (u | 0x80); u >>= 7; }
+  *(ptr++) = (unsigned char) u;
+  return ptr;
+}
+
+
+
+static const unsigned char *
+DecodeVarint(const unsigned char *ptr, const unsigned char *end, int *value)
+{
+  // Read seven bits per byte, then zigzag decode value
+  unsigned int u = 0;
+  for (int shift = 0; shift < 35; shift += 7) {
+    if (ptr >= end) return NULL;
+    unsigned char byte = *(ptr++);
+    u |= (unsigned int) (byte & 0x7F) << shift;
+    if (!(byte & 0x80)) { *value = (int) (u >> 1) ^ -((int) (u & 1)); return ptr; }
+  }
+  return NULL;
+}
+
+
+
+static int
+EncodeSurfels(R3Surfel *ptr, int count, RNLength precision, 
+  unsigned char *buffer, unsigned int *nbytes)
+{
+  // Encode surfels into buffer (which must have room for count * max_compressed_surfel_size bytes)
+  unsigned char *bufferp = buffer;
+  int previous_position[3] = { 0, 0, 0 };
+  int previous_normal[3] = { 0, 0, 0 };
+  int previous_radius = 0;
+  unsigned int previous_id = 0;
+  for (int i = 0; i < count; i++) {
+    R3Surfel *surfel = &ptr[i];
+
+    // Encode quantized position
+    for (int j = 0; j < 3; j++) {
+      double q = floor(surfel->Coord(j) / precision + 0.5);
+      if ((q < -(1 << 30)) || (q > (1 << 30))) return 0;
+      int position = (int) q;
+      bufferp = EncodeVarint(bufferp, position - previous_position[j]);
+      previous_position[j] = position;
+    }
+
+    // Encode normal
+    RNInt16 *normal = surfel->NormalPtr();
+    for (int j = 0; j < 3; j++) {
+      bufferp = EncodeVarint(bufferp, normal[j] - previous_normal[j]);
+      previous_normal[j] = normal[j];
+    }
+
+    // Encode radius
+    int radius = *(surfel->RadiusPtr());
+    bufferp = EncodeVarint(bufferp, radius - previous_radius);
+    previous_radius = radius;
+
+    // Encode id
+    unsigned int id = (unsigned int) surfel->ID();
+    bufferp = EncodeVarint(bufferp, (int) (id - previous_id));
+    previous_id = id;
+
+    // Copy color and flags (without mark)
+    const unsigned char *color = surfel->Color();
+    *(bufferp++) = color[0];
+    *(bufferp++) = color[1];
+    *(bufferp++) = color[2];
+    *(bufferp++) = surfel->Flags() & ~R3_SURFEL_MARKED_FLAG;
+  }
+
+  // Return number of bytes
+  *nbytes = (unsigned int) (bufferp - buffer);
+  return 1;
+}
+
+
+
+static int
+DecodeSurfels(const unsigned char *buffer, unsigned int nbytes, RNLength precision, 
+  R3Surfel *ptr, int count)
+{
+  // Decode surfels from buffer
+  const unsigned char *bufferp = buffer;
+  const unsigned char *end = buffer + nbytes;
+  int position[3] = { 0, 0, 0 };
+  int normal[3] = { 0, 0, 0 };
+  int radius = 0;
+  int id = 0;
+  for (int i = 0; i < count; i++) {
+    R3Surfel *surfel = &ptr[i];
+    int delta;
+
+    // Decode position
+    float coords[3];
+    for (int j = 0; j < 3; j++) {
+      if (!(bufferp = DecodeVarint(bufferp, end, &delta))) break;
+      position[j] += delta;
+      coords[j] = (float) (position[j] * precision);
+    }
+    if (!bufferp) break;
+    surfel->SetCoords(coords);
+
+    // Decode normal
+    RNInt16 *normalp = surfel->NormalPtr();
+    for (int j = 0; j < 3; j++) {
+      if (!(bufferp = DecodeVarint(bufferp, end, &delta))) break;
+      normal[j] += delta;
+      normalp[j] = (RNInt16) normal[j];
+    }
+    if (!bufferp) break;
+
+    // Decode radius
+    if (!(bufferp = DecodeVarint(bufferp, end, &delta))) break;
+    radius += delta;
+    *(surfel->RadiusPtr()) = (RNUInt16) radius;
+
+    // Decode id
+    if (!(bufferp = DecodeVarint(bufferp, end, &delta))) break;
+    id = (int) ((unsigned int) id + (unsigned int) delta);
+    surfel->SetID(id);
+
+    // Copy color and flags
+    if (bufferp + 4 > end) { bufferp = NULL; break; }
+    surfel->SetColor(bufferp);
+    surfel->SetFlags(bufferp[3]);
+    bufferp += 4;
+  }
+
+  // Check for truncated data
+  if (!bufferp) {
+    fprintf(stderr, "Unable to decode compressed surfels from database file\n");
+    return 0;
+  }
+
+  // Return success
+  return 1;
+}
+
+
+
 ////////////////////////////////////////////////////////////////////////
 // BLOCK I/O FUNCTIONS
 ////////////////////////////////////////////////////////////////////////
@@ -929,7 +1201,7 @@ InternalReadBlock(R3SurfelBlock *block)
   assert(fp);
   assert(block->database == this);
   assert(block->file_surfels_offset > 0);
-  assert(block->file_surfels_count >= (unsigned int) block->nsurfels);
+  assert(block->flags[R3_SURFEL_BLOCK_COMPRESSED_FLAG] || (block->file_surfels_count >= (unsigned int) block->nsurfels));
 
   // Allocate surfels
   block->surfels = new R3Surfel [ block->nsurfels ];
@@ -939,11 +1211,36 @@ InternalReadBlock(R3SurfelBlock *block)
   }
   
   // Read surfels
-  RNFileSeek(fp, block->file_surfels_offset, RN_FILE_SEEK_SET);
-  if (!ReadSurfel(fp, block->surfels, block->nsurfels, swap_endian, major_version, minor_version)) return 0;
-  
-  // Update resident surfels
-  resident_surfels += block->NSurfels();
+  if (block->flags[R3_SURFEL_BLOCK_COMPRESSED_FLAG]) {
+    // Read header of compressed surfels
+    unsigned char header[sizeof(unsigned int) + sizeof(double)];
+    if (!ReadFileBytes(header, sizeof(header), block->file_surfels_offset)) return 0;
+    unsigned int nbytes;
+    double precision;
+    memcpy(&nbytes, header, sizeof(unsigned int));
+    memcpy(&precision, header + sizeof(unsigned int), sizeof(double));
+    if (swap_endian) { swap4(&nbytes, 1); swap8(&precision, 1); }
+
+    // Read and decode compressed bytes
+    unsigned char *buffer = new unsigned char [ nbytes + 1 ];
+    if (!ReadFileBytes(buffer, nbytes, block->file_surfels_offset + sizeof(header))) { delete [] buffer; return 0; }
+    int status = DecodeSurfels(buffer, nbytes, precision, block->surfels, block->nsurfels);
+    delete [] buffer;
+    if (!status) return 0;
+  }
+  else if (major_version == current_major_version) {
+    // Read surfels all at once into struct
+    if (!ReadFileBytes(block->surfels, block->nsurfels * sizeof(R3Surfel), block->file_surfels_offset)) return 0;
+    if (swap_endian) SwapSurfel(block->surfels, block->nsurfels);
+  }
+  else {
+    // Read surfels of older version element by element (with shared file pointer)
+    mutex.Lock();
+    RNFileSeek(fp, block->file_surfels_offset, RN_FILE_SEEK_SET);
+    int status = ReadSurfel(fp, block->surfels, block->nsurfels, swap_endian, major_version, minor_version);
+    mutex.Unlock();
+    if (!status) return 0;
+  }
 
 #ifdef PRINT_DEBUG
   // Print debug message
@@ -968,6 +1265,9 @@ InternalReleaseBlock(R3SurfelBlock *block)
 
   // Write block
   if (!SyncBlock(block)) return 0;
+
+  // Update prefetch window
+  if (block->cache_prefetched) ConsumePrefetchedBlock(block);
     
 #ifdef R3_SURFEL_DRAW_WITH_DISPLAY_LIST
   // Delete opengl display lists
@@ -1021,7 +1321,7 @@ InternalSyncBlock(R3SurfelBlock *block)
   }
 
   // Check database version
-  if ((major_version != current_major_version) || (minor_version != current_minor_version)) {
+  if (major_version != current_major_version) {
     fprintf(stderr, "Unable to write block to database with different version\n");
     return 0;
   }
@@ -1030,8 +1330,25 @@ InternalSyncBlock(R3SurfelBlock *block)
   assert(fp);
   assert(block->database == this);
 
+  // Compress surfels
+  unsigned char *buffer = NULL;
+  unsigned int nbytes = 0;
+  if (compression_precision > 0) {
+    buffer = new unsigned char [ block->nsurfels * max_compressed_surfel_size ];
+    if (!EncodeSurfels(block->surfels, block->nsurfels, compression_precision, buffer, &nbytes)) {
+      // Positions are out of range for precision -- write uncompressed
+      delete [] buffer;
+      buffer = NULL;
+    }
+  }
+
+  // Compute space needed in file (in units of surfels)
+  unsigned int header_size = sizeof(unsigned int) + sizeof(double);
+  unsigned int file_count = block->nsurfels;
+  if (buffer) file_count = (header_size + nbytes + sizeof(R3Surfel) - 1) / sizeof(R3Surfel);
+
   // Check if surfels can be put at original offset in file
-  if ((block->file_surfels_offset > 0) && ((unsigned int) block->nsurfels <= block->file_surfels_count)) {
+  if ((block->file_surfels_offset > 0) && (file_count <= block->file_surfels_count)) {
     // Surfels fit at original offset in file
     RNFileSeek(fp, block->file_surfels_offset, RN_FILE_SEEK_SET);
   }
@@ -1039,11 +1356,32 @@ InternalSyncBlock(R3SurfelBlock *block)
     // Surfels must be put at end of file
     RNFileSeek(fp, 0, SEEK_END);
     block->file_surfels_offset = RNFileTell(fp);
-    block->file_surfels_count = block->nsurfels;
+    block->file_surfels_count = file_count;
   }
 
   // Write surfels to file
-  if (!WriteSurfel(fp, block->surfels, block->nsurfels, swap_endian, major_version, minor_version)) return 0;
+  if (buffer) {
+    // Write compressed surfels
+    double precision = compression_precision;
+    if (!WriteUnsignedInt(fp, &nbytes, 1, swap_endian)) { delete [] buffer; return 0; }
+    if (!WriteDouble(fp, &precision, 1, swap_endian)) { delete [] buffer; return 0; }
+    if (fwrite(buffer, sizeof(unsigned char), nbytes, fp) != (size_t) nbytes) {
+      fprintf(stderr, "Unable to write compressed surfels to database file\n");
+      delete [] buffer;
+      return 0;
+    }
+    block->flags.Add(R3_SURFEL_BLOCK_COMPRESSED_FLAG);
+    minor_version = current_minor_version;
+    delete [] buffer;
+  }
+  else {
+    // Write uncompressed surfels
+    if (!WriteSurfel(fp, block->surfels, block->nsurfels, swap_endian, major_version, minor_version)) return 0;
+    block->flags.Remove(R3_SURFEL_BLOCK_COMPRESSED_FLAG);
+  }
+
+  // Flush file buffer (blocks are read with positional reads that bypass it)
+  fflush(fp);
 
 #ifdef PRINT_DEBUG
   // Print debug message
@@ -1059,10 +1397,437 @@ InternalSyncBlock(R3SurfelBlock *block)
 
 
 
+////////////////////////////////////////////////////////////////////////
+// MEMORY MANAGEMENT FUNCTIONS
+////////////////////////////////////////////////////////////////////////
+
+int R3SurfelDatabase::
+ReadBlock(R3SurfelBlock *block)
+{
+  // Lock block (other threads reading it wait until it is resident)
+  RNMutex& block_mutex = BlockMutex(block);
+  block_mutex.Lock();
+
+  // Lock database
+  mutex.Lock();
+
+  // Stop prefetching blocks that readers have passed
+  if (block->prefetch_queued) DequeuePrefetchBlocks(block);
+
+  // Check whether block is already resident
+  if ((block->file_read_count > 0) || IsBlockCached(block)) {
+    if (block->file_read_count == 0) {
+      // Block is still resident in cache
+      RemoveCachedBlock(block);
+      cache_hits++;
+    }
+
+    // Update prefetch window
+    if (block->cache_prefetched) ConsumePrefetchedBlock(block);
+
+    // Increment reference count
+    block->file_read_count++;
+    mutex.Unlock();
+    block_mutex.Unlock();
+    return 1;
+  }
+
+  // Update statistics
+  cache_misses++;
+  mutex.Unlock();
+
+  // Read block from file (in parallel with reads of other blocks)
+  if (!InternalReadBlock(block)) {
+    // Delete surfels of block that could not be read (so that it is not resident)
+    if (block->surfels) { delete [] block->surfels; block->surfels = NULL; }
+    block_mutex.Unlock();
+    return 0;
+  }
+
+  // Update resident surfels and increment reference count
+  mutex.Lock();
+  resident_surfels += block->NSurfels();
+  block->file_read_count++;
+  mutex.Unlock();
+
+  // Unlock block
+  block_mutex.Unlock();
+
+  // Return success
+  return 1;
+}
+
+
+
+int R3SurfelDatabase::
+ReleaseBlock(R3SurfelBlock *block)
+{
+  // Lock database
+  mutex.Lock();
+
+  // Check whether block needs to be written and deleted now
+  int status = 1;
+  if (block->file_read_count == 1) {
+    if ((cache_budget == 0) || !block->surfels || block->flags[R3_SURFEL_BLOCK_DELETE_PENDING_FLAG]) {
+      if (!InternalReleaseBlock(block)) { mutex.Unlock(); return 0; }
+    }
+  }
+
+  // Decrement reference count
+  block->file_read_count--;
+
+  // Check if delete pending
+  if (block->file_read_count == 0) {
+    if (block->flags[R3_SURFEL_BLOCK_DELETE_PENDING_FLAG]) {
+      InternalRemoveBlock(block);
+      delete block;
+    }
+    else if (block->surfels) {
+      // Keep block resident until cache is full
+      status = InsertCachedBlock(block);
+    }
+  }
+
+  // Unlock database
+  mutex.Unlock();
+
+  // Return status
+  return status;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////
+// BLOCK CACHE FUNCTIONS
+////////////////////////////////////////////////////////////////////////
+
+void R3SurfelDatabase::
+SetCacheBudget(unsigned long long nbytes)
+{
+  // Set maximum number of bytes in resident unreferenced blocks
+  mutex.Lock();
+  cache_budget = nbytes;
+
+  // Release blocks that no longer fit
+  EvictCachedBlocks(cache_budget);
+  mutex.Unlock();
+}
+
+
+
+int R3SurfelDatabase::
+EmptyCache(void)
+{
+  // Release all unreferenced blocks
+  mutex.Lock();
+  int status = EvictCachedBlocks(0);
+  mutex.Unlock();
+  return status;
+}
+
+
+
+int R3SurfelDatabase::
+InsertCachedBlock(R3SurfelBlock *block)
+{
+  // Just checking
+  assert(block->database == this);
+  assert(block->file_read_count == 0);
+  assert(!IsBlockCached(block));
+
+  // Insert block at head of list (most recently used)
+  block->cache_previous = NULL;
+  block->cache_next = cache_head;
+  if (cache_head) cache_head->cache_previous = block;
+  else cache_tail = block;
+  cache_head = block;
+
+  // Update cached surfels
+  cached_surfels += block->NSurfels();
+
+  // Release least recently used blocks that do not fit
+  return EvictCachedBlocks(cache_budget);
+}
+
+
+
+void R3SurfelDatabase::
+RemoveCachedBlock(R3SurfelBlock *block)
+{
+  // Just checking
+  assert(IsBlockCached(block));
+
+  // Remove block from list
+  if (block->cache_previous) block->cache_previous->cache_next = block->cache_next;
+  else cache_head = block->cache_next;
+  if (block->cache_next) block->cache_next->cache_previous = block->cache_previous;
+  else cache_tail = block->cache_previous;
+  block->cache_previous = NULL;
+  block->cache_next = NULL;
+
+  // Update cached surfels
+  cached_surfels -= block->NSurfels();
+}
+
+
+
+int R3SurfelDatabase::
+EvictCachedBlocks(unsigned long long max_nbytes)
+{
+  // Release least recently used blocks until cache fits in max_nbytes
+  while (cache_tail && (cached_surfels * sizeof(R3Surfel) > max_nbytes)) {
+    R3SurfelBlock *block = cache_tail;
+    RemoveCachedBlock(block);
+    if (!InternalReleaseBlock(block)) return 0;
+  }
+
+  // Return success
+  return 1;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////
+// PREFETCH FUNCTIONS
+////////////////////////////////////////////////////////////////////////
+
+int R3SurfelDatabase::
+PrefetchBlocks(const RNArray<R3SurfelBlock *>& blocks)
+{
+  // Check if prefetched blocks can stay resident
+  R3SurfelPrefetchState *state = (R3SurfelPrefetchState *) prefetch_state;
+  if (!state || !fp || (cache_budget == 0)) return 0;
+
+  // Start prefetch threads
+  mutex.Lock();
+  std::unique_lock<std::mutex> lock(state->mutex);
+  while (state->threads.size() < R3_SURFEL_DATABASE_PREFETCH_THREADS) {
+    state->threads.push_back(std::thread(&R3SurfelDatabase::PrefetchThread, this));
+  }
+
+  // Queue blocks
+  for (int i = 0; i < blocks.NEntries(); i++) {
+    R3SurfelBlock *block = blocks.Kth(i);
+    if (block->database != this) continue;
+    if (block->NSurfels() == 0) continue;
+    if (block->prefetch_queued) continue;
+    block->prefetch_queued = TRUE;
+    state->queue.push_back(block);
+  }
+
+  // Wake up prefetch threads
+  state->changed.notify_all();
+  lock.unlock();
+  mutex.Unlock();
+
+  // Return success
+  return 1;
+}
+
+
+
+void R3SurfelDatabase::
+CancelPrefetch(void)
+{
+  // Check prefetch state
+  R3SurfelPrefetchState *state = (R3SurfelPrefetchState *) prefetch_state;
+  if (!state) return;
+
+  // Remove queued blocks
+  mutex.Lock();
+  std::unique_lock<std::mutex> lock(state->mutex);
+  for (unsigned int i = 0; i < state->queue.size(); i++) state->queue[i]->prefetch_queued = FALSE;
+  state->queue.clear();
+  mutex.Unlock();
+
+  // Wait for blocks being read
+  while (state->nbusy > 0) state->changed.wait(lock);
+}
+
+
+
+void R3SurfelDatabase::
+DequeuePrefetchBlocks(R3SurfelBlock *block)
+{
+  // Remove queued blocks up to block, which readers have passed (called with database locked)
+  R3SurfelPrefetchState *state = (R3SurfelPrefetchState *) prefetch_state;
+  std::unique_lock<std::mutex> lock(state->mutex);
+  while (block->prefetch_queued && !state->queue.empty()) {
+    state->queue.front()->prefetch_queued = FALSE;
+    state->queue.pop_front();
+  }
+  block->prefetch_queued = FALSE;
+}
+
+
+
+void R3SurfelDatabase::
+ConsumePrefetchedBlock(R3SurfelBlock *block)
+{
+  // Remove block from prefetch window (called with database locked)
+  R3SurfelPrefetchState *state = (R3SurfelPrefetchState *) prefetch_state;
+  block->cache_prefetched = FALSE;
+  if (!state) return;
+  std::unique_lock<std::mutex> lock(state->mutex);
+  state->prefetched_surfels -= block->NSurfels();
+  state->changed.notify_all();
+}
+
+
+
+void R3SurfelDatabase::
+PrefetchThread(void)
+{
+  // Read queued blocks until stopped
+  R3SurfelPrefetchState *state = (R3SurfelPrefetchState *) prefetch_state;
+  while (TRUE) {
+    // Wait for queued block that fits in prefetch window
+    R3SurfelBlock *block = NULL;
+    std::unique_lock<std::mutex> lock(state->mutex);
+    while (!state->stop) {
+      if (!state->queue.empty()) {
+        block = state->queue.front();
+        if (state->prefetched_surfels == 0) break;
+        if ((state->prefetched_surfels + block->NSurfels()) * sizeof(R3Surfel) <= cache_budget / 2) break;
+      }
+      block = NULL;
+      state->changed.wait(lock);
+    }
+    lock.unlock();
+    if (!block) break;
+
+    // Lock block and database (same order as ReadBlock)
+    RNMutex& block_mutex = BlockMutex(block);
+    block_mutex.Lock();
+    mutex.Lock();
+
+    // Check if block was removed from queue meanwhile (it may have been deleted)
+    lock.lock();
+    if (state->queue.empty() || (state->queue.front() != block)) {
+      lock.unlock();
+      mutex.Unlock();
+      block_mutex.Unlock();
+      continue;
+    }
+
+    // Remove block from queue
+    state->queue.pop_front();
+    block->prefetch_queued = FALSE;
+    state->nbusy++;
+    lock.unlock();
+
+    // Read block unless it is already resident
+    if ((block->file_read_count == 0) && !IsBlockCached(block)) {
+      // Reference block while reading it (readers of same block wait for block lock)
+      block->file_read_count++;
+      cache_misses++;
+      mutex.Unlock();
+      int status = InternalReadBlock(block);
+      mutex.Lock();
+      resident_surfels += block->NSurfels();
+
+      if (status) {
+        // Add block to prefetch window if nobody else is using it
+        if (block->file_read_count == 1) {
+          block->cache_prefetched = TRUE;
+          lock.lock();
+          state->prefetched_surfels += block->NSurfels();
+          lock.unlock();
+        }
+
+        // Release block (it stays in cache)
+        mutex.Unlock();
+        block_mutex.Unlock();
+        ReleaseBlock(block);
+      }
+      else {
+        // Delete surfels of block that could not be read
+        InternalReleaseBlock(block);
+        block->file_read_count--;
+        if ((block->file_read_count == 0) && block->flags[R3_SURFEL_BLOCK_DELETE_PENDING_FLAG]) {
+          InternalRemoveBlock(block);
+          delete block;
+        }
+        mutex.Unlock();
+        block_mutex.Unlock();
+      }
+    }
+    else {
+      // Block is already resident
+      mutex.Unlock();
+      block_mutex.Unlock();
+    }
+
+    // Notify threads waiting for prefetch to finish
+    lock.lock();
+    state->nbusy--;
+    state->changed.notify_all();
+    lock.unlock();
+  }
+}
+
+
+
+void R3SurfelDatabase::
+StopPrefetch(void)
+{
+  // Check prefetch state
+  R3SurfelPrefetchState *state = (R3SurfelPrefetchState *) prefetch_state;
+  if (!state) return;
+
+  // Stop prefetch threads
+  state->mutex.lock();
+  state->stop = true;
+  for (unsigned int i = 0; i < state->queue.size(); i++) state->queue[i]->prefetch_queued = FALSE;
+  state->queue.clear();
+  state->changed.notify_all();
+  state->mutex.unlock();
+  for (unsigned int i = 0; i < state->threads.size(); i++) state->threads[i].join();
+
+  // Delete prefetch state
+  delete state;
+  prefetch_state = NULL;
+}
+
+
+
 ////////////////////////////////////////////////////////////////////////
 // FILE I/O FUNCTIONS
 ////////////////////////////////////////////////////////////////////////
 
+int R3SurfelDatabase::
+ReadFileBytes(void *buffer, unsigned long long nbytes, unsigned long long offset)
+{
+#if (RN_OS == RN_WINDOWS)
+  // Read bytes at offset with shared file pointer
+  mutex.Lock();
+  RNFileSeek(fp, offset, RN_FILE_SEEK_SET);
+  size_t status = fread(buffer, 1, nbytes, fp);
+  mutex.Unlock();
+  if (status != (size_t) nbytes) {
+    fprintf(stderr, "Unable to read surfels from database file\n");
+    return 0;
+  }
+#else
+  // Read bytes at offset without moving shared file pointer
+  int fd = fileno(fp);
+  char *bufferp = (char *) buffer;
+  while (nbytes > 0) {
+    ssize_t status = pread(fd, bufferp, nbytes, (off_t) offset);
+    if (status <= 0) {
+      fprintf(stderr, "Unable to read surfels from database file\n");
+      return 0;
+    }
+    bufferp += status;
+    nbytes -= status;
+    offset += status;
+  }
+#endif
+
+  // Return success
+  return 1;
+}
+
 int R3SurfelDatabase::
 WriteHeader(FILE *fp, int swap_endian)
 {
@@ -1188,10 +1953,13 @@ SyncFile(void)
   // Check if file is read-only
   if (!strcmp(rwaccess, "rb")) return 1;
 
+  // Lock database (prefetch threads write evicted blocks through the same file pointer)
+  mutex.Lock();
+
   // Sync blocks
   for (int i = 0; i < blocks.NEntries(); i++) {
     R3SurfelBlock *block = blocks.Kth(i);
-    if (!SyncBlock(block)) return 0;
+    if (!SyncBlock(block)) { mutex.Unlock(); return 0; }
   }
 
   // Update blocks offset
@@ -1208,21 +1976,26 @@ SyncFile(void)
   for (int i = 0; i < blocks.NEntries(); i++) {
     R3SurfelBlock *block = blocks.Kth(i);
     unsigned int block_flags = block->flags; 
-    if (!WriteUnsignedLongLong(fp, &block->file_surfels_offset, 1, swap_endian)) return 0;
-    if (!WriteUnsignedInt(fp, &block->file_surfels_count, 1, swap_endian)) return 0;
-    if (!WriteInt(fp, &block->nsurfels, 1, swap_endian)) return 0;
-    if (!WriteDouble(fp, &block->origin[0], 3, swap_endian)) return 0;
-    if (!WriteDouble(fp, &block->bbox[0][0], 6, swap_endian)) return 0;
-    if (!WriteDouble(fp, &block->resolution, 1, swap_endian)) return 0;
-    if (!WriteUnsignedInt(fp, &block_flags, 1, swap_endian)) return 0;
-    if (!WriteChar(fp, buffer, 64, swap_endian)) return 0;
+    int status = 1;
+    status &= WriteUnsignedLongLong(fp, &block->file_surfels_offset, 1, swap_endian);
+    status &= WriteUnsignedInt(fp, &block->file_surfels_count, 1, swap_endian);
+    status &= WriteInt(fp, &block->nsurfels, 1, swap_endian);
+    status &= WriteDouble(fp, &block->origin[0], 3, swap_endian);
+    status &= WriteDouble(fp, &block->bbox[0][0], 6, swap_endian);
+    status &= WriteDouble(fp, &block->resolution, 1, swap_endian);
+    status &= WriteUnsignedInt(fp, &block_flags, 1, swap_endian);
+    status &= WriteChar(fp, buffer, 64, swap_endian);
+    if (!status) { mutex.Unlock(); return 0; }
   }
 
   // Write header again (now that the offset values have been filled in)
-  if (!WriteHeader(fp, swap_endian)) return 0;
+  int status = WriteHeader(fp, swap_endian);
 
-  // Return success
-  return 1;
+  // Unlock database
+  mutex.Unlock();
+
+  // Return status
+  return status;
 }
 
 
@@ -1230,9 +2003,15 @@ SyncFile(void)
 int R3SurfelDatabase::
 CloseFile(void)
 {
+  // Wait for prefetch threads (before writing anything to file)
+  CancelPrefetch();
+
   // Sync file
   if (!SyncFile()) return 0;
 
+  // Release cached blocks
+  if (!EmptyCache()) return 0;
+
   // Close file
   fclose(fp);
   fp = NULL;
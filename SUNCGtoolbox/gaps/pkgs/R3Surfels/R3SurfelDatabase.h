@@ -2,6 +2,18 @@
 
 
 
+////////////////////////////////////////////////////////////////////////
+// CONSTANT DEFINITIONS
+////////////////////////////////////////////////////////////////////////
+
+// Number of locks serializing reads of same block (blocks are mapped to locks by address)
+#define R3_SURFEL_DATABASE_BLOCK_MUTEXES 64
+
+// Number of background threads reading prefetched blocks
+#define R3_SURFEL_DATABASE_PREFETCH_THREADS 4
+
+
+
 ////////////////////////////////////////////////////////////////////////
 // CLASS DEFINITION
 ////////////////////////////////////////////////////////////////////////
@@ -32,6 +44,9 @@ public:
   const R3Box& BBox(void) const;
   R3Point Centroid(void) const;
 
+  // Compression property functions
+  RNLength CompressionPrecision(void) const;
+
 
   //////////////////////////
   //// ACCESS FUNCTIONS ////
@@ -52,6 +67,10 @@ public:
   // Property manipulation functions
   void SetName(const char *name);
 
+  // Compression manipulation functions
+  // (blocks synced afterwards are stored with positions quantized to precision, 0 = uncompressed)
+  void SetCompressionPrecision(RNLength precision);
+
 
   //////////////////////////////////////////
   //// STRUCTURE MANIPULATION FUNCTIONS ////
@@ -66,6 +85,7 @@ public:
   virtual int InsertSubsetBlocks(R3SurfelBlock *block, 
     const RNArray<const R3Surfel *>& subsetA, const RNArray<const R3Surfel *>& subsetB, 
     R3SurfelBlock **blockA, R3SurfelBlock **blockB);
+  virtual int InsertSubsetBlocks(R3SurfelBlock *block, R3SurfelBlock *blockA, R3SurfelBlock *blockB);
 
 
   ///////////////////////////////////////
@@ -81,12 +101,27 @@ public:
   /////////////////////////////////////
 
   // Memory management functions
+  // (ReadBlock and ReleaseBlock may be called concurrently, different blocks are read in parallel)
   int ReadBlock(R3SurfelBlock *block);
   int ReleaseBlock(R3SurfelBlock *block);
   int SyncBlock(R3SurfelBlock *block);
   RNBoolean IsBlockResident(R3SurfelBlock *block) const;
   unsigned long ResidentSurfels(void) const;
 
+  // Block cache functions
+  // (released blocks stay resident until the least recently used ones exceed budget bytes, 0 = release immediately)
+  unsigned long long CacheBudget(void) const;
+  unsigned long CachedSurfels(void) const;
+  unsigned long CacheHits(void) const;
+  unsigned long CacheMisses(void) const;
+  void SetCacheBudget(unsigned long long nbytes);
+  int EmptyCache(void);
+
+  // Prefetch functions
+  // (blocks are read into cache by background threads in order, at most half the cache budget ahead of readers)
+  int PrefetchBlocks(const RNArray<R3SurfelBlock *>& blocks);
+  void CancelPrefetch(void);
+
 
   ///////////////////////
   //// I/O FUNCTIONS ////
@@ -123,9 +158,24 @@ protected:
   virtual int InternalReadBlock(R3SurfelBlock *block);
   virtual int InternalReleaseBlock(R3SurfelBlock *block);
   virtual int InternalSyncBlock(R3SurfelBlock *block);
+  virtual void InternalRemoveBlock(R3SurfelBlock *block);
+
+  // Block cache functions
+  RNBoolean IsBlockCached(R3SurfelBlock *block) const;
+  int InsertCachedBlock(R3SurfelBlock *block);
+  void RemoveCachedBlock(R3SurfelBlock *block);
+  int EvictCachedBlocks(unsigned long long max_nbytes);
+
+  // Prefetch functions
+  void ConsumePrefetchedBlock(R3SurfelBlock *block);
+  void DequeuePrefetchBlocks(R3SurfelBlock *block);
+  void PrefetchThread(void);
+  void StopPrefetch(void);
 
   // Internal functions
   virtual int WriteHeader(FILE *fp, int swap_endian);
+  int ReadFileBytes(void *buffer, unsigned long long nbytes, unsigned long long offset);
+  RNMutex& BlockMutex(R3SurfelBlock *block);
 
 protected:
   FILE *fp;
@@ -143,6 +193,16 @@ protected:
   friend class R3SurfelTree;
   R3SurfelTree *tree;
   unsigned long resident_surfels;
+  RNLength compression_precision;
+  R3SurfelBlock *cache_head;
+  R3SurfelBlock *cache_tail;
+  unsigned long long cache_budget;
+  unsigned long cached_surfels;
+  unsigned long cache_hits;
+  unsigned long cache_misses;
+  RNMutex mutex;
+  RNMutex block_mutexes[R3_SURFEL_DATABASE_BLOCK_MUTEXES];
+  void *prefetch_state;
 };
 
 
@@ -178,6 +238,15 @@ Centroid(void) const
 
 
 
+inline RNLength R3SurfelDatabase::
+CompressionPrecision(void) const
+{
+  // Return precision of quantized positions in compressed blocks
+  return compression_precision;
+}
+
+
+
 inline const char *R3SurfelDatabase::
 Name(void) const
 {
@@ -240,44 +309,56 @@ ResidentSurfels(void) const
 
 
 
-inline int R3SurfelDatabase::
-ReadBlock(R3SurfelBlock *block)
+inline unsigned long long R3SurfelDatabase::
+CacheBudget(void) const
 {
-  // Check whether block needs to be read
-  if (block->file_read_count == 0) {
-    if (!InternalReadBlock(block)) return 0;
-  }
+  // Return maximum number of bytes in resident unreferenced blocks
+  return cache_budget;
+}
 
-  // Increment reference count
-  block->file_read_count++;
 
-  // Return success
-  return 1;
+
+inline unsigned long R3SurfelDatabase::
+CachedSurfels(void) const
+{
+  // Return number of surfels in resident unreferenced blocks
+  return cached_surfels;
 }
 
 
 
-inline int R3SurfelDatabase::
-ReleaseBlock(R3SurfelBlock *block)
+inline unsigned long R3SurfelDatabase::
+CacheHits(void) const
 {
-  // Check whether block needs to be written
-  if (block->file_read_count == 1) {
-    if (!InternalReleaseBlock(block)) return 0;
-  }
+  // Return number of block reads satisfied by cache
+  return cache_hits;
+}
 
-  // Decrement reference count
-  block->file_read_count--;
 
-  // Check if delete pending
-  if (block->file_read_count == 0) {
-    if (block->flags[R3_SURFEL_BLOCK_DELETE_PENDING_FLAG]) {
-      RemoveBlock(block);
-      delete block;
-    }
-  }
 
-  // Return success
-  return 1;
+inline unsigned long R3SurfelDatabase::
+CacheMisses(void) const
+{
+  // Return number of block reads from file
+  return cache_misses;
+}
+
+
+
+inline RNBoolean R3SurfelDatabase::
+IsBlockCached(R3SurfelBlock *block) const
+{
+  // Return whether block is in list of resident unreferenced blocks
+  return (block->cache_previous || block->cache_next || (cache_head == block)) ? TRUE : FALSE;
+}
+
+
+
+inline RNMutex& R3SurfelDatabase::
+BlockMutex(R3SurfelBlock *block)
+{
+  // Return lock serializing reads of block
+  return block_mutexes[(((size_t) block) / sizeof(R3SurfelBlock)) % R3_SURFEL_DATABASE_BLOCK_MUTEXES];
 }
 
 
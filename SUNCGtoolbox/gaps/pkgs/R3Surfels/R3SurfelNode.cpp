@@ -43,6 +43,8 @@ R3SurfelNode(const char *name)
     flags(0),
     data(NULL)
 {
+  // Index blocks for constant time removal
+  blocks.SetIndexed(TRUE);
 }
 
 
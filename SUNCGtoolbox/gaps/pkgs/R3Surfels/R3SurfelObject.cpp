@@ -39,6 +39,8 @@ R3SurfelObject(const char *name)
     bbox(FLT_MAX,FLT_MAX,FLT_MAX,-FLT_MAX,-FLT_MAX,-FLT_MAX),
     data(NULL)
 {
+  // Index nodes for constant time removal
+  nodes.SetIndexed(TRUE);
 }
 
 
@@ -0,0 +1,603 @@
+/* Source file for the R3 surfel point bitset class */
+
+
+
+////////////////////////////////////////////////////////////////////////
+// INCLUDE FILES
+////////////////////////////////////////////////////////////////////////
+
+#include "R3Surfels/R3Surfels.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+
+
+////////////////////////////////////////////////////////////////////////
+// WORD FUNCTIONS
+////////////////////////////////////////////////////////////////////////
+
+static int
+NWords(int nsurfels)
+{
+  // Return number of 64-bit words needed for nsurfels bits
+  return (nsurfels + 63) / 64;
+}
+
+
+
+static int
+CountBits(RNUInt64 word)
+{
+  // Return number of set bits in word
+#if defined(__GNUC__)
+  return __builtin_popcountll(word);
+#else
+  word = word - ((word >> 1) & 0x5555555555555555ULL);
+  word = (word & 0x3333333333333333ULL) + ((word >> 2) & 0x3333333333333333ULL);
+  word = (word + (word >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+  return (int) ((word * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+
+
+static void
+OrWords(RNUInt64 *words1, const RNUInt64 *words2, int nwords)
+{
+  // Set words1 to (words1 | words2)
+  int i = 0;
+#if defined(__SSE2__)
+  for ( ; i + 2 <= nwords; i += 2) {
+    __m128i a = _mm_loadu_si128((const __m128i *) &words1[i]);
+    __m128i b = _mm_loadu_si128((const __m128i *) &words2[i]);
+    _mm_storeu_si128((__m128i *) &words1[i], _mm_or_si128(a, b));
+  }
+#endif
+  for ( ; i < nwords; i++) words1[i] |= words2[i];
+}
+
+
+
+static RNBoolean
+AndWords(RNUInt64 *words1, const RNUInt64 *words2, int nwords)
+{
+  // Set words1 to (words1 & words2), and return whether any bit remains set
+  RNUInt64 any = 0;
+  int i = 0;
+#if defined(__SSE2__)
+  __m128i any2 = _mm_setzero_si128();
+  for ( ; i + 2 <= nwords; i += 2) {
+    __m128i a = _mm_loadu_si128((const __m128i *) &words1[i]);
+    __m128i b = _mm_loadu_si128((const __m128i *) &words2[i]);
+    __m128i c = _mm_and_si128(a, b);
+    _mm_storeu_si128((__m128i *) &words1[i], c);
+    any2 = _mm_or_si128(any2, c);
+  }
+  RNUInt64 anys[2];
+  _mm_storeu_si128((__m128i *) anys, any2);
+  any = anys[0] | anys[1];
+#endif
+  for ( ; i < nwords; i++) any |= (words1[i] &= words2[i]);
+  return (any) ? TRUE : FALSE;
+}
+
+
+
+static RNBoolean
+AndNotWords(RNUInt64 *words1, const RNUInt64 *words2, int nwords1, int nwords2)
+{
+  // Set words1 to (words1 & ~words2), and return whether any bit remains set
+  int nwords = (nwords1 < nwords2) ? nwords1 : nwords2;
+  RNUInt64 any = 0;
+  int i = 0;
+#if defined(__SSE2__)
+  __m128i any2 = _mm_setzero_si128();
+  for ( ; i + 2 <= nwords; i += 2) {
+    __m128i a = _mm_loadu_si128((const __m128i *) &words1[i]);
+    __m128i b = _mm_loadu_si128((const __m128i *) &words2[i]);
+    __m128i c = _mm_andnot_si128(b, a);
+    _mm_storeu_si128((__m128i *) &words1[i], c);
+    any2 = _mm_or_si128(any2, c);
+  }
+  RNUInt64 anys[2];
+  _mm_storeu_si128((__m128i *) anys, any2);
+  any = anys[0] | anys[1];
+#endif
+  for ( ; i < nwords; i++) any |= (words1[i] &= ~words2[i]);
+  for ( ; i < nwords1; i++) any |= words1[i];
+  return (any) ? TRUE : FALSE;
+}
+
+
+
+static RNUInt64 *
+CopyWords(const RNUInt64 *words, int nwords, int nallocated)
+{
+  // Return new array of nallocated words, starting with copy of words
+  RNUInt64 *result = new RNUInt64 [ nallocated ];
+  for (int i = 0; i < nwords; i++) result[i] = words[i];
+  for (int i = nwords; i < nallocated; i++) result[i] = 0;
+  return result;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////
+// CONSTRUCTORS/DESTRUCTORS
+////////////////////////////////////////////////////////////////////////
+
+R3SurfelPointBitSet::
+R3SurfelPointBitSet(void)
+  : entries(NULL),
+    nentries(0),
+    nallocated(0)
+{
+}
+
+
+
+R3SurfelPointBitSet::
+R3SurfelPointBitSet(const R3SurfelPointBitSet& set)
+  : entries(NULL),
+    nentries(0),
+    nallocated(0)
+{
+  // Copy bitsets
+  *this = set;
+}
+
+
+
+R3SurfelPointBitSet::
+R3SurfelPointBitSet(const R3SurfelPointSet *set)
+  : entries(NULL),
+    nentries(0),
+    nallocated(0)
+{
+  // Insert points from set
+  InsertPoints(set);
+}
+
+
+
+R3SurfelPointBitSet::
+~R3SurfelPointBitSet(void)
+{
+  // Delete everything
+  Empty();
+  if (entries) delete [] entries;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////
+// PROPERTY FUNCTIONS
+////////////////////////////////////////////////////////////////////////
+
+int R3SurfelPointBitSet::
+NPoints(void) const
+{
+  // Count set bits
+  int count = 0;
+  for (int i = 0; i < nentries; i++) {
+    const Entry& entry = entries[i];
+    for (int j = 0; j < entry.nwords; j++) {
+      if (entry.words[j]) count += CountBits(entry.words[j]);
+    }
+  }
+
+  // Return number of points
+  return count;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////
+// MEMBERSHIP QUERY FUNCTIONS
+////////////////////////////////////////////////////////////////////////
+
+RNBoolean R3SurfelPointBitSet::
+HasPoint(const R3SurfelBlock *block, int surfel_index) const
+{
+  // Find bitset of block
+  int k = FindEntry(block);
+  if (k < 0) return FALSE;
+
+  // Check bit
+  const Entry& entry = entries[k];
+  int w = surfel_index / 64;
+  if ((w < 0) || (w >= entry.nwords)) return FALSE;
+  return (entry.words[w] & (1ULL << (surfel_index % 64))) ? TRUE : FALSE;
+}
+
+
+
+RNBoolean R3SurfelPointBitSet::
+HasPoint(const R3SurfelPoint& point) const
+{
+  // Check point (block is resident while referenced by point)
+  R3SurfelBlock *block = point.Block();
+  if (!block || !point.Surfel()) return FALSE;
+
+  // Check bit of surfel
+  return HasPoint(block, block->SurfelIndex(point.Surfel()));
+}
+
+
+
+////////////////////////////////////////////////////////////////////////
+// MEMBERSHIP MANIPULATION FUNCTIONS
+////////////////////////////////////////////////////////////////////////
+
+void R3SurfelPointBitSet::
+InsertPoints(R3SurfelBlock *block)
+{
+  // Check block
+  int nsurfels = block->NSurfels();
+  if (nsurfels == 0) return;
+
+  // Set all bits of block
+  Entry *entry = InsertEntry(block);
+  int nwords = NWords(nsurfels);
+  for (int i = 0; i < nwords; i++) entry->words[i] = ~0ULL;
+  if (nsurfels % 64) entry->words[nwords-1] = (1ULL << (nsurfels % 64)) - 1;
+}
+
+
+
+void R3SurfelPointBitSet::
+InsertPoints(R3SurfelBlock *block, const R3SurfelConstraint& constraint)
+{
+  // Check block
+  int nsurfels = block->NSurfels();
+  if (nsurfels == 0) return;
+  if (!constraint.Check(block->BBox())) return;
+
+  // Read block
+  R3SurfelDatabase *database = block->Database();
+  if (database) database->ReadBlock(block);
+
+  // Compute mask of surfels satisfying constraint
+  int nwords = NWords(nsurfels);
+  RNUInt64 *mask = new RNUInt64 [ nwords ];
+  constraint.CheckSurfels(block, mask);
+
+  // Release block
+  if (database) database->ReleaseBlock(block);
+
+  // Or mask into bitset of block
+  Entry *entry = InsertEntry(block);
+  if (entry->nwords < nwords) {
+    RNUInt64 *words = CopyWords(entry->words, entry->nwords, nwords);
+    if (entry->words) delete [] entry->words;
+    entry->words = words;
+    entry->nwords = nwords;
+  }
+  OrWords(entry->words, mask, nwords);
+
+  // Delete mask
+  delete [] mask;
+}
+
+
+
+void R3SurfelPointBitSet::
+InsertPoints(const R3SurfelPointSet *set)
+{
+  // Insert points, remembering last bitset since points are usually grouped by block
+  Entry *entry = NULL;
+  for (int i = 0; i < set->NPoints(); i++) {
+    const R3SurfelPoint *point = set->Point(i);
+    R3SurfelBlock *block = point->Block();
+    if (!block || !point->Surfel()) continue;
+    if (!entry || (entry->block != block)) entry = InsertEntry(block);
+    int surfel_index = block->SurfelIndex(point->Surfel());
+    if (surfel_index >= 64 * entry->nwords) { InsertPoint(block, surfel_index); entry = NULL; continue; }
+    entry->words[surfel_index / 64] |= 1ULL << (surfel_index % 64);
+  }
+}
+
+
+
+void R3SurfelPointBitSet::
+InsertPoint(R3SurfelBlock *block, int surfel_index)
+{
+  // Find or create bitset of block
+  assert(surfel_index >= 0);
+  Entry *entry = InsertEntry(block);
+
+  // Grow bitset if block has more surfels than when bitset was created
+  int w = surfel_index / 64;
+  if (w >= entry->nwords) {
+    RNUInt64 *words = CopyWords(entry->words, entry->nwords, w + 1);
+    if (entry->words) delete [] entry->words;
+    entry->words = words;
+    entry->nwords = w + 1;
+  }
+
+  // Set bit
+  entry->words[w] |= 1ULL << (surfel_index % 64);
+}
+
+
+
+void R3SurfelPointBitSet::
+InsertPoint(const R3SurfelPoint& point)
+{
+  // Check point
+  R3SurfelBlock *block = point.Block();
+  if (!block || !point.Surfel()) return;
+
+  // Set bit of surfel
+  InsertPoint(block, block->SurfelIndex(point.Surfel()));
+}
+
+
+
+void R3SurfelPointBitSet::
+RemovePoint(const R3SurfelBlock *block, int surfel_index)
+{
+  // Find bitset of block
+  int k = FindEntry(block);
+  if (k < 0) return;
+
+  // Clear bit
+  Entry& entry = entries[k];
+  int w = surfel_index / 64;
+  if ((w < 0) || (w >= entry.nwords)) return;
+  entry.words[w] &= ~(1ULL << (surfel_index % 64));
+}
+
+
+
+void R3SurfelPointBitSet::
+RemovePoint(const R3SurfelPoint& point)
+{
+  // Check point
+  R3SurfelBlock *block = point.Block();
+  if (!block || !point.Surfel()) return;
+
+  // Clear bit of surfel
+  RemovePoint(block, block->SurfelIndex(point.Surfel()));
+}
+
+
+
+////////////////////////////////////////////////////////////////////////
+// SET MANIPULATION FUNCTIONS
+////////////////////////////////////////////////////////////////////////
+
+void R3SurfelPointBitSet::
+Empty(void)
+{
+  // Delete bitsets
+  for (int i = 0; i < nentries; i++) {
+    if (entries[i].words) delete [] entries[i].words;
+  }
+
+  // Reset everything (keep entry array for reuse)
+  nentries = 0;
+}
+
+
+
+void R3SurfelPointBitSet::
+Subtract(const R3SurfelPointBitSet *set)
+{
+  // Check set
+  if (set == this) { Empty(); return; }
+
+  // Clear bits of blocks found in both sets (both are sorted by block)
+  int count = 0;
+  int j = 0;
+  for (int i = 0; i < nentries; i++) {
+    Entry& entry = entries[i];
+    while ((j < set->nentries) && (set->entries[j].block < entry.block)) j++;
+    RNBoolean keep = TRUE;
+    if ((j < set->nentries) && (set->entries[j].block == entry.block)) {
+      const Entry& other = set->entries[j];
+      keep = AndNotWords(entry.words, other.words, entry.nwords, other.nwords);
+    }
+
+    // Remove bitsets that became empty
+    if (keep) entries[count++] = entry;
+    else if (entry.words) delete [] entry.words;
+  }
+
+  // Update number of bitsets
+  nentries = count;
+}
+
+
+
+void R3SurfelPointBitSet::
+Intersect(const R3SurfelPointBitSet *set)
+{
+  // Check set
+  if (set == this) return;
+
+  // Keep bits of blocks found in both sets (both are sorted by block)
+  int count = 0;
+  int j = 0;
+  for (int i = 0; i < nentries; i++) {
+    Entry& entry = entries[i];
+    while ((j < set->nentries) && (set->entries[j].block < entry.block)) j++;
+    RNBoolean keep = FALSE;
+    if ((j < set->nentries) && (set->entries[j].block == entry.block)) {
+      const Entry& other = set->entries[j];
+      if (other.nwords < entry.nwords) entry.nwords = other.nwords;
+      keep = AndWords(entry.words, other.words, entry.nwords);
+    }
+
+    // Remove bitsets that became empty
+    if (keep) entries[count++] = entry;
+    else if (entry.words) delete [] entry.words;
+  }
+
+  // Update number of bitsets
+  nentries = count;
+}
+
+
+
+void R3SurfelPointBitSet::
+Union(const R3SurfelPointBitSet *set)
+{
+  // Check set
+  if ((set == this) || (set->nentries == 0)) return;
+
+  // Merge sorted bitsets into new array
+  int nmerged_allocated = nentries + set->nentries;
+  Entry *merged = new Entry [ nmerged_allocated ];
+  int nmerged = 0;
+  int i = 0, j = 0;
+  while ((i < nentries) || (j < set->nentries)) {
+    if ((j == set->nentries) || ((i < nentries) && (entries[i].block < set->entries[j].block))) {
+      // Keep bitset only in this set
+      merged[nmerged++] = entries[i++];
+    }
+    else if ((i == nentries) || (set->entries[j].block < entries[i].block)) {
+      // Copy bitset only in other set
+      const Entry& other = set->entries[j++];
+      Entry& entry = merged[nmerged++];
+      entry.block = other.block;
+      entry.words = CopyWords(other.words, other.nwords, other.nwords);
+      entry.nwords = other.nwords;
+    }
+    else {
+      // Or bitsets found in both sets
+      Entry entry = entries[i++];
+      const Entry& other = set->entries[j++];
+      if (other.nwords > entry.nwords) {
+        RNUInt64 *words = CopyWords(entry.words, entry.nwords, other.nwords);
+        if (entry.words) delete [] entry.words;
+        entry.words = words;
+        entry.nwords = other.nwords;
+      }
+      OrWords(entry.words, other.words, other.nwords);
+      merged[nmerged++] = entry;
+    }
+  }
+
+  // Replace entries
+  if (entries) delete [] entries;
+  entries = merged;
+  nentries = nmerged;
+  nallocated = nmerged_allocated;
+}
+
+
+
+R3SurfelPointBitSet& R3SurfelPointBitSet::
+operator=(const R3SurfelPointBitSet& set)
+{
+  // Check set
+  if (&set == this) return *this;
+
+  // Empty this set
+  Empty();
+
+  // Copy bitsets from other set
+  AllocateEntries(set.nentries);
+  for (int i = 0; i < set.nentries; i++) {
+    const Entry& other = set.entries[i];
+    Entry& entry = entries[i];
+    entry.block = other.block;
+    entry.words = CopyWords(other.words, other.nwords, other.nwords);
+    entry.nwords = other.nwords;
+  }
+
+  // Update number of bitsets
+  nentries = set.nentries;
+
+  // Return this
+  return *this;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////
+// ENTRY FUNCTIONS
+////////////////////////////////////////////////////////////////////////
+
+int R3SurfelPointBitSet::
+FindEntry(const R3SurfelBlock *block) const
+{
+  // Binary search bitsets sorted by block
+  int low = 0;
+  int high = nentries - 1;
+  while (low <= high) {
+    int mid = (low + high) / 2;
+    if (entries[mid].block == block) return mid;
+    else if (entries[mid].block < block) low = mid + 1;
+    else high = mid - 1;
+  }
+
+  // Not found
+  return -1;
+}
+
+
+
+R3SurfelPointBitSet::Entry *R3SurfelPointBitSet::
+InsertEntry(R3SurfelBlock *block)
+{
+  // Find position of block in sorted bitsets (checking end first since blocks are often inserted in order)
+  int k = nentries;
+  if ((nentries > 0) && (entries[nentries-1].block >= block)) {
+    int low = 0;
+    int high = nentries - 1;
+    while (low < high) {
+      int mid = (low + high) / 2;
+      if (entries[mid].block < block) low = mid + 1;
+      else high = mid;
+    }
+    if (entries[low].block == block) return &entries[low];
+    k = low;
+  }
+
+  // Allocate space for bitset
+  if (nentries == nallocated) {
+    if (nentries > 0) AllocateEntries(2 * nentries);
+    else AllocateEntries(4);
+  }
+
+  // Shift later bitsets
+  for (int i = nentries; i > k; i--) entries[i] = entries[i-1];
+  nentries++;
+
+  // Create empty bitset with one bit per surfel of block
+  Entry& entry = entries[k];
+  entry.block = block;
+  entry.nwords = NWords(block->NSurfels());
+  entry.words = (entry.nwords > 0) ? CopyWords(NULL, 0, entry.nwords) : NULL;
+
+  // Return bitset
+  return &entry;
+}
+
+
+
+void R3SurfelPointBitSet::
+AllocateEntries(int n)
+{
+  // Check if already big enough
+  if (n <= nallocated) return;
+
+  // Allocate enough memory to store n bitsets
+  Entry *next_entries = new Entry [ n ];
+
+  // Copy and delete old bitsets
+  if (entries) {
+    for (int i = 0; i < nentries; i++) next_entries[i] = entries[i];
+    delete [] entries;
+  }
+
+  // Update set
+  entries = next_entries;
+  nallocated = n;
+}
+
+
+
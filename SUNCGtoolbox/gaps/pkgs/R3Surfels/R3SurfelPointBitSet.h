@@ -0,0 +1,124 @@
+/* Include file for the R3 surfel point bitset class */
+
+
+
+////////////////////////////////////////////////////////////////////////
+// CLASS DEFINITION
+////////////////////////////////////////////////////////////////////////
+
+// Set of surfels keyed by (block, surfel index), with one bitset per block.
+// Membership is stored in the bitsets only (surfel marks are never touched),
+// so const queries may run concurrently and set operations are word-parallel.
+
+class R3SurfelPointBitSet {
+public:
+  // Constructor functions
+  R3SurfelPointBitSet(void);
+  R3SurfelPointBitSet(const R3SurfelPointBitSet& set);
+  R3SurfelPointBitSet(const R3SurfelPointSet *set);
+  ~R3SurfelPointBitSet(void);
+
+  // Property functions
+  int NPoints(void) const;
+  RNBoolean IsEmpty(void) const;
+
+  // Block access functions
+  int NBlocks(void) const;
+  R3SurfelBlock *Block(int k) const;
+  int BlockNWords(int k) const;
+  const RNUInt64 *BlockWords(int k) const;
+
+  // Membership query functions
+  RNBoolean HasPoint(const R3SurfelBlock *block, int surfel_index) const;
+  RNBoolean HasPoint(const R3SurfelPoint& point) const;
+
+  // Membership manipulation functions
+  void InsertPoints(R3SurfelBlock *block);
+  void InsertPoints(R3SurfelBlock *block, const R3SurfelConstraint& constraint);
+  void InsertPoints(const R3SurfelPointSet *set);
+  void InsertPoint(R3SurfelBlock *block, int surfel_index);
+  void InsertPoint(const R3SurfelPoint& point);
+  void RemovePoint(const R3SurfelBlock *block, int surfel_index);
+  void RemovePoint(const R3SurfelPoint& point);
+
+  // Set manipulation functions
+  void Empty(void);
+  void Subtract(const R3SurfelPointBitSet *set);
+  void Intersect(const R3SurfelPointBitSet *set);
+  void Union(const R3SurfelPointBitSet *set);
+  R3SurfelPointBitSet& operator=(const R3SurfelPointBitSet& set);
+
+
+  ////////////////////////////////////////////////////////////////////////
+  // INTERNAL STUFF BELOW HERE
+  ////////////////////////////////////////////////////////////////////////
+
+  // Bitset of one block (bit i of words[i/64] is surfel i)
+  struct Entry {
+    R3SurfelBlock *block;
+    RNUInt64 *words;
+    int nwords;
+  };
+
+  // Entry functions
+  int FindEntry(const R3SurfelBlock *block) const;
+  Entry *InsertEntry(R3SurfelBlock *block);
+  void AllocateEntries(int n);
+
+private:
+  Entry *entries;
+  int nentries;
+  int nallocated;
+};
+
+
+
+////////////////////////////////////////////////////////////////////////
+// INLINE FUNCTION DEFINITIONS
+////////////////////////////////////////////////////////////////////////
+
+inline RNBoolean R3SurfelPointBitSet::
+IsEmpty(void) const
+{
+  // Return whether set has no points
+  return (NPoints() == 0);
+}
+
+
+
+inline int R3SurfelPointBitSet::
+NBlocks(void) const
+{
+  // Return number of blocks with bitsets (sorted by address)
+  return nentries;
+}
+
+
+
+inline R3SurfelBlock *R3SurfelPointBitSet::
+Block(int k) const
+{
+  // Return block of kth bitset
+  return entries[k].block;
+}
+
+
+
+inline int R3SurfelPointBitSet::
+BlockNWords(int k) const
+{
+  // Return number of 64-bit words in kth bitset
+  return entries[k].nwords;
+}
+
+
+
+inline const RNUInt64 *R3SurfelPointBitSet::
+BlockWords(int k) const
+{
+  // Return words of kth bitset
+  return entries[k].words;
+}
+
+
+
@@ -17,7 +17,8 @@
 R3SurfelPointGraph::
 R3SurfelPointGraph(void)
   : set(),
-    neighbors(NULL),
+    neighbor_offsets(NULL),
+    neighbor_indices(NULL),
     max_neighbors(0),
     max_distance(-1)
 {
@@ -28,18 +29,18 @@ R3SurfelPointGraph(void)
 R3SurfelPointGraph::
 R3SurfelPointGraph(const R3SurfelPointGraph& graph)
   : set(graph.set),
-    neighbors(NULL),
+    neighbor_offsets(NULL),
+    neighbor_indices(NULL),
     max_neighbors(graph.max_neighbors),
     max_distance(graph.max_distance)
 {
   // Copy neighbors
-  neighbors = new RNArray<R3SurfelPoint *> [ NPoints() ];
-  for (int i = 0; i < NPoints(); i++) {
-    neighbors[i].Resize(graph.neighbors[i].NEntries());
-    for (int j = 0; j < graph.neighbors[i].NEntries(); j++) {
-      neighbors[i].Insert(graph.neighbors[i][j]);
-    }
-  }
+  if (!graph.neighbor_offsets) return;
+  size_t nneighbors = graph.neighbor_offsets[NPoints()];
+  neighbor_offsets = new size_t [ NPoints() + 1 ];
+  neighbor_indices = new int [ nneighbors ];
+  for (int i = 0; i <= NPoints(); i++) neighbor_offsets[i] = graph.neighbor_offsets[i];
+  for (size_t i = 0; i < nneighbors; i++) neighbor_indices[i] = graph.neighbor_indices[i];
 }
 
 
@@ -47,20 +48,32 @@ R3SurfelPointGraph(const R3SurfelPointGraph& graph)
 R3SurfelPointGraph::
 R3SurfelPointGraph(const R3SurfelPointSet& set, int max_neighbors, RNLength max_distance)
   : set(set),
-    neighbors(NULL),
+    neighbor_offsets(NULL),
+    neighbor_indices(NULL),
     max_neighbors(max_neighbors),
     max_distance(max_distance)
 {
-  // Allocate neighbors
-  neighbors = new RNArray<R3SurfelPoint *> [ NPoints() ];
-
-  // Find neighbors with kdtree
-  RNArray<R3SurfelPoint *> points;
-  for (int i = 0; i < NPoints(); i++) points.Insert(Point(i));
-  R3Kdtree<R3SurfelPoint *> kdtree(points, SurfelPointPosition, NULL);
-  for (int i = 0; i < NPoints(); i++) {
-    kdtree.FindClosest(Point(i), 0, max_distance, max_neighbors, neighbors[i]);
-  }
+  // Gather point positions
+  int npoints = NPoints();
+  R3Point *positions = new R3Point [ npoints ];
+  RNParallelFor(0, npoints, [&](int i, int) {
+    positions[i] = Point(i)->Position();
+  }, 1024);
+
+  // Find neighbors with flat kdtree (all queries at once)
+  size_t max_entries = (max_neighbors > 0) ? (size_t) npoints * (size_t) max_neighbors : 0;
+  R3FlatKdtree kdtree(positions, npoints);
+  int *indices = new int [ max_entries ];
+  neighbor_offsets = new size_t [ npoints + 1 ];
+  size_t nneighbors = kdtree.FindAllClosest(0, max_distance, max_neighbors, neighbor_offsets, indices);
+
+  // Copy neighbor indices into compact array
+  neighbor_indices = new int [ nneighbors ];
+  for (size_t i = 0; i < nneighbors; i++) neighbor_indices[i] = indices[i];
+
+  // Delete temporary memory
+  delete [] positions;
+  delete [] indices;
 }
 
 
@@ -69,9 +82,13 @@ R3SurfelPointGraph::
 ~R3SurfelPointGraph(void)
 {
   // Delete neighbors
-  if (neighbors) {
-    delete [] neighbors;
-    neighbors = NULL;
+  if (neighbor_offsets) {
+    delete [] neighbor_offsets;
+    neighbor_offsets = NULL;
+  }
+  if (neighbor_indices) {
+    delete [] neighbor_indices;
+    neighbor_indices = NULL;
   }
 }
 
@@ -245,25 +262,26 @@ RemoveOutlierEdges(RNScalar max_zscore)
     stddevs[i] = sqrt(variance);
   }
 
-  // Remove outlier edges
+  // Remove outlier edges (compacting rows of neighbor indices)
+  size_t nneighbors = 0;
   for (int i = 0; i < NPoints(); i++) {
-    if (stddevs[i] == 0) continue;
+    size_t start = neighbor_offsets[i];
+    size_t end = neighbor_offsets[i+1];
+    neighbor_offsets[i] = nneighbors;
     R3SurfelPoint *point0 = Point(i);
     R3Point position0 = point0->Position();
-    for (int j = 0; j < neighbors[i].NEntries(); j++) {
-      R3SurfelPoint *point1 = neighbors[i].Kth(j);
-      R3Point position1 = point1->Position();
-      RNLength edge_length = R3Distance(position0, position1);
-      RNScalar zscore = (edge_length - means[i]) / stddevs[i];
-      if (zscore > max_zscore) {
-        // Remove edge
-        RNArrayEntry *entry = neighbors[i].KthEntry(j);
-        neighbors[i].EntryContents(entry) = neighbors[i].Tail();
-        neighbors[i].RemoveTail();
-        j--;
+    for (size_t j = start; j < end; j++) {
+      if (stddevs[i] > 0) {
+        R3SurfelPoint *point1 = Point(neighbor_indices[j]);
+        R3Point position1 = point1->Position();
+        RNLength edge_length = R3Distance(position0, position1);
+        RNScalar zscore = (edge_length - means[i]) / stddevs[i];
+        if (zscore > max_zscore) continue;
       }
+      neighbor_indices[nneighbors++] = neighbor_indices[j];
     }
   }    
+  neighbor_offsets[NPoints()] = nneighbors;
 
   // Delete temporary memory for edge length statistics
   delete [] means;
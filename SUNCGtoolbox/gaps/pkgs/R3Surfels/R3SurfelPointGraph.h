@@ -46,6 +46,7 @@ public:
   // Surfel neighbor access functions
   int NNeighbors(int surfel_index) const;
   R3SurfelPoint *Neighbor(int surfel_index, int neighbor_index) const;
+  int NeighborIndex(int surfel_index, int neighbor_index) const;
 
 
   //////////////////////////////////
@@ -86,7 +87,8 @@ public:
 
 private:
   R3SurfelPointSet set;
-  RNArray<R3SurfelPoint *> *neighbors;
+  size_t *neighbor_offsets;
+  int *neighbor_indices;
   int max_neighbors;
   RNLength max_distance;
 };
@@ -174,7 +176,17 @@ inline int R3SurfelPointGraph::
 NNeighbors(int surfel_index) const
 {
   // Return number of neighbors
-  return neighbors[surfel_index].NEntries();
+  return (int) (neighbor_offsets[surfel_index+1] - neighbor_offsets[surfel_index]);
+}
+
+
+
+inline int R3SurfelPointGraph::
+NeighborIndex(int surfel_index, int neighbor_index) const
+{
+  // Return point index of neighbor
+  assert((0 <= neighbor_index) && (neighbor_index < NNeighbors(surfel_index)));
+  return neighbor_indices[neighbor_offsets[surfel_index] + neighbor_index];
 }
 
 
@@ -183,7 +195,7 @@ inline R3SurfelPoint *R3SurfelPointGraph::
 Neighbor(int surfel_index, int neighbor_index) const
 {
   // Return neighbor
-  return neighbors[surfel_index][neighbor_index];
+  return Point(NeighborIndex(surfel_index, neighbor_index));
 }
 
 
@@ -224,32 +224,9 @@ InsertPoints(R3SurfelBlock *block, const R2Box& constraint_box)
   if (intersection_box.IsEmpty()) return;
   bbox.Union(intersection_box);
 
-  // Translate constraint by block origin (and store in floats)
-  const R3Point& origin = block->Origin();
-  float xmin = constraint_box[0][0] - origin[0];
-  float ymin = constraint_box[0][1] - origin[1];
-  float xmax = constraint_box[1][0] - origin[0];
-  float ymax = constraint_box[1][1] - origin[1];
-
-  // Allocate space for points
-  AllocatePoints(npoints + block->NSurfels());
-
-  // Read block
-  if (block->database) block->database->ReadBlock(block);
-
-  // Copy points
-  for (int i = 0; i < block->NSurfels(); i++) {
-    const R3Surfel *surfel = block->Surfel(i);
-    if (surfel->X() < xmin) continue;
-    if (surfel->Y() < ymin) continue;
-    if (surfel->X() > xmax) continue;
-    if (surfel->Y() > ymax) continue;
-    points[npoints].Reset(block, surfel);
-    npoints++;
-  }
-
-  // Release block
-  if (block->database) block->database->ReleaseBlock(block);
+  // Insert points inside box
+  R3Box box(constraint_box[0][0], constraint_box[0][1], -FLT_MAX, constraint_box[1][0], constraint_box[1][1], FLT_MAX);
+  InsertMaskedPoints(block, R3SurfelBoxConstraint(box));
 }
 
 
@@ -267,36 +244,8 @@ InsertPoints(R3SurfelBlock *block, const R3Box& constraint_box)
   if (intersection_box.IsEmpty()) return;
   bbox.Union(intersection_box);
 
-  // Translate constraint to block coordinate system (and store in floats)
-  const R3Point& origin = block->Origin();
-  float xmin = constraint_box[0][0] - origin[0];
-  float ymin = constraint_box[0][1] - origin[1];
-  float zmin = constraint_box[0][2] - origin[2];
-  float xmax = constraint_box[1][0] - origin[0];
-  float ymax = constraint_box[1][1] - origin[1];
-  float zmax = constraint_box[1][2] - origin[2];
-
-  // Allocate space for points
-  AllocatePoints(npoints + block->NSurfels());
-
-  // Read block
-  if (block->database) block->database->ReadBlock(block);
-
-  // Copy points
-  for (int i = 0; i < block->NSurfels(); i++) {
-    const R3Surfel *surfel = block->Surfel(i);
-    if (surfel->X() < xmin) continue;
-    if (surfel->Y() < ymin) continue;
-    if (surfel->Z() < zmin) continue;
-    if (surfel->X() > xmax) continue;
-    if (surfel->Y() > ymax) continue;
-    if (surfel->Z() > zmax) continue;
-    points[npoints].Reset(block, surfel);
-    npoints++;
-  }
-
-  // Release block
-  if (block->database) block->database->ReleaseBlock(block);
+  // Insert points inside box
+  InsertMaskedPoints(block, R3SurfelBoxConstraint(constraint_box));
 }
 
 
@@ -315,35 +264,8 @@ InsertPoints(R3SurfelBlock *block, const R3Point& center, RNLength radius, RNCoo
   if (intersection_box.IsEmpty()) return;
   bbox.Union(intersection_box);
 
-  // Translate constraint to block coordinate system (and store in floats)
-  const R3Point& origin = block->Origin();
-  float xc = center[0] - origin[0];
-  float yc = center[1] - origin[1];
-  float zlo = zmin - origin[2];
-  float zhi = zmax - origin[2];
-  float rr = radius * radius;
-
-  // Allocate space for points
-  AllocatePoints(npoints + block->NSurfels());
-
-  // Read block
-  if (block->database) block->database->ReadBlock(block);
-
-  // Copy points
-  for (int i = 0; i < block->NSurfels(); i++) {
-    const R3Surfel *surfel = block->Surfel(i);
-    if (surfel->Z() < zlo) continue;
-    if (surfel->Z() > zhi) continue;
-    float dx = surfel->X() - xc;
-    float dy = surfel->Y() - yc;
-    float dd = dx*dx + dy*dy;
-    if (dd > rr) continue;
-    points[npoints].Reset(block, surfel);
-    npoints++;
-  }
-
-  // Release block
-  if (block->database) block->database->ReleaseBlock(block);
+  // Insert points inside cylinder
+  InsertMaskedPoints(block, R3SurfelCylinderConstraint(center, radius, zmin, zmax));
 }
 
 
@@ -356,23 +278,53 @@ InsertPoints(R3SurfelBlock *block, const R3SurfelConstraint& constraint)
   if (block->NSurfels() == 0) return;
   if (!constraint.Check(block->BBox())) return;
 
-  // Allocate space for points
-  AllocatePoints(npoints + block->NSurfels());
+  // Insert points satisfying constraint (and update bounding box)
+  int npoints_before = npoints;
+  InsertMaskedPoints(block, constraint);
+  for (int i = npoints_before; i < npoints; i++) {
+    bbox.Union(points[i].Position());
+  }
+}
+
+
+
+void R3SurfelPointSet::
+InsertMaskedPoints(R3SurfelBlock *block, const R3SurfelConstraint& constraint)
+{
+  // Allocate mask with one bit per surfel
+  int nsurfels = block->NSurfels();
+  int nwords = (nsurfels + 63) / 64;
+  if (nwords == 0) return;
+  RNUInt64 *mask = new RNUInt64 [ nwords ];
 
   // Read block
   if (block->database) block->database->ReadBlock(block);
 
+  // Check surfels
+  constraint.CheckSurfels(block, mask);
+
+  // Count points
+  int count = 0;
+  for (int w = 0; w < nwords; w++) {
+    for (RNUInt64 bits = mask[w]; bits; bits &= bits - 1) count++;
+  }
+
   // Copy points
-  for (int i = 0; i < block->NSurfels(); i++) {
-    const R3Surfel *surfel = block->Surfel(i);
-    if (!constraint.Check(block, surfel)) continue;
-    points[npoints].Reset(block, surfel);
-    bbox.Union(points[npoints].Position());
-    npoints++;
+  AllocatePoints(npoints + count);
+  for (int w = 0; w < nwords; w++) {
+    RNUInt64 bits = mask[w];
+    for (int i = 64 * w; bits; i++, bits >>= 1) {
+      if (!(bits & 1)) continue;
+      points[npoints].Reset(block, block->Surfel(i));
+      npoints++;
+    }
   }
 
   // Release block
   if (block->database) block->database->ReleaseBlock(block);
+
+  // Delete mask
+  delete [] mask;
 }
 
 
@@ -508,6 +460,46 @@ InsertPoints(const R3SurfelPointSet *set, const R3SurfelConstraint& constraint)
 
 
 
+void R3SurfelPointSet::
+InsertPoints(const R3SurfelPointBitSet *set)
+{
+  // Check set
+  int count = set->NPoints();
+  if (count == 0) return;
+
+  // Allocate space for points
+  AllocatePoints(npoints + count);
+
+  // Insert surfels of each block in order of surfel index
+  for (int k = 0; k < set->NBlocks(); k++) {
+    R3SurfelBlock *block = set->Block(k);
+    const RNUInt64 *words = set->BlockWords(k);
+    int nsurfels = block->NSurfels();
+
+    // Read block
+    if (block->database) block->database->ReadBlock(block);
+
+    // Insert surfels with bits set
+    for (int w = 0; w < set->BlockNWords(k); w++) {
+      RNUInt64 word = words[w];
+      for (int b = 0; word; b++, word >>= 1) {
+        if (!(word & 1)) continue;
+        int surfel_index = 64 * w + b;
+        if (surfel_index >= nsurfels) break;
+        const R3Surfel *surfel = block->Surfel(surfel_index);
+        points[npoints].Reset(block, surfel);
+        bbox.Union(points[npoints].Position());
+        npoints++;
+      }
+    }
+
+    // Release block
+    if (block->database) block->database->ReleaseBlock(block);
+  }
+}
+
+
+
 void R3SurfelPointSet::
 InsertPoint(const R3SurfelPoint& point)
 {
@@ -586,24 +578,25 @@ Empty(void)
 void R3SurfelPointSet::
 Subtract(const R3SurfelPointSet *set)
 {
-  // Clear marks in this point set
-  for (int i = 0; i < npoints; i++) {
-    points[i].SetMark(FALSE);
-  }
+  // Check set
+  if (set == this) { Empty(); return; }
+  if ((npoints == 0) || (set->npoints == 0)) return;
 
-  // Set marks in other point set
-  for (int i = 0; i < set->npoints; i++) {
-    set->points[i].SetMark(TRUE);
-  }
+  // Build bitsets of other point set (surfel marks are not used)
+  R3SurfelPointBitSet members(set);
 
-  // Remove marked points from this point set
+  // Keep points of this point set not in other point set
+  int count = 0;
   for (int i = 0; i < npoints; i++) {
-    if (!points[i].IsMarked()) continue;
-    points[i] = points[npoints-1];
-    npoints--;
-    i--;
+    if (members.HasPoint(points[i])) continue;
+    if (count != i) points[count] = points[i];
+    count++;
   }
 
+  // Release removed points
+  for (int i = count; i < npoints; i++) points[i].Reset(NULL, NULL);
+  npoints = count;
+
   // Update bounding box (conservatively)
   // Do nothing
 }
@@ -613,24 +606,24 @@ Subtract(const R3SurfelPointSet *set)
 void R3SurfelPointSet::
 Intersect(const R3SurfelPointSet *set)
 {
-  // Set marks in this point set
-  for (int i = 0; i < npoints; i++) {
-    points[i].SetMark(TRUE);
-  }
+  // Check set
+  if ((set == this) || (npoints == 0)) return;
 
-  // Clear marks in other point set
-  for (int i = 0; i < set->npoints; i++) {
-    set->points[i].SetMark(FALSE);
-  }
+  // Build bitsets of other point set (surfel marks are not used)
+  R3SurfelPointBitSet members(set);
 
-  // Remove marked points from this point set
+  // Keep points of this point set also in other point set
+  int count = 0;
   for (int i = 0; i < npoints; i++) {
-    if (!points[i].IsMarked()) continue;
-    points[i] = points[npoints-1];
-    npoints--;
-    i--;
+    if (!members.HasPoint(points[i])) continue;
+    if (count != i) points[count] = points[i];
+    count++;
   }
 
+  // Release removed points
+  for (int i = count; i < npoints; i++) points[i].Reset(NULL, NULL);
+  npoints = count;
+
   // Update bounding box (conservatively)
   // Do nothing
 }
@@ -640,30 +633,27 @@ Intersect(const R3SurfelPointSet *set)
 void R3SurfelPointSet::
 Union(const R3SurfelPointSet *set)
 {
-  // Set marks in other point set
-  for (int i = 0; i < set->npoints; i++) {
-    set->points[i].SetMark(TRUE);
-  }
+  // Check set
+  if ((set == this) || (set->npoints == 0)) return;
 
-  // Clear marks in this point set
-  for (int i = 0; i < npoints; i++) {
-    points[i].SetMark(FALSE);
-  }
+  // Build bitsets of this point set (surfel marks are not used)
+  R3SurfelPointBitSet members(this);
 
-  // Count marked points from other point set
-  int count = 0;
-  for (int i = 0; i < set->npoints; i++) {
-    if (!set->points[i].IsMarked()) continue;
-    count++;
-  }
+  // Count points from other point set not in this point set
+  R3SurfelPointBitSet inserted(set);
+  inserted.Subtract(&members);
+  int count = inserted.NPoints();
+  if (count == 0) return;
 
   // Allocate space for points
   AllocatePoints(npoints + count);
 
-  // Insert marked points from other point set
+  // Insert points from other point set not in this point set (each once)
   for (int i = 0; i < set->npoints; i++) {
-    if (!set->points[i].IsMarked()) continue;
-    points[npoints] = set->points[i];
+    const R3SurfelPoint& point = set->points[i];
+    if (!inserted.HasPoint(point)) continue;
+    inserted.RemovePoint(point);
+    points[npoints] = point;
     npoints++;
   }
 
@@ -936,6 +926,7 @@ UpdateNormals(RNScalar max_neighborhood_radius, int max_neighborhood_points) con
   RNArray<R3SurfelPoint *> neighbors;
   R3Point *positions = NULL;
   R3Point *viewpoint = NULL;
+  R3Point estimated_viewpoint(0, 0, 0);
 
   // Compute normals for all points that don't already have them
   for (int i = 0; i < NPoints(); i++) {
@@ -976,7 +967,6 @@ UpdateNormals(RNScalar max_neighborhood_radius, int max_neighborhood_points) con
 
     // Compute scan viewpoint
     if (!viewpoint) {
-      static R3Point estimated_viewpoint(0, 0, 0);
       estimated_viewpoint = Centroid();
       viewpoint = &estimated_viewpoint;
     }
@@ -36,6 +36,7 @@ public:
   virtual void InsertPoints(const R3SurfelPointSet *set, const R2Box& box);
   virtual void InsertPoints(const R3SurfelPointSet *set, const R3Point& center, RNLength radius, RNCoord zmin = -FLT_MAX, RNCoord zmax = FLT_MAX);
   virtual void InsertPoints(const R3SurfelPointSet *set, const R3SurfelConstraint& constraint);
+  virtual void InsertPoints(const R3SurfelPointBitSet *set);
   virtual void InsertPoint(const R3SurfelPoint& point);
   virtual void RemovePoint(const R3SurfelPoint *point);
   virtual void RemovePoint(int k);
@@ -64,6 +65,9 @@ public:
   // INTERNAL STUFF BELOW HERE
   ////////////////////////////////////////////////////////////////////////
 
+  // Insert surfels of block passing constraint.CheckSurfels (without updating bounding box)
+  void InsertMaskedPoints(R3SurfelBlock *block, const R3SurfelConstraint& constraint);
+
   // Update functions
   void UpdateNormals(RNScalar max_neighborhood_radius = 1.0, int max_neighborhood_points = 8) const;
 
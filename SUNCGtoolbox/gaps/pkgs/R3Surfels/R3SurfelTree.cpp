@@ -7,6 +7,8 @@
 ////////////////////////////////////////////////////////////////////////
 
 #include "R3Surfels/R3Surfels.h"
+#include <algorithm>
+#include <vector>
 
 
 
@@ -140,19 +142,9 @@ RemoveNode(R3SurfelNode *node)
 //  HIGH-LEVEL MANIPULATION FUNCTIONS
 ////////////////////////////////////////////////////////////////////////
 
-int R3SurfelTree::
-CreateMultiresolutionBlocks(R3SurfelNode *node, RNScalar multiresolution_factor, RNScalar max_complexity, RNScalar max_resolution)
+static RNScalar
+MultiresolutionTargetResolution(R3SurfelNode *node, RNScalar multiresolution_factor, RNScalar max_complexity, RNScalar max_resolution)
 {
-  // Check node
-  if (node->NBlocks() > 0) return 1;
-  if (node->NParts() == 0) return 1;
-
-  // Create multiresolution blocks for parts
-  for (int i = 0; i < node->NParts(); i++) {
-    R3SurfelNode *part = node->Part(i);
-    if (!CreateMultiresolutionBlocks(part, multiresolution_factor, max_complexity, max_resolution)) return 0;
-  }
-
   // Compute some statistics
   RNScalar total_complexity = 0;
   RNScalar mean_resolution = 0;
@@ -163,8 +155,8 @@ CreateMultiresolutionBlocks(R3SurfelNode *node, RNScalar multiresolution_factor,
   }
 
   // Check statistics
-  if (total_complexity == 0) return 1;
-  if (mean_resolution == 0) return 1;
+  if (total_complexity == 0) return 0;
+  if (mean_resolution == 0) return 0;
   
   // Compute target resolution
   RNScalar target_resolution = multiresolution_factor * mean_resolution;
@@ -176,8 +168,46 @@ CreateMultiresolutionBlocks(R3SurfelNode *node, RNScalar multiresolution_factor,
     if (target_resolution > max_res) target_resolution = max_res;
   }
 
-  // Construct set with surfels sampled from blocks of parts
-  R3SurfelPointSet set;
+  // Return target resolution
+  return target_resolution;
+}
+
+
+
+static RNScalar
+MultiresolutionRandomScalar(unsigned long long *random_state)
+{
+  // Return global random number, or next value of splitmix64 generator if given state
+  if (!random_state) return RNRandomScalar();
+  unsigned long long z = (*random_state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  z = z ^ (z >> 31);
+  return (z >> 11) * (1.0 / 9007199254740992.0);
+}
+
+
+
+static void
+UpdateBlockPropertiesWithoutNormals(R3SurfelBlock *block)
+{
+  // Update cached properties of a block that is not yet shared with other threads
+  // (surfel normals are not estimated here because kdtrees use the global random number generator)
+  block->BBox();
+  block->Resolution();
+  block->HasAerial();
+}
+
+
+
+static R3SurfelBlock *
+CreateMultiresolutionBlock(R3SurfelDatabase *database, R3SurfelNode *node, 
+  RNScalar target_resolution, unsigned long long *random_state)
+{
+  // Copy surfels sampled from blocks of parts, with their global positions
+  // (raw surfels rather than R3SurfelPoints, whose reference counting locks the database)
+  std::vector<R3Surfel> surfels;
+  std::vector<R3Point> positions;
   for (int i = 0; i < node->NParts(); i++) {
     R3SurfelNode *part = node->Part(i);
     for (int j = 0; j < part->NBlocks(); j++) {
@@ -188,36 +218,61 @@ CreateMultiresolutionBlocks(R3SurfelNode *node, RNScalar multiresolution_factor,
           
       // Compute subsampling probability based on block resolution
       RNScalar block_resolution = block->Resolution();
-      if (block_resolution == 0) continue;
+      if (block_resolution == 0) { database->ReleaseBlock(block); continue; }
       RNScalar probability = target_resolution / block_resolution;
           
-      // Insert surfels from block
-      if (probability >= 1) {
-        // Insert all surfels from block
-        set.InsertPoints(block);
-      }
-      else {
-        // Insert subset of surfels from block
-        for (int k = 0; k < block->NSurfels(); k++) {
-          if (RNRandomScalar() > probability) continue;
-          const R3Surfel *surfel = block->Surfel(k);
-          R3SurfelPoint point(block, surfel);
-          set.InsertPoint(point);
-        }
+      // Copy all surfels from block, or a random subset if resolution is too high
+      const R3Point& block_origin = block->Origin();
+      for (int k = 0; k < block->NSurfels(); k++) {
+        if ((probability < 1) && (MultiresolutionRandomScalar(random_state) > probability)) continue;
+        const R3Surfel *surfel = block->Surfel(k);
+        surfels.push_back(*surfel);
+        positions.push_back(R3Point(surfel->X() + block_origin.X(), 
+          surfel->Y() + block_origin.Y(), surfel->Z() + block_origin.Z()));
       }
 
       // Release block
       database->ReleaseBlock(block);
     }
   }
+
+  // Compute origin of new block at centroid of surfels
+  int nsurfels = (int) surfels.size();
+  R3Point origin(0, 0, 0);
+  for (int i = 0; i < nsurfels; i++) {
+    origin[0] += positions[i].X();
+    origin[1] += positions[i].Y();
+    origin[2] += positions[i].Z();
+  }
+  if (nsurfels > 0) origin /= nsurfels;
+
+  // Make surfel coordinates relative to new origin
+  for (int i = 0; i < nsurfels; i++) {
+    R3Surfel& surfel = surfels[i];
+    R3Vector position = positions[i] - origin;
+    surfel.SetCoords(position[0], position[1], position[2]);
+    surfel.SetFlags(surfel.Flags() & ~R3_SURFEL_MARKED_FLAG);
+  }
       
-  // Create block from set
-  R3SurfelBlock *block = new R3SurfelBlock(&set);
-  if (!block) return 0;
+  // Create block from surfels
+  R3SurfelBlock *block = new R3SurfelBlock((nsurfels > 0) ? &surfels[0] : NULL, nsurfels, origin);
+  if (!block) return NULL;
 
+  // Update block properties (except normals, which are updated when block is inserted)
+  UpdateBlockPropertiesWithoutNormals(block);
+
+  // Return block
+  return block;
+}
+
+
+
+static void
+InsertMultiresolutionBlock(R3SurfelDatabase *database, R3SurfelNode *node, R3SurfelBlock *block)
+{
   // Update block properties
   block->UpdateProperties();
-  
+
   // Insert block into database
   database->InsertBlock(block);
         
@@ -229,6 +284,33 @@ CreateMultiresolutionBlocks(R3SurfelNode *node, RNScalar multiresolution_factor,
         
   // Release block
   database->ReleaseBlock(block);
+}
+
+
+
+int R3SurfelTree::
+CreateMultiresolutionBlocks(R3SurfelNode *node, RNScalar multiresolution_factor, RNScalar max_complexity, RNScalar max_resolution)
+{
+  // Check node
+  if (node->NBlocks() > 0) return 1;
+  if (node->NParts() == 0) return 1;
+
+  // Create multiresolution blocks for parts
+  for (int i = 0; i < node->NParts(); i++) {
+    R3SurfelNode *part = node->Part(i);
+    if (!CreateMultiresolutionBlocks(part, multiresolution_factor, max_complexity, max_resolution)) return 0;
+  }
+
+  // Compute target resolution
+  RNScalar target_resolution = MultiresolutionTargetResolution(node, multiresolution_factor, max_complexity, max_resolution);
+  if (target_resolution == 0) return 1;
+
+  // Create block with surfels sampled from blocks of parts
+  R3SurfelBlock *block = CreateMultiresolutionBlock(database, node, target_resolution, NULL);
+  if (!block) return 0;
+
+  // Insert block into database and node
+  InsertMultiresolutionBlock(database, node, block);
 
   // Return success
   return 1;
@@ -239,15 +321,76 @@ CreateMultiresolutionBlocks(R3SurfelNode *node, RNScalar multiresolution_factor,
 int R3SurfelTree::
 CreateMultiresolutionBlocks(RNScalar multiresolution_factor, RNScalar max_complexity)
 {
-#if 0
-  // Create multiresolution blocks for all nodes starting at Root
-  for (int i = 0; i < NNodes(); i++) {
-    R3SurfelNode *node = Node(i);
-    CreateMultiresolutionBlocks(node, multiresolution_factor, max_complexity);
+  // Find nodes needing blocks, with height above deepest such descendent (postorder traversal)
+  std::vector< std::pair<int, R3SurfelNode *> > todo;
+  std::vector< std::pair<R3SurfelNode *, int> > stack;
+  std::vector<int> heights(NNodes(), -1);
+  stack.push_back(std::pair<R3SurfelNode *, int>(RootNode(), 0));
+  while (!stack.empty()) {
+    R3SurfelNode *node = stack.back().first;
+    int visited = stack.back().second;
+    if ((node->NBlocks() > 0) || (node->NParts() == 0)) { stack.pop_back(); continue; }
+    if (!visited) {
+      stack.back().second = 1;
+      for (int i = 0; i < node->NParts(); i++) stack.push_back(std::pair<R3SurfelNode *, int>(node->Part(i), 0));
+      continue;
+    }
+    int height = 0;
+    for (int i = 0; i < node->NParts(); i++) {
+      int part_height = heights[node->Part(i)->TreeIndex()];
+      if (part_height >= height) height = part_height + 1;
+    }
+    heights[node->TreeIndex()] = height;
+    todo.push_back(std::pair<int, R3SurfelNode *>(height, node));
+    stack.pop_back();
+  }
+
+  // Sort nodes by height (parts of nodes with same height are complete when they are processed)
+  std::stable_sort(todo.begin(), todo.end(), 
+    [](const std::pair<int, R3SurfelNode *>& a, const std::pair<int, R3SurfelNode *>& b) { return a.first < b.first; });
+
+  // Seed random numbers of every node from global random numbers (same samples for any number of threads)
+  unsigned long long random_seed = (unsigned long long) (RNRandomScalar() * 9007199254740992.0);
+
+  // Create blocks for batches of nodes with same height
+  int batch_size = 4 * RNNumThreads();
+  std::vector<R3SurfelBlock *> blocks;
+  std::vector<RNScalar> target_resolutions;
+  for (int first = 0; first < (int) todo.size(); ) {
+    // Find batch
+    int last = first + 1;
+    while ((last < (int) todo.size()) && (last - first < batch_size) && (todo[last].first == todo[first].first)) last++;
+    int n = last - first;
+
+    // Compute target resolutions (updates cached properties of parts before threads read them)
+    target_resolutions.assign(n, 0);
+    for (int i = 0; i < n; i++) {
+      R3SurfelNode *node = todo[first + i].second;
+      target_resolutions[i] = MultiresolutionTargetResolution(node, multiresolution_factor, max_complexity, 0);
+      for (int j = 0; j < node->NParts(); j++) {
+        R3SurfelNode *part = node->Part(j);
+        for (int k = 0; k < part->NBlocks(); k++) part->Block(k)->Resolution();
+      }
+    }
+
+    // Create blocks concurrently
+    blocks.assign(n, (R3SurfelBlock *) NULL);
+    RNParallelFor(0, n, [&](int i, int thread) {
+      if (target_resolutions[i] == 0) return;
+      R3SurfelNode *node = todo[first + i].second;
+      unsigned long long random_state = random_seed ^ (0xD1B54A32D192ED03ULL * (node->TreeIndex() + 1));
+      blocks[i] = CreateMultiresolutionBlock(database, node, target_resolutions[i], &random_state);
+    });
+
+    // Insert blocks into database and nodes (releasing them streams them to the file)
+    for (int i = 0; i < n; i++) {
+      if (!blocks[i]) continue;
+      InsertMultiresolutionBlock(database, todo[first + i].second, blocks[i]);
+    }
+
+    // Advance to next batch
+    first = last;
   }
-#else
-  CreateMultiresolutionBlocks(RootNode(), multiresolution_factor, max_complexity);
-#endif
   
   // Return success
   return 1;
@@ -329,18 +472,28 @@ SplitLeafNodeWithKMeansClusteringOfBlocks(R3SurfelTree *tree, R3SurfelNode *node
   ////// INITIALIZE KMEANS ////// 
 
   // Allocate temporary data for kmeans clustering
+  int nblocks = node->NBlocks();
   R3Point *centroids = new R3Point [ nparts ];
-  int *membership = new int [ node->NBlocks() ];
+  R3Point *block_centroids = new R3Point [ nblocks ];
+  int *block_nsurfels = new int [ nblocks ];
+  int *membership = new int [ nblocks ];
+  RNBoolean *changed = new RNBoolean [ nblocks ];
+
+  // Gather block centroids (so that threads do not update block properties)
+  for (int i = 0; i < nblocks; i++) {
+    R3SurfelBlock *block = node->Block(i);
+    block_centroids[i] = block->Centroid();
+    block_nsurfels[i] = block->NSurfels();
+  }
 
   // Initialize kmeans centroids
   for (int i = 0; i < nparts; i++) {
-    int block_index = i * node->NBlocks() / nparts;
-    R3SurfelBlock *block = node->Block(block_index);
-    centroids[i] = block->Centroid();
+    int block_index = i * nblocks / nparts;
+    centroids[i] = block_centroids[block_index];
   }
 
   // Intialize kmeans membership
-  for (int i = 0; i < node->NBlocks(); i++) {
+  for (int i = 0; i < nblocks; i++) {
     membership[i] = -1;
   }
 
@@ -351,40 +504,41 @@ SplitLeafNodeWithKMeansClusteringOfBlocks(R3SurfelTree *tree, R3SurfelNode *node
   RNBoolean done = FALSE;
   const int max_iterations = 16;
   for (int i = 0; i < max_iterations; i++) {
-    // Done when there are no changes in membership
-    done = TRUE;
-
-    // Update kmeans membership
-    for (int j = 0; j < node->NBlocks(); j++) {
-      R3SurfelBlock *block = node->Block(j);
-      R3Point block_centroid = block->Centroid();
+    // Update kmeans membership (blocks are independent)
+    RNParallelFor(0, nblocks, [&](int j, int thread) {
+      changed[j] = FALSE;
       RNLength closest_distance = FLT_MAX;
       for (int k = 0; k < nparts; k++) {
-        RNLength distance = R3SquaredDistance(centroids[k], block_centroid);
+        RNLength distance = R3SquaredDistance(centroids[k], block_centroids[j]);
         if (distance < closest_distance) {
           closest_distance = distance;
-          if (membership[j] != k) done = FALSE;
+          if (membership[j] != k) changed[j] = TRUE;
           membership[j] = k;
         }
       }
+    }, 256);
+
+    // Done when there are no changes in membership
+    done = TRUE;
+    for (int j = 0; j < nblocks; j++) {
+      if (changed[j]) { done = FALSE; break; }
     }
 
     // Check if there were no membership changes 
     if (done) break;
     
-    // Update kmeans centroids
-    for (int j = 0; j < nparts; j++) {
+    // Update kmeans centroids (parts are independent)
+    RNParallelFor(0, nparts, [&](int j, int thread) {
       // Find centroid
       int weight = 0;
       centroids[j] = R3zero_point;
-      for (int k = 0; k < node->NBlocks(); k++) {
+      for (int k = 0; k < nblocks; k++) {
         if (membership[k] != j) continue;
-        R3SurfelBlock *block = node->Block(k);
-        centroids[j] += block->NSurfels() * block->Centroid();
-        weight += block->NSurfels();
+        centroids[j] += block_nsurfels[k] * block_centroids[k];
+        weight += block_nsurfels[k];
       }
       if (weight > 0) centroids[j] /= weight;
-    }
+    });
   }
 
   ////// CREATE PARTS AND REDISTRIBUTE BLOCKS ////// 
@@ -439,7 +593,10 @@ SplitLeafNodeWithKMeansClusteringOfBlocks(R3SurfelTree *tree, R3SurfelNode *node
 
   ////// CLEAN UP ////// 
 
+  delete [] changed;
   delete [] membership;
+  delete [] block_nsurfels;
+  delete [] block_centroids;
   delete [] centroids;
 
   // Return whether anything was split
@@ -655,10 +812,31 @@ SplitNodes(R3SurfelNode *start_node,
     RNLength max_leaf_extent, RNLength max_block_extent,
     int max_levels)
 {
-  // Initialize stack for depth first traversal from root node
+  // Initialize return value
+  int status = 0;
+
+  // Just checking
+  RNScalar max_complexity = max_block_complexity;
+  if (max_complexity > max_leaf_complexity) max_complexity = max_leaf_complexity;
+
+  // Split oversized blocks of all leaf nodes at once (so that blocks are split concurrently)
+  RNArray<R3SurfelBlock *> blocks;
   RNArray<R3SurfelNode *> stack;
   stack.Insert(start_node);
-  int status = 0;
+  while (!stack.IsEmpty()) {
+    R3SurfelNode *node = stack.Tail();
+    stack.RemoveTail();
+    for (int i = 0; i < node->NParts(); i++) stack.Insert(node->Part(i));
+    if (node->NParts() > 0) continue;
+    if (((max_complexity > 0) && (node->Complexity() > max_complexity)) ||
+        ((max_block_extent > 0) && (node->BBox().LongestAxisLength() > max_block_extent))) {
+      for (int i = 0; i < node->NBlocks(); i++) blocks.Insert(node->Block(i));
+    }
+  }
+  status |= SplitBlocks(blocks, max_complexity, max_block_extent);
+
+  // Initialize stack for depth first traversal from root node
+  stack.Insert(start_node);
 
   // Split nodes into manageable sized chunks
   while (!stack.IsEmpty()) {
@@ -853,6 +1031,79 @@ SplitLeafNodes(const R3SurfelConstraint& constraint,
 
 
 
+////////////////////////////////////////////////////////////////////////
+// PREFETCH FUNCTIONS
+////////////////////////////////////////////////////////////////////////
+
+static void
+FindPrefetchBlocks(R3SurfelNode *node, const R3SurfelConstraint *constraint, 
+  RNArray<R3SurfelBlock *>& blocks)
+{
+  // Check node
+  if (constraint && !constraint->Check(node)) return;
+
+  // Check if leaf node
+  if (node->NParts() == 0) {
+    // Insert blocks
+    for (int i = 0; i < node->NBlocks(); i++) {
+      R3SurfelBlock *block = node->Block(i);
+      if (constraint && !constraint->Check(block)) continue;
+      blocks.Insert(block);
+    }
+  }
+  else {
+    // Consider parts
+    for (int i = 0; i < node->NParts(); i++) {
+      R3SurfelNode *part = node->Part(i);
+      FindPrefetchBlocks(part, constraint, blocks);
+    }
+  }
+}
+
+
+
+int R3SurfelTree::
+PrefetchBlocks(R3SurfelNode *node, const R3SurfelConstraint *constraint, const R3Point *viewpoint)
+{
+  // Check database
+  if (!database) return 0;
+
+  // Find blocks in depth-first order (same as traversals creating point sets)
+  RNArray<R3SurfelBlock *> blocks;
+  if (!node) node = RootNode();
+  FindPrefetchBlocks(node, constraint, blocks);
+  if (blocks.IsEmpty()) return 1;
+
+  // Sort blocks by distance from viewpoint
+  if (viewpoint) {
+    std::vector< std::pair<RNLength, int> > distances(blocks.NEntries());
+    for (int i = 0; i < blocks.NEntries(); i++) {
+      RNLength distance = R3Distance(*viewpoint, blocks.Kth(i)->BBox());
+      distances[i] = std::pair<RNLength, int>(distance, i);
+    }
+    std::sort(distances.begin(), distances.end());
+    RNArray<R3SurfelBlock *> sorted_blocks;
+    for (int i = 0; i < blocks.NEntries(); i++) {
+      sorted_blocks.Insert(blocks.Kth(distances[i].second));
+    }
+    blocks = sorted_blocks;
+  }
+
+  // Queue blocks for background reads
+  return database->PrefetchBlocks(blocks);
+}
+
+
+
+void R3SurfelTree::
+CancelPrefetch(void)
+{
+  // Stop reading blocks in background
+  if (database) database->CancelPrefetch();
+}
+
+
+
 ////////////////////////////////////////////////////////////////////////
 // BLOCK MANIPULATION FUNCTIONS
 ////////////////////////////////////////////////////////////////////////
@@ -994,6 +1245,17 @@ SplitBlocks(R3SurfelNode *node, const R3SurfelConstraint& constraint,
 
 
 
+static RNBoolean
+IsBlockSplittable(R3SurfelBlock *block, RNScalar max_complexity, RNScalar max_extent)
+{
+  // Return whether block is too big or has too much complexity
+  if ((max_complexity > 0) && (block->NSurfels() > max_complexity)) return TRUE;
+  if ((max_extent > 0) && (block->BBox().AxisLength(block->BBox().LongestAxis()) > max_extent)) return TRUE;
+  return FALSE;
+}
+
+
+
 int R3SurfelTree::
 SplitBlocks(R3SurfelNode *node, RNScalar max_complexity, RNScalar max_extent)
 {
@@ -1002,31 +1264,108 @@ SplitBlocks(R3SurfelNode *node, RNScalar max_complexity, RNScalar max_extent)
   assert(node->Tree() == this);
   assert(node->tree_index >= 0);
   assert(nodes.Kth(node->tree_index) == node);
+
+  // Make a temporary array of blocks
+  RNArray<R3SurfelBlock *> blocks;
+  for (int i = 0; i < node->NBlocks(); i++) {
+    R3SurfelBlock *block = node->Block(i);
+    blocks.Insert(block);
+  }
+
+  // Split blocks
+  return SplitBlocks(blocks, max_complexity, max_extent);
+}
+
+
+
+int R3SurfelTree::
+SplitBlocks(const RNArray<R3SurfelBlock *>& blocks, RNScalar max_complexity, RNScalar max_extent)
+{
+  // Just checking
   if ((max_extent <= 0) && (max_complexity <= 0)) return 0;
   int status = 0;
   
-  // Make a temporary array of blocks
+  // Make a temporary array of blocks that are too big or have too much complexity
   RNArray<R3SurfelBlock *> splittable_blocks;
-  for (int i = 0; i < node->NBlocks(); i++) {
-    R3SurfelBlock *block = node->Block(i);
+  for (int i = 0; i < blocks.NEntries(); i++) {
+    R3SurfelBlock *block = blocks.Kth(i);
+    assert(block->Node() && (block->Node()->Tree() == this));
+    if (!IsBlockSplittable(block, max_complexity, max_extent)) continue;
     splittable_blocks.Insert(block);
   }
 
-  // Split blocks that are too big or have too much complexity
+  // Split batches of blocks (halves are computed concurrently, then inserted serially)
+  // Batch size does not depend on number of threads, so blocks are ordered deterministically
+  const int batch_size = 64;
+  std::vector<R3SurfelBlock *> batch, halves;
   while (!splittable_blocks.IsEmpty()) {
-    R3SurfelBlock *block = splittable_blocks.Tail();
-    splittable_blocks.RemoveTail();
-    int dim = block->BBox().LongestAxis();
-    if (((max_complexity > 0) && (block->NSurfels() > max_complexity)) || 
-        ((max_extent > 0) && (block->BBox().AxisLength(dim) > max_extent))) {
-      R3SurfelBlock *blockA, *blockB;
+    // Pop batch of blocks from stack
+    batch.clear();
+    while (!splittable_blocks.IsEmpty() && ((int) batch.size() < batch_size)) {
+      batch.push_back(splittable_blocks.Tail());
+      splittable_blocks.RemoveTail();
+    }
+
+    // Read blocks (and update their properties before threads read them)
+    for (int i = 0; i < (int) batch.size(); i++) {
+      database->ReadBlock(batch[i]);
+      batch[i]->Centroid();
+    }
+
+    // Split each block into halves at centroid along longest axis
+    int n = batch.size();
+    halves.assign(2 * n, (R3SurfelBlock *) NULL);
+    RNParallelFor(0, n, [&](int i, int thread) {
+      R3SurfelBlock *block = batch[i];
+      int dim = block->BBox().LongestAxis();
       R3Plane split(block->Centroid(), R3xyz_triad[dim]);
       R3SurfelHalfspaceConstraint constraint(R3Halfspace(split, 0));
-      if (SplitBlock(node, block, constraint, &blockA, &blockB) && blockA && blockB) {
-        splittable_blocks.Insert(blockA);
-        splittable_blocks.Insert(blockB);
-        status = 1;
+      int nwords = (block->NSurfels() + 63) / 64;
+      RNUInt64 *mask = new RNUInt64 [ nwords ];
+      constraint.CheckSurfels(block, mask);
+      RNArray<const R3Surfel *> subset1, subset2;
+      for (int k = 0; k < block->NSurfels(); k++) {
+        if (mask[k / 64] & (1ULL << (k % 64))) subset1.Insert(block->Surfel(k));
+        else subset2.Insert(block->Surfel(k));
       }
+      delete [] mask;
+      if (subset1.IsEmpty() || subset2.IsEmpty()) return;
+      halves[2*i+0] = new R3SurfelBlock(subset1, block->Origin());
+      halves[2*i+1] = new R3SurfelBlock(subset2, block->Origin());
+      UpdateBlockPropertiesWithoutNormals(halves[2*i+0]);
+      UpdateBlockPropertiesWithoutNormals(halves[2*i+1]);
+    });
+
+    // Replace blocks by halves
+    for (int i = 0; i < n; i++) {
+      R3SurfelBlock *block = batch[i];
+      R3SurfelBlock *block1 = halves[2*i+0];
+      R3SurfelBlock *block2 = halves[2*i+1];
+      if (!block1 || !block2) {
+        database->ReleaseBlock(block);
+        continue;
+      }
+
+      // Insert halves into database
+      block1->UpdateProperties();
+      block2->UpdateProperties();
+      database->InsertSubsetBlocks(block, block1, block2);
+
+      // Update node
+      R3SurfelNode *node = block->Node();
+      node->InsertBlock(block1); 
+      node->InsertBlock(block2); 
+      node->RemoveBlock(block);
+
+      // Remove old block
+      block->SetDirty(FALSE);
+      database->ReleaseBlock(block);
+      database->RemoveAndDeleteBlock(block);
+
+      // Split halves further if necessary
+      if (IsBlockSplittable(block1, max_complexity, max_extent)) splittable_blocks.Insert(block1);
+      if (IsBlockSplittable(block2, max_complexity, max_extent)) splittable_blocks.Insert(block2);
+      status = 1;
     }
   }
 
@@ -86,12 +86,24 @@ public:
   int CreateMultiresolutionNodes(RNScalar min_complexity = 8, RNScalar min_resolution = 1.0, RNScalar min_multiresolution_factor = 0.25);
 
 
+  ////////////////////////////
+  //// PREFETCH FUNCTIONS ////
+  ////////////////////////////
+
+  // Prefetch functions
+  // (blocks of leaf nodes satisfying constraint are read in background, 
+  //  in depth-first order or, if viewpoint is given, in order of distance from viewpoint)
+  int PrefetchBlocks(R3SurfelNode *node = NULL, const R3SurfelConstraint *constraint = NULL, const R3Point *viewpoint = NULL);
+  void CancelPrefetch(void);
+
+
   //////////////////////////////////////
   //// BLOCK MANIPULATION FUNCTIONS ////
   //////////////////////////////////////
 
-  // Block splitting based on complexity/size
+  // Block splitting based on complexity/size (blocks are split concurrently, each stays in its node)
   virtual int SplitBlocks(R3SurfelNode *node, RNScalar max_complexity, RNScalar max_extent);
+  virtual int SplitBlocks(const RNArray<R3SurfelBlock *>& blocks, RNScalar max_complexity, RNScalar max_extent);
 
   // Block spliting based on pointset
   virtual int SplitBlocks(R3SurfelNode *node, R3SurfelPointSet& pointset, 
@@ -103,7 +115,7 @@ public:
   virtual int SplitBlocks(R3SurfelNode *node, const R3SurfelConstraint& constraint, 
     RNArray<R3SurfelBlock *> *blocksA = NULL, RNArray<R3SurfelBlock *> *blocksB = NULL);
 
-  // Muiltiresolution block creation
+  // Muiltiresolution block creation (for all nodes, creates blocks of independent subtrees concurrently)
   virtual int CreateMultiresolutionBlocks(R3SurfelNode *node, RNScalar multiresolution_factor = 0.25, RNScalar max_complexity = 0, RNScalar max_resolution = 0);
   virtual int CreateMultiresolutionBlocks(RNScalar multiresolution_factor = 0.25, RNScalar max_complexity = 0);
 
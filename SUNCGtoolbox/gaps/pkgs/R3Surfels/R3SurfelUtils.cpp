@@ -7,6 +7,8 @@
 ////////////////////////////////////////////////////////////////////////
 
 #include "R3Surfels/R3Surfels.h"
+#include <algorithm>
+#include <vector>
 
 
 
@@ -78,9 +80,15 @@ CreatePointSet(R3SurfelScene *scene,
     return NULL;
   }
 
+  // Read blocks in background ahead of traversal
+  tree->PrefetchBlocks(source_node, constraint);
+
   // Insert nodes 
   InsertPoints(pointset, tree, source_node, constraint);
 
+  // Stop reading blocks that were not visited
+  tree->CancelPrefetch();
+
   // Check result
   if (pointset->NPoints() == 0) { 
     delete pointset; 
@@ -248,6 +256,330 @@ CreateBlock(R3SurfelScene *scene,
 
 
 
+////////////////////////////////////////////////////////////////////////
+// Bulk point import
+////////////////////////////////////////////////////////////////////////
+
+static RNUInt64
+MortonBits(RNUInt64 x)
+{
+  // Spread lowest 21 bits of x so that there are two zero bits between each
+  x &= 0x1FFFFFULL;
+  x = (x | (x << 32)) & 0x1F00000000FFFFULL;
+  x = (x | (x << 16)) & 0x1F0000FF0000FFULL;
+  x = (x | (x << 8)) & 0x100F00F00F00F00FULL;
+  x = (x | (x << 4)) & 0x10C30C30C30C30C3ULL;
+  x = (x | (x << 2)) & 0x1249249249249249ULL;
+  return x;
+}
+
+
+
+static void
+RadixSortPass(const RNUInt64 *keys, const int *indices, const int *digits, int n, int nbuckets,
+  RNUInt64 *sorted_keys, int *sorted_indices)
+{
+  // Divide entries into chunks (independent of number of threads, so order is deterministic)
+  const int chunk_size = 65536;
+  int nchunks = (n + chunk_size - 1) / chunk_size;
+  int *offsets = new int [ nchunks * nbuckets ];
+
+  // Count digits of each chunk
+  RNParallelFor(0, nchunks, [&](int c, int thread) {
+    int *counts = &offsets[c * nbuckets];
+    for (int b = 0; b < nbuckets; b++) counts[b] = 0;
+    int end = (c + 1) * chunk_size;
+    if (end > n) end = n;
+    for (int i = c * chunk_size; i < end; i++) counts[digits[i]]++;
+  });
+
+  // Convert counts into starting offsets (bucket major, then chunk)
+  int offset = 0;
+  for (int b = 0; b < nbuckets; b++) {
+    for (int c = 0; c < nchunks; c++) {
+      int count = offsets[c * nbuckets + b];
+      offsets[c * nbuckets + b] = offset;
+      offset += count;
+    }
+  }
+
+  // Scatter entries of each chunk (stable)
+  RNParallelFor(0, nchunks, [&](int c, int thread) {
+    int *next = &offsets[c * nbuckets];
+    int end = (c + 1) * chunk_size;
+    if (end > n) end = n;
+    for (int i = c * chunk_size; i < end; i++) {
+      int k = next[digits[i]]++;
+      sorted_keys[k] = keys[i];
+      sorted_indices[k] = indices[i];
+    }
+  });
+
+  // Delete temporary data
+  delete [] offsets;
+}
+
+
+
+struct ImportRange {
+  R3SurfelNode *node;
+  int begin, end;
+  int shift;
+};
+
+
+
+int
+CreateBlocks(R3SurfelScene *scene,
+  const double *xyz, const unsigned char *rgb, const int *labels, int npoints,
+  R3SurfelNode *parent_node, int max_block_surfels, RNLength surfel_radius)
+{
+  // Get convenient variables
+  if (npoints <= 0) return 0;
+  if (max_block_surfels <= 0) return 0;
+  R3SurfelTree *tree = scene->Tree();
+  if (!tree) return 0;
+  R3SurfelDatabase *database = tree->Database();
+  if (!database) return 0;
+  if (!parent_node) parent_node = tree->RootNode();
+
+  ////// COMPUTE MORTON CODES //////
+
+  // Compute bounding box of points
+  const int chunk_size = 65536;
+  int nchunks = (npoints + chunk_size - 1) / chunk_size;
+  R3Box *chunk_boxes = new R3Box [ nchunks ];
+  RNParallelFor(0, nchunks, [&](int c, int thread) {
+    R3Box box = R3null_box;
+    int end = (c + 1) * chunk_size;
+    if (end > npoints) end = npoints;
+    for (int i = c * chunk_size; i < end; i++) box.Union(R3Point(xyz[3*i], xyz[3*i+1], xyz[3*i+2]));
+    chunk_boxes[c] = box;
+  });
+  R3Box bbox = R3null_box;
+  for (int c = 0; c < nchunks; c++) bbox.Union(chunk_boxes[c]);
+  delete [] chunk_boxes;
+
+  // Compute Morton code of every point (21 bits per dimension)
+  RNUInt64 *keys = new RNUInt64 [ npoints ];
+  int *indices = new int [ npoints ];
+  RNScalar scale[3];
+  for (int dim = 0; dim < 3; dim++) {
+    RNLength length = bbox.AxisLength(dim);
+    scale[dim] = (length > 0) ? 0x1FFFFF / length : 0;
+  }
+  RNParallelFor(0, npoints, [&](int i, int thread) {
+    RNUInt64 q[3];
+    for (int dim = 0; dim < 3; dim++) {
+      q[dim] = (RNUInt64) ((xyz[3*i+dim] - bbox.Min()[dim]) * scale[dim]);
+      if (q[dim] > 0x1FFFFF) q[dim] = 0x1FFFFF;
+    }
+    keys[i] = (MortonBits(q[0]) << 2) | (MortonBits(q[1]) << 1) | MortonBits(q[2]);
+    indices[i] = i;
+  }, 4096);
+
+  ////// SORT POINTS //////
+
+  // Radix sort points by Morton code, 8 bits per pass
+  RNUInt64 *sorted_keys = new RNUInt64 [ npoints ];
+  int *sorted_indices = new int [ npoints ];
+  int *digits = new int [ npoints ];
+  for (int shift = 0; shift < 64; shift += 8) {
+    // Compute digits (skip pass if all are same)
+    RNParallelFor(0, npoints, [&](int i, int thread) {
+      digits[i] = (int) ((keys[i] >> shift) & 0xFF);
+    }, 4096);
+    RNBoolean same = TRUE;
+    for (int i = 1; i < npoints; i++) {
+      if (digits[i] != digits[0]) { same = FALSE; break; }
+    }
+    if (same) continue;
+
+    // Sort by digits
+    RadixSortPass(keys, indices, digits, npoints, 256, sorted_keys, sorted_indices);
+    std::swap(keys, sorted_keys);
+    std::swap(indices, sorted_indices);
+  }
+
+  // Sort points by label (stable, so points of each label stay in Morton order)
+  std::vector<int> label_values;
+  std::vector<int> label_ends;
+  if (labels) {
+    // Find distinct labels
+    label_values.assign(labels, labels + npoints);
+    std::sort(label_values.begin(), label_values.end());
+    label_values.erase(std::unique(label_values.begin(), label_values.end()), label_values.end());
+
+    // Sort by label rank
+    int nlabels = label_values.size();
+    if (nlabels > 1) {
+      RNParallelFor(0, npoints, [&](int i, int thread) {
+        int label = labels[indices[i]];
+        digits[i] = std::lower_bound(label_values.begin(), label_values.end(), label) - label_values.begin();
+      }, 4096);
+      RadixSortPass(keys, indices, digits, npoints, nlabels, sorted_keys, sorted_indices);
+      std::swap(keys, sorted_keys);
+      std::swap(indices, sorted_indices);
+    }
+
+    // Find end of range of each label
+    for (int i = 1; i < npoints; i++) {
+      if (labels[indices[i]] != labels[indices[i-1]]) label_ends.push_back(i);
+    }
+  }
+  label_ends.push_back(npoints);
+  delete [] sorted_keys;
+  delete [] sorted_indices;
+  delete [] digits;
+
+  ////// CREATE NODES //////
+
+  // Create top-level node for each label (or one for all points)
+  std::vector<ImportRange> stack;
+  std::vector<R3SurfelNode *> nodes;
+  std::vector<R3SurfelObject *> objects;
+  for (int k = 0; k < (int) label_ends.size(); k++) {
+    int begin = (k > 0) ? label_ends[k-1] : 0;
+    int end = label_ends[k];
+    char name[256];
+    if (labels) sprintf(name, "%d", labels[indices[begin]]);
+    R3SurfelNode *node = new R3SurfelNode((labels) ? name : NULL);
+    tree->InsertNode(node, parent_node);
+    nodes.push_back(node);
+    ImportRange range = { node, begin, end, 60 };
+    stack.push_back(range);
+
+    // Create object for label
+    if (labels) {
+      R3SurfelObject *object = new R3SurfelObject(name);
+      scene->InsertObject(object, scene->RootObject());
+      object->InsertNode(node);
+      objects.push_back(object);
+    }
+  }
+
+  // Split ranges into octants until they fit in blocks
+  std::vector<ImportRange> leaves;
+  while (!stack.empty()) {
+    ImportRange range = stack.back();
+    stack.pop_back();
+
+    // Check if range is small enough for blocks
+    if ((range.end - range.begin <= max_block_surfels) || (range.shift < 0)) {
+      leaves.push_back(range);
+      continue;
+    }
+
+    // Find octants (points of range share all key bits above shift)
+    int bounds[9];
+    int noctants = 0;
+    RNUInt64 prefix = (keys[range.begin] >> (range.shift + 3)) << (range.shift + 3);
+    bounds[0] = range.begin;
+    for (int c = 0; c < 8; c++) {
+      RNUInt64 octant_end = prefix + ((RNUInt64) (c + 1) << range.shift);
+      bounds[c+1] = (c == 7) ? range.end : std::lower_bound(keys + bounds[c], keys + range.end, octant_end) - keys;
+      if (bounds[c+1] > bounds[c]) noctants++;
+    }
+
+    // Descend without creating node if all points are in one octant
+    if (noctants == 1) {
+      range.shift -= 3;
+      stack.push_back(range);
+      continue;
+    }
+
+    // Create node for every octant with points
+    for (int c = 7; c >= 0; c--) {
+      if (bounds[c+1] == bounds[c]) continue;
+      R3SurfelNode *node = new R3SurfelNode();
+      tree->InsertNode(node, range.node);
+      nodes.push_back(node);
+      ImportRange octant = { node, bounds[c], bounds[c+1], range.shift - 3 };
+      stack.push_back(octant);
+    }
+  }
+
+  // Divide leaf ranges into blocks
+  std::vector<ImportRange> block_ranges;
+  for (int i = 0; i < (int) leaves.size(); i++) {
+    const ImportRange& leaf = leaves[i];
+    for (int begin = leaf.begin; begin < leaf.end; begin += max_block_surfels) {
+      int end = begin + max_block_surfels;
+      if (end > leaf.end) end = leaf.end;
+      ImportRange block_range = { leaf.node, begin, end, leaf.shift };
+      block_ranges.push_back(block_range);
+    }
+  }
+
+  ////// CREATE BLOCKS //////
+
+  // Allocate one buffer of surfels per thread
+  int nthreads = RNNumThreads();
+  if (nthreads < 1) nthreads = 1;
+  R3Surfel **thread_surfels = new R3Surfel * [ nthreads ];
+  for (int t = 0; t < nthreads; t++) thread_surfels[t] = new R3Surfel [ max_block_surfels ];
+
+  // Create batches of blocks (concurrently), then insert them into database and tree (serially)
+  const int batch_size = 64;
+  int nblocks = block_ranges.size();
+  R3SurfelBlock *blocks[batch_size];
+  for (int first = 0; first < nblocks; first += batch_size) {
+    int n = (first + batch_size <= nblocks) ? batch_size : nblocks - first;
+
+    // Create blocks
+    RNParallelFor(0, n, [&](int i, int thread) {
+      const ImportRange& range = block_ranges[first + i];
+
+      // Compute origin at center of points
+      R3Box box = R3null_box;
+      for (int j = range.begin; j < range.end; j++) {
+        const double *p = &xyz[3*indices[j]];
+        box.Union(R3Point(p[0], p[1], p[2]));
+      }
+      R3Point origin = box.Centroid();
+
+      // Fill surfels
+      R3Surfel *surfels = thread_surfels[thread];
+      for (int j = range.begin; j < range.end; j++) {
+        int index = indices[j];
+        const double *p = &xyz[3*index];
+        R3Surfel *surfel = &surfels[j - range.begin];
+        if (rgb) *surfel = R3Surfel(p[0] - origin.X(), p[1] - origin.Y(), p[2] - origin.Z(), rgb[3*index], rgb[3*index+1], rgb[3*index+2]);
+        else *surfel = R3Surfel(p[0] - origin.X(), p[1] - origin.Y(), p[2] - origin.Z());
+        if (surfel_radius > 0) surfel->SetRadius(surfel_radius);
+      }
+
+      // Create block
+      blocks[i] = new R3SurfelBlock(surfels, range.end - range.begin, origin);
+    });
+
+    // Insert blocks
+    for (int i = 0; i < n; i++) {
+      R3SurfelBlock *block = blocks[i];
+      R3SurfelNode *node = block_ranges[first + i].node;
+      block->UpdateProperties();
+      database->InsertBlock(block);
+      node->InsertBlock(block);
+      database->ReleaseBlock(block);
+    }
+  }
+
+  // Update properties of nodes (in reverse order of creation, so parts are updated first)
+  for (int i = (int) nodes.size() - 1; i >= 0; i--) nodes[i]->UpdateProperties();
+  for (int i = 0; i < (int) objects.size(); i++) objects[i]->UpdateProperties();
+
+  // Delete temporary data
+  for (int t = 0; t < nthreads; t++) delete [] thread_surfels[t];
+  delete [] thread_surfels;
+  delete [] keys;
+  delete [] indices;
+
+  // Return number of blocks
+  return nblocks;
+}
+
+
+
 ////////////////////////////////////////////////////////////////////////
 // Node creation
 ////////////////////////////////////////////////////////////////////////
@@ -2126,9 +2458,9 @@ CreateClusterObjects(R3SurfelScene *scene, R3SurfelPointGraph *graph,
     const R3Vector& normal0 = (normals) ? normals[index0] : R3zero_vector;
     R3Plane plane0(position0, normal0);
     for (int j = 0; j < graph->NNeighbors(index0); j++) {
-      R3SurfelPoint *point1 = graph->Neighbor(index0, j);
-      int index1 = graph->PointIndex(point1);
+      int index1 = graph->NeighborIndex(index0, j);
       if (index1 < index0) continue;
+      R3SurfelPoint *point1 = graph->Point(index1);
       R3Point position1 = point1->Position();
 
       // Compute plane similarity
@@ -44,6 +44,19 @@ R3SurfelBlock *CreateBlock(R3SurfelScene *scene,
 
 
 
+////////////////////////////////////////////////////////////////////////
+// Bulk point import
+////////////////////////////////////////////////////////////////////////
+
+// Creates blocks from contiguous buffers of npoints xyz coordinates, rgb colors (optional), 
+// and labels (optional), with an octree of nodes built from the Morton order of the points.
+// A node and object is created for every label.  Returns number of blocks created.
+int CreateBlocks(R3SurfelScene *scene,
+  const double *xyz, const unsigned char *rgb, const int *labels, int npoints,
+  R3SurfelNode *parent_node = NULL, int max_block_surfels = 4096, RNLength surfel_radius = 0);
+
+
+
 ////////////////////////////////////////////////////////////////////////
 // Node creation
 ////////////////////////////////////////////////////////////////////////
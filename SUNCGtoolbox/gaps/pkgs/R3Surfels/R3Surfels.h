@@ -36,6 +36,7 @@ class R3SurfelDatabase;
 class R3SurfelConstraint;
 class R3SurfelPoint;
 class R3SurfelPointSet;
+class R3SurfelPointBitSet;
 class R3SurfelPointGraph;
 class R3SurfelNode;
 class R3SurfelNodeSet;
@@ -66,6 +67,7 @@ class R3SurfelScene;
 #include "R3Surfels/R3SurfelConstraint.h"
 #include "R3Surfels/R3SurfelPoint.h"
 #include "R3Surfels/R3SurfelPointSet.h"
+#include "R3Surfels/R3SurfelPointBitSet.h"
 #include "R3Surfels/R3SurfelPointGraph.h"
 #include "R3Surfels/R3SurfelNode.h"
 #include "R3Surfels/R3SurfelNodeSet.h"
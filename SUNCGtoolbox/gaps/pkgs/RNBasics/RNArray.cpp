@@ -14,6 +14,123 @@ static const int RN_ARRAY_MIN_ALLOCATED = 1;
 
 
 
+/* Index from data to entries (open addressing hash table with linear probing) */
+
+struct RNArrayIndex {
+    struct Slot { const void *data; int k; } *slots;
+    int nslots;
+    int nused;
+};
+
+
+
+static int
+IndexHome(const RNArrayIndex *index, const void *data)
+{
+    // Return home slot of data (mix pointer bits, since low ones are mostly zero)
+    unsigned long long h = (unsigned long long) (size_t) data * 0x9E3779B97F4A7C15ULL;
+    return (int) ((h ^ (h >> 32)) & (unsigned long long) (index->nslots - 1));
+}
+
+
+
+static int
+IndexFind(const RNArrayIndex *index, const void *data)
+{
+    // Return slot with data, or -1 if not found
+    if (index->nused == 0) return -1;
+    int slot = IndexHome(index, data);
+    while (index->slots[slot].data) {
+        if (index->slots[slot].data == data) return slot;
+        slot = (slot + 1) & (index->nslots - 1);
+    }
+    return -1;
+}
+
+
+
+static void
+IndexClear(RNArrayIndex *index, int n)
+{
+    // Allocate empty slots for at least n entries (keeping table at most half full)
+    int nslots = (n > 0) ? 4 : 0;
+    while (nslots < 2 * n) nslots *= 2;
+    if (nslots != index->nslots) {
+        if (index->slots) free(index->slots);
+        index->slots = NULL;
+        if (nslots > 0) {
+            index->slots = (RNArrayIndex::Slot *) malloc(nslots * sizeof(RNArrayIndex::Slot));
+            assert(index->slots);
+        }
+        index->nslots = nslots;
+    }
+    if (nslots > 0) memset(index->slots, 0, nslots * sizeof(RNArrayIndex::Slot));
+    index->nused = 0;
+}
+
+
+
+static void
+IndexSet(RNArrayIndex *index, const void *data, int k)
+{
+    // Update entry of data if already indexed
+    int slot = IndexFind(index, data);
+    if (slot >= 0) { index->slots[slot].k = k; return; }
+
+    // Grow table to keep it at most half full
+    if (2 * (index->nused + 1) > index->nslots) {
+        RNArrayIndex::Slot *old_slots = index->slots;
+        int old_nslots = index->nslots;
+        index->slots = NULL;
+        index->nslots = 0;
+        IndexClear(index, index->nused + 1);
+        for (int i = 0; i < old_nslots; i++) {
+            if (!old_slots[i].data) continue;
+            int s = IndexHome(index, old_slots[i].data);
+            while (index->slots[s].data) s = (s + 1) & (index->nslots - 1);
+            index->slots[s] = old_slots[i];
+            index->nused++;
+        }
+        if (old_slots) free(old_slots);
+    }
+
+    // Insert data into empty slot
+    slot = IndexHome(index, data);
+    while (index->slots[slot].data) slot = (slot + 1) & (index->nslots - 1);
+    index->slots[slot].data = data;
+    index->slots[slot].k = k;
+    index->nused++;
+}
+
+
+
+static void
+IndexErase(RNArrayIndex *index, const void *data)
+{
+    // Find slot with data
+    int slot = IndexFind(index, data);
+    if (slot < 0) return;
+
+    // Shift following slots of probe sequence back into hole
+    int mask = index->nslots - 1;
+    int hole = slot;
+    int next = (hole + 1) & mask;
+    while (index->slots[next].data) {
+        int home = IndexHome(index, index->slots[next].data);
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            index->slots[hole] = index->slots[next];
+            hole = next;
+        }
+        next = (next + 1) & mask;
+    }
+
+    // Clear hole
+    index->slots[hole].data = NULL;
+    index->nused--;
+}
+
+
+
 /* Public functions */
 
 int 
@@ -36,7 +153,8 @@ RNVArray::
 RNVArray(void)
     : entries(NULL),
       nallocated(0),
-      nentries(0)
+      nentries(0),
+      index(NULL)
 {
 }
 
@@ -46,10 +164,14 @@ RNVArray::
 RNVArray(const RNVArray& array)
     : entries(NULL),
       nallocated(0),
-      nentries(0)
+      nentries(0),
+      index(NULL)
 {
     // Copy array
     *this = array;
+
+    // Copy indexed mode
+    if (array.index) SetIndexed(TRUE);
 }
 
 
@@ -60,6 +182,9 @@ RNVArray::
 {
     // Free memory for entries
     if (entries) free(entries);
+
+    // Free memory for index
+    SetIndexed(FALSE);
 }
 
 
@@ -68,6 +193,13 @@ RNVArray::
 RNArrayEntry *RNVArray::
 FindEntry(const void *data) const
 {
+    // Look up entry matching data in index
+    if (index) {
+        int slot = IndexFind(index, data);
+        if (slot < 0) return NULL;
+        return &entries[index->slots[slot].k];
+    }
+
     // Search for entry matching data
     for (int i = 0; i < nentries; i++) 
         if (entries[i] == data) return &entries[i];
@@ -89,11 +221,14 @@ InternalInsert(void *data, int k)
     nentries++;
 
     // Shift entries up one notch 
-    if (k < (nentries-1)) Shift(k, 0, 1);
+    if (k < (nentries-1)) memmove(&entries[k+1], &entries[k], (nentries-1-k) * sizeof(RNArrayEntry));
 
     // Copy data into kth entry
     entries[k] = data;
 
+    // Update index of kth and shifted entries
+    if (index) UpdateIndex(k, nentries);
+
     // Return entry
     return &entries[k];
 }
@@ -103,11 +238,72 @@ InternalInsert(void *data, int k)
 void RNVArray::
 InternalRemove(int k) 
 {
+    // Remove kth entry from index
+    if (index) IndexErase(index, entries[k]);
+
     // Shift entries down one notch
-    if (k < (nentries-1)) Shift(k+1, 0, -1);
+    if (k < (nentries-1)) memmove(&entries[k], &entries[k+1], (nentries-1-k) * sizeof(RNArrayEntry));
 
     // Decrement number of entries
     nentries--;
+
+    // Update index of shifted entries
+    if (index) UpdateIndex(k, nentries);
+}
+
+
+
+void RNVArray::
+UpdateIndex(int start, int end)
+{
+    // Update index of entries from start to end (exclusive)
+    for (int i = start; i < end; i++) IndexSet(index, entries[i], i);
+}
+
+
+
+void RNVArray::
+Remove(const void *data)
+{
+    // Check if indexed
+    if (!index) {
+        // Remove data from array
+        RemoveEntry(FindEntry(data));
+    }
+    else {
+        // Replace entry with tail (without shifting other entries)
+        RNArrayEntry *entry = FindEntry(data);
+        assert(entry);
+        int k = EntryIndex(entry);
+        IndexErase(index, data);
+        if (k < (nentries-1)) {
+            entries[k] = entries[nentries-1];
+            IndexSet(index, entries[k], k);
+        }
+        nentries--;
+    }
+}
+
+
+
+void RNVArray::
+SetIndexed(RNBoolean indexed)
+{
+    // Check if indexed mode changes
+    if (indexed && !index) {
+        // Build index of all entries
+        index = new RNArrayIndex();
+        index->slots = NULL;
+        index->nslots = 0;
+        IndexClear(index, nentries);
+        UpdateIndex(0, nentries);
+    }
+    else if (!indexed && index) {
+        // Delete index
+        if (index->slots) free(index->slots);
+        delete index;
+        index = NULL;
+    }
 }
 
 
@@ -120,7 +316,7 @@ Empty(RNBoolean deallocate)
 
     // Deallocate memory
     if (deallocate) {
-        if (entries) delete entries;
+        if (entries) free(entries);
         entries = NULL;
         nallocated = 0;
     }
@@ -131,6 +327,12 @@ Empty(RNBoolean deallocate)
 void RNVArray::
 Truncate(int length)
 {
+    // Remove tail entries from index
+    if (index && (length < nentries)) {
+        if (length <= 0) IndexClear(index, 0);
+        else for (int i = length; i < nentries; i++) IndexErase(index, entries[i]);
+    }
+
     // Remove tail entries from array
     if (length < nentries) nentries = length;
 }
@@ -157,15 +359,14 @@ Shift(int start, int length, int delta)
     if ((length > 0) && (length < nshift)) nshift = length;
 
     /* Shift array entries */
-    if (delta < 0) {
-        for (int i = start; i < (start + nshift); i++) {
-	    entries[i+delta]=entries[i];
-	}
+    if (delta != 0) {
+        memmove(&entries[start+delta], &entries[start], nshift * sizeof(RNArrayEntry));
     }
-    else if (delta > 0) {
-        for (int i = (start + nshift - 1); i >= start; i--) {
-	    entries[i+delta]=entries[i];
-	}
+
+    /* Rebuild index (shifted entries overwrite others) */
+    if (index && (delta != 0)) {
+        IndexClear(index, nentries);
+        UpdateIndex(0, nentries);
     }
 }
 
@@ -202,11 +403,15 @@ void RNVArray::
 Append(const RNVArray& array)
 {
     // Resize first
-    Resize(NEntries() + array.NEntries());
+    int n = array.nentries;
+    Resize(nentries + n);
+
+    // Copy entries of array
+    if (n > 0) memcpy(&entries[nentries], array.entries, n * sizeof(RNArrayEntry));
+    nentries += n;
 
-    // Insert entries of array
-    for (int i = 0; i < array.NEntries(); i++)
-	Insert(array.Kth(i));
+    // Update index of appended entries
+    if (index) UpdateIndex(nentries - n, nentries);
 }
 
 
@@ -216,6 +421,9 @@ Sort(int (*compare)(const void *data1, const void *data2))
 {
     // Use qsort
     qsort(entries, nentries, sizeof(void *), compare);
+
+    // Update index of sorted entries
+    if (index) UpdateIndex(0, nentries);
 }
 
 
@@ -242,6 +450,12 @@ SwapEntries(RNArrayEntry *entry1, RNArrayEntry *entry2)
     void *tmp = *entry1;
     *entry1 = *entry2;
     *entry2 = tmp;
+
+    // Update index of swapped entries
+    if (index) {
+        IndexSet(index, *entry1, EntryIndex(entry1));
+        IndexSet(index, *entry2, EntryIndex(entry2));
+    }
 }
 
 
@@ -253,6 +467,12 @@ Swap(int i, int j)
     void *tmp = entries[i];
     entries[i] = entries[j];
     entries[j] = tmp;
+
+    // Update index of swapped entries
+    if (index) {
+        IndexSet(index, entries[i], i);
+        IndexSet(index, entries[j], j);
+    }
 }
 
 
@@ -271,30 +491,16 @@ Resize(int length)
 	while (tmplength < length) tmplength *= 2;
 	length = tmplength;
 
-	// Allocate new entries
-	RNArrayEntry *newentries = NULL;
-	if (length > 0) {
-	    newentries = (RNArrayEntry *) malloc(length * sizeof(RNArrayEntry));
-	    assert(newentries);
-	}
+	// Reallocate entries (old entries are kept)
+	RNArrayEntry *newentries = (RNArrayEntry *) realloc(entries, length * sizeof(RNArrayEntry));
+	assert(newentries);
 
-	// Copy old entries into new entries
-	if (nentries > 0) {
-	    assert(entries);
-	    assert(newentries);
-	    for (int i = 0; i < nentries; i++)
-                newentries[i] = entries[i];
-	}
- 
 	// Zero remaining new entries
 	if (nentries < length) {
-	    assert(newentries);
-	    for (int i = nentries; i < length; i++)
-                newentries[i] = NULL;
+	    memset(&newentries[nentries], 0, (length - nentries) * sizeof(RNArrayEntry));
 	}
 
 	// Replace entries
-	if (entries) free(entries);
 	entries = newentries;
 
 	// Update nallocated
@@ -307,6 +513,9 @@ Resize(int length)
 RNVArray& RNVArray::
 operator=(const RNVArray& array)
 {
+    // Check for self assignment
+    if (this == &array) return *this;
+
     // Empty array
     Empty();
 
@@ -316,11 +525,13 @@ operator=(const RNVArray& array)
 	Resize(array.nentries);
 	
 	// Copy entries from array
-	for (int i = 0; i < array.nentries; i++) 
-            entries[i] = array.entries[i];
+	memcpy(entries, array.entries, array.nentries * sizeof(RNArrayEntry));
 
 	// Update number of entries
 	nentries = array.nentries;
+
+	// Update index of copied entries
+	if (index) UpdateIndex(0, nentries);
     }
 
     // Return array
@@ -344,6 +555,17 @@ IsValid(void) const
         assert(entries[i]);
     }
 
+#ifndef NDEBUG
+    // Check index
+    if (index) {
+        assert(index->nused == nentries);
+        for (int i = 0; i < nentries; i++) {
+            int slot = IndexFind(index, entries[i]);
+            assert((slot >= 0) && (index->slots[slot].k == i));
+        }
+    }
+#endif
+
     // Return success
     return TRUE;
 }
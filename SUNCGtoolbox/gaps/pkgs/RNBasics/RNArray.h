@@ -18,8 +18,19 @@ typedef void *RNArrayEntry;
 
 
 
+/* Index from data to entries (used in indexed mode) */
+
+struct RNArrayIndex;
+
+
+
 /* Array of (void *) class definition */
 
+// In indexed mode (SetIndexed), a hash table maps each data pointer to its entry,
+// so that FindEntry and Remove(data) take constant time.  Entries must then be
+// unique and must not be modified through EntryContents, and Remove(data)
+// moves the tail entry into the removed one (the order of entries is not kept).
+
 class RNVArray {
     public:
         // Constructor functions
@@ -31,6 +42,7 @@ class RNVArray {
 	const RNBoolean IsEmpty(void) const;
 	const int NAllocated(void) const;
 	const int NEntries(void) const;
+	const RNBoolean IsIndexed(void) const;
 
         // Entry property functions/operators
 	const int EntryIndex(const RNArrayEntry *entry) const;
@@ -66,6 +78,7 @@ class RNVArray {
 	void Remove(const void *data);
 
         // Manipulation functions/operators
+	void SetIndexed(RNBoolean indexed = TRUE);
 	void Empty(RNBoolean deallocate = FALSE);
 	void Truncate(int length);
 	void Shift(int delta);
@@ -87,11 +100,13 @@ class RNVArray {
 	// Internal functions -- do not use these
 	RNArrayEntry *InternalInsert(void *data, int k);
 	void InternalRemove(int k);
+	void UpdateIndex(int start, int end);
 
     private:
 	RNArrayEntry *entries;
         int nallocated;
 	int nentries;
+        RNArrayIndex *index;
 };
 
 
@@ -66,6 +66,7 @@
 #include "RNQueue.h"
 #include "RNHeap.h"
 #include "RNMap.h"
+#include "RNSymbolTable.h"
 
 
 
@@ -79,6 +80,7 @@
 /* OS utility include files */
 
 #include "RNTime.h"
+#include "RNThread.h"
 
 
 
@@ -67,17 +67,6 @@ class RNMap {
 
 
 
-/* A useful derived class definition */
-
-template <class ValueType>
-class RNSymbolTable : public RNMap<std::string, ValueType> {
-    public:
-        // Constructor/destructor functions
-        RNSymbolTable(void) : RNMap<std::string, ValueType>() {};
-};
-
-
-
 #endif
 
 
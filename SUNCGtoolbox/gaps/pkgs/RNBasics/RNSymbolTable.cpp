@@ -0,0 +1,332 @@
+#ifndef __RN_SYMBOL_TABLE__C__
+#define __RN_SYMBOL_TABLE__C__
+
+
+
+// Include files
+
+#include "RNBasics.h"
+
+
+
+// Member functions
+
+template <class ValueType>
+RNSymbolTable<ValueType>::
+RNSymbolTable(void)
+    : entries(NULL),
+      nentries(0),
+      nslots(0),
+      chunks(NULL),
+      nchunks(0),
+      chunk_used(0),
+      chunk_size(0)
+{
+}
+
+
+
+template <class ValueType>
+RNSymbolTable<ValueType>::
+RNSymbolTable(const RNSymbolTable<ValueType>& table)
+    : entries(NULL),
+      nentries(0),
+      nslots(0),
+      chunks(NULL),
+      nchunks(0),
+      chunk_used(0),
+      chunk_size(0)
+{
+    // Copy table
+    *this = table;
+}
+
+
+
+template <class ValueType>
+RNSymbolTable<ValueType>::
+~RNSymbolTable(void)
+{
+    // Delete entries and keys
+    Empty();
+}
+
+
+
+template <class ValueType>
+int RNSymbolTable<ValueType>::
+NEntries(void) const
+{
+    // Return number of entries in table
+    return nentries;
+}
+
+
+
+template <class ValueType>
+RNBoolean RNSymbolTable<ValueType>::
+Find(const char *key, ValueType *value) const
+{
+    // Return value associated with key, or FALSE if not found
+    int slot = FindEntry(key, RNHashString(key));
+    if (slot < 0) return FALSE;
+    if (value) *value = entries[slot].value;
+    return TRUE;
+}
+
+
+
+template <class ValueType>
+RNBoolean RNSymbolTable<ValueType>::
+Find(const std::string& key, ValueType *value) const
+{
+    // Return value associated with key, or FALSE if not found
+    return Find(key.c_str(), value);
+}
+
+
+
+template <class ValueType>
+const ValueType *RNSymbolTable<ValueType>::
+FindValue(const char *key) const
+{
+    // Return pointer to value stored for key (valid until table is modified), or NULL if not found
+    int slot = FindEntry(key, RNHashString(key));
+    if (slot < 0) return NULL;
+    return &entries[slot].value;
+}
+
+
+
+template <class ValueType>
+ValueType *RNSymbolTable<ValueType>::
+FindValue(const char *key)
+{
+    // Return pointer to value stored for key, so that it can be modified in place
+    int slot = FindEntry(key, RNHashString(key));
+    if (slot < 0) return NULL;
+    return &entries[slot].value;
+}
+
+
+
+template <class ValueType>
+const char *RNSymbolTable<ValueType>::
+Key(const char *key) const
+{
+    // Return interned copy of key (valid until key is removed), or NULL if not found
+    int slot = FindEntry(key, RNHashString(key));
+    if (slot < 0) return NULL;
+    return entries[slot].key;
+}
+
+
+
+template <class ValueType>
+void RNSymbolTable<ValueType>::
+Empty(void)
+{
+    // Delete entries
+    if (entries) delete [] entries;
+    entries = NULL;
+    nentries = 0;
+    nslots = 0;
+
+    // Delete interned keys
+    for (int i = 0; i < nchunks; i++) delete [] chunks[i];
+    if (chunks) free(chunks);
+    chunks = NULL;
+    nchunks = 0;
+    chunk_used = 0;
+    chunk_size = 0;
+}
+
+
+
+template <class ValueType>
+void RNSymbolTable<ValueType>::
+Insert(const char *key, const ValueType& value)
+{
+    // Find slot for key
+    int length;
+    unsigned int hash = RNHashString(key, &length);
+    int slot = FindEntry(key, hash);
+    if (slot >= 0) { entries[slot].value = value; return; }
+
+    // Resize table to keep it at most 3/4 full
+    if (4 * (nentries + 1) > 3 * nslots) Resize((nslots > 0) ? 2 * nslots : 16);
+
+    // Find empty slot with linear probing
+    slot = hash & (nslots - 1);
+    while (entries[slot].key) slot = (slot + 1) & (nslots - 1);
+
+    // Insert entry
+    entries[slot].key = InternKey(key, length);
+    entries[slot].hash = hash;
+    entries[slot].value = value;
+    nentries++;
+}
+
+
+
+template <class ValueType>
+void RNSymbolTable<ValueType>::
+Insert(const std::string& key, const ValueType& value)
+{
+    // Insert entry into table
+    Insert(key.c_str(), value);
+}
+
+
+
+template <class ValueType>
+void RNSymbolTable<ValueType>::
+Replace(const char *key, const ValueType& value)
+{
+    // Replace entry in table
+    Insert(key, value);
+}
+
+
+
+template <class ValueType>
+void RNSymbolTable<ValueType>::
+Replace(const std::string& key, const ValueType& value)
+{
+    // Replace entry in table
+    Insert(key.c_str(), value);
+}
+
+
+
+template <class ValueType>
+void RNSymbolTable<ValueType>::
+Remove(const char *key)
+{
+    // Find entry
+    int slot = FindEntry(key, RNHashString(key));
+    if (slot < 0) return;
+
+    // Shift following entries of probe sequence back into hole (so that no tombstones are needed)
+    // (the interned key is not freed, it stays in its chunk until the table is emptied or assigned)
+    int mask = nslots - 1;
+    int hole = slot;
+    int next = (hole + 1) & mask;
+    while (entries[next].key) {
+        int home = entries[next].hash & mask;
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            entries[hole] = entries[next];
+            hole = next;
+        }
+        next = (next + 1) & mask;
+    }
+
+    // Clear hole
+    entries[hole].key = NULL;
+    entries[hole].value = ValueType();
+    nentries--;
+}
+
+
+
+template <class ValueType>
+void RNSymbolTable<ValueType>::
+Remove(const std::string& key)
+{
+    // Remove entry from table
+    Remove(key.c_str());
+}
+
+
+
+template <class ValueType>
+RNSymbolTable<ValueType>& RNSymbolTable<ValueType>::
+operator=(const RNSymbolTable<ValueType>& table)
+{
+    // Check for self assignment
+    if (this == &table) return *this;
+
+    // Replace entries (keys are interned again)
+    Empty();
+    if (table.nentries == 0) return *this;
+    Resize(table.nslots);
+    for (int i = 0; i < table.nslots; i++) {
+        const Entry& entry = table.entries[i];
+        if (!entry.key) continue;
+        int slot = entry.hash & (nslots - 1);
+        while (entries[slot].key) slot = (slot + 1) & (nslots - 1);
+        entries[slot].key = InternKey(entry.key, (int) strlen(entry.key));
+        entries[slot].hash = entry.hash;
+        entries[slot].value = entry.value;
+        nentries++;
+    }
+
+    // Return this
+    return *this;
+}
+
+
+
+template <class ValueType>
+int RNSymbolTable<ValueType>::
+FindEntry(const char *key, unsigned int hash) const
+{
+    // Return slot with key, or -1 if not found
+    if (nentries == 0) return -1;
+    int slot = hash & (nslots - 1);
+    while (entries[slot].key) {
+        if ((entries[slot].hash == hash) && !strcmp(entries[slot].key, key)) return slot;
+        slot = (slot + 1) & (nslots - 1);
+    }
+    return -1;
+}
+
+
+
+template <class ValueType>
+const char *RNSymbolTable<ValueType>::
+InternKey(const char *key, int length)
+{
+    // Allocate chunk if key does not fit in current one
+    if (chunk_used + length + 1 > chunk_size) {
+        chunk_size = (length + 1 > 4096) ? length + 1 : 4096;
+        chunks = (char **) realloc(chunks, (nchunks + 1) * sizeof(char *));
+        chunks[nchunks++] = new char [ chunk_size ];
+        chunk_used = 0;
+    }
+
+    // Copy key into chunk
+    char *copy = &chunks[nchunks-1][chunk_used];
+    memcpy(copy, key, length + 1);
+    chunk_used += length + 1;
+    return copy;
+}
+
+
+
+template <class ValueType>
+void RNSymbolTable<ValueType>::
+Resize(int n)
+{
+    // Allocate slots (n must be a power of two)
+    Entry *old_entries = entries;
+    int old_nslots = nslots;
+    entries = new Entry [ n ];
+    for (int i = 0; i < n; i++) entries[i].key = NULL;
+    nslots = n;
+
+    // Reinsert entries (keys stay in their chunks)
+    for (int i = 0; i < old_nslots; i++) {
+        if (!old_entries[i].key) continue;
+        int slot = old_entries[i].hash & (nslots - 1);
+        while (entries[slot].key) slot = (slot + 1) & (nslots - 1);
+        entries[slot] = old_entries[i];
+    }
+
+    // Delete old slots
+    if (old_entries) delete [] old_entries;
+}
+
+
+
+#endif
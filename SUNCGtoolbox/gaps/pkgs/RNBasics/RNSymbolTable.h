@@ -0,0 +1,88 @@
+/* Include file for the GAPS symbol table class */
+
+#ifndef __RN__SYMBOL__TABLE__H__
+#define __RN__SYMBOL__TABLE__H__
+
+
+
+/* Class definition */
+
+// Map from strings to values, stored in an open-addressing hash table.
+// Keys are looked up directly as const char * (no temporary std::string),
+// and are interned: each key is copied once into chunks owned by the table,
+// and Key() returns that copy, so interned keys can be compared by pointer.
+// Key storage only grows: Remove() does not free the copy of its key (other
+// interned keys stay at fixed addresses), it is freed by Empty() or when the
+// table is assigned, which copies only the keys still in the table.
+
+template <class ValueType>
+class RNSymbolTable {
+    public:
+        // Constructor/destructor functions
+        RNSymbolTable(void);
+        RNSymbolTable(const RNSymbolTable<ValueType>& table);
+        ~RNSymbolTable(void);
+
+        // Property functions/operations
+        int NEntries(void) const;
+
+        // Data access functions/operators
+        RNBoolean Find(const char *key, ValueType *value = NULL) const;
+        RNBoolean Find(const std::string& key, ValueType *value = NULL) const;
+        const ValueType *FindValue(const char *key) const;
+        ValueType *FindValue(const char *key);
+        const char *Key(const char *key) const;
+
+        // Manipulation functions
+        void Empty(void);
+        void Insert(const char *key, const ValueType& value);
+        void Insert(const std::string& key, const ValueType& value);
+        void Replace(const char *key, const ValueType& value);
+        void Replace(const std::string& key, const ValueType& value);
+        void Remove(const char *key);
+        void Remove(const std::string& key);
+
+        // Manipulation operators
+        RNSymbolTable<ValueType>& operator=(const RNSymbolTable<ValueType>& table);
+
+    public:
+        // Internal functions
+        struct Entry { const char *key; unsigned int hash; ValueType value; };
+        int FindEntry(const char *key, unsigned int hash) const;
+        const char *InternKey(const char *key, int length);
+        void Resize(int n);
+
+    private:
+        Entry *entries;
+        int nentries;
+        int nslots;
+        char **chunks;
+        int nchunks;
+        int chunk_used;
+        int chunk_size;
+};
+
+
+
+/* Hash function for strings (FNV-1a) */
+
+inline unsigned int
+RNHashString(const char *key, int *length = NULL)
+{
+    // Compute hash and length of string
+    unsigned int hash = 2166136261U;
+    const char *c = key;
+    while (*c) { hash = (hash ^ (unsigned char) *c) * 16777619U; c++; }
+    if (length) *length = (int) (c - key);
+    return hash;
+}
+
+
+
+/* Templated member functions */
+
+#include "RNSymbolTable.cpp"
+
+
+
+#endif
@@ -0,0 +1,142 @@
+/* Source file for GAPS thread utility */
+
+
+
+/* Include files */
+
+#include "RNBasics.h"
+#include <thread>
+#include <atomic>
+#include <mutex>
+
+
+
+/* Private variables */
+
+static int RNnthreads = 0;
+
+
+
+int RNInitThread() 
+{
+    /* Return OK status */
+    return TRUE;
+}
+
+
+
+void RNStopThread()
+{
+}
+
+
+
+int 
+RNNumThreads(void)
+{
+    /* Initialize number of threads from hardware, if not set explicitly */
+    if (RNnthreads <= 0) {
+        RNnthreads = (int) std::thread::hardware_concurrency();
+        if (RNnthreads <= 0) RNnthreads = 1;
+    }
+
+    /* Return number of threads used by parallel loops */
+    return RNnthreads;
+}
+
+
+
+void 
+RNSetNumThreads(int nthreads)
+{
+    /* Set number of threads used by parallel loops (0 means number of cores) */
+    RNnthreads = nthreads;
+}
+
+
+
+static void
+RNParallelForWorker(std::atomic<int> *next, int end, int grain, int thread, 
+    RNParallelForFunction function, void *data)
+{
+    /* Grab chunks of grain indices until none are left */
+    while (TRUE) {
+        int start = next->fetch_add(grain);
+        if (start >= end) break;
+        int stop = (start + grain < end) ? start + grain : end;
+        for (int i = start; i < stop; i++) (*function)(i, thread, data);
+    }
+}
+
+
+
+void 
+RNParallelFor(int begin, int end, RNParallelForFunction function, void *data, int grain)
+{
+    /* Check range */
+    if (end <= begin) return;
+    if (grain < 1) grain = 1;
+
+    /* Determine number of threads */
+    int nchunks = (end - begin + grain - 1) / grain;
+    int nthreads = RNNumThreads();
+    if (nthreads > nchunks) nthreads = nchunks;
+
+    /* Execute serially if there is no parallelism */
+    if (nthreads <= 1) {
+        for (int i = begin; i < end; i++) (*function)(i, 0, data);
+        return;
+    }
+
+    /* Start worker threads (the calling thread acts as thread 0) */
+    std::atomic<int> next(begin);
+    std::thread *threads = new std::thread [ nthreads - 1 ];
+    for (int t = 1; t < nthreads; t++) {
+        threads[t-1] = std::thread(RNParallelForWorker, &next, end, grain, t, function, data);
+    }
+
+    /* Do share of work in calling thread */
+    RNParallelForWorker(&next, end, grain, 0, function, data);
+
+    /* Wait for worker threads */
+    for (int t = 1; t < nthreads; t++) threads[t-1].join();
+    delete [] threads;
+}
+
+
+
+RNMutex::
+RNMutex(void)
+    : mutex(new std::mutex())
+{
+}
+
+
+
+RNMutex::
+~RNMutex(void)
+{
+    /* Delete mutex */
+    delete (std::mutex *) mutex;
+}
+
+
+
+void RNMutex::
+Lock(void)
+{
+    /* Acquire mutex */
+    ((std::mutex *) mutex)->lock();
+}
+
+
+
+void RNMutex::
+Unlock(void)
+{
+    /* Release mutex */
+    ((std::mutex *) mutex)->unlock();
+}
+
+
+
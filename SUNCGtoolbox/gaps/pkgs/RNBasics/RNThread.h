@@ -0,0 +1,70 @@
+/* Include file for GAPS thread utility */
+
+
+
+/* Initialization functions */
+
+int RNInitThread();
+void RNStopThread();
+
+
+
+/* Thread count functions */
+
+int RNNumThreads(void);
+void RNSetNumThreads(int nthreads);
+
+
+
+/* Parallel loop functions */
+
+typedef void (*RNParallelForFunction)(int index, int thread, void *data);
+void RNParallelFor(int begin, int end, RNParallelForFunction function, void *data, int grain = 1);
+template <class Function> void RNParallelFor(int begin, int end, const Function& function, int grain = 1);
+
+
+
+/* Mutual exclusion class */
+
+class RNMutex {
+public:
+    /* Constructor/destructor functions */
+    RNMutex(void);
+    ~RNMutex(void);
+
+    /* Copying is not allowed (the copy would delete the same mutex) */
+    RNMutex(const RNMutex& mutex) = delete;
+    RNMutex& operator=(const RNMutex& mutex) = delete;
+
+    /* Locking functions */
+    void Lock(void);
+    void Unlock(void);
+
+private:
+    void *mutex;
+};
+
+
+
+/* Inline functions */
+
+template <class Function>
+inline void
+RNParallelForCallback(int index, int thread, void *data)
+{
+    /* Call function object passed through data pointer */
+    (*((const Function *) data))(index, thread);
+}
+
+
+
+template <class Function>
+inline void
+RNParallelFor(int begin, int end, const Function& function, int grain)
+{
+    /* Execute function(index, thread) for every index in [begin, end) */
+    RNParallelFor(begin, end, RNParallelForCallback<Function>, (void *) &function, grain);
+}
+
+
+
@@ -7,6 +7,8 @@
 ////////////////////////////////////////////////////////////////////////
 
 #include "RNMath/RNMath.h"
+#include <vector>
+#include <cmath>
 
 
 
@@ -256,11 +258,11 @@ RemoveEquation(RNEquation *equation)
 void RNSystemOfEquations::
 EvaluateResiduals(const RNScalar *x, RNScalar *y) const
 {
-  // Evaluate equations
-  for (int i = 0; i < NEquations(); i++) {
+  // Evaluate equations in parallel
+  RNParallelFor(0, NEquations(), [&](int i, int thread) {
     RNEquation *equation = Equation(i);
     y[i] = equation->Evaluate(x);
-  }
+  }, 256);
 }
 
 
@@ -356,3 +358,577 @@ Print(FILE *fp) const
 
 
 
+////////////////////////////////////////////////////////////////////////
+// Compiled system of equations (used by built-in solver)
+////////////////////////////////////////////////////////////////////////
+
+struct RNCompiledInstruction {
+  int operation;
+  int operand0, operand1;
+  int first_term, nterms;
+};
+
+struct RNCompiledTerm {
+  RNScalar coefficient;
+  int first_factor, nfactors;
+};
+
+struct RNCompiledFactor {
+  int variable;
+  int entry;
+  RNScalar exponent;
+};
+
+struct RNCompiledSystem {
+  RNCompiledSystem(const RNSystemOfEquations *system);
+  ~RNCompiledSystem(void);
+  void EvaluateResiduals(const RNScalar *x, RNScalar *y) const;
+  void EvaluateJacobian(const RNScalar *x, RNScalar *y, RNScalar *jacobian) const;
+  RNScalar EvaluateCost(const RNScalar *x, RNScalar *y) const;
+  void MultiplyJacobian(const RNScalar *jacobian, const RNScalar *v, RNScalar *result) const;
+  void MultiplyJacobianTranspose(const RNScalar *jacobian, const RNScalar *v, RNScalar *result) const;
+  int CompileAlgebraic(const RNAlgebraic *algebraic, int *variable_entries, int& row_nentries);
+  int m, n, nnz;
+  std::vector<RNCompiledInstruction> instructions;
+  std::vector<RNCompiledTerm> terms;
+  std::vector<RNCompiledFactor> factors;
+  std::vector<int> program_offsets;
+  std::vector<int> row_offsets;
+  std::vector<int> columns;
+  std::vector<int> column_offsets;
+  std::vector<int> column_entries;
+  std::vector<int> column_rows;
+  std::vector<RNScalar> thresholds;
+  int max_program_length;
+  RNScalar *workspace;
+};
+
+
+
+static const int RN_COMPILED_BLOCK_SIZE = 1024;
+
+
+
+static inline RNScalar
+RNCompiledPower(RNScalar x, RNScalar e)
+{
+  // Raise x to exponent e (with same special cases as RNPolynomialTerm)
+  if (e == 1.0) return x;
+  else if (e == 2.0) return x * x;
+  else if ((e < 0) && RNIsZero(x)) return RN_INFINITY;
+  else return pow(x, e);
+}
+
+
+
+static inline RNScalar
+RNCompiledPowerDerivative(RNScalar x, RNScalar e)
+{
+  // Differentiate x^e (with same special cases as RNPolynomialTerm)
+  if (e == 1.0) return 1.0;
+  else if (e == 2.0) return 2.0 * x;
+  else if ((e < 1.0) && RNIsZero(x)) return RN_INFINITY;
+  else return e * pow(x, e - 1.0);
+}
+
+
+
+static RNScalar
+RNEvaluateCompiledProgram(const RNCompiledSystem *system, int equation, const RNScalar *x, RNScalar *values)
+{
+  // Evaluate instructions in postfix order (operands always precede their operation)
+  const RNCompiledInstruction *program = &system->instructions[system->program_offsets[equation]];
+  int length = system->program_offsets[equation+1] - system->program_offsets[equation];
+  for (int i = 0; i < length; i++) {
+    const RNCompiledInstruction& instruction = program[i];
+    RNScalar value = 0;
+    switch (instruction.operation) {
+    case RN_POLYNOMIAL_OPERATION:
+      for (int t = instruction.first_term; t < instruction.first_term + instruction.nterms; t++) {
+        const RNCompiledTerm& term = system->terms[t];
+        const RNCompiledFactor *factor = &system->factors[term.first_factor];
+        RNScalar product = term.coefficient;
+        for (int f = 0; f < term.nfactors; f++) {
+          product *= RNCompiledPower(x[factor[f].variable], factor[f].exponent);
+        }
+        value += product;
+      }
+      break;
+
+    case RN_ADD_OPERATION:
+      value = values[instruction.operand0] + values[instruction.operand1];
+      break;
+
+    case RN_SUBTRACT_OPERATION:
+      value = values[instruction.operand0] - values[instruction.operand1];
+      break;
+
+    case RN_MULTIPLY_OPERATION:
+      value = values[instruction.operand0] * values[instruction.operand1];
+      break;
+
+    case RN_DIVIDE_OPERATION: {
+      RNScalar v1 = values[instruction.operand1];
+      if (RNIsZero(v1, RN_SMALL_EPSILON)) value = RN_INFINITY;
+      else value = values[instruction.operand0] / v1;
+      break; }
+
+    case RN_POW_OPERATION: {
+      RNScalar v0 = values[instruction.operand0];
+      RNScalar v1 = values[instruction.operand1];
+      if (v0 == 0) value = 0;
+      else if (v1 == 0) value = 1;
+      else value = pow(v0, v1);
+      break; }
+    }
+    values[i] = value;
+  }
+
+  // Return value of last instruction
+  return (length > 0) ? values[length-1] : 0.0;
+}
+
+
+
+static void
+RNDifferentiateCompiledProgram(const RNCompiledSystem *system, int equation, const RNScalar *x, 
+  const RNScalar *values, RNScalar *adjoints, RNScalar *row)
+{
+  // Initialize adjoints and jacobian row
+  const RNCompiledInstruction *program = &system->instructions[system->program_offsets[equation]];
+  int length = system->program_offsets[equation+1] - system->program_offsets[equation];
+  int nentries = system->row_offsets[equation+1] - system->row_offsets[equation];
+  for (int i = 0; i < nentries; i++) row[i] = 0;
+  if (length == 0) return;
+  for (int i = 0; i < length-1; i++) adjoints[i] = 0;
+  adjoints[length-1] = 1;
+
+  // Propagate adjoints backwards through instructions (reverse-mode differentiation)
+  for (int i = length-1; i >= 0; i--) {
+    const RNCompiledInstruction& instruction = program[i];
+    RNScalar adjoint = adjoints[i];
+    if (adjoint == 0) continue;
+    switch (instruction.operation) {
+    case RN_POLYNOMIAL_OPERATION:
+      for (int t = instruction.first_term; t < instruction.first_term + instruction.nterms; t++) {
+        const RNCompiledTerm& term = system->terms[t];
+        const RNCompiledFactor *factor = &system->factors[term.first_factor];
+        for (int f = 0; f < term.nfactors; f++) {
+          RNScalar derivative = adjoint * term.coefficient;
+          for (int g = 0; g < term.nfactors; g++) {
+            if (g == f) derivative *= RNCompiledPowerDerivative(x[factor[g].variable], factor[g].exponent);
+            else derivative *= RNCompiledPower(x[factor[g].variable], factor[g].exponent);
+          }
+          row[factor[f].entry] += derivative;
+        }
+      }
+      break;
+
+    case RN_ADD_OPERATION:
+      adjoints[instruction.operand0] += adjoint;
+      adjoints[instruction.operand1] += adjoint;
+      break;
+
+    case RN_SUBTRACT_OPERATION:
+      adjoints[instruction.operand0] += adjoint;
+      adjoints[instruction.operand1] -= adjoint;
+      break;
+
+    case RN_MULTIPLY_OPERATION:
+      adjoints[instruction.operand0] += adjoint * values[instruction.operand1];
+      adjoints[instruction.operand1] += adjoint * values[instruction.operand0];
+      break;
+
+    case RN_DIVIDE_OPERATION: {
+      // Quotient rule
+      RNScalar v0 = values[instruction.operand0];
+      RNScalar v1 = values[instruction.operand1];
+      RNScalar v1_squared = v1 * v1;
+      if (RNIsZero(v1_squared, RN_SMALL_EPSILON)) {
+        adjoints[instruction.operand0] += RN_INFINITY;
+        adjoints[instruction.operand1] += RN_INFINITY;
+      }
+      else {
+        adjoints[instruction.operand0] += adjoint / v1;
+        adjoints[instruction.operand1] -= adjoint * v0 / v1_squared;
+      }
+      break; }
+
+    case RN_POW_OPERATION: {
+      // Power rule
+      RNScalar v0 = values[instruction.operand0];
+      RNScalar v1 = values[instruction.operand1];
+      if (RNIsZero(v0, RN_SMALL_EPSILON)) {
+        adjoints[instruction.operand0] += RN_INFINITY;
+        adjoints[instruction.operand1] += RN_INFINITY;
+      }
+      else {
+        adjoints[instruction.operand0] += adjoint * values[i] * v1 / v0;
+        adjoints[instruction.operand1] += adjoint * values[i] * log(v0);
+      }
+      break; }
+    }
+  }
+}
+
+
+
+RNCompiledSystem::
+RNCompiledSystem(const RNSystemOfEquations *system)
+  : m(system->NEquations()),
+    n(system->NVariables()),
+    nnz(0),
+    max_program_length(1),
+    workspace(NULL)
+{
+  // Allocate temporary map from variable to entry of current jacobian row
+  int *variable_entries = new int [ n ];
+  for (int i = 0; i < n; i++) variable_entries[i] = -1;
+
+  // Flatten equations into postfix programs and CSR jacobian rows
+  program_offsets.push_back(0);
+  row_offsets.push_back(0);
+  for (int i = 0; i < m; i++) {
+    RNEquation *equation = system->Equation(i);
+    int row_start = (int) columns.size();
+    int row_nentries = 0;
+    CompileAlgebraic(equation, variable_entries, row_nentries);
+    for (int j = row_start; j < (int) columns.size(); j++) variable_entries[columns[j]] = -1;
+    int length = (int) instructions.size() - program_offsets.back();
+    if (length > max_program_length) max_program_length = length;
+    program_offsets.push_back((int) instructions.size());
+    row_offsets.push_back((int) columns.size());
+    thresholds.push_back(equation->ResidualThreshold());
+  }
+
+  // Build transpose of jacobian pattern (CSC, referencing CSR entries)
+  nnz = (int) columns.size();
+  column_offsets.assign(n+1, 0);
+  column_entries.resize(nnz);
+  column_rows.resize(nnz);
+  for (int k = 0; k < nnz; k++) column_offsets[columns[k]+1]++;
+  for (int j = 0; j < n; j++) column_offsets[j+1] += column_offsets[j];
+  std::vector<int> column_fill(column_offsets.begin(), column_offsets.end()-1);
+  for (int i = 0; i < m; i++) {
+    for (int k = row_offsets[i]; k < row_offsets[i+1]; k++) {
+      int index = column_fill[columns[k]]++;
+      column_entries[index] = k;
+      column_rows[index] = i;
+    }
+  }
+
+  // Allocate per-thread workspace for values and adjoints
+  workspace = new RNScalar [ 2 * max_program_length * RNNumThreads() ];
+
+  // Delete temporary map
+  delete [] variable_entries;
+}
+
+
+
+RNCompiledSystem::
+~RNCompiledSystem(void)
+{
+  // Delete workspace
+  if (workspace) delete [] workspace;
+}
+
+
+
+int RNCompiledSystem::
+CompileAlgebraic(const RNAlgebraic *algebraic, int *variable_entries, int& row_nentries)
+{
+  // Compile operands first, then append instruction (returns its slot in program)
+  RNCompiledInstruction instruction;
+  instruction.operation = algebraic->Operation();
+  instruction.operand0 = instruction.operand1 = -1;
+  instruction.first_term = instruction.nterms = 0;
+  if (instruction.operation == RN_POLYNOMIAL_OPERATION) {
+    RNPolynomial *polynomial = algebraic->Polynomial();
+    instruction.first_term = (int) terms.size();
+    instruction.nterms = polynomial->NTerms();
+    for (int t = 0; t < polynomial->NTerms(); t++) {
+      RNPolynomialTerm *term = polynomial->Term(t);
+      RNCompiledTerm compiled_term;
+      compiled_term.coefficient = term->Coefficient();
+      compiled_term.first_factor = (int) factors.size();
+      compiled_term.nfactors = term->NVariables();
+      for (int k = 0; k < term->NVariables(); k++) {
+        RNCompiledFactor factor;
+        factor.variable = term->Variable(k);
+        factor.exponent = term->Exponent(k);
+        if (variable_entries[factor.variable] < 0) {
+          variable_entries[factor.variable] = row_nentries++;
+          columns.push_back(factor.variable);
+        }
+        factor.entry = variable_entries[factor.variable];
+        factors.push_back(factor);
+      }
+      terms.push_back(compiled_term);
+    }
+  }
+  else if (instruction.operation != RN_ZERO_OPERATION) {
+    instruction.operand0 = CompileAlgebraic(algebraic->Operand(0), variable_entries, row_nentries);
+    instruction.operand1 = CompileAlgebraic(algebraic->Operand(1), variable_entries, row_nentries);
+  }
+
+  // Append instruction
+  instructions.push_back(instruction);
+  return (int) instructions.size() - 1 - program_offsets.back();
+}
+
+
+
+void RNCompiledSystem::
+EvaluateResiduals(const RNScalar *x, RNScalar *y) const
+{
+  // Evaluate residuals in parallel
+  RNParallelFor(0, m, [&](int i, int thread) {
+    y[i] = RNEvaluateCompiledProgram(this, i, x, &workspace[2 * max_program_length * thread]);
+  }, RN_COMPILED_BLOCK_SIZE);
+}
+
+
+
+void RNCompiledSystem::
+EvaluateJacobian(const RNScalar *x, RNScalar *y, RNScalar *jacobian) const
+{
+  // Evaluate residuals and jacobian rows in parallel
+  RNParallelFor(0, m, [&](int i, int thread) {
+    RNScalar *values = &workspace[2 * max_program_length * thread];
+    RNScalar *adjoints = values + max_program_length;
+    y[i] = RNEvaluateCompiledProgram(this, i, x, values);
+    RNDifferentiateCompiledProgram(this, i, x, values, adjoints, &jacobian[row_offsets[i]]);
+  }, RN_COMPILED_BLOCK_SIZE);
+}
+
+
+
+static inline RNScalar
+RNRobustCost(RNScalar residual, RNScalar threshold)
+{
+  // Return huber cost of residual (squared residual if no threshold)
+  RNScalar squared_residual = residual * residual;
+  if ((threshold <= 0) || (squared_residual <= threshold * threshold)) return squared_residual;
+  return 2.0 * threshold * sqrt(squared_residual) - threshold * threshold;
+}
+
+
+
+RNScalar RNCompiledSystem::
+EvaluateCost(const RNScalar *x, RNScalar *y) const
+{
+  // Evaluate residuals
+  EvaluateResiduals(x, y);
+
+  // Sum robust costs of blocks in parallel (fixed order so result is deterministic)
+  int nblocks = (m + RN_COMPILED_BLOCK_SIZE - 1) / RN_COMPILED_BLOCK_SIZE;
+  std::vector<RNScalar> block_costs(nblocks, 0.0);
+  RNParallelFor(0, nblocks, [&](int b, int thread) {
+    int end = (b + 1) * RN_COMPILED_BLOCK_SIZE;
+    if (end > m) end = m;
+    RNScalar sum = 0;
+    for (int i = b * RN_COMPILED_BLOCK_SIZE; i < end; i++) sum += RNRobustCost(y[i], thresholds[i]);
+    block_costs[b] = sum;
+  });
+  RNScalar cost = 0;
+  for (int b = 0; b < nblocks; b++) cost += block_costs[b];
+  return cost;
+}
+
+
+
+void RNCompiledSystem::
+MultiplyJacobian(const RNScalar *jacobian, const RNScalar *v, RNScalar *result) const
+{
+  // Compute J * v (parallel over rows)
+  RNParallelFor(0, m, [&](int i, int thread) {
+    RNScalar sum = 0;
+    for (int k = row_offsets[i]; k < row_offsets[i+1]; k++) sum += jacobian[k] * v[columns[k]];
+    result[i] = sum;
+  }, RN_COMPILED_BLOCK_SIZE);
+}
+
+
+
+void RNCompiledSystem::
+MultiplyJacobianTranspose(const RNScalar *jacobian, const RNScalar *v, RNScalar *result) const
+{
+  // Compute J^T * v (parallel over columns)
+  RNParallelFor(0, n, [&](int j, int thread) {
+    RNScalar sum = 0;
+    for (int k = column_offsets[j]; k < column_offsets[j+1]; k++) sum += jacobian[column_entries[k]] * v[column_rows[k]];
+    result[j] = sum;
+  }, 64);
+}
+
+
+
+static int
+RNSolveDampedNormalEquations(const RNCompiledSystem& system, const RNScalar *jacobian,
+  const RNScalar *diagonal, RNScalar lambda, const RNScalar *gradient, RNScalar *step, 
+  RNScalar *r, RNScalar *z, RNScalar *p, RNScalar *q, RNScalar *u)
+{
+  // Solve (J^T J + lambda D) step = -gradient with jacobi-preconditioned conjugate gradients
+  const int n = system.n;
+  RNScalar rz = 0, rr0 = 0;
+  for (int j = 0; j < n; j++) {
+    step[j] = 0;
+    r[j] = -gradient[j];
+    z[j] = r[j] / ((1.0 + lambda) * diagonal[j]);
+    p[j] = z[j];
+    rz += r[j] * z[j];
+    rr0 += r[j] * r[j];
+  }
+
+  // Iterate
+  int max_iterations = (n < 1000) ? n : 1000;
+  for (int iteration = 0; iteration < max_iterations; iteration++) {
+    // Compute q = (J^T J + lambda D) p
+    system.MultiplyJacobian(jacobian, p, u);
+    system.MultiplyJacobianTranspose(jacobian, u, q);
+    RNScalar pq = 0;
+    for (int j = 0; j < n; j++) {
+      q[j] += lambda * diagonal[j] * p[j];
+      pq += p[j] * q[j];
+    }
+    if (pq <= 0) break;
+
+    // Update step and residual
+    RNScalar alpha = rz / pq;
+    RNScalar rr = 0;
+    for (int j = 0; j < n; j++) {
+      step[j] += alpha * p[j];
+      r[j] -= alpha * q[j];
+      rr += r[j] * r[j];
+    }
+    if (rr <= 1E-20 * rr0) break;
+
+    // Update search direction
+    RNScalar rz_next = 0;
+    for (int j = 0; j < n; j++) {
+      z[j] = r[j] / ((1.0 + lambda) * diagonal[j]);
+      rz_next += r[j] * z[j];
+    }
+    RNScalar beta = rz_next / rz;
+    for (int j = 0; j < n; j++) p[j] = z[j] + beta * p[j];
+    rz = rz_next;
+  }
+
+  // Return success
+  return 1;
+}
+
+
+
+int RNSystemOfEquations::
+MinimizeWithLevenbergMarquardt(RNScalar *x, RNScalar tolerance) const
+{
+  // Check system
+  if (NVariables() == 0) return 1;
+  if (NEquations() == 0) return 1;
+
+  // Compile equations into flat programs and sparse jacobian pattern (once)
+  RNCompiledSystem system(this);
+  const int m = system.m;
+  const int n = system.n;
+
+  // Allocate temporary data
+  RNScalar *y = new RNScalar [ m ];
+  RNScalar *u = new RNScalar [ m ];
+  RNScalar *jacobian = new RNScalar [ system.nnz + 1 ];
+  RNScalar *gradient = new RNScalar [ n ];
+  RNScalar *diagonal = new RNScalar [ n ];
+  RNScalar *step = new RNScalar [ n ];
+  RNScalar *x_next = new RNScalar [ n ];
+  RNScalar *r = new RNScalar [ n ];
+  RNScalar *z = new RNScalar [ n ];
+  RNScalar *p = new RNScalar [ n ];
+  RNScalar *q = new RNScalar [ n ];
+
+  // Evaluate initial cost
+  RNScalar cost = system.EvaluateCost(x, y);
+  RNScalar lambda = 1E-4;
+  const int max_iterations = 100;
+  RNBoolean converged = FALSE;
+  int naccepted = 0;
+  for (int iteration = 0; iteration < max_iterations; iteration++) {
+    // Check cost (RN_INFINITY is only a large value, so check for IEEE infinity and NaN)
+    if (!std::isfinite(cost)) break;
+
+    // Evaluate residuals and jacobian
+    system.EvaluateJacobian(x, y, jacobian);
+
+    // Reweight residuals and jacobian rows for huber loss (so J^T J approximates hessian)
+    RNParallelFor(0, m, [&](int i, int thread) {
+      RNScalar threshold = system.thresholds[i];
+      RNScalar magnitude = fabs(y[i]);
+      if ((threshold <= 0) || (magnitude <= threshold)) return;
+      RNScalar weight = sqrt(threshold / magnitude);
+      y[i] *= weight;
+      for (int k = system.row_offsets[i]; k < system.row_offsets[i+1]; k++) jacobian[k] *= weight;
+    }, RN_COMPILED_BLOCK_SIZE);
+
+    // Compute gradient and diagonal of J^T J
+    system.MultiplyJacobianTranspose(jacobian, y, gradient);
+    RNScalar max_gradient = 0;
+    for (int j = 0; j < n; j++) {
+      RNScalar sum = 0;
+      for (int k = system.column_offsets[j]; k < system.column_offsets[j+1]; k++) {
+        RNScalar d = jacobian[system.column_entries[k]];
+        sum += d * d;
+      }
+      if (sum < 1E-6) sum = 1E-6;
+      else if (sum > 1E32) sum = 1E32;
+      diagonal[j] = sum;
+      if (fabs(gradient[j]) > max_gradient) max_gradient = fabs(gradient[j]);
+    }
+
+    // Check for convergence
+    if (!std::isfinite(max_gradient)) break;
+    if (max_gradient < 1E-10) { converged = TRUE; break; }
+
+    // Search for damping that reduces cost
+    RNScalar next_cost = cost;
+    while (lambda < 1E16) {
+      // Compute step
+      RNSolveDampedNormalEquations(system, jacobian, diagonal, lambda, gradient, step, r, z, p, q, u);
+      for (int j = 0; j < n; j++) x_next[j] = x[j] + step[j];
+
+      // Check whether step reduces cost
+      next_cost = system.EvaluateCost(x_next, y);
+      if (next_cost < cost) break;
+      lambda *= 10;
+    }
+
+    // Check if found step that reduces cost (none does at a minimum reached by earlier steps)
+    if (!(next_cost < cost)) { converged = (naccepted > 0); break; }
+
+    // Accept step
+    RNScalar decrease = (cost - next_cost) / cost;
+    for (int j = 0; j < n; j++) x[j] = x_next[j];
+    cost = next_cost;
+    naccepted++;
+    if (lambda > 1E-12) lambda *= 0.1;
+
+    // Check for convergence
+    if (decrease < tolerance) { converged = TRUE; break; }
+  }
+
+  // Delete temporary data
+  delete [] y;
+  delete [] u;
+  delete [] jacobian;
+  delete [] gradient;
+  delete [] diagonal;
+  delete [] step;
+  delete [] x_next;
+  delete [] r;
+  delete [] z;
+  delete [] p;
+  delete [] q;
+
+  // Return whether converged to finite cost
+  if (!converged || !std::isfinite(cost)) return 0;
+  return 1;
+}
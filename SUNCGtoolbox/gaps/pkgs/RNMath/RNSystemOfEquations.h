@@ -47,6 +47,7 @@ public:
 
   // Optimization functions
   int Minimize(RNScalar *x, int solver = 0, RNScalar tolerance = RN_EPSILON) const;
+  int MinimizeWithLevenbergMarquardt(RNScalar *x, RNScalar tolerance = RN_EPSILON) const;
 
   // Print functions
   void PrintEquations(FILE *fp = stdout) const;
@@ -113,6 +114,7 @@ enum {
   RN_MINPACK_SOLVER,
   RN_SPLM_SOLVER,
   RN_CSPARSE_SOLVER,
+  RN_LEVENBERG_MARQUARDT_SOLVER,
   RN_NUM_SOLVERS
 };
 
@@ -291,10 +293,16 @@ MinimizeCERES(const RNSystemOfEquations *system, RNScalar *io, RNScalar toleranc
 static int 
 MinimizeCERES(const RNSystemOfEquations *system, RNScalar *io, RNScalar tolerance)
 {
-  // Print error message
-  fprintf(stderr, "Cannot minimize equation: Ceres solver disabled during compile.\n");
-  fprintf(stderr, "Enable it by adding -DRN_USE_CERES and -lceres xxx to compilation and link commands.\n");
-  return 0;
+  // Print notice once
+  static RNBoolean notified = FALSE;
+  if (!notified) {
+    fprintf(stderr, "Ceres solver disabled during compile, using built-in Levenberg-Marquardt solver instead.\n");
+    fprintf(stderr, "Enable it by adding -DRN_USE_CERES and -lceres xxx to compilation and link commands.\n");
+    notified = TRUE;
+  }
+
+  // Fall back to built-in solver (Ceres disabled during compile)
+  return system->MinimizeWithLevenbergMarquardt(io, tolerance);
 }
 
 #endif
@@ -443,10 +451,16 @@ MinimizeSPLM(const RNSystemOfEquations *system, RNScalar *io, RNScalar tolerance
 static int 
 MinimizeSPLM(const RNSystemOfEquations *system, RNScalar *io, RNScalar tolerance)
 {
-  // Print error message
-  fprintf(stderr, "Cannot minimize equation: SPLM solver disabled during compile.\n");
-  fprintf(stderr, "Enable it by adding -DRN_USE_SPLM and -lsplm to compilation and link commands.\n");
-  return 0;
+  // Print notice once
+  static RNBoolean notified = FALSE;
+  if (!notified) {
+    fprintf(stderr, "SPLM solver disabled during compile, using built-in Levenberg-Marquardt solver instead.\n");
+    fprintf(stderr, "Enable it by adding -DRN_USE_SPLM and -lsplm to compilation and link commands.\n");
+    notified = TRUE;
+  }
+
+  // Fall back to built-in solver (SPLM disabled during compile)
+  return system->MinimizeWithLevenbergMarquardt(io, tolerance);
 }
 
 #endif
@@ -631,10 +645,16 @@ MinimizeMINPACK(const RNSystemOfEquations *system, RNScalar *io, RNScalar tolera
 static int 
 MinimizeMINPACK(const RNSystemOfEquations *system, RNScalar *io, RNScalar tolerance)
 {
-  // Print error message
-  fprintf(stderr, "Cannot minimize equation: Minpack solver disabled during compile.\n");
-  fprintf(stderr, "Enable it by adding -DRN_USE_MINPACK and -lminpack to compilation and link commands.\n");
-  return 0;
+  // Print notice once
+  static RNBoolean notified = FALSE;
+  if (!notified) {
+    fprintf(stderr, "Minpack solver disabled during compile, using built-in Levenberg-Marquardt solver instead.\n");
+    fprintf(stderr, "Enable it by adding -DRN_USE_MINPACK and -lminpack to compilation and link commands.\n");
+    notified = TRUE;
+  }
+
+  // Fall back to built-in solver (Minpack disabled during compile)
+  return system->MinimizeWithLevenbergMarquardt(io, tolerance);
 }
 
 #endif
@@ -751,10 +771,16 @@ MinimizeCSPARSE(const RNSystemOfEquations *system, RNScalar *io, RNScalar tolera
 static int 
 MinimizeCSPARSE(const RNSystemOfEquations *system, RNScalar *io, RNScalar tolerance)
 {
-  // Print error message
-  fprintf(stderr, "Cannot minimize equation: CSparse solver disabled during compile.\n");
-  fprintf(stderr, "Enable it by adding -DRN_USE_CSPARSE and -lCSparse to compilation and link commands.\n");
-  return 0;
+  // Print notice once
+  static RNBoolean notified = FALSE;
+  if (!notified) {
+    fprintf(stderr, "CSparse solver disabled during compile, using built-in Levenberg-Marquardt solver instead.\n");
+    fprintf(stderr, "Enable it by adding -DRN_USE_CSPARSE and -lCSparse to compilation and link commands.\n");
+    notified = TRUE;
+  }
+
+  // Fall back to built-in solver (CSparse disabled during compile)
+  return system->MinimizeWithLevenbergMarquardt(io, tolerance);
 }
 
 #endif
@@ -770,6 +796,7 @@ Minimize(RNScalar *x, int solver, RNScalar tolerance) const
   else if (solver == RN_MINPACK_SOLVER) return MinimizeMINPACK(this, x, tolerance);
   else if (solver == RN_CERES_SOLVER) return MinimizeCERES(this, x, tolerance);
   else if (solver == RN_CSPARSE_SOLVER) return MinimizeCSPARSE(this, x, tolerance);
+  else if (solver == RN_LEVENBERG_MARQUARDT_SOLVER) return MinimizeWithLevenbergMarquardt(x, tolerance);
   fprintf(stderr, "System of equation solver not recognized: %d\n", solver);
   return 0;
 }
@@ -1,6 +1,6 @@
 import numpy as np
 import numpy.ctypeslib as npct
-from ctypes import c_void_p,c_int
+from ctypes import c_void_p,c_int,c_double,POINTER,CFUNCTYPE
 from ctypes import c_char_p
 
 # load the library, using numpy mechanisms
@@ -13,3 +13,31 @@ libcd.get_data.argtypes =  [c_char_p,c_void_p,c_int,c_int,c_int,c_char_p]
 
 def data_func(s, b, x, y, z,label_file):
 	return libcd.get_data(s,b,x,y,z,label_file)
+
+# streaming interface: points are produced one spatial brick at a time
+POINT_CALLBACK = CFUNCTYPE(None, POINTER(c_double), c_int, c_void_p)
+libcd.stream_data.restype = c_int
+libcd.stream_data.argtypes = [c_char_p,c_int,c_int,c_int,c_char_p,c_int,POINT_CALLBACK,c_void_p]
+libcd.write_data.restype = c_int
+libcd.write_data.argtypes = [c_char_p,c_int,c_int,c_int,c_char_p,c_int,c_char_p]
+
+
+def stream_func(s, x, y, z, label_file, brick_resolution, callback):
+	# callback(points) receives a (n,7) numpy array per brick
+	def brick_callback(points, npoints, data):
+		callback(np.ctypeslib.as_array(points, shape=(npoints, 7)).copy())
+	return libcd.stream_data(s,x,y,z,label_file,brick_resolution,POINT_CALLBACK(brick_callback),None)
+
+
+def write_func(s, x, y, z, label_file, brick_resolution, output_file):
+	# output_file holds float64 records of 7 values (np.fromfile(output_file).reshape(-1, 7))
+	return libcd.write_data(s,x,y,z,label_file,brick_resolution,output_file)
+
+# surfel scene export: one R3SurfelObject per label, blocks compressed in the database file
+libcd.write_surfels.restype = c_int
+libcd.write_surfels.argtypes = [c_char_p,c_int,c_int,c_int,c_char_p,c_int,c_char_p,c_char_p]
+
+
+def surfel_func(s, x, y, z, label_file, brick_resolution, scene_file, database_file):
+	# scene_file should end in .ssa or .ssb, database_file in .ssb
+	return libcd.write_surfels(s,x,y,z,label_file,brick_resolution,scene_file,database_file)